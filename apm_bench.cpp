@@ -0,0 +1,92 @@
+#include "bench.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <memory>
+#include <string>
+
+#include "api/audio/audio_frame.h"
+#include "modules/audio_processing/include/audio_processing.h"
+#include "audioprofile.h"
+
+namespace {
+
+// The voice engine runs APM at 48 kHz mono, 10 ms at a time.
+const int kSampleRate = 48000;
+const size_t kFrameSamples = kSampleRate / 100;
+const int kFrames = 3000;
+
+// Sets up |apm| the way WebRtcVoiceEngine::ApplyOptions() does for the
+// options AudioOptionsForFeatures(|features|) gives.
+void Configure(webrtc::AudioProcessing* apm, int features) {
+    cricket::AudioOptions options = AudioOptionsForFeatures(features);
+    webrtc::AudioProcessing::Config config;
+    config.echo_canceller.enabled = *options.echo_cancellation;
+    config.high_pass_filter.enabled = *options.highpass_filter;
+    config.residual_echo_detector.enabled = *options.residual_echo_detector;
+    apm->ApplyConfig(config);
+    apm->noise_suppression()->set_level(webrtc::NoiseSuppression::kHigh);
+    apm->noise_suppression()->Enable(*options.noise_suppression);
+    apm->gain_control()->set_mode(webrtc::GainControl::kAdaptiveAnalog);
+    apm->gain_control()->set_analog_level_limits(0, 255);
+    apm->gain_control()->Enable(*options.auto_gain_control);
+    // Typing detection runs on the VAD's decisions.
+    apm->voice_detection()->Enable(*options.typing_detection);
+}
+
+// A talker picked up with some room noise, and the far end playing out.
+void FillFrames(webrtc::AudioFrame* capture, webrtc::AudioFrame* render, int index) {
+    int16_t near[kFrameSamples];
+    int16_t far[kFrameSamples];
+    for (size_t i = 0; i < kFrameSamples; ++i) {
+        double t = static_cast<double>(index * kFrameSamples + i) / kSampleRate;
+        far[i] = static_cast<int16_t>(6000 * sin(2 * M_PI * 330 * t));
+        near[i] = static_cast<int16_t>(4000 * sin(2 * M_PI * 220 * t) + far[i] / 8 +
+                                       (rand() % 400) - 200);
+    }
+    capture->UpdateFrame(0, near, kFrameSamples, kSampleRate,
+                         webrtc::AudioFrame::kNormalSpeech,
+                         webrtc::AudioFrame::kVadUnknown, 1);
+    render->UpdateFrame(0, far, kFrameSamples, kSampleRate,
+                        webrtc::AudioFrame::kNormalSpeech,
+                        webrtc::AudioFrame::kVadUnknown, 1);
+}
+
+}  // namespace
+
+// What one 10 ms frame costs in APM under each audio profile: the render
+// side for the echo canceller, then the capture side, as the ADM drives
+// them.  The last column is the share of one core that takes in real time.
+BENCHMARK(AudioProfileCost) {
+    const AudioProfile profiles[] = {
+        kAudioProfileFull, kAudioProfileHeadset, kAudioProfileLowCpu,
+        kAudioProfilePassthrough,
+    };
+    for (AudioProfile profile : profiles) {
+        std::unique_ptr<webrtc::AudioProcessing> apm(
+                    webrtc::AudioProcessingBuilder().Create());
+        Configure(apm.get(), AudioProfileFeatures(profile));
+
+        webrtc::AudioFrame capture;
+        webrtc::AudioFrame render;
+        int analog_level = 128;
+        int64_t total_ns = 0;
+        for (int i = 0; i < kFrames; ++i) {
+            srand(i);
+            FillFrames(&capture, &render, i);
+            int64_t start_ns = BenchNowNs();
+            apm->ProcessReverseStream(&render);
+            apm->set_stream_delay_ms(40);
+            apm->gain_control()->set_stream_analog_level(analog_level);
+            apm->ProcessStream(&capture);
+            analog_level = apm->gain_control()->stream_analog_level();
+            total_ns += BenchNowNs() - start_ns;
+            BenchKeep(capture);
+        }
+        double frame_ns = static_cast<double>(total_ns) / kFrames;
+        std::string label = std::string("profile ") + AudioProfileName(profile);
+        printf("  %-40s %10.1f ns/frame  (%.2f%% of a core)\n", label.c_str(),
+               frame_ns, frame_ns / (10 * 1000 * 1000) * 100);
+    }
+}
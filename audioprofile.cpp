@@ -0,0 +1,66 @@
+#include "audioprofile.h"
+
+namespace {
+
+struct ProfileEntry {
+    AudioProfile profile;
+    const char* name;
+    int features;
+};
+
+const ProfileEntry kProfiles[] = {
+    {kAudioProfileFull, "full",
+     kFeatureEchoCancellation | kFeatureNoiseSuppression | kFeatureGainControl |
+     kFeatureHighPassFilter | kFeatureTypingDetection},
+    {kAudioProfileHeadset, "headset",
+     kFeatureNoiseSuppression | kFeatureGainControl | kFeatureHighPassFilter},
+    {kAudioProfileLowCpu, "low-cpu",
+     kFeatureEchoCancellation | kFeatureNoiseSuppression | kFeatureHighPassFilter},
+    {kAudioProfilePassthrough, "passthrough", 0},
+};
+
+const ProfileEntry& Entry(AudioProfile profile) {
+    for (const ProfileEntry& entry : kProfiles) {
+        if (entry.profile == profile)
+            return entry;
+    }
+    return kProfiles[0];
+}
+
+}  // namespace
+
+const char* AudioProfileName(AudioProfile profile) {
+    return Entry(profile).name;
+}
+
+bool ParseAudioProfile(const std::string& name, AudioProfile* profile) {
+    for (const ProfileEntry& entry : kProfiles) {
+        if (name == entry.name) {
+            *profile = entry.profile;
+            return true;
+        }
+    }
+    return false;
+}
+
+int AudioProfileFeatures(AudioProfile profile) {
+    return Entry(profile).features;
+}
+
+cricket::AudioOptions AudioOptionsForFeatures(int features) {
+    cricket::AudioOptions options;
+    options.echo_cancellation = (features & kFeatureEchoCancellation) != 0;
+    options.noise_suppression = (features & kFeatureNoiseSuppression) != 0;
+    options.auto_gain_control = (features & kFeatureGainControl) != 0;
+    options.highpass_filter = (features & kFeatureHighPassFilter) != 0;
+    options.typing_detection = (features & kFeatureTypingDetection) != 0;
+    // Only the full chain keeps the residual echo detector; the
+    // experimental variants stay at the engine's default, off.
+    options.residual_echo_detector =
+            features == AudioProfileFeatures(kAudioProfileFull);
+    options.experimental_agc = false;
+    options.experimental_ns = false;
+    options.extended_filter_aec = false;
+    options.delay_agnostic_aec = false;
+    return options;
+}
@@ -0,0 +1,45 @@
+#ifndef AUDIOPROFILE_H
+#define AUDIOPROFILE_H
+
+#include <string>
+
+#include "api/audio_options.h"
+
+// Named sets of capture-path processing (AudioProcessing, "APM").
+enum AudioProfile {
+    // Echo cancellation, noise suppression, gain control, high-pass filter
+    // and typing detection: WebRTC's defaults.
+    kAudioProfileFull,
+    // No echo to cancel with a headset; keeps NS, AGC and high-pass.
+    kAudioProfileHeadset,
+    // Echo cancellation, NS and high-pass only; no AGC, typing detection
+    // or residual echo detector.
+    kAudioProfileLowCpu,
+    // Nothing; APM leaves the capture signal alone.  For bridges and other
+    // endpoints without a microphone in a room.
+    kAudioProfilePassthrough,
+};
+
+// "full", "headset", "low-cpu", "passthrough".
+const char* AudioProfileName(AudioProfile profile);
+bool ParseAudioProfile(const std::string& name, AudioProfile* profile);
+
+// Processing steps, as bits.
+enum AudioProcessingFeature {
+    kFeatureEchoCancellation = 1 << 0,
+    kFeatureNoiseSuppression = 1 << 1,
+    kFeatureGainControl = 1 << 2,
+    kFeatureHighPassFilter = 1 << 3,
+    kFeatureTypingDetection = 1 << 4,
+};
+
+// What |profile| runs.  All calls share one capture path, so what actually
+// runs is the union over the calls in progress.
+int AudioProfileFeatures(AudioProfile profile);
+
+// Options for an audio source that makes the voice engine configure APM
+// with exactly |features|.  Every option is set, since the engine keeps
+// the previous value of any that isn't.
+cricket::AudioOptions AudioOptionsForFeatures(int features);
+
+#endif // AUDIOPROFILE_H
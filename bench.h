@@ -0,0 +1,67 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <chrono>
+
+// A few lines of harness for webrtc-bench.pro.  Each *_bench.cpp defines its
+// cases with BENCHMARK(); bench_main.cpp runs the ones whose name contains
+// the first command line argument, or all of them.  Cases print their own
+// results, one line per measurement, usually through BenchTime().
+//
+//   BENCHMARK(ParseResponse) {
+//       BenchTime("parse 1KB", 100000, [&]() { ... });
+//   }
+
+typedef void (*BenchFunction)();
+
+class BenchRegistration
+{
+public:
+    BenchRegistration(const char* name, BenchFunction function);
+
+    // Runs the registered cases whose name contains |filter|; all when null.
+    // Returns how many ran.
+    static int RunAll(const char* filter);
+
+private:
+    const char* name_;
+    BenchFunction function_;
+    BenchRegistration* next_;
+};
+
+#define BENCHMARK(name)                                                      \
+    static void name();                                                      \
+    static BenchRegistration name##_registration(#name, name);               \
+    static void name()
+
+inline int64_t BenchNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// User plus system CPU time of the process.
+int64_t BenchCpuTimeUs();
+
+// Keeps the compiler from dropping a computation whose result is unused.
+template <typename T>
+inline void BenchKeep(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+// Runs |body| |iterations| times, after a tenth as many to warm up, and
+// prints the mean time per iteration.
+template <typename Body>
+void BenchTime(const char* label, int iterations, Body body) {
+    for (int i = 0; i < iterations / 10 + 1; ++i)
+        body();
+    int64_t start_ns = BenchNowNs();
+    for (int i = 0; i < iterations; ++i)
+        body();
+    int64_t elapsed_ns = BenchNowNs() - start_ns;
+    printf("  %-40s %10.1f ns/iter  (%d iterations)\n", label,
+           static_cast<double>(elapsed_ns) / iterations, iterations);
+}
+
+#endif // BENCH_H
@@ -0,0 +1,57 @@
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <QCoreApplication>
+
+#include "bench.h"
+
+// Micro benchmarks for the hot paths whose speed-ups are claimed in the code;
+// see bench.h.  Build in release: qmake CONFIG+=release webrtc-bench.pro.
+//
+//   webrtc-bench [filter]
+
+namespace {
+
+BenchRegistration* registrations = nullptr;
+
+}  // namespace
+
+BenchRegistration::BenchRegistration(const char* name, BenchFunction function)
+    : name_(name), function_(function), next_(registrations) {
+    registrations = this;
+}
+
+int BenchRegistration::RunAll(const char* filter) {
+    int ran = 0;
+    for (BenchRegistration* bench = registrations; bench; bench = bench->next_) {
+        if (filter && !strstr(bench->name_, filter))
+            continue;
+        printf("%s\n", bench->name_);
+        fflush(stdout);
+        bench->function_();
+        fflush(stdout);
+        ++ran;
+    }
+    return ran;
+}
+
+int64_t BenchCpuTimeUs() {
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    return (static_cast<int64_t>(usage.ru_utime.tv_sec) + usage.ru_stime.tv_sec) * 1000000 +
+            usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+int main(int argc, char *argv[])
+{
+    // Some cases run the Qt dispatcher.
+    QCoreApplication app(argc, argv);
+
+    const char* filter = argc > 1 ? argv[1] : nullptr;
+    if (BenchRegistration::RunAll(filter) == 0) {
+        fprintf(stderr, "No benchmark matches %s\n", filter);
+        return 1;
+    }
+    return 0;
+}
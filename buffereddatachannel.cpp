@@ -0,0 +1,117 @@
+#include "buffereddatachannel.h"
+
+#include <utility>
+
+#include "rtc_base/checks.h"
+
+DataChannelOptions::DataChannelOptions()
+    : ordered(true),
+      max_retransmits(-1),
+      max_packet_life_time_ms(-1) {
+}
+
+BufferedDataChannel::BufferedDataChannel(
+        int peer_id, rtc::scoped_refptr<webrtc::DataChannelInterface> channel,
+        BufferedDataChannelObserver* observer)
+    : peer_id_(peer_id),
+      channel_(std::move(channel)),
+      observer_(observer),
+      queued_bytes_(0),
+      refused_(false) {
+    RTC_DCHECK(channel_);
+    channel_->RegisterObserver(this);
+}
+
+BufferedDataChannel::~BufferedDataChannel() {
+    channel_->UnregisterObserver();
+    channel_->Close();
+}
+
+webrtc::DataChannelInit BufferedDataChannel::ToInit(const DataChannelOptions& options) {
+    RTC_DCHECK(options.max_retransmits < 0 || options.max_packet_life_time_ms < 0);
+    webrtc::DataChannelInit init;
+    init.ordered = options.ordered;
+    if (options.max_retransmits >= 0)
+        init.maxRetransmits = options.max_retransmits;
+    if (options.max_packet_life_time_ms >= 0)
+        init.maxRetransmitTime = options.max_packet_life_time_ms;
+    return init;
+}
+
+bool BufferedDataChannel::open() const {
+    return channel_->state() == webrtc::DataChannelInterface::kOpen;
+}
+
+bool BufferedDataChannel::closed() const {
+    return channel_->state() == webrtc::DataChannelInterface::kClosed;
+}
+
+bool BufferedDataChannel::Send(const rtc::CopyOnWriteBuffer& data, bool binary) {
+    webrtc::DataChannelInterface::DataState state = channel_->state();
+    if (state == webrtc::DataChannelInterface::kClosing ||
+            state == webrtc::DataChannelInterface::kClosed)
+        return false;
+    // An oversized message is still taken when nothing else is waiting, or
+    // it could never be sent.
+    if (!queue_.empty() && queued_bytes_ + data.size() > kMaxQueuedBytes) {
+        refused_ = true;
+        return false;
+    }
+    queue_.emplace_back(data, binary);
+    queued_bytes_ += data.size();
+    Pump();
+    return true;
+}
+
+bool BufferedDataChannel::Send(const std::string& text) {
+    return Send(rtc::CopyOnWriteBuffer(text.data(), text.size()), false);
+}
+
+void BufferedDataChannel::Close() {
+    queue_.clear();
+    queued_bytes_ = 0;
+    channel_->Close();
+}
+
+void BufferedDataChannel::Pump() {
+    if (!open())
+        return;
+    while (!queue_.empty() && channel_->buffered_amount() < kHighWaterMark) {
+        if (!channel_->Send(queue_.front()))
+            break;  // Closing; OnStateChange() follows.
+        queued_bytes_ -= queue_.front().size();
+        queue_.pop_front();
+    }
+}
+
+void BufferedDataChannel::NotifyIfWritable() {
+    if (refused_ && queued_bytes_ <= kMaxQueuedBytes / 2) {
+        refused_ = false;
+        observer_->OnChannelWritable(this);
+    }
+}
+
+void BufferedDataChannel::OnStateChange() {
+    webrtc::DataChannelInterface::DataState state = channel_->state();
+    if (state == webrtc::DataChannelInterface::kOpen) {
+        Pump();
+        NotifyIfWritable();
+    } else if (state == webrtc::DataChannelInterface::kClosed) {
+        queue_.clear();
+        queued_bytes_ = 0;
+    } else {
+        return;
+    }
+    observer_->OnChannelStateChange(this);
+}
+
+void BufferedDataChannel::OnMessage(const webrtc::DataBuffer& buffer) {
+    observer_->OnChannelMessage(this, buffer);
+}
+
+void BufferedDataChannel::OnBufferedAmountChange(uint64_t sent_data_size) {
+    if (channel_->buffered_amount() > kLowWaterMark)
+        return;
+    Pump();
+    NotifyIfWritable();
+}
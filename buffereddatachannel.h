@@ -0,0 +1,101 @@
+#ifndef BUFFEREDDATACHANNEL_H
+#define BUFFEREDDATACHANNEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <deque>
+#include <string>
+
+#include "api/data_channel_interface.h"
+#include "rtc_base/copy_on_write_buffer.h"
+
+// How a data channel delivers.  Reliable and ordered by default; setting
+// one of the limits makes it partially reliable.
+struct DataChannelOptions {
+    DataChannelOptions();
+
+    bool ordered;
+    // Give up on a message after this many retransmissions, or after it
+    // has been in flight this long.  -1 for no limit; at most one of them.
+    int max_retransmits;
+    int max_packet_life_time_ms;
+};
+
+class BufferedDataChannel;
+
+class BufferedDataChannelObserver {
+public:
+    // The channel opened or closed; see BufferedDataChannel::open().
+    virtual void OnChannelStateChange(BufferedDataChannel* channel) = 0;
+    virtual void OnChannelMessage(BufferedDataChannel* channel,
+                                  const webrtc::DataBuffer& buffer) = 0;
+    // Send() turned a message away and there's room again.
+    virtual void OnChannelWritable(BufferedDataChannel* channel) = 0;
+
+protected:
+    virtual ~BufferedDataChannelObserver() {}
+};
+
+// A data channel with send-side flow control.  WebRTC buffers whatever
+// doesn't fit SCTP's window and closes the channel once that buffer passes
+// 16 MB, so writing as fast as possible is not an option.  Here messages
+// are handed to the channel only while its bufferedAmount is under
+// kHighWaterMark; the rest wait in a queue that is topped up, as many
+// messages at a time as fit, whenever bufferedAmount drains below
+// kLowWaterMark.  The queue is bounded too: past kMaxQueuedBytes Send()
+// refuses, and OnChannelWritable() says when to try again.
+//
+// Messages are reference-counted buffers, so queueing copies no payload.
+// Everything runs on the signaling thread.
+class BufferedDataChannel : public webrtc::DataChannelObserver
+{
+public:
+    static const uint64_t kHighWaterMark = 1024 * 1024;
+    static const uint64_t kLowWaterMark = 256 * 1024;
+    static const size_t kMaxQueuedBytes = 4 * 1024 * 1024;
+
+    BufferedDataChannel(int peer_id,
+                        rtc::scoped_refptr<webrtc::DataChannelInterface> channel,
+                        BufferedDataChannelObserver* observer);
+    // Closes the channel.
+    ~BufferedDataChannel() override;
+
+    static webrtc::DataChannelInit ToInit(const DataChannelOptions& options);
+
+    int peer_id() const { return peer_id_; }
+    std::string label() const { return channel_->label(); }
+    bool open() const;
+    bool closed() const;
+    // Waiting here; buffered_amount() is what the channel itself holds.
+    size_t queued_bytes() const { return queued_bytes_; }
+    uint64_t buffered_amount() const { return channel_->buffered_amount(); }
+
+    // Queues one message.  Messages sent before the channel opens go out
+    // when it does.  Returns false if the channel is closing or closed, or
+    // the queue is full.
+    bool Send(const rtc::CopyOnWriteBuffer& data, bool binary);
+    bool Send(const std::string& text);
+    void Close();
+
+    // DataChannelObserver implementation.
+    void OnStateChange() override;
+    void OnMessage(const webrtc::DataBuffer& buffer) override;
+    void OnBufferedAmountChange(uint64_t sent_data_size) override;
+
+private:
+    // Hands queued messages to the channel up to the high-water mark.
+    void Pump();
+    // Calls OnChannelWritable() if a refused sender can go on.  Never from
+    // inside Send(), so observers may send from the callback.
+    void NotifyIfWritable();
+
+    const int peer_id_;
+    rtc::scoped_refptr<webrtc::DataChannelInterface> channel_;
+    BufferedDataChannelObserver* observer_;
+    std::deque<webrtc::DataBuffer> queue_;
+    size_t queued_bytes_;
+    // Send() refused something since the last OnChannelWritable().
+    bool refused_;
+};
+
+#endif // BUFFEREDDATACHANNEL_H
@@ -0,0 +1,314 @@
+#include "callrecorder.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <QDebug>
+
+#include "rtc_base/time_utils.h"
+
+namespace {
+
+// The rings hold 2.5 s, so this leaves plenty of room for a slow disk.
+const int kWriteIntervalMs = 20;
+const size_t kWavHeaderSize = 44;
+// stdio buffer per open file, allocated once when the recording starts.
+const size_t kFileBufferSize = 64 * 1024;
+
+void PutLittleEndian(uint8_t* out, uint32_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; ++i)
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+// 16-bit PCM WAV.  The sizes in the header are patched on Close().
+class WavFileWriter
+{
+public:
+    WavFileWriter() : file_(nullptr), sample_rate_hz_(0), channels_(0), data_bytes_(0) {}
+    ~WavFileWriter() { Close(); }
+
+    bool Open(const std::string& path, int sample_rate_hz, size_t channels,
+              char* buffer, size_t buffer_size) {
+        Close();
+        file_ = fopen(path.c_str(), "wb");
+        if (!file_) {
+            qDebug() << "Can't open recording" << path.c_str() << strerror(errno);
+            return false;
+        }
+        setvbuf(file_, buffer, _IOFBF, buffer_size);
+        sample_rate_hz_ = sample_rate_hz;
+        channels_ = channels;
+        data_bytes_ = 0;
+        WriteHeader();
+        return true;
+    }
+
+    bool is_open() const { return file_ != nullptr; }
+    int sample_rate_hz() const { return sample_rate_hz_; }
+    size_t channels() const { return channels_; }
+
+    // Samples are written as they are in memory; WAV is little-endian, as
+    // are all the platforms this builds for.
+    void Write(const int16_t* samples, size_t count) {
+        size_t written = fwrite(samples, sizeof(int16_t), count, file_);
+        data_bytes_ += static_cast<uint32_t>(written * sizeof(int16_t));
+    }
+
+    void Close() {
+        if (!file_)
+            return;
+        fseek(file_, 0, SEEK_SET);
+        WriteHeader();
+        fclose(file_);
+        file_ = nullptr;
+    }
+
+private:
+    void WriteHeader() {
+        const uint32_t block_align = static_cast<uint32_t>(channels_ * sizeof(int16_t));
+        uint8_t header[kWavHeaderSize];
+        memcpy(header, "RIFF", 4);
+        PutLittleEndian(header + 4, 36 + data_bytes_, 4);
+        memcpy(header + 8, "WAVEfmt ", 8);
+        PutLittleEndian(header + 16, 16, 4);  // fmt chunk size
+        PutLittleEndian(header + 20, 1, 2);   // PCM
+        PutLittleEndian(header + 22, static_cast<uint32_t>(channels_), 2);
+        PutLittleEndian(header + 24, static_cast<uint32_t>(sample_rate_hz_), 4);
+        PutLittleEndian(header + 28, static_cast<uint32_t>(sample_rate_hz_) * block_align, 4);
+        PutLittleEndian(header + 32, block_align, 2);
+        PutLittleEndian(header + 34, 16, 2);  // bits per sample
+        memcpy(header + 36, "data", 4);
+        PutLittleEndian(header + 40, data_bytes_, 4);
+        fwrite(header, 1, sizeof(header), file_);
+    }
+
+    FILE* file_;
+    int sample_rate_hz_;
+    size_t channels_;
+    uint32_t data_bytes_;
+};
+
+}  // namespace
+
+AudioFrameRing::AudioFrameRing()
+    : frames_(new Frame[kCapacity]),
+      head_(0),
+      tail_(0),
+      dropped_(0) {
+}
+
+bool AudioFrameRing::Push(const int16_t* data, int sample_rate_hz, size_t channels,
+                          size_t samples_per_channel) {
+    const size_t count = channels * samples_per_channel;
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    if (count > kMaxSamples ||
+            head - tail_.load(std::memory_order_acquire) == kCapacity) {
+        CountDrop();
+        return false;
+    }
+    Frame& frame = frames_[head & (kCapacity - 1)];
+    frame.sample_rate_hz = sample_rate_hz;
+    frame.channels = channels;
+    frame.samples_per_channel = samples_per_channel;
+    memcpy(frame.data, data, count * sizeof(int16_t));
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+const AudioFrameRing::Frame* AudioFrameRing::Front() const {
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    if (head_.load(std::memory_order_acquire) == tail)
+        return nullptr;
+    return &frames_[tail & (kCapacity - 1)];
+}
+
+void AudioFrameRing::Release() {
+    tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+// One recorded track.  OnData() runs on the audio thread, Drain() and
+// Finish() on the writer, the rest on the signaling thread.
+class CallRecorder::Recording : public webrtc::AudioTrackSinkInterface
+{
+public:
+    Recording(int peer_id, webrtc::AudioTrackInterface* track, const std::string& path)
+        : peer_id_(peer_id),
+          track_(track),
+          path_(path),
+          stopped_(false),
+          buffer_(new char[kFileBufferSize]),
+          files_(0) {
+    }
+
+    int peer_id() const { return peer_id_; }
+    webrtc::AudioTrackInterface* track() const { return track_.get(); }
+    void set_stopped() {
+        track_ = nullptr;
+        stopped_.store(true, std::memory_order_release);
+    }
+    // Stopped and nothing more will be pushed.
+    bool stopped() const { return stopped_.load(std::memory_order_acquire); }
+
+    void OnData(const void* audio_data, int bits_per_sample, int sample_rate,
+                size_t number_of_channels, size_t number_of_frames) override {
+        if (bits_per_sample != 16) {
+            ring_.CountDrop();
+            return;
+        }
+        ring_.Push(static_cast<const int16_t*>(audio_data), sample_rate,
+                   number_of_channels, number_of_frames);
+    }
+
+    void Drain() {
+        while (const AudioFrameRing::Frame* frame = ring_.Front()) {
+            if (!file_.is_open() || frame->sample_rate_hz != file_.sample_rate_hz() ||
+                    frame->channels != file_.channels()) {
+                std::string path = path_;
+                if (files_ > 0)
+                    path += "-" + std::to_string(files_ + 1);
+                ++files_;
+                file_.Open(path + ".wav", frame->sample_rate_hz, frame->channels,
+                           buffer_.get(), kFileBufferSize);
+            }
+            if (file_.is_open())
+                file_.Write(frame->data, frame->channels * frame->samples_per_channel);
+            ring_.Release();
+        }
+    }
+
+    void Finish() {
+        Drain();
+        file_.Close();
+        qDebug() << "Recording" << path_.c_str() << "finished;"
+                 << ring_.dropped() << "frames dropped";
+    }
+
+private:
+    const int peer_id_;
+    rtc::scoped_refptr<webrtc::AudioTrackInterface> track_;
+    // Without the .wav extension.
+    const std::string path_;
+    std::atomic<bool> stopped_;
+    AudioFrameRing ring_;
+    // Writer state.  |buffer_| backs |file_| and must outlive it.
+    std::unique_ptr<char[]> buffer_;
+    WavFileWriter file_;
+    int files_;
+};
+
+CallRecorder::CallRecorder()
+    : stopping_(false) {
+}
+
+CallRecorder::~CallRecorder() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& recording : recordings_) {
+            if (!recording->stopped())
+                Detach(recording.get());
+        }
+        stopping_ = true;
+    }
+    writer_wakeup_.notify_one();
+    if (writer_.joinable())
+        writer_.join();
+    DrainAll();
+}
+
+void CallRecorder::SetDirectory(const std::string& directory) {
+    directory_ = directory;
+}
+
+bool CallRecorder::Start(int peer_id, webrtc::AudioTrackInterface* track) {
+    if (!enabled())
+        return false;
+    std::string path = directory_ + "/call-" + std::to_string(peer_id) + "-" +
+            std::to_string(rtc::TimeUTCMillis()) + "-" + track->id();
+    std::shared_ptr<Recording> recording(new Recording(peer_id, track, path));
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& existing : recordings_) {
+            if (existing->track() == track)
+                return true;  // Already recording.
+        }
+        recordings_.push_back(recording);
+        if (!writer_.joinable())
+            writer_ = std::thread(&CallRecorder::WriterLoop, this);
+    }
+    track->AddSink(recording.get());
+    qDebug() << "Recording peer" << peer_id << "to" << (path + ".wav").c_str();
+    return true;
+}
+
+void CallRecorder::Stop(webrtc::AudioTrackInterface* track) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& recording : recordings_) {
+        if (recording->track() == track)
+            Detach(recording.get());
+    }
+}
+
+void CallRecorder::StopCall(int peer_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& recording : recordings_) {
+        if (recording->peer_id() == peer_id && !recording->stopped())
+            Detach(recording.get());
+    }
+}
+
+bool CallRecorder::recording(int peer_id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& recording : recordings_) {
+        if (recording->peer_id() == peer_id && !recording->stopped())
+            return true;
+    }
+    return false;
+}
+
+void CallRecorder::Detach(Recording* recording) {
+    // Once RemoveSink() returns the audio thread is done with the sink, so
+    // everything it pushed is visible to the writer.
+    recording->track()->RemoveSink(recording);
+    recording->set_stopped();
+}
+
+void CallRecorder::WriterLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+        writer_wakeup_.wait_for(lock, std::chrono::milliseconds(kWriteIntervalMs));
+        lock.unlock();
+        DrainAll();
+        lock.lock();
+    }
+}
+
+void CallRecorder::DrainAll() {
+    std::vector<std::shared_ptr<Recording>> recordings;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        recordings = recordings_;
+    }
+    std::vector<Recording*> finished;
+    for (const auto& recording : recordings) {
+        // Read before draining so that nothing pushed before the stop is
+        // left behind.
+        bool stopped = recording->stopped();
+        if (stopped) {
+            recording->Finish();
+            finished.push_back(recording.get());
+        } else {
+            recording->Drain();
+        }
+    }
+    if (finished.empty())
+        return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    recordings_.erase(std::remove_if(recordings_.begin(), recordings_.end(),
+                                     [&finished](const std::shared_ptr<Recording>& recording) {
+                                         return std::find(finished.begin(), finished.end(),
+                                                          recording.get()) != finished.end();
+                                     }),
+                      recordings_.end());
+}
@@ -0,0 +1,104 @@
+#ifndef CALLRECORDER_H
+#define CALLRECORDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "api/media_stream_interface.h"
+
+// 10 ms PCM frames handed from an audio thread to the recorder's writer.
+// Single producer, single consumer, no locks; every slot is allocated up
+// front so pushing never allocates.
+class AudioFrameRing
+{
+public:
+    static const size_t kCapacity = 256;
+    // 10 ms of 48 kHz stereo, the most a remote track delivers at once.
+    static const size_t kMaxSamples = 960;
+
+    struct Frame {
+        int sample_rate_hz;
+        size_t channels;
+        size_t samples_per_channel;
+        int16_t data[kMaxSamples];
+    };
+
+    AudioFrameRing();
+
+    // Producer side; returns false (and counts a drop) when full or when
+    // the frame doesn't fit a slot.
+    bool Push(const int16_t* data, int sample_rate_hz, size_t channels,
+              size_t samples_per_channel);
+    // Consumer side: the oldest frame, or nullptr.  It's read in place and
+    // stays valid until Release().
+    const Frame* Front() const;
+    void Release();
+
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+    void CountDrop() { dropped_.fetch_add(1, std::memory_order_relaxed); }
+
+private:
+    static_assert((kCapacity & (kCapacity - 1)) == 0, "must be a power of two");
+
+    std::unique_ptr<Frame[]> frames_;
+    // Free-running, like TraceRing's, and padded apart for the same reason.
+    std::atomic<uint64_t> head_;
+    char padding_[64 - sizeof(std::atomic<uint64_t>)];
+    std::atomic<uint64_t> tail_;
+    std::atomic<uint64_t> dropped_;
+};
+
+// Records remote audio tracks to WAV files, one per track, for compliance
+// recording.  The sink on the track only copies each frame into its ring;
+// a writer thread drains the rings to disk every few tens of milliseconds,
+// so the audio thread never waits on I/O or a lock.  A ring holds 2.5 s of
+// audio; if the disk stalls longer than that, frames are dropped (and
+// counted) rather than delaying playout.
+//
+// Start()/Stop() are called from the signaling thread.
+class CallRecorder
+{
+public:
+    CallRecorder();
+    // Writes out what's buffered and closes every file.
+    ~CallRecorder();
+
+    // Where recordings go; empty, the default, disables recording.
+    void SetDirectory(const std::string& directory);
+    bool enabled() const { return !directory_.empty(); }
+
+    // Records |track| of the call with |peer_id| to
+    // <directory>/call-<peer_id>-<unix time ms>-<track id>.wav.  A change of
+    // sample rate or channel count starts a new file with a -<n> suffix.
+    bool Start(int peer_id, webrtc::AudioTrackInterface* track);
+    // Detaches from |track|; frames already buffered are still written.
+    void Stop(webrtc::AudioTrackInterface* track);
+    void StopCall(int peer_id);
+    bool recording(int peer_id) const;
+
+private:
+    class Recording;
+
+    // Detaches |recording| from its track; the writer finishes it.
+    void Detach(Recording* recording);
+    void WriterLoop();
+    // Drains every ring and closes the recordings that were stopped.
+    void DrainAll();
+
+    std::string directory_;
+    // Shared with the writer; held to change the list, never while writing.
+    mutable std::mutex mutex_;
+    std::vector<std::shared_ptr<Recording>> recordings_;
+    std::thread writer_;
+    std::condition_variable writer_wakeup_;
+    bool stopping_;
+};
+
+#endif // CALLRECORDER_H
@@ -0,0 +1,67 @@
+#include "calltimeline.h"
+
+#include <stdio.h>
+
+#include "rtc_base/time_utils.h"
+
+namespace {
+
+const char* const kPhaseNames[kCallPhaseCount] = {
+    "started",
+    "offer_created",
+    "offer_sent",
+    "offer_received",
+    "answer_created",
+    "answer_sent",
+    "answer_received",
+    "first_candidate",
+    "ice_checking",
+    "ice_connected",
+    "dtls_connected",
+    "first_audio_packet",
+};
+
+void AppendField(std::string* json, const char* name, long long value) {
+    char field[64];
+    int length = snprintf(field, sizeof(field), ",\"%s\":%lld", name, value);
+    if (length > 0 && static_cast<size_t>(length) < sizeof(field))
+        json->append(field, length);
+}
+
+}  // namespace
+
+const char* CallPhaseName(CallPhase phase) {
+    return phase >= 0 && phase < kCallPhaseCount ? kPhaseNames[phase] : "unknown";
+}
+
+CallTimeline::CallTimeline() {
+    Reset();
+}
+
+void CallTimeline::Reset() {
+    for (int64_t& at : at_ms_)
+        at = -1;
+    reported_ = false;
+}
+
+void CallTimeline::Mark(CallPhase phase) {
+    if (!reached(phase))
+        at_ms_[phase] = rtc::TimeMillis();
+}
+
+int64_t CallTimeline::OffsetMs(CallPhase phase) const {
+    return at_ms_[phase] - at_ms_[kPhaseStarted];
+}
+
+std::string CallTimeline::ToJson(int peer_id, int64_t sign_in_ms) const {
+    std::string json = "{\"peer\":" + std::to_string(peer_id);
+    if (sign_in_ms >= 0)
+        AppendField(&json, "sign_in_ms", sign_in_ms);
+    for (int i = kPhaseStarted + 1; i < kCallPhaseCount; ++i) {
+        CallPhase phase = static_cast<CallPhase>(i);
+        if (reached(phase) && reached(kPhaseStarted))
+            AppendField(&json, CallPhaseName(phase), OffsetMs(phase));
+    }
+    json += '}';
+    return json;
+}
@@ -0,0 +1,62 @@
+#ifndef CALLTIMELINE_H
+#define CALLTIMELINE_H
+
+#include <stdint.h>
+#include <string>
+
+// Milestones of one call's setup.  A caller goes through the offer_created,
+// offer_sent and answer_received phases; a callee through offer_received,
+// answer_created and answer_sent.  The rest apply to both.
+enum CallPhase {
+    // The session was bound to the peer.  Offsets are measured from here.
+    kPhaseStarted,
+    kPhaseOfferCreated,
+    kPhaseOfferSent,
+    kPhaseOfferReceived,
+    kPhaseAnswerCreated,
+    kPhaseAnswerSent,
+    kPhaseAnswerReceived,
+    // First local candidate; before kPhaseStarted for pooled sessions.
+    kPhaseFirstCandidate,
+    kPhaseIceChecking,
+    kPhaseIceConnected,
+    // ICE and DTLS both connected (PeerConnectionState::kConnected).
+    kPhaseDtlsConnected,
+    kPhaseFirstAudioPacket,
+    kCallPhaseCount,
+};
+
+// "offer_created" and so on.
+const char* CallPhaseName(CallPhase phase);
+
+// When each phase of a call was first reached.
+class CallTimeline
+{
+public:
+    CallTimeline();
+
+    void Reset();
+    // Records now, unless |phase| was already reached.
+    void Mark(CallPhase phase);
+
+    bool reached(CallPhase phase) const { return at_ms_[phase] >= 0; }
+    // rtc::TimeMillis() of |phase|, -1 if not reached.
+    int64_t at_ms(CallPhase phase) const { return at_ms_[phase]; }
+    // Milliseconds from kPhaseStarted to |phase|, negative for phases that
+    // happened before the call was placed.  Both must have been reached.
+    int64_t OffsetMs(CallPhase phase) const;
+
+    // The summary has been handed out; see Conductor::ReportCallTimeline().
+    bool reported() const { return reported_; }
+    void set_reported(bool reported) { reported_ = reported; }
+
+    // One-line JSON object: {"peer":7,"sign_in_ms":41,"offer_created":3,...}
+    // with the offset of every phase reached.  |sign_in_ms| < 0 leaves it out.
+    std::string ToJson(int peer_id, int64_t sign_in_ms) const;
+
+private:
+    int64_t at_ms_[kCallPhaseCount];
+    bool reported_;
+};
+
+#endif // CALLTIMELINE_H
@@ -2,14 +2,21 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <algorithm>
 #include <memory>
 #include <utility>
 #include <vector>
 #include <QDebug>
+#include <QTimer>
+#if defined(WEBRTC_MAC)
+#include <mach/mach.h>
+#endif
 
 #include "third_party/abseil-cpp/absl/memory/memory.h"
 #include "third_party/abseil-cpp/absl/types/optional.h"
-#include "third_party/jsoncpp/source/include/json/json.h"
 #include "api/audio/audio_mixer.h"
 #include "api/audio_codecs/audio_decoder_factory.h"
 #include "api/audio_codecs/audio_encoder_factory.h"
@@ -33,18 +40,61 @@
 #include "rtc_base/logging.h"
 #include "rtc_base/ref_counted_object.h"
 #include "rtc_base/rtc_certificate_generator.h"
-#include "rtc_base/strings/json.h"
+#include "rtc_base/time_utils.h"
 #include "test/vcm_capturer.h"
+#include "loudestaudiomixer.h"
+#include "threadtopology.h"
+#include "tracer.h"
+
+// Build with DEFINES += NO_SDP_DUMPS to keep whole descriptions and
+// candidates out of the log; turning them into QStrings on the signaling
+// thread isn't free.
+#ifdef NO_SDP_DUMPS
+#define SDP_DUMP(label, text) do {} while (0)
+#else
+#define SDP_DUMP(label, text) qDebug() << label << QString::fromStdString(text)
+#endif
 
 namespace {
-// Names used for a IceCandidate JSON object.
-const char kCandidateSdpMidName[] = "sdpMid";
-const char kCandidateSdpMlineIndexName[] = "sdpMLineIndex";
-const char kCandidateSdpName[] = "candidate";
+// Queued messages are coalesced into a JSON array of at most this many
+// entries (and roughly this many bytes) per POST.
+const size_t kMaxMessagesPerBatch = 16;
+const size_t kMaxBatchBytes = 32 * 1024;
+// Requests kept outstanding at once when the client pipelines over a
+// keep-alive connection.  Without keep-alive only one can be in flight.
+const size_t kMaxMessagesInFlight = 4;
+// Events handled per DrainEvents() before yielding to the event loop.
+const size_t kMaxEventsPerBatch = 64;
+// What PeerConnectionClient::SendHangUp() sends.
+const char kByeMessage[] = "BYE";
+
+int64_t TimevalToMs(const timeval& tv) {
+    return static_cast<int64_t>(tv.tv_sec) * 1000 + tv.tv_usec / 1000;
+}
 
-// Names used for a SessionDescription JSON object.
-const char kSessionDescriptionTypeName[] = "type";
-const char kSessionDescriptionSdpName[] = "sdp";
+// The resident set now; ru_maxrss is only the peak and never drops when
+// sessions end.  0 if unknown.
+long ResidentKb() {
+#if defined(WEBRTC_MAC)
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO,
+                  reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS)
+        return 0;
+    return static_cast<long>(info.resident_size / 1024);
+#else
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (!statm)
+        return 0;
+    long total_pages = 0;
+    long resident_pages = 0;
+    int fields = fscanf(statm, "%ld %ld", &total_pages, &resident_pages);
+    fclose(statm);
+    if (fields != 2)
+        return 0;
+    return resident_pages * (sysconf(_SC_PAGESIZE) / 1024);
+#endif
+}
 }
 
 class DummySetSessionDescriptionObserver : public webrtc::SetSessionDescriptionObserver {
@@ -61,127 +111,525 @@ public:
 
 Conductor::Conductor(PeerConnectionClient* client, QObject *parent)
     : QObject{parent},
-      peer_id_(-1),
-      loopback_(false),
-      client_(client) {
+      client_(client),
+      threads_(nullptr),
+      max_mixed_sources_(0),
+      audio_profile_(kAudioProfileFull),
+      audio_features_(0),
+      pool_size_(0),
+      pool_refill_pending_(false),
+      ice_candidate_pool_size_(0),
+      trickle_ice_(true),
+      events_(kEventQueueCapacity),
+      drain_posted_(false),
+      stats_(kMaxSessions),
+      last_cpu_time_ms_(0) {
 //    client_->RegisterObserver(this);
+    connect(&network_configurations_, &QNetworkConfigurationManager::onlineStateChanged,
+            this, [this](bool) { OnNetworkChanged(); });
+    connect(&network_configurations_, &QNetworkConfigurationManager::configurationChanged,
+            this, [this](const QNetworkConfiguration&) { OnNetworkChanged(); });
+    event_queue_stats_.capacity = events_.capacity();
+    stats_.SetEventQueueStats(&event_queue_stats_);
 }
 
 Conductor::~Conductor() {
-    RTC_DCHECK(!peer_connection_);
+    RTC_DCHECK(sessions_.empty());
+    // Pooled sessions still point at us as their observer.
+    for (const auto& session : peer_connection_pool_)
+        session->Close();
+    peer_connection_pool_.clear();
 }
 
 bool Conductor::connection_active() const {
-    return peer_connection_ != nullptr;
+    return !sessions_.empty();
 }
 
 void Conductor::Close() {
     client_->SignOut();
-    DeletePeerConnection();
+    DeletePeerConnections();
+}
+
+void Conductor::SetThreadTopology(ThreadTopology* threads) {
+    RTC_DCHECK(!peer_connection_factory_);
+    RTC_DCHECK(!threads || threads->started());
+    threads_ = threads;
+}
+
+void Conductor::SetAudioDeviceModule(rtc::scoped_refptr<webrtc::AudioDeviceModule> adm) {
+    RTC_DCHECK(!peer_connection_factory_);
+    audio_device_ = adm;
 }
 
-bool Conductor::InitializePeerConnection() {
+void Conductor::SetMaxMixedSources(size_t count) {
     RTC_DCHECK(!peer_connection_factory_);
-    RTC_DCHECK(!peer_connection_);
+    max_mixed_sources_ = count;
+}
+
+bool Conductor::InitializePeerConnectionFactory() {
+    if (peer_connection_factory_)
+        return true;
+
+    rtc::scoped_refptr<webrtc::AudioMixer> audio_mixer;
+    if (max_mixed_sources_ > 0)
+        audio_mixer = LoudestAudioMixer::Create(max_mixed_sources_);
 
     peer_connection_factory_ = webrtc::CreatePeerConnectionFactory(
-                nullptr /* network_thread */, nullptr /* worker_thread */,
-                nullptr /* signaling_thread */, nullptr /* default_adm */,
-                webrtc::CreateBuiltinAudioEncoderFactory(),
+                threads_ ? threads_->network_thread() : nullptr,
+                threads_ ? threads_->worker_thread() : nullptr,
+                threads_ ? threads_->signaling_thread() : nullptr,
+                audio_device_,
+                CreateOpusTuningEncoderFactory(webrtc::CreateBuiltinAudioEncoderFactory()),
                 webrtc::CreateBuiltinAudioDecoderFactory(),
                 webrtc::CreateBuiltinVideoEncoderFactory(),
-                webrtc::CreateBuiltinVideoDecoderFactory(), nullptr /* audio_mixer */,
+                webrtc::CreateBuiltinVideoDecoderFactory(), audio_mixer,
                 nullptr /* audio_processing */);
 
     if (!peer_connection_factory_) {
-        DeletePeerConnection();
+        qDebug() << "Failed to create the PeerConnectionFactory";
         return false;
     }
 
-    if (!CreatePeerConnection(/*dtls=*/true)) {
-        DeletePeerConnection();
+    RefillPeerConnectionPool();
+    return true;
+}
+
+void Conductor::SetPeerConnectionPoolSize(size_t size) {
+    pool_size_ = size;
+    while (peer_connection_pool_.size() > pool_size_) {
+        peer_connection_pool_.back()->Close();
+        peer_connection_pool_.pop_back();
     }
+    if (peer_connection_factory_)
+        RefillPeerConnectionPool();
+}
 
-    AddTracks();
+void Conductor::SetIceCandidatePoolSize(int size) {
+    ice_candidate_pool_size_ = size;
+}
 
-    return peer_connection_ != nullptr;
+void Conductor::SetTrickleIce(bool trickle) {
+    trickle_ice_ = trickle;
 }
 
-bool Conductor::ReinitializePeerConnectionForLoopback() {
-    loopback_ = true;
-    std::vector<rtc::scoped_refptr<webrtc::RtpSenderInterface>> senders =
-            peer_connection_->GetSenders();
-    peer_connection_ = nullptr;
-    if (CreatePeerConnection(/*dtls=*/false)) {
-        for (const auto& sender : senders) {
-            peer_connection_->AddTrack(sender->track(), sender->stream_ids());
-        }
-        peer_connection_->CreateOffer(this, webrtc::PeerConnectionInterface::RTCOfferAnswerOptions());
+void Conductor::SetOpusSettings(const OpusSettings& settings) {
+    opus_settings_ = settings;
+}
+
+bool Conductor::SetCallOpusSettings(int peer_id, const OpusSettings& settings) {
+    auto it = sessions_.find(peer_id);
+    if (it == sessions_.end())
+        return false;
+    PeerSession* session = it->second;
+    OpusSettings previous = session->opus_settings();
+    session->set_opus_settings(settings);
+    if (settings.bitrate_bps != previous.bitrate_bps)
+        ApplyOpusBitrate(session->peer_connection(), settings.bitrate_bps);
+    if (!settings.NeedsNegotiation(previous))
+        return true;
+    if (session->peer_connection()->signaling_state() !=
+            webrtc::PeerConnectionInterface::kStable) {
+        qDebug() << "Opus settings for peer" << peer_id << "apply at the next negotiation";
+        return true;
     }
-    return peer_connection_ != nullptr;
+    session->peer_connection()->CreateOffer(session, webrtc::PeerConnectionInterface::RTCOfferAnswerOptions());
+    return true;
 }
 
-bool Conductor::CreatePeerConnection(bool dtls) {
-    RTC_DCHECK(peer_connection_factory_);
-    RTC_DCHECK(!peer_connection_);
+void Conductor::SetAudioProfile(AudioProfile profile) {
+    audio_profile_ = profile;
+    UpdateAudioProcessing();
+}
+
+bool Conductor::SetCallAudioProfile(int peer_id, AudioProfile profile) {
+    auto it = sessions_.find(peer_id);
+    if (it == sessions_.end())
+        return false;
+    it->second->set_audio_profile(profile);
+    UpdateAudioProcessing();
+    return true;
+}
+
+void Conductor::SetRecordingDirectory(const std::string& directory) {
+    recorder_.SetDirectory(directory);
+}
+
+bool Conductor::SetCallRecording(int peer_id, bool record) {
+    auto it = sessions_.find(peer_id);
+    if (it == sessions_.end())
+        return false;
+    if (record && !recorder_.enabled()) {
+        qDebug() << "Not recording call" << peer_id << "without --record_dir";
+        return false;
+    }
+    PeerSession* session = it->second;
+    session->set_record_audio(record);
+    if (!record) {
+        recorder_.StopCall(peer_id);
+        return true;
+    }
+    for (const auto& receiver : session->peer_connection()->GetReceivers())
+        StartRecording(session, receiver);
+    return true;
+}
+
+BufferedDataChannel* Conductor::OpenDataChannel(int peer_id, const std::string& label,
+                                                const DataChannelOptions& options) {
+    auto it = sessions_.find(peer_id);
+    if (it == sessions_.end() || it->second->FindDataChannel(label))
+        return nullptr;
+    PeerSession* session = it->second;
+    webrtc::PeerConnectionInterface* peer_connection = session->peer_connection();
+    std::string local_sdp;
+    if (peer_connection->local_description())
+        peer_connection->local_description()->ToString(&local_sdp);
+
+    webrtc::DataChannelInit init = BufferedDataChannel::ToInit(options);
+    rtc::scoped_refptr<webrtc::DataChannelInterface> channel =
+            peer_connection->CreateDataChannel(label, &init);
+    if (!channel) {
+        qDebug() << "Failed to create data channel" << label.c_str();
+        return nullptr;
+    }
+    std::unique_ptr<BufferedDataChannel> buffered(
+                new BufferedDataChannel(peer_id, channel, this));
+    BufferedDataChannel* result = buffered.get();
+    session->AddDataChannel(std::move(buffered));
+
+    // Later channels reuse the SCTP association of the first.
+    if (local_sdp.find("m=application") == std::string::npos) {
+        if (peer_connection->signaling_state() == webrtc::PeerConnectionInterface::kStable)
+            peer_connection->CreateOffer(session, webrtc::PeerConnectionInterface::RTCOfferAnswerOptions());
+        else
+            qDebug() << "Data channel" << label.c_str() << "opens with the next negotiation";
+    }
+    return result;
+}
+
+BufferedDataChannel* Conductor::FindDataChannel(int peer_id, const std::string& label) const {
+    auto it = sessions_.find(peer_id);
+    return it == sessions_.end() ? nullptr : it->second->FindDataChannel(label);
+}
+
+bool Conductor::CloseDataChannel(int peer_id, const std::string& label) {
+    auto it = sessions_.find(peer_id);
+    return it != sessions_.end() && it->second->RemoveDataChannel(label);
+}
+
+PeerSession* Conductor::InitializePeerConnection(int peer_id) {
+    RTC_DCHECK(sessions_.find(peer_id) == sessions_.end());
+
+    if (!InitializePeerConnectionFactory())
+        return nullptr;
+
+    int64_t start = rtc::TimeMillis();
+    rtc::scoped_refptr<PeerSession> session;
+    bool pooled = !peer_connection_pool_.empty();
+    if (pooled) {
+        session = peer_connection_pool_.front();
+        peer_connection_pool_.pop_front();
+        SchedulePoolRefill();
+    } else {
+        session = NewSession(/*dtls=*/true);
+        if (!session || !AddTracks(session->peer_connection()))
+            return nullptr;
+    }
+    qDebug() << "PeerConnection for peer" << peer_id << "ready in"
+             << rtc::TimeMillis() - start << "ms"
+             << (pooled ? "(pooled)" : "(created)");
+
+    session->set_peer_id(peer_id);
+    session->set_opus_settings(opus_settings_);
+    session->set_audio_profile(audio_profile_);
+    session->set_record_audio(recorder_.enabled());
+    session->timeline().Mark(kPhaseStarted);
+    sessions_[peer_id] = session;
+    UpdateAudioProcessing();
+    stats_.AddCall(peer_id, session->peer_connection());
+    LogSessionResourceUsage();
+    return session.get();
+}
+
+bool Conductor::ReinitializePeerConnectionForLoopback(PeerSession* session) {
+    session->set_loopback(true);
+    recorder_.StopCall(session->peer_id());
+    std::vector<rtc::scoped_refptr<webrtc::RtpSenderInterface>> senders =
+            session->peer_connection()->GetSenders();
+    if (!session->Initialize(peer_connection_factory_, BuildConfiguration(/*dtls=*/false)))
+        return false;
+    for (const auto& sender : senders) {
+        session->peer_connection()->AddTrack(sender->track(), sender->stream_ids());
+    }
+    stats_.AddCall(session->peer_id(), session->peer_connection());
+    session->peer_connection()->CreateOffer(session, webrtc::PeerConnectionInterface::RTCOfferAnswerOptions());
+    return true;
+}
 
+webrtc::PeerConnectionInterface::RTCConfiguration Conductor::BuildConfiguration(bool dtls) const {
     webrtc::PeerConnectionInterface::RTCConfiguration config;
     config.sdp_semantics = webrtc::SdpSemantics::kUnifiedPlan;
     config.enable_dtls_srtp = dtls;
+    config.ice_candidate_pool_size = ice_candidate_pool_size_;
+    // One transport and one set of ports per peer, however many m= sections
+    // the call ends up with; keeps the per-peer cost flat in a conference.
+    config.bundle_policy = webrtc::PeerConnectionInterface::kBundlePolicyMaxBundle;
+    config.rtcp_mux_policy = webrtc::PeerConnectionInterface::kRtcpMuxPolicyRequire;
+    // Keeps gathering after network changes during a call.  Gathering then
+    // never completes, which a non-trickle offer has to wait for.
+    if (trickle_ice_) {
+        config.continual_gathering_policy =
+                webrtc::PeerConnectionInterface::GATHER_CONTINUALLY;
+    }
     webrtc::PeerConnectionInterface::IceServer server;
     server.uri = GetPeerConnectionString();
     config.servers.push_back(server);
+    return config;
+}
+
+rtc::scoped_refptr<PeerSession> Conductor::NewSession(bool dtls) {
+    RTC_DCHECK(peer_connection_factory_);
+
+    rtc::scoped_refptr<PeerSession> session(
+                new rtc::RefCountedObject<PeerSession>(this));
+    if (!session->Initialize(peer_connection_factory_, BuildConfiguration(dtls)))
+        return nullptr;
+    return session;
+}
+
+void Conductor::SchedulePoolRefill() {
+    if (pool_refill_pending_ || peer_connection_pool_.size() >= pool_size_)
+        return;
+    // Creating a PeerConnection takes a while; don't do it on the call path.
+    pool_refill_pending_ = true;
+    QTimer::singleShot(0, this, [this]() {
+        pool_refill_pending_ = false;
+        RefillPeerConnectionPool();
+    });
+}
+
+void Conductor::RefillPeerConnectionPool() {
+    while (peer_connection_pool_.size() < pool_size_) {
+        rtc::scoped_refptr<PeerSession> session = NewSession(/*dtls=*/true);
+        if (!session || !AddTracks(session->peer_connection())) {
+            qDebug() << "Failed to pre-create a PeerConnection for the pool";
+            return;
+        }
+        peer_connection_pool_.push_back(session);
+    }
+}
+
+void Conductor::OnNetworkChanged() {
+    if (peer_connection_pool_.empty())
+        return;
+    qDebug() << "Network changed; re-gathering pooled PeerConnections";
+    for (const auto& session : peer_connection_pool_)
+        session->Close();
+    peer_connection_pool_.clear();
+    SchedulePoolRefill();
+}
+
+void Conductor::DeletePeerConnection(int peer_id) {
+    // The factory, the local audio track and the pool outlive calls.
+    auto it = sessions_.find(peer_id);
+    if (it == sessions_.end())
+        return;
+    ReportCallTimeline(it->second);
+    recorder_.StopCall(peer_id);
+    it->second->Close();
+    sessions_.erase(it);
+    stats_.RemoveCall(peer_id);
+    UpdateAudioProcessing();
+    LogSessionResourceUsage();
+    emit callEnded(peer_id);
+}
 
-    peer_connection_ = peer_connection_factory_->CreatePeerConnection(config, nullptr, nullptr, this);
-    return peer_connection_ != nullptr;
+void Conductor::DeletePeerConnections() {
+    std::vector<int> peer_ids;
+    for (auto& entry : sessions_) {
+        stats_.RemoveCall(entry.first);
+        ReportCallTimeline(entry.second);
+        recorder_.StopCall(entry.first);
+        entry.second->Close();
+        peer_ids.push_back(entry.first);
+    }
+    sessions_.clear();
+    UpdateAudioProcessing();
+    for (int peer_id : peer_ids)
+        emit callEnded(peer_id);
+}
+
+int Conductor::CaptureFeatures() const {
+    if (sessions_.empty())
+        return AudioProfileFeatures(audio_profile_);
+    int features = 0;
+    for (const auto& entry : sessions_)
+        features |= AudioProfileFeatures(entry.second->audio_profile());
+    return features;
+}
+
+rtc::scoped_refptr<webrtc::AudioTrackInterface> Conductor::CreateLocalAudioTrack(int features) {
+    // The voice engine configures APM from the options of the source being
+    // sent, so the profile rides on the source.
+    audio_features_ = features;
+    return peer_connection_factory_->CreateAudioTrack(
+                kAudioLabel, peer_connection_factory_->CreateAudioSource(
+                    AudioOptionsForFeatures(features)));
+}
+
+void Conductor::UpdateAudioProcessing() {
+    if (!local_audio_track_)
+        return;  // Created with the right options on first use.
+    int features = CaptureFeatures();
+    if (features == audio_features_)
+        return;
+    rtc::scoped_refptr<webrtc::AudioTrackInterface> previous = local_audio_track_;
+    local_audio_track_ = CreateLocalAudioTrack(features);
+    auto replace_track = [this, &previous](PeerSession* session) {
+        for (const auto& sender : session->peer_connection()->GetSenders()) {
+            if (sender->track() == previous)
+                sender->SetTrack(local_audio_track_);
+        }
+    };
+    for (const auto& entry : sessions_)
+        replace_track(entry.second);
+    for (const auto& session : peer_connection_pool_)
+        replace_track(session);
+    qDebug() << "Capture processing:"
+             << "aec" << ((features & kFeatureEchoCancellation) != 0)
+             << "ns" << ((features & kFeatureNoiseSuppression) != 0)
+             << "agc" << ((features & kFeatureGainControl) != 0)
+             << "hpf" << ((features & kFeatureHighPassFilter) != 0);
+}
+
+void Conductor::LogSessionResourceUsage() {
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return;
+    int64_t cpu_time_ms = TimevalToMs(usage.ru_utime) + TimevalToMs(usage.ru_stime);
+#if defined(WEBRTC_MAC)
+    long max_rss_kb = usage.ru_maxrss / 1024;  // Bytes on macOS.
+#else
+    long max_rss_kb = usage.ru_maxrss;
+#endif
+    qDebug() << "Sessions:" << sessions_.size()
+             << "cpu:" << cpu_time_ms << "ms"
+             << "(+" << cpu_time_ms - last_cpu_time_ms_ << "ms)"
+             << "rss:" << ResidentKb() << "KB"
+             << "peak rss:" << max_rss_kb << "KB";
+    last_cpu_time_ms_ = cpu_time_ms;
 }
 
-void Conductor::DeletePeerConnection() {
-    peer_connection_ = nullptr;
-    peer_connection_factory_ = nullptr;
-    peer_id_ = -1;
-    loopback_ = false;
+void Conductor::StartRecording(PeerSession* session, webrtc::RtpReceiverInterface* receiver) {
+    rtc::scoped_refptr<webrtc::MediaStreamTrackInterface> track = receiver->track();
+    if (!track || track->kind() != webrtc::MediaStreamTrackInterface::kAudioKind)
+        return;
+    recorder_.Start(session->peer_id(), static_cast<webrtc::AudioTrackInterface*>(track.get()));
 }
 
 //
-// PeerConnectionObserver implementation.
+// PeerSessionObserver implementation.
 //
 
-void Conductor::onAddTrack(rtc::scoped_refptr<webrtc::RtpReceiverInterface> receiver, const std::vector<rtc::scoped_refptr<webrtc::MediaStreamInterface>>&streams)
-{
+void Conductor::OnSessionTrackAdded(PeerSession* session, rtc::scoped_refptr<webrtc::RtpReceiverInterface> receiver,
+                                    const std::vector<rtc::scoped_refptr<webrtc::MediaStreamInterface>>& streams) {
     QString receiverId = QString(receiver->id().c_str());
-    qDebug() << __FUNCTION__ << " " << receiverId;
+    qDebug() << __FUNCTION__ << session->peer_id() << " " << receiverId;
+    if (session->peer_id() != -1 && session->record_audio())
+        StartRecording(session, receiver);
+}
+
+void Conductor::OnSessionDataChannel(PeerSession* session,
+                                     rtc::scoped_refptr<webrtc::DataChannelInterface> channel) {
+    qDebug() << __FUNCTION__ << session->peer_id() << channel->label().c_str();
+    // Taken up in HandleEvent(); the channel holds on to whatever arrives
+    // until it has an observer.
+    UIEvent event(UIEvent::kDataChannel, session->peer_id());
+    event.data_channel = std::move(channel);
+    PostEvent(std::move(event));
+}
+
+void Conductor::AddRemoteDataChannel(int peer_id,
+                                     rtc::scoped_refptr<webrtc::DataChannelInterface> channel) {
+    auto it = sessions_.find(peer_id);
+    if (it == sessions_.end()) {
+        channel->Close();
+        return;
+    }
+    PeerSession* session = it->second.get();
+    // A reopened label replaces the closed channel, but never one in use.
+    BufferedDataChannel* existing = session->FindDataChannel(channel->label());
+    if (existing && !existing->closed()) {
+        qDebug() << "Refusing a second data channel" << channel->label().c_str()
+                 << "from peer" << peer_id;
+        channel->Close();
+        return;
+    }
+    if (existing)
+        session->RemoveDataChannel(channel->label());
+    BufferedDataChannel* buffered = new BufferedDataChannel(peer_id, channel, this);
+    session->AddDataChannel(std::unique_ptr<BufferedDataChannel>(buffered));
+    // The open handshake may have completed before we started listening.
+    if (buffered->open())
+        OnChannelStateChange(buffered);
 }
 
-void Conductor::OnRemoveTrack(rtc::scoped_refptr<webrtc::RtpReceiverInterface> receiver) {
+void Conductor::OnSessionTrackRemoved(PeerSession* session, rtc::scoped_refptr<webrtc::RtpReceiverInterface> receiver) {
     QString receiverId = QString(receiver->id().c_str());
-    qDebug() << __FUNCTION__ << " " << receiverId;
-    UIThreadCallback(TRACK_REMOVED, receiver->track().release());
-//    main_wnd_->QueueUIThreadCallback(TRACK_REMOVED, receiver->track().release());
+    qDebug() << __FUNCTION__ << session->peer_id() << " " << receiverId;
+    rtc::scoped_refptr<webrtc::MediaStreamTrackInterface> track = receiver->track();
+    if (track && track->kind() == webrtc::MediaStreamTrackInterface::kAudioKind)
+        recorder_.Stop(static_cast<webrtc::AudioTrackInterface*>(track.get()));
+    UIEvent event(UIEvent::kTrackRemoved, session->peer_id());
+    event.track = std::move(track);
+    PostEvent(std::move(event));
 }
 
-void Conductor::OnIceCandidate(const webrtc::IceCandidateInterface* candidate) {
-    qDebug() << __FUNCTION__ << " " << candidate->sdp_mline_index();
+void Conductor::OnSessionIceCandidate(PeerSession* session, const webrtc::IceCandidateInterface* candidate) {
+    TRACE_INSTANT("OnIceCandidate", session->peer_id());
+    // Pooled sessions aren't talking to anyone yet.
+    if (session->peer_id() == -1)
+        return;
     // For loopback test. To save some connecting delay.
-    if (loopback_) {
-        if (!peer_connection_->AddIceCandidate(candidate)) {
+    if (session->loopback()) {
+        if (!session->peer_connection()->AddIceCandidate(candidate)) {
             qDebug() << "Failed to apply the received candidate";
         }
         return;
     }
+    // Non-trickle: the candidates go out inside the description instead.
+    if (!trickle_ice_)
+        return;
 
-    Json::StyledWriter writer;
-    Json::Value jmessage;
-
-    jmessage[kCandidateSdpMidName] = candidate->sdp_mid();
-    jmessage[kCandidateSdpMlineIndexName] = candidate->sdp_mline_index();
     std::string sdp;
     if (!candidate->ToString(&sdp)) {
         qDebug() << "Failed to serialize candidate";
         return;
     }
-    jmessage[kCandidateSdpName] = sdp;
-    SendMessage(writer.write(jmessage));
+    SendMessage(session->peer_id(),
+                codec_.WriteCandidate(candidate->sdp_mid(),
+                                      candidate->sdp_mline_index(), sdp));
+}
+
+void Conductor::OnSessionFirstPacketReceived(PeerSession* session) {
+    if (session->peer_id() != -1)
+        ReportCallTimeline(session);
+}
+
+void Conductor::OnSessionIceGatheringChange(PeerSession* session, webrtc::PeerConnectionInterface::IceGatheringState new_state) {
+    if (new_state == webrtc::PeerConnectionInterface::kIceGatheringComplete &&
+            session->awaiting_gathering()) {
+        session->set_awaiting_gathering(false);
+        SendLocalDescription(session);
+    }
+}
+
+void Conductor::OnSessionIceConnectionChange(PeerSession* session, webrtc::PeerConnectionInterface::IceConnectionState new_state) {
+    if (session->peer_id() == -1)
+        return;
+    if (new_state == webrtc::PeerConnectionInterface::kIceConnectionConnected)
+        emit callConnected(session->peer_id());
+    else if (new_state == webrtc::PeerConnectionInterface::kIceConnectionFailed)
+        emit callFailed(session->peer_id());
 }
 
 //
@@ -190,76 +638,89 @@ void Conductor::OnIceCandidate(const webrtc::IceCandidateInterface* candidate) {
 
 void Conductor::OnSignedIn() {
     qDebug() << __FUNCTION__;
-    main_wnd_->SwitchToPeerList(client_->peers());
+    if (ice_candidate_pool_size_ > 0) {
+        // Pooled connections gather on creation; make sure there's one.
+        if (pool_size_ == 0)
+            SetPeerConnectionPoolSize(1);
+        InitializePeerConnectionFactory();
+    }
+    emit signedIn();
 }
 
 void Conductor::OnDisconnected() {
     qDebug() << __FUNCTION__;
 
-    DeletePeerConnection();
+    DeletePeerConnections();
+    emit disconnected();
+}
 
-    if (main_wnd_->IsWindow())
-        main_wnd_->SwitchToConnectUI();
+void Conductor::OnPeersConnected(const std::vector<int>& ids) {
+    qDebug() << __FUNCTION__ << ids.size();
+    emit peersConnected(QVector<int>::fromStdVector(ids));
 }
 
 void Conductor::OnPeerConnected(int id, const std::string& name) {
     qDebug() << __FUNCTION__;
-    // Refresh the list if we're showing it.
-    if (main_wnd_->current_ui() == MainWindow::LIST_PEERS)
-        main_wnd_->SwitchToPeerList(client_->peers());
+    emit peerConnected(id, QString::fromStdString(name));
 }
 
 void Conductor::OnPeerDisconnected(int id) {
     qDebug() << __FUNCTION__;
-    if (id == peer_id_) {
-        qDebug() << "Our peer disconnected";
-        UIThreadCallback(PEER_CONNECTION_CLOSED, NULL);
-//        main_wnd_->QueueUIThreadCallback(PEER_CONNECTION_CLOSED, NULL);
-    } else {
-        // Refresh the list if we're showing it.
-        if (main_wnd_->current_ui() == MainWindow::LIST_PEERS)
-            main_wnd_->SwitchToPeerList(client_->peers());
+    if (sessions_.find(id) != sessions_.end()) {
+        qDebug() << "Peer" << id << "disconnected";
+        PostEvent(UIEvent(UIEvent::kPeerConnectionClosed, id));
     }
+    emit peerDisconnected(id);
 }
 
 void Conductor::OnMessageFromPeer(int peer_id, const std::string& message) {
-    RTC_DCHECK(peer_id_ == peer_id || peer_id_ == -1);
     RTC_DCHECK(!message.empty());
-
-    if (!peer_connection_.get()) {
-        RTC_DCHECK(peer_id_ == -1);
-        peer_id_ = peer_id;
-
-        if (!InitializePeerConnection()) {
+    TRACE_SCOPE("OnMessageFromPeer");
+
+    // Keep the session alive across HandlePeerMessage(), which may delete it.
+    rtc::scoped_refptr<PeerSession> session;
+    auto it = sessions_.find(peer_id);
+    if (it != sessions_.end()) {
+        session = it->second;
+    } else if (sessions_.size() >= kMaxSessions) {
+        qDebug() << "Received a message from peer" << peer_id
+                 << "while already in" << sessions_.size() << "calls; dropping it.";
+        return;
+    } else {
+        session = InitializePeerConnection(peer_id);
+        if (!session) {
             qDebug() << "Failed to initialize our PeerConnection instance";
             client_->SignOut();
             return;
         }
     }
-    else if (peer_id != peer_id_) {
-        RTC_DCHECK(peer_id_ != -1);
-        qDebug() << "Received a message from unknown peer while already in a conversation with a different peer.";
+
+    size_t count = 0;
+    if (!codec_.Parse(message, &inbound_messages_, &count)) {
+        qDebug() << "Received unknown message from peer" << peer_id
+                 << "(" << message.size() << "bytes)";
+        SDP_DUMP("Unknown message:", message);
         return;
     }
 
-    Json::Reader reader;
-    Json::Value jmessage;
-    QString messageFromPeer = QString(message.c_str());
-    if (!reader.parse(message, jmessage)) {
-        qDebug() << "Received unknown message. " << messageFromPeer;
-        return;
+    // Either a single object or a batch produced by TakeMessageBatch();
+    // batch entries are in send order.
+    for (size_t i = 0; i < count; ++i) {
+        HandlePeerMessage(session, inbound_messages_[i]);
+        if (!session->peer_connection())
+            return;
     }
-    std::string type_str;
-    std::string json_object;
+}
 
-    rtc::GetStringFromJsonObject(jmessage, kSessionDescriptionTypeName, &type_str);
+void Conductor::HandlePeerMessage(PeerSession* session, const SignalingMessage& message) {
+    const std::string& type_str = message.type;
     if (!type_str.empty()) {
         if (type_str == "offer-loopback") {
             // This is a loopback call.
             // Recreate the peerconnection with DTLS disabled.
-            if (!ReinitializePeerConnectionForLoopback()) {
+            if (!ReinitializePeerConnectionForLoopback(session)) {
                 qDebug() << "Failed to initialize our PeerConnection instance";
-                DeletePeerConnection();
+                DeletePeerConnection(session->peer_id());
                 client_->SignOut();
             }
             return;
@@ -271,57 +732,68 @@ void Conductor::OnMessageFromPeer(int peer_id, const std::string& message) {
             return;
         }
         webrtc::SdpType type = *type_maybe;
-        std::string sdp;
-        if (!rtc::GetStringFromJsonObject(jmessage, kSessionDescriptionSdpName, &sdp)) {
+        if (!message.has_sdp) {
             qDebug() << "Can't parse received session description message.";
             return;
         }
+        // The peer's description configures our encoder.
+        std::string munged;
+        const std::string* sdp = &message.sdp;
+        if (!session->opus_settings().empty()) {
+            munged = ApplyOpusSettingsToSdp(message.sdp, session->opus_settings(), /*local=*/false);
+            sdp = &munged;
+        }
         webrtc::SdpParseError error;
-        std::unique_ptr<webrtc::SessionDescriptionInterface> session_description = webrtc::CreateSessionDescription(type, sdp, &error);
+        std::unique_ptr<webrtc::SessionDescriptionInterface> session_description = webrtc::CreateSessionDescription(type, *sdp, &error);
         QString errorDescription = QString(error.description.c_str());
         if (!session_description) {
             qDebug() << "Can't parse received session description message. SdpParseError was: " << errorDescription;
             return;
         }
-        qDebug() << " Received session description :" << messageFromPeer;
-        peer_connection_->SetRemoteDescription(
+        SDP_DUMP(" Received session description :", message.sdp);
+        session->peer_connection()->SetRemoteDescription(
                     DummySetSessionDescriptionObserver::Create(),
                     session_description.release());
+        session->timeline().Mark(type == webrtc::SdpType::kOffer ? kPhaseOfferReceived
+                                                                 : kPhaseAnswerReceived);
         if (type == webrtc::SdpType::kOffer) {
-            peer_connection_->CreateAnswer(this, webrtc::PeerConnectionInterface::RTCOfferAnswerOptions());
+            session->peer_connection()->CreateAnswer(session, webrtc::PeerConnectionInterface::RTCOfferAnswerOptions());
         }
     }
     else {
-        std::string sdp_mid;
-        int sdp_mlineindex = 0;
-        std::string sdp;
-        if (!rtc::GetStringFromJsonObject(jmessage, kCandidateSdpMidName,
-                                          &sdp_mid) ||
-                !rtc::GetIntFromJsonObject(jmessage, kCandidateSdpMlineIndexName,
-                                           &sdp_mlineindex) ||
-                !rtc::GetStringFromJsonObject(jmessage, kCandidateSdpName, &sdp)) {
+        if (!message.has_sdp_mid || !message.has_sdp_mline_index ||
+                !message.has_candidate) {
             qDebug() << "Can't parse received message.";
             return;
         }
         webrtc::SdpParseError error;
-        std::unique_ptr<webrtc::IceCandidateInterface> candidate(webrtc::CreateIceCandidate(sdp_mid, sdp_mlineindex, sdp, &error));
+        std::unique_ptr<webrtc::IceCandidateInterface> candidate(webrtc::CreateIceCandidate(message.sdp_mid, message.sdp_mline_index, message.candidate, &error));
         QString errorDescription = QString(error.description.c_str());
         if (!candidate.get()) {
             qDebug() << "Can't parse received candidate message. SdpParseError was: " << errorDescription;
             return;
         }
-        if (!peer_connection_->AddIceCandidate(candidate.get())) {
+        if (!session->peer_connection()->AddIceCandidate(candidate.get())) {
             qDebug() << "Failed to apply the received candidate";
             return;
         }
-        qDebug() << " Received candidate :" << messageFromPeer;
+        SDP_DUMP(" Received candidate :", message.candidate);
     }
 }
 
 void Conductor::OnMessageSent(int err) {
-    // Process the next pending message if any.
-    UIThreadCallback(SEND_MESSAGE_TO_PEER, NULL);
-//    main_wnd_->QueueUIThreadCallback(SEND_MESSAGE_TO_PEER, NULL);
+    // Process the next pending message if any.  The client calls this on
+    // the Qt thread.
+    FlushPendingMessages();
+}
+
+void Conductor::OnMessageFailed(int peer_id) {
+    // Part of the call's signaling may be lost and resending could repeat
+    // an offer the peer already applied; either way the two ends no longer
+    // agree on the call, so end it.
+    qDebug() << "Error: a message to peer" << peer_id << "was lost with the server connection";
+    DisconnectFromPeer(peer_id);
+    FlushPendingMessages();
 }
 
 void Conductor::OnServerConnectionFailure() {
@@ -345,34 +817,36 @@ void Conductor::DisconnectFromServer() {
 }
 
 void Conductor::ConnectToPeer(int peer_id) {
-    RTC_DCHECK(peer_id_ == -1);
     RTC_DCHECK(peer_id != -1);
 
-//    if (peer_connection_.get()) {
-//        main_wnd_->MessageBox(
-//                    "Error", "We only support connecting to one peer at a time", true);
-//        return;
-//    }
-    if (InitializePeerConnection()) {
-        peer_id_ = peer_id;
-        peer_connection_->CreateOffer(this, webrtc::PeerConnectionInterface::RTCOfferAnswerOptions());
+    if (sessions_.find(peer_id) != sessions_.end()) {
+        qDebug() << "Already in a call with peer" << peer_id;
+        return;
+    }
+    if (sessions_.size() >= kMaxSessions) {
+        qDebug() << "Error: at most" << kMaxSessions << "concurrent calls are supported";
+        return;
+    }
+    PeerSession* session = InitializePeerConnection(peer_id);
+    if (session) {
+        session->peer_connection()->CreateOffer(session, webrtc::PeerConnectionInterface::RTCOfferAnswerOptions());
     } else {
         qDebug() << "Error: Failed to initialize PeerConnection";
     }
 }
 
-void Conductor::AddTracks() {
-    if (!peer_connection_->GetSenders().empty()) {
-        return;  // Already added tracks.
+bool Conductor::AddTracks(webrtc::PeerConnectionInterface* peer_connection) {
+    if (!peer_connection->GetSenders().empty()) {
+        return true;  // Already added tracks.
     }
 
-    rtc::scoped_refptr<webrtc::AudioTrackInterface> audio_track(
-                peer_connection_factory_->CreateAudioTrack(
-                    kAudioLabel, peer_connection_factory_->CreateAudioSource(
-                        cricket::AudioOptions())));
-    auto result_or_error = peer_connection_->AddTrack(audio_track, {kStreamId});
+    // One capture track feeds every PeerConnection the factory creates.
+    if (!local_audio_track_)
+        local_audio_track_ = CreateLocalAudioTrack(CaptureFeatures());
+    auto result_or_error = peer_connection->AddTrack(local_audio_track_, {kStreamId});
     if (!result_or_error.ok()) {
         qDebug() << "Failed to add audio track to PeerConnection: " << result_or_error.error().message();
+        return false;
     }
 
 //    rtc::scoped_refptr<CapturerTrackSource> video_device =
@@ -392,89 +866,103 @@ void Conductor::AddTracks() {
 //    }
 
     //    main_wnd_->SwitchToStreamingUI();
+    return true;
 }
 
 void Conductor::SetAudioControl(bool mute)
 {
-    webrtc::MediaStreamInterface* remote_stream = nullptr;
-    webrtc::AudioTrackVector tracks = remote_stream->GetAudioTracks();
-    webrtc::AudioTrackInterface* audio_track = tracks[0];
-    for (auto& track : tracks) {
-            track->set_enabled(mute);
+    // Mutes what we hear from every peer in the call.
+    for (const auto& entry : sessions_) {
+        for (const auto& receiver : entry.second->peer_connection()->GetReceivers()) {
+            rtc::scoped_refptr<webrtc::MediaStreamTrackInterface> track = receiver->track();
+            if (track && track->kind() == webrtc::MediaStreamTrackInterface::kAudioKind)
+                track->set_enabled(!mute);
+        }
     }
 }
 
+void Conductor::DisconnectFromPeer(int peer_id) {
+    qDebug() << __FUNCTION__ << peer_id;
+    if (sessions_.find(peer_id) == sessions_.end())
+        return;
+    // Queued behind whatever is still pending for the peer; the client only
+    // takes one request at a time without keep-alive.
+    SendMessage(peer_id, kByeMessage);
+    DeletePeerConnection(peer_id);
+}
+
 void Conductor::DisconnectFromCurrentPeer() {
     qDebug() << __FUNCTION__;
-    if (peer_connection_.get()) {
-        client_->SendHangUp(peer_id_);
-        DeletePeerConnection();
-    }
-
-    if (main_wnd_->IsWindow())
-        main_wnd_->SwitchToPeerList(client_->peers());
+    for (const auto& entry : sessions_)
+        SendMessage(entry.first, kByeMessage);
+    DeletePeerConnections();
 }
 
-void Conductor::UIThreadCallback(int msg_id, void* data) {
-    switch (msg_id) {
-    case PEER_CONNECTION_CLOSED:
-        qDebug() << "PEER_CONNECTION_CLOSED";
-        DeletePeerConnection();
-        DisconnectFromServer();
-//        if (main_wnd_->IsWindow()) {
-//            if (client_->is_connected()) {
-//                main_wnd_->SwitchToPeerList(client_->peers());
-//            } else {
-//                main_wnd_->SwitchToConnectUI();
-//            }
-//        } else {
-//            DisconnectFromServer();
-//        }
-        break;
-
-    case SEND_MESSAGE_TO_PEER: {
-        qDebug() << "SEND_MESSAGE_TO_PEER";
-        std::string* msg = reinterpret_cast<std::string*>(data);
-        if (msg) {
-            // For convenience, we always run the message through the queue.
-            // This way we can be sure that messages are sent to the server
-            // in the same order they were signaled without much hassle.
-            pending_messages_.push_back(msg);
-        }
-
-        if (!pending_messages_.empty() && !client_->IsSendingMessage()) {
-            msg = pending_messages_.front();
-            pending_messages_.pop_front();
+void Conductor::PostEvent(UIEvent event) {
+    // A removed track may go: the producer then releases it itself.
+    // Anything else would be a lost message or a call never torn down.
+    bool droppable = event.type == UIEvent::kTrackRemoved;
+    if (!events_.Push(std::move(event), droppable)) {
+        qDebug() << "Error: event queue full, dropping event" << event.type
+                 << "for peer" << event.peer_id;
+        return;
+    }
+    // One queued DrainEvents() at a time, however many producers push.
+    if (!drain_posted_.exchange(true, std::memory_order_acq_rel))
+        QMetaObject::invokeMethod(this, "DrainEvents", Qt::QueuedConnection);
+}
 
-            if (!client_->SendToPeer(peer_id_, *msg) && peer_id_ != -1) {
-                qDebug() << "SendToPeer failed";
-                DisconnectFromServer();
-            }
-            delete msg;
+void Conductor::DrainEvents() {
+    TRACE_SCOPE("DrainEvents");
+    // Cleared before popping: anything pushed from here on posts again.
+    drain_posted_.store(false, std::memory_order_release);
+    size_t depth = events_.size();
+    TRACE_COUNTER("event_queue_depth", static_cast<int64_t>(depth));
+    event_queue_stats_.depth = depth;
+    event_queue_stats_.max_depth = std::max(event_queue_stats_.max_depth, depth);
+    ++event_queue_stats_.batches;
+
+    UIEvent event;
+    bool queued_messages = false;
+    size_t handled = 0;
+    while (handled < kMaxEventsPerBatch && events_.Pop(&event)) {
+        if (event.type == UIEvent::kSendMessage) {
+            // Sent together below so that they can share batches.
+            pending_messages_.emplace_back(event.peer_id, std::move(event.message));
+            queued_messages = true;
+        } else {
+            HandleEvent(&event);
         }
+        ++handled;
+    }
+    if (queued_messages)
+        FlushPendingMessages();
+    event_queue_stats_.pushed = events_.pushed();
+    event_queue_stats_.overflowed = events_.overflowed();
+    event_queue_stats_.dropped = events_.dropped();
+
+    // Let the rest of the event loop run before the remainder.
+    if (events_.size() > 0 && !drain_posted_.exchange(true, std::memory_order_acq_rel))
+        QMetaObject::invokeMethod(this, "DrainEvents", Qt::QueuedConnection);
+}
 
-        if (!peer_connection_.get())
-            peer_id_ = -1;
-
+void Conductor::HandleEvent(UIEvent* event) {
+    switch (event->type) {
+    case UIEvent::kPeerConnectionClosed: {
+        qDebug() << "PEER_CONNECTION_CLOSED";
+        // Stay signed in so the next call can come in.
+        DeletePeerConnection(event->peer_id);
         break;
     }
 
-//    case NEW_TRACK_ADDED: {
-//        auto* track = reinterpret_cast<webrtc::MediaStreamTrackInterface*>(data);
-//        if (track->kind() == webrtc::MediaStreamTrackInterface::kVideoKind) {
-//            auto* video_track = static_cast<webrtc::VideoTrackInterface*>(track);
-//            main_wnd_->StartRemoteRenderer(video_track);
-//        }
-//        track->Release();
-//        break;
-//    }
+    case UIEvent::kTrackRemoved:
+        // Remote peer stopped sending a track; dropping |event| releases
+        // it here rather than on the signaling thread.
+        break;
 
-    case TRACK_REMOVED: {
-        // Remote peer stopped sending a track.
-        auto* track = reinterpret_cast<webrtc::MediaStreamTrackInterface*>(data);
-        track->Release();
+    case UIEvent::kDataChannel:
+        AddRemoteDataChannel(event->peer_id, std::move(event->data_channel));
         break;
-    }
 
     default:
         RTC_NOTREACHED();
@@ -482,40 +970,184 @@ void Conductor::UIThreadCallback(int msg_id, void* data) {
     }
 }
 
-void Conductor::OnSuccess(webrtc::SessionDescriptionInterface* desc) {
-    peer_connection_->SetLocalDescription(DummySetSessionDescriptionObserver::Create(), desc);
+void Conductor::OnSessionDescriptionCreated(PeerSession* session, webrtc::SessionDescriptionInterface* desc) {
+    // Without trickle the description is sent from
+    // OnSessionIceGatheringChange().  Set the flag first in case gathering
+    // finishes right away.
+    bool wait_for_candidates = !trickle_ice_ && !session->loopback();
+    session->set_awaiting_gathering(wait_for_candidates);
+    if (!session->opus_settings().empty()) {
+        // Ask the peer's encoder for the same settings.
+        std::string original;
+        desc->ToString(&original);
+        webrtc::SdpParseError error;
+        std::unique_ptr<webrtc::SessionDescriptionInterface> munged =
+                webrtc::CreateSessionDescription(
+                    desc->GetType(),
+                    ApplyOpusSettingsToSdp(original, session->opus_settings(), /*local=*/true),
+                    &error);
+        if (munged) {
+            delete desc;
+            desc = munged.release();
+        } else {
+            qDebug() << "Can't apply Opus settings:" << QString::fromStdString(error.description);
+        }
+    }
+    session->peer_connection()->SetLocalDescription(DummySetSessionDescriptionObserver::Create(), desc);
+    if (wait_for_candidates)
+        return;
 
     std::string sdp;
     desc->ToString(&sdp);
     webrtc::SdpParseError error;
 
     // For loopback test. To save some connecting delay.
-//    if (loopback_) {
+//    if (session->loopback()) {
 //        // Replace message type from "offer" to "answer"
 //        std::unique_ptr<webrtc::SessionDescriptionInterface> session_description =
 //                webrtc::CreateSessionDescription(webrtc::SdpType::kAnswer, sdp, &error);
-//        peer_connection_->SetRemoteDescription(
+//        session->peer_connection()->SetRemoteDescription(
 //                    DummySetSessionDescriptionObserver::Create(),
 //                    session_description.release());
 //        return;
 //    }
 
-    Json::StyledWriter writer;
-    Json::Value jmessage;
-    jmessage[kSessionDescriptionTypeName] = webrtc::SdpTypeToString(desc->GetType());
-    jmessage[kSessionDescriptionSdpName] = sdp;
-    SendMessage(writer.write(jmessage));
+    SendMessage(session->peer_id(),
+                codec_.WriteSessionDescription(
+                    webrtc::SdpTypeToString(desc->GetType()), sdp));
+}
+
+void Conductor::SendLocalDescription(PeerSession* session)
+{
+    const webrtc::SessionDescriptionInterface* desc =
+            session->peer_connection()->local_description();
+    if (!desc) {
+        qDebug() << "No local description to send";
+        return;
+    }
+    std::string sdp;
+    desc->ToString(&sdp);
+    SendMessage(session->peer_id(),
+                codec_.WriteSessionDescription(
+                    webrtc::SdpTypeToString(desc->GetType()), sdp));
+}
+
+void Conductor::MarkDescriptionSent(int peer_id)
+{
+    auto it = sessions_.find(peer_id);
+    if (it == sessions_.end())
+        return;
+    // The description is queued before any candidate for the peer (and is
+    // all there is without trickle), so the first batch after it carries it.
+    CallTimeline& timeline = it->second->timeline();
+    if (timeline.reached(kPhaseOfferCreated))
+        timeline.Mark(kPhaseOfferSent);
+    else if (timeline.reached(kPhaseAnswerCreated))
+        timeline.Mark(kPhaseAnswerSent);
 }
 
-void Conductor::OnFailure(webrtc::RTCError error)
+bool Conductor::GetCallTimeline(int peer_id, CallTimeline* timeline) const
 {
-    qDebug() << error.message();
+    auto it = sessions_.find(peer_id);
+    if (it == sessions_.end())
+        return false;
+    *timeline = it->second->timeline();
+    return true;
 }
 
-void Conductor::SendMessage(const std::string& json_object)
+void Conductor::ReportCallTimeline(PeerSession* session)
 {
-    std::string* msg = new std::string(json_object);
-    UIThreadCallback(SEND_MESSAGE_TO_PEER, msg);
-//    main_wnd_->QueueUIThreadCallback(SEND_MESSAGE_TO_PEER, msg);
+    CallTimeline& timeline = session->timeline();
+    if (timeline.reported())
+        return;
+    timeline.set_reported(true);
+    std::string json = timeline.ToJson(session->peer_id(), client_->sign_in_time_ms());
+    qDebug().noquote() << "call-timeline" << QString::fromStdString(json);
+    emit callTimelineReady(session->peer_id(), QString::fromStdString(json));
+}
+
+void Conductor::OnSessionDescriptionFailure(PeerSession* session, webrtc::RTCError error)
+{
+    qDebug() << session->peer_id() << error.message();
+}
+
+//
+// BufferedDataChannelObserver implementation.
+//
+
+void Conductor::OnChannelStateChange(BufferedDataChannel* channel) {
+    QString label = QString::fromStdString(channel->label());
+    if (channel->open())
+        emit dataChannelOpened(channel->peer_id(), label);
+    else
+        emit dataChannelClosed(channel->peer_id(), label);
+}
+
+void Conductor::OnChannelMessage(BufferedDataChannel* channel, const webrtc::DataBuffer& buffer) {
+    // A copy: queued connections deliver the signal after |buffer| is gone.
+    QByteArray data(buffer.data.data<char>(), static_cast<int>(buffer.size()));
+    emit dataChannelMessage(channel->peer_id(), QString::fromStdString(channel->label()),
+                            data, buffer.binary);
+}
+
+void Conductor::OnChannelWritable(BufferedDataChannel* channel) {
+    emit dataChannelWritable(channel->peer_id(), QString::fromStdString(channel->label()));
+}
+
+void Conductor::SendMessage(int peer_id, const std::string& json_object)
+{
+    // For convenience, we always run the message through the queue.
+    // This way we can be sure that messages are sent to the server
+    // in the same order they were signaled without much hassle.
+    UIEvent event(UIEvent::kSendMessage, peer_id);
+    event.message = json_object;
+    PostEvent(std::move(event));
+}
+
+void Conductor::FlushPendingMessages()
+{
+    size_t max_in_flight = client_->keep_alive() ? kMaxMessagesInFlight : 1;
+    TRACE_COUNTER("pending_messages", static_cast<int64_t>(pending_messages_.size()));
+    while (!pending_messages_.empty() &&
+           client_->MessagesInFlight() < max_in_flight) {
+        int peer_id = -1;
+        std::string batch = TakeMessageBatch(&peer_id);
+        if (!client_->SendToPeer(peer_id, batch)) {
+            qDebug() << "SendToPeer failed";
+            DisconnectFromServer();
+            break;
+        }
+        MarkDescriptionSent(peer_id);
+    }
+}
+
+std::string Conductor::TakeMessageBatch(int* peer_id)
+{
+    RTC_DCHECK(!pending_messages_.empty());
+    *peer_id = pending_messages_.front().first;
+    std::string batch = std::move(pending_messages_.front().second);
+    pending_messages_.pop_front();
+    // The client recognizes a hang-up only as a message of its own.
+    if (pending_messages_.empty() || batch == kByeMessage)
+        return batch;
+
+    // Only wrap into an array when there's actually something to coalesce so
+    // that single messages stay in the plain format.
+    size_t count = 1;
+    batch.insert(0, 1, '[');
+    while (!pending_messages_.empty() && count < kMaxMessagesPerBatch &&
+           pending_messages_.front().first == *peer_id &&
+           pending_messages_.front().second != kByeMessage &&
+           batch.size() + pending_messages_.front().second.size() < kMaxBatchBytes) {
+        batch += ',';
+        batch += pending_messages_.front().second;
+        pending_messages_.pop_front();
+        ++count;
+    }
+    if (count == 1)
+        batch.erase(0, 1);
+    else
+        batch += ']';
+    return batch;
 }
 
@@ -1,56 +1,182 @@
 #ifndef CONDUCTOR_H
 #define CONDUCTOR_H
 
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <QByteArray>
+#include <QNetworkConfigurationManager>
 #include <QObject>
+#include <QString>
+#include <QVector>
 #include "api/media_stream_interface.h"
 #include "api/peer_connection_interface.h"
+#include "modules/audio_device/include/audio_device.h"
+#include "audioprofile.h"
+#include "buffereddatachannel.h"
+#include "callrecorder.h"
+#include "eventqueue.h"
 #include "peerconnectionclient.h"
+#include "opussettings.h"
+#include "peersession.h"
+#include "signalingcodec.h"
+#include "statscollector.h"
 
-class Conductor : public QObject, public webrtc::PeerConnectionObserver, public webrtc::CreateSessionDescriptionObserver, public PeerConnectionClientObserver
+class ThreadTopology;
+
+class Conductor : public QObject, public PeerConnectionClientObserver, public PeerSessionObserver,
+                  public BufferedDataChannelObserver
 {
     Q_OBJECT
 public:
-    enum CallbackID {
-        MEDIA_CHANNELS_INITIALIZED = 1,
-        PEER_CONNECTION_CLOSED,
-        SEND_MESSAGE_TO_PEER,
-        NEW_TRACK_ADDED,
-        TRACK_REMOVED,
+    // Work handed to the Qt thread by callbacks that may run elsewhere
+    // (WebRTC's signaling thread when there's no ThreadTopology).  Which
+    // fields mean something depends on |type|; payloads are moved in and
+    // out of the queue, never copied.
+    struct UIEvent {
+        enum Type {
+            kNone,
+            // |peer_id| hung up.
+            kPeerConnectionClosed,
+            // Queue |message| for |peer_id|.
+            kSendMessage,
+            // The remote side stopped sending |track|.
+            kTrackRemoved,
+            // |peer_id| opened |data_channel|.
+            kDataChannel,
+        };
+
+        UIEvent() : type(kNone), peer_id(-1) {}
+        UIEvent(Type type, int peer_id) : type(type), peer_id(peer_id) {}
+        UIEvent(UIEvent&&) = default;
+        UIEvent& operator=(UIEvent&&) = default;
+        UIEvent(const UIEvent&) = delete;
+        UIEvent& operator=(const UIEvent&) = delete;
+
+        Type type;
+        int peer_id;
+        std::string message;
+        rtc::scoped_refptr<webrtc::MediaStreamTrackInterface> track;
+        rtc::scoped_refptr<webrtc::DataChannelInterface> data_channel;
     };
+    // Events waiting for the Qt thread.  Far more than a burst of candidates
+    // from every call at once; past it removed tracks are dropped and
+    // counted, and other events overflow.
+    static const size_t kEventQueueCapacity = 1024;
+    // Concurrent calls; messages from further peers are dropped.
+    static const size_t kMaxSessions = 16;
+
     Conductor(PeerConnectionClient *client, QObject *parent = 0);
 
     bool connection_active() const;
+    size_t session_count() const { return sessions_.size(); }
+    // RTCStats of every call; not polling until started.
+    StatsCollector* stats() { return &stats_; }
 
     virtual void Close();
     ~Conductor();
-    bool InitializePeerConnection();
-    bool ReinitializePeerConnectionForLoopback();
-    bool CreatePeerConnection(bool dtls);
-    void DeletePeerConnection();
-    void AddTracks();
+    // Network/worker/signaling threads for the factory.  Must be started and
+    // outlive us; without one the factory creates its own.
+    void SetThreadTopology(ThreadTopology* threads);
+    // Audio device for the factory; by default the platform's.  Must be set
+    // before the factory is created.
+    void SetAudioDeviceModule(rtc::scoped_refptr<webrtc::AudioDeviceModule> adm);
+    // Plays out only the |count| loudest remote streams, through
+    // LoudestAudioMixer; 0 keeps WebRTC's mixer, which sums them all.  Must
+    // be set before the factory is created.
+    void SetMaxMixedSources(size_t count);
+    // Creates the factory (and fills the pool) if that hasn't happened yet.
+    // Call at startup to keep it off the call-setup path.
+    bool InitializePeerConnectionFactory();
+    // Number of ready-to-use PeerConnections, audio track attached, kept
+    // around for ConnectToPeer() and incoming offers.  0 disables the pool.
+    void SetPeerConnectionPoolSize(size_t size);
+    // When > 0, PeerConnections are created with this ICE candidate pool
+    // size and a pooled one starts gathering as soon as we're signed in, so
+    // candidates are ready before a peer is picked.
+    void SetIceCandidatePoolSize(int size);
+    // With trickle off, candidates aren't sent one by one; the offer/answer
+    // goes out once gathering completes and carries all of them.
+    void SetTrickleIce(bool trickle);
+    // Opus settings for calls started from now on.
+    void SetOpusSettings(const OpusSettings& settings);
+    // Changes the settings of the call with |peer_id|.  The bitrate applies
+    // right away; anything else renegotiates (now if the call is stable,
+    // otherwise with the next offer/answer).
+    bool SetCallOpusSettings(int peer_id, const OpusSettings& settings);
+    // Capture processing for calls started from now on.
+    void SetAudioProfile(AudioProfile profile);
+    // Changes the profile of the call with |peer_id|.  There is one capture
+    // path for all calls, so it runs what the calls in progress need between
+    // them; switching swaps the local track under every sender, without
+    // renegotiating.
+    bool SetCallAudioProfile(int peer_id, AudioProfile profile);
+    // Records the remote audio of every call to WAV files in |directory|;
+    // empty, the default, records nothing.
+    void SetRecordingDirectory(const std::string& directory);
+    // Starts or stops recording the call with |peer_id|.  Needs a recording
+    // directory.
+    bool SetCallRecording(int peer_id, bool record);
+    // Opens a data channel named |label| on the call with |peer_id|.  The
+    // first one of a call needs a negotiation, which starts right away if
+    // the call is stable.  Null if there's no such call or the label is in
+    // use.
+    BufferedDataChannel* OpenDataChannel(int peer_id, const std::string& label,
+                                         const DataChannelOptions& options);
+    BufferedDataChannel* FindDataChannel(int peer_id, const std::string& label) const;
+    bool CloseDataChannel(int peer_id, const std::string& label);
+    // Starts a session for |peer_id|, from the pool when possible.
+    PeerSession* InitializePeerConnection(int peer_id);
+    bool ReinitializePeerConnectionForLoopback(PeerSession* session);
+    void DeletePeerConnection(int peer_id);
+    void DeletePeerConnections();
+    bool AddTracks(webrtc::PeerConnectionInterface* peer_connection);
     void SetAudioControl(bool mute);
+    // Copies the setup timeline of the call with |peer_id|.
+    bool GetCallTimeline(int peer_id, CallTimeline* timeline) const;
 
     //
-    // PeerConnectionObserver implementation.
+    // PeerSessionObserver implementation.
     //
 
-    void OnSignalingChange(
-            webrtc::PeerConnectionInterface::SignalingState new_state) override {}
-    void onAddTrack(
+    void OnSessionIceCandidate(
+            PeerSession* session,
+            const webrtc::IceCandidateInterface* candidate) override;
+    void OnSessionIceGatheringChange(
+            PeerSession* session,
+            webrtc::PeerConnectionInterface::IceGatheringState new_state) override;
+    void OnSessionIceConnectionChange(
+            PeerSession* session,
+            webrtc::PeerConnectionInterface::IceConnectionState new_state) override;
+    void OnSessionTrackAdded(
+            PeerSession* session,
             rtc::scoped_refptr<webrtc::RtpReceiverInterface> receiver,
-            const std::vector<rtc::scoped_refptr<webrtc::MediaStreamInterface>>&
-            streams);
-    void OnRemoveTrack(
+            const std::vector<rtc::scoped_refptr<webrtc::MediaStreamInterface>>& streams) override;
+    void OnSessionTrackRemoved(
+            PeerSession* session,
             rtc::scoped_refptr<webrtc::RtpReceiverInterface> receiver) override;
-    void OnDataChannel(
-            rtc::scoped_refptr<webrtc::DataChannelInterface> channel) override {}
-    void OnRenegotiationNeeded() override {}
-    void OnIceConnectionChange(
-            webrtc::PeerConnectionInterface::IceConnectionState new_state) override {}
-    void OnIceGatheringChange(
-            webrtc::PeerConnectionInterface::IceGatheringState new_state) override {}
-    void OnIceCandidate(const webrtc::IceCandidateInterface* candidate) override;
-    void OnIceConnectionReceivingChange(bool receiving) override {}
+    void OnSessionDataChannel(
+            PeerSession* session,
+            rtc::scoped_refptr<webrtc::DataChannelInterface> channel) override;
+    void OnSessionDescriptionCreated(
+            PeerSession* session,
+            webrtc::SessionDescriptionInterface* desc) override;
+    void OnSessionDescriptionFailure(PeerSession* session,
+                                     webrtc::RTCError error) override;
+    void OnSessionFirstPacketReceived(PeerSession* session) override;
+
+    //
+    // BufferedDataChannelObserver implementation.
+    //
+
+    void OnChannelStateChange(BufferedDataChannel* channel) override;
+    void OnChannelMessage(BufferedDataChannel* channel,
+                          const webrtc::DataBuffer& buffer) override;
+    void OnChannelWritable(BufferedDataChannel* channel) override;
 
     //
     // PeerConnectionClientObserver implementation.
@@ -60,6 +186,8 @@ public:
 
     void OnDisconnected() override;
 
+    void OnPeersConnected(const std::vector<int>& ids) override;
+
     void OnPeerConnected(int id, const std::string& name) override;
 
     void OnPeerDisconnected(int id) override;
@@ -68,6 +196,8 @@ public:
 
     void OnMessageSent(int err) override;
 
+    void OnMessageFailed(int peer_id) override;
+
     void OnServerConnectionFailure() override;
 
     //
@@ -80,27 +210,118 @@ public:
 
     void ConnectToPeer(int peer_id);
 
-    void DisconnectFromCurrentPeer();
+    void DisconnectFromPeer(int peer_id);
 
-    void UIThreadCallback(int msg_id, void* data);
+    // Hangs up on every peer.
+    void DisconnectFromCurrentPeer();
 
-    // CreateSessionDescriptionObserver implementation.
-    void OnSuccess(webrtc::SessionDescriptionInterface* desc) override;
-    void OnFailure(webrtc::RTCError error) override;
+signals:
+    void signedIn();
+    // Signed out, or the server went away.
+    void disconnected();
+    // Peer list deltas; the list itself stays in client_->peers().
+    void peersConnected(const QVector<int>& ids);
+    void peerConnected(int id, const QString& name);
+    void peerDisconnected(int id);
+    // ICE connectivity with |peerId| was established or gave up.
+    void callConnected(int peerId);
+    void callFailed(int peerId);
+    // The call with |peerId| was torn down, by either side.
+    void callEnded(int peerId);
+    // Setup timeline of a call as one JSON line (see CallTimeline::ToJson()),
+    // once the first audio packet arrived or the call ended without one.
+    void callTimelineReady(int peerId, const QString& json);
+    // Data channel events, by call and channel label.  |data| is a copy,
+    // so any connection type will do.
+    void dataChannelOpened(int peerId, const QString& label);
+    void dataChannelClosed(int peerId, const QString& label);
+    void dataChannelMessage(int peerId, const QString& label, const QByteArray& data,
+                            bool binary);
+    // Sending on |label| was refused before and can go on.
+    void dataChannelWritable(int peerId, const QString& label);
 
 protected:
-    // Send a message to the remote peer.
-    void SendMessage(const std::string& json_object);
+    webrtc::PeerConnectionInterface::RTCConfiguration BuildConfiguration(bool dtls) const;
+    rtc::scoped_refptr<PeerSession> NewSession(bool dtls);
+    // Tops the pool up from a posted task rather than synchronously.
+    void SchedulePoolRefill();
+    void RefillPeerConnectionPool();
+    // Pooled connections gathered on the old network; replace them.
+    void OnNetworkChanged();
+    // Sends the session's local description as it stands now.
+    void SendLocalDescription(PeerSession* session);
+    // AudioProcessingFeature bits the capture path needs: the union over
+    // the calls in progress, or the default profile's when there are none.
+    int CaptureFeatures() const;
+    rtc::scoped_refptr<webrtc::AudioTrackInterface> CreateLocalAudioTrack(int features);
+    // Records |receiver|'s track if it's audio.
+    void StartRecording(PeerSession* session, webrtc::RtpReceiverInterface* receiver);
+    // Wraps a channel the peer opened and adds it to the call; Qt thread.
+    void AddRemoteDataChannel(int peer_id,
+                              rtc::scoped_refptr<webrtc::DataChannelInterface> channel);
+    // Replaces the local track if CaptureFeatures() changed.
+    void UpdateAudioProcessing();
+    // Logs process CPU time and current and peak RSS against the number of sessions.
+    void LogSessionResourceUsage();
+    // Marks the offer or answer sent once a batch for |peer_id| went out.
+    void MarkDescriptionSent(int peer_id);
+    // Logs the timeline and emits callTimelineReady(), once per call.
+    void ReportCallTimeline(PeerSession* session);
+
+    // Queues |event| for the Qt thread; any thread.
+    void PostEvent(UIEvent event);
+    // Handles the queued events in batches, on the Qt thread.
+    Q_INVOKABLE void DrainEvents();
+    void HandleEvent(UIEvent* event);
+
+    // Send a message to a remote peer.  Any thread; the message goes out
+    // from the Qt thread in the order of the calls.
+    void SendMessage(int peer_id, const std::string& json_object);
+    // Sends as many queued messages as the client's in-flight limit allows.
+    void FlushPendingMessages();
+    // Removes up to kMaxMessagesPerBatch messages for the same peer from the
+    // front of |pending_messages_| and returns them as a single payload (a
+    // JSON array if more than one).
+    std::string TakeMessageBatch(int* peer_id);
+    // Handles one signaling object, either a whole message or an element of
+    // a batch.
+    void HandlePeerMessage(PeerSession* session, const SignalingMessage& message);
 
-    int peer_id_;
-    bool loopback_;
-    rtc::scoped_refptr<webrtc::PeerConnectionInterface> peer_connection_;
+    // Active calls by peer id.  All share |peer_connection_factory_| and
+    // |local_audio_track_|.
+    std::map<int, rtc::scoped_refptr<PeerSession>> sessions_;
     rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface>
     peer_connection_factory_;
     PeerConnectionClient* client_;
-    std::deque<std::string*> pending_messages_;
+    ThreadTopology* threads_;
+    rtc::scoped_refptr<webrtc::AudioDeviceModule> audio_device_;
+    size_t max_mixed_sources_;
+    rtc::scoped_refptr<webrtc::AudioTrackInterface> local_audio_track_;
+    AudioProfile audio_profile_;
+    // Features |local_audio_track_|'s source was created with.
+    int audio_features_;
+    std::deque<rtc::scoped_refptr<PeerSession>> peer_connection_pool_;
+    size_t pool_size_;
+    bool pool_refill_pending_;
+    int ice_candidate_pool_size_;
+    bool trickle_ice_;
+    OpusSettings opus_settings_;
+    QNetworkConfigurationManager network_configurations_;
+    OverflowingMpscQueue<UIEvent> events_;
+    // A DrainEvents() call is queued on the Qt thread.
+    std::atomic<bool> drain_posted_;
+    // Read by stats_; Qt thread only.
+    EventQueueStats event_queue_stats_;
+    // (peer id, message) in signaling order.  Qt thread only.
+    std::deque<std::pair<int, std::string>> pending_messages_;
+    SignalingCodec codec_;
+    StatsCollector stats_;
+    CallRecorder recorder_;
+    // Parse results, reused across OnMessageFromPeer() calls.
+    std::vector<SignalingMessage> inbound_messages_;
     std::string server_;
-    webrtc::MediaStreamInterface* remote_stream;
+    // CPU time at the last LogSessionResourceUsage(), in ms.
+    int64_t last_cpu_time_ms_;
 
 };
 
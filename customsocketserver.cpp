@@ -1,13 +1,139 @@
 #include "customsocketserver.h"
 
+#include <algorithm>
+#include <QAbstractEventDispatcher>
+#include <QCoreApplication>
+
+#if defined(HAVE_GLIB)
+#include <errno.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <glib.h>
+#endif
+
+namespace {
+
+// Bounds for the time Wait() blocks in the socket server without giving Qt a
+// chance to run, when Qt can't wake it.  Socket activity and
+// rtc::Thread::Post() from other threads wake the wait immediately; these
+// only bound the latency of Qt events.
+const int kMinQtSliceMs = 5;
+const int kMaxQtSliceMs = 50;
+
+}  // namespace
+
+#if defined(HAVE_GLIB)
+
+// An epoll set of the descriptors Qt's GLib context polls, itself watched by
+// the socket server: once any of them is ready the set turns readable and
+// ends the wait.  A set of its own rather than adding Qt's descriptors to the
+// socket server, so a descriptor Qt closes, whose number an rtc socket then
+// gets, can't take that socket out of the socket server's set.
+class QtDescriptorWatch : public rtc::Dispatcher
+{
+public:
+    explicit QtDescriptorWatch(rtc::SocketServer* server)
+        : server_(server), epoll_fd_(epoll_create1(EPOLL_CLOEXEC)) {}
+    ~QtDescriptorWatch() override {
+        if (epoll_fd_ >= 0)
+            close(epoll_fd_);
+    }
+
+    bool valid() const { return epoll_fd_ >= 0; }
+
+    // Watches what |context| would poll now and lowers |timeout| to its
+    // next timeout.  False if another thread owns the context.
+    bool Sync(GMainContext* context, int* timeout) {
+        if (!g_main_context_acquire(context))
+            return false;
+        gint priority = 0;
+        g_main_context_prepare(context, &priority);
+        gint context_timeout = -1;
+        gint count = g_main_context_query(context, priority, &context_timeout,
+                                          fds_.data(), static_cast<gint>(fds_.size()));
+        if (count > static_cast<gint>(fds_.size())) {
+            fds_.resize(count);
+            count = g_main_context_query(context, priority, &context_timeout,
+                                         fds_.data(), count);
+        }
+        g_main_context_release(context);
+
+        Watch(count);
+        if (context_timeout >= 0 &&
+                (*timeout == rtc::SocketServer::kForever || context_timeout < *timeout))
+            *timeout = context_timeout;
+        return true;
+    }
+
+    // rtc::Dispatcher
+    uint32_t GetRequestedEvents() override { return rtc::DE_READ; }
+    void OnPreEvent(uint32_t ff) override {}
+    void OnEvent(uint32_t ff, int err) override {
+        // The socket server only stops waiting when woken; Qt picks the
+        // event up at the top of the next Wait().
+        server_->WakeUp();
+    }
+    int GetDescriptor() override { return epoll_fd_; }
+    bool IsDescriptorClosed() override { return false; }
+
+private:
+    // Makes the set hold the first |count| entries of |fds_|.
+    void Watch(int count) {
+        std::map<int, uint32_t> wanted;
+        for (int i = 0; i < count; ++i) {
+            uint32_t& events = wanted[fds_[i].fd];
+            if (fds_[i].events & (G_IO_IN | G_IO_PRI))
+                events |= EPOLLIN;
+            if (fds_[i].events & G_IO_OUT)
+                events |= EPOLLOUT;
+        }
+        for (const auto& entry : watched_) {
+            // Fails harmlessly for descriptors that are closed already.
+            if (wanted.find(entry.first) == wanted.end())
+                epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, entry.first, nullptr);
+        }
+        for (const auto& entry : wanted) {
+            epoll_event event;
+            memset(&event, 0, sizeof(event));
+            event.events = entry.second;
+            event.data.fd = entry.first;
+            // A descriptor closed and reopened under the same number since
+            // the last Wait() has left the set; MOD tells.
+            if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, entry.first, &event) != 0 &&
+                    errno == ENOENT)
+                epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, entry.first, &event);
+        }
+        watched_.swap(wanted);
+    }
+
+    rtc::SocketServer* server_;
+    int epoll_fd_;
+    std::vector<GPollFD> fds_;
+    // Descriptor to epoll events, as last registered.
+    std::map<int, uint32_t> watched_;
+};
+
+#else
+
+class QtDescriptorWatch : public rtc::Dispatcher {};
+
+#endif  // HAVE_GLIB
+
 CustomSocketServer::CustomSocketServer()
-    : conductor(NULL),
-      client(NULL)
+    : messageQueue(NULL),
+      conductor(NULL),
+      client(NULL),
+      shuttingDown(false),
+      qtSliceMs(kMinQtSliceMs),
+      waits(0)
 {
 }
 
 CustomSocketServer::~CustomSocketServer()
 {
+    if (qtWatch)
+        Remove(qtWatch.get());
 }
 
 void CustomSocketServer::SetMessageQueue(rtc::MessageQueue *queue)
@@ -25,10 +151,50 @@ void CustomSocketServer::setConducotr(Conductor *appConductor)
     conductor = appConductor;
 }
 
+void CustomSocketServer::shutdown()
+{
+    shuttingDown = true;
+    WakeUp();
+}
+
+bool CustomSocketServer::watchQtDescriptors(int* timeout)
+{
+#if defined(HAVE_GLIB)
+    // Not when QT_NO_GLIB=1 put Qt on its own dispatcher.
+    QAbstractEventDispatcher* dispatcher = QAbstractEventDispatcher::instance();
+    if (!dispatcher || !dispatcher->inherits("QEventDispatcherGlib"))
+        return false;
+    if (!qtWatch) {
+        std::unique_ptr<QtDescriptorWatch> watch(new QtDescriptorWatch(this));
+        if (!watch->valid())
+            return false;
+        qtWatch = std::move(watch);
+        Add(qtWatch.get());
+    }
+    // Qt's main thread dispatcher runs the default context.
+    return qtWatch->Sync(g_main_context_default(), timeout);
+#else
+    Q_UNUSED(timeout);
+    return false;
+#endif
+}
+
 bool CustomSocketServer::Wait(int cms, bool process_io)
 {
-    if (!conductor->connection_active() && client != NULL && !client->is_connected()) {
+    ++waits;
+    if (shuttingDown && !conductor->connection_active() &&
+            (client == NULL || !client->is_connected())) {
         messageQueue->Quit();
+        return true;
+    }
+
+    QAbstractEventDispatcher* dispatcher = QAbstractEventDispatcher::instance();
+    bool qtBusy = dispatcher && dispatcher->processEvents(QEventLoop::AllEvents);
+
+    int timeout = cms;
+    if (!watchQtDescriptors(&timeout)) {
+        qtSliceMs = qtBusy ? kMinQtSliceMs : std::min(qtSliceMs * 2, kMaxQtSliceMs);
+        timeout = cms == kForever ? qtSliceMs : std::min(cms, qtSliceMs);
     }
-    return rtc::PhysicalSocketServer::Wait(0, process_io);
+    return rtc::PhysicalSocketServer::Wait(timeout, process_io);
 }
@@ -1,10 +1,24 @@
 #ifndef CUSTOMSOCKETSERVER_H
 #define CUSTOMSOCKETSERVER_H
+#include <stdint.h>
+#include <map>
+#include <memory>
+#include <vector>
 #include "rtc_base/physical_socket_server.h"
 #include "peerconnectionclient.h"
 #include "conductor.h"
 
+class QtDescriptorWatch;
 
+// Socket server for the main thread.  The rtc::Thread built on top of it
+// drives both loops: Wait() hands pending Qt events to the Qt dispatcher and
+// then blocks in the socket server for as long as rtc allows.
+//
+// Where Qt runs on GLib (Linux, HAVE_GLIB) the wait also watches the
+// descriptors of Qt's GLib context and ends with Qt's next timer, so events
+// posted from other threads, window system events and Qt sockets wake it
+// and an idle thread sleeps until there's work.  Elsewhere Qt can't wake it
+// and the wait is cut into slices instead, see qtSliceMs.
 class CustomSocketServer : public rtc::PhysicalSocketServer
 {
 public:
@@ -14,12 +28,29 @@ public:
     void SetMessageQueue(rtc::MessageQueue* queue) override;
     void setClient(PeerConnectionClient* peerClient);
     void setConducotr(Conductor* appConductor);
+    // Asks the loop to stop once the client has signed out and the call is
+    // gone.
+    void shutdown();
     bool Wait(int cms, bool process_io) override;
+    // Wait() calls so far; how often an idle loop wakes up.
+    uint64_t waitCount() const { return waits; }
 
 protected:
+    // Points qtWatch at the descriptors Qt's GLib context polls and lowers
+    // |timeout| to its next timer.  False if Qt doesn't run on GLib.
+    bool watchQtDescriptors(int* timeout);
+
     rtc::MessageQueue* messageQueue;
     Conductor* conductor;
     PeerConnectionClient* client;
+    bool shuttingDown;
+    // How long Wait() may block before looking at Qt again, when Qt can't
+    // wake it.  Grows while Qt stays idle and resets as soon as it has
+    // events to deliver.
+    int qtSliceMs;
+    uint64_t waits;
+    // Readable whenever one of Qt's descriptors is ready; null without GLib.
+    std::unique_ptr<QtDescriptorWatch> qtWatch;
 };
 
 #endif // CUSTOMSOCKETSERVER_H
@@ -0,0 +1,136 @@
+#include "dnscache.h"
+
+#include <algorithm>
+#include <QDebug>
+
+#include "rtc_base/checks.h"
+#include "rtc_base/socket_address.h"
+#include "rtc_base/time_utils.h"
+
+DnsCache::Entry::Entry()
+    : expires_ms(0),
+      preferred_family(AF_UNSPEC),
+      resolver(nullptr) {
+}
+
+DnsCache* DnsCache::Instance() {
+    // Never destroyed: resolvers may still be running at exit.
+    static DnsCache* cache = new DnsCache();
+    return cache;
+}
+
+DnsCache::DnsCache()
+    : notifying_(nullptr),
+      ttl_ms_(kDefaultTtlMs) {
+}
+
+DnsCache::~DnsCache() {
+    for (auto& entry : entries_) {
+        if (entry.second.resolver)
+            entry.second.resolver->Destroy(false);
+    }
+}
+
+bool DnsCache::Lookup(const std::string& hostname, std::vector<rtc::IPAddress>* addresses) const {
+    auto it = entries_.find(hostname);
+    if (it == entries_.end() || it->second.addresses.empty() ||
+            rtc::TimeMillis() >= it->second.expires_ms)
+        return false;
+    *addresses = ConnectOrder(it->second.addresses, it->second.preferred_family);
+    return true;
+}
+
+void DnsCache::Resolve(const std::string& hostname, DnsCacheObserver* observer) {
+    Entry& entry = entries_[hostname];
+    if (std::find(entry.observers.begin(), entry.observers.end(), observer) ==
+            entry.observers.end())
+        entry.observers.push_back(observer);
+    if (entry.resolver)
+        return;
+    entry.resolver = new rtc::AsyncResolver();
+    entry.resolver->SignalDone.connect(this, &DnsCache::OnResolveResult);
+    // Port 0: only the name matters, and one entry serves every port.
+    entry.resolver->Start(rtc::SocketAddress(hostname, 0));
+}
+
+void DnsCache::Cancel(DnsCacheObserver* observer) {
+    for (auto& entry : entries_) {
+        std::vector<DnsCacheObserver*>& observers = entry.second.observers;
+        observers.erase(std::remove(observers.begin(), observers.end(), observer),
+                        observers.end());
+    }
+    if (notifying_)
+        std::replace(notifying_->begin(), notifying_->end(), observer,
+                     static_cast<DnsCacheObserver*>(nullptr));
+}
+
+void DnsCache::SetPreferredFamily(const std::string& hostname, int family) {
+    auto it = entries_.find(hostname);
+    if (it != entries_.end())
+        it->second.preferred_family = family;
+}
+
+void DnsCache::Invalidate(const std::string& hostname) {
+    auto it = entries_.find(hostname);
+    if (it != entries_.end())
+        it->second.expires_ms = 0;
+}
+
+void DnsCache::OnResolveResult(rtc::AsyncResolverInterface* resolver) {
+    auto it = entries_.begin();
+    while (it != entries_.end() && it->second.resolver != resolver)
+        ++it;
+    RTC_DCHECK(it != entries_.end());
+    if (it == entries_.end())
+        return;
+    const std::string& hostname = it->first;
+    Entry& entry = it->second;
+
+    rtc::AsyncResolver* done = entry.resolver;
+    entry.resolver = nullptr;
+    if (done->GetError() == 0 && !done->addresses().empty()) {
+        if (entry.addresses != done->addresses()) {
+            // The winning family may not be reachable on the new addresses.
+            entry.addresses = done->addresses();
+            entry.preferred_family = AF_UNSPEC;
+        }
+        entry.expires_ms = rtc::TimeMillis() + ttl_ms_;
+    } else if (!entry.addresses.empty()) {
+        qDebug() << "Can't resolve" << hostname.c_str() << "; using the previous addresses";
+    } else {
+        qDebug() << "Can't resolve" << hostname.c_str();
+    }
+    done->Destroy(false);
+
+    std::vector<rtc::IPAddress> addresses =
+            ConnectOrder(entry.addresses, entry.preferred_family);
+    // Observers may resolve again from the callback, or cancel others.
+    std::vector<DnsCacheObserver*> observers;
+    observers.swap(entry.observers);
+    notifying_ = &observers;
+    for (size_t i = 0; i < observers.size(); ++i) {
+        if (observers[i])
+            observers[i]->OnHostResolved(hostname, addresses);
+    }
+    notifying_ = nullptr;
+}
+
+std::vector<rtc::IPAddress> DnsCache::ConnectOrder(
+        const std::vector<rtc::IPAddress>& addresses, int preferred_family) {
+    // As in RFC 8305 section 4: alternate families, so that a broken one
+    // costs one attempt delay rather than one per address.
+    std::vector<rtc::IPAddress> first;
+    std::vector<rtc::IPAddress> second;
+    int first_family = preferred_family != AF_UNSPEC ? preferred_family : AF_INET6;
+    for (const rtc::IPAddress& address : addresses)
+        (address.family() == first_family ? first : second).push_back(address);
+    std::vector<rtc::IPAddress> ordered;
+    ordered.reserve(addresses.size());
+    for (size_t i = 0; i < std::max(first.size(), second.size()); ++i) {
+        if (i < first.size())
+            ordered.push_back(first[i]);
+        if (i < second.size())
+            ordered.push_back(second[i]);
+    }
+    return ordered;
+}
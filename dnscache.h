@@ -0,0 +1,87 @@
+#ifndef DNSCACHE_H
+#define DNSCACHE_H
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "rtc_base/ip_address.h"
+#include "rtc_base/net_helpers.h"
+#include "rtc_base/third_party/sigslot/sigslot.h"
+
+class DnsCacheObserver {
+public:
+    // |addresses| in connect order (see DnsCache::Lookup()); empty if the
+    // name didn't resolve.
+    virtual void OnHostResolved(const std::string& hostname,
+                                const std::vector<rtc::IPAddress>& addresses) = 0;
+
+protected:
+    virtual ~DnsCacheObserver() {}
+};
+
+// Resolved addresses of the signaling server, shared by every
+// PeerConnectionClient in the process so that reconnecting, or the load
+// generator signing in hundreds of clients, doesn't go back to DNS each
+// time.  getaddrinfo() doesn't report record TTLs, so an entry is fresh for
+// a fixed ttl_ms() after it was resolved.  Concurrent lookups of the same
+// name share one resolver.  When re-resolving an expired name fails the old
+// addresses are handed out once more rather than nothing, which is what a
+// reconnect during a network blip needs.
+//
+// The main thread only; results arrive on it.
+class DnsCache : public sigslot::has_slots<>
+{
+public:
+    static const int kDefaultTtlMs = 60 * 1000;
+
+    static DnsCache* Instance();
+
+    void set_ttl_ms(int ttl_ms) { ttl_ms_ = ttl_ms; }
+    int ttl_ms() const { return ttl_ms_; }
+
+    // Fresh addresses of |hostname| in the order to try them: alternating
+    // between families, starting with the one that last won the race (see
+    // SetPreferredFamily()), IPv6 if none has.  False on a miss.
+    bool Lookup(const std::string& hostname, std::vector<rtc::IPAddress>* addresses) const;
+    // Resolves |hostname|, or joins the lookup already under way, and tells
+    // |observer| when done.  For a miss; it doesn't look at the cache first.
+    void Resolve(const std::string& hostname, DnsCacheObserver* observer);
+    // |observer| is going away; it won't be called.
+    void Cancel(DnsCacheObserver* observer);
+
+    // A connection to |hostname| over |family| was established first.
+    void SetPreferredFamily(const std::string& hostname, int family);
+    // None of the addresses could be reached; resolve again next time.
+    void Invalidate(const std::string& hostname);
+
+    // |addresses| in the order Lookup() hands them out: alternating between
+    // families, |preferred_family| first, or IPv6 for AF_UNSPEC.
+    static std::vector<rtc::IPAddress> ConnectOrder(
+            const std::vector<rtc::IPAddress>& addresses, int preferred_family);
+
+private:
+    struct Entry {
+        Entry();
+
+        std::vector<rtc::IPAddress> addresses;
+        int64_t expires_ms;
+        int preferred_family;
+        // Set while resolving.
+        rtc::AsyncResolver* resolver;
+        std::vector<DnsCacheObserver*> observers;
+    };
+
+    DnsCache();
+    ~DnsCache();
+
+    void OnResolveResult(rtc::AsyncResolverInterface* resolver);
+
+    std::map<std::string, Entry> entries_;
+    // Observers being called back by OnResolveResult(), for Cancel().
+    std::vector<DnsCacheObserver*>* notifying_;
+    int ttl_ms_;
+};
+
+#endif // DNSCACHE_H
@@ -0,0 +1,58 @@
+#include "tests.h"
+
+#include <sys/socket.h>
+#include <string>
+#include <vector>
+
+#include "rtc_base/ip_address.h"
+#include "dnscache.h"
+
+namespace {
+
+std::vector<rtc::IPAddress> Addresses(const std::vector<std::string>& texts) {
+    std::vector<rtc::IPAddress> addresses;
+    for (const std::string& text : texts) {
+        rtc::IPAddress address;
+        rtc::IPFromString(text, &address);
+        addresses.push_back(address);
+    }
+    return addresses;
+}
+
+// "a b c", to compare orders in one check.
+std::string Join(const std::vector<rtc::IPAddress>& addresses) {
+    std::string joined;
+    for (const rtc::IPAddress& address : addresses)
+        joined += (joined.empty() ? "" : " ") + address.ToString();
+    return joined;
+}
+
+// Resolver order: all of one family, then the other.
+const std::vector<std::string> kResolved = {
+    "192.0.2.1", "192.0.2.2", "192.0.2.3", "2001:db8::1", "2001:db8::2",
+};
+
+}  // namespace
+
+// IPv6 goes first until a family has won a race.
+TEST(ConnectOrderAlternates) {
+    EXPECT_EQ(Join(DnsCache::ConnectOrder(Addresses(kResolved), AF_UNSPEC)),
+              std::string("2001:db8::1 192.0.2.1 2001:db8::2 192.0.2.2 192.0.2.3"));
+    EXPECT_EQ(Join(DnsCache::ConnectOrder(Addresses(kResolved), AF_INET6)),
+              std::string("2001:db8::1 192.0.2.1 2001:db8::2 192.0.2.2 192.0.2.3"));
+}
+
+TEST(ConnectOrderPreferredFamilyFirst) {
+    EXPECT_EQ(Join(DnsCache::ConnectOrder(Addresses(kResolved), AF_INET)),
+              std::string("192.0.2.1 2001:db8::1 192.0.2.2 2001:db8::2 192.0.2.3"));
+}
+
+// One family only, or the preferred one missing: resolver order, unchanged.
+TEST(ConnectOrderSingleFamily) {
+    std::vector<std::string> v4 = {"192.0.2.1", "192.0.2.2"};
+    EXPECT_EQ(Join(DnsCache::ConnectOrder(Addresses(v4), AF_INET6)),
+              std::string("192.0.2.1 192.0.2.2"));
+    EXPECT_EQ(Join(DnsCache::ConnectOrder(Addresses(v4), AF_INET)),
+              std::string("192.0.2.1 192.0.2.2"));
+    EXPECT_TRUE(DnsCache::ConnectOrder(std::vector<rtc::IPAddress>(), AF_UNSPEC).empty());
+}
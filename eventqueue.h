@@ -0,0 +1,202 @@
+#ifndef EVENTQUEUE_H
+#define EVENTQUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+// Bounded multi-producer, single-consumer queue of move-only values.
+//
+// Every slot is allocated up front and carries a sequence number that says
+// whose turn it is: producers claim a position with one compare-and-swap on
+// |head_| and publish the value by bumping the slot's sequence, the consumer
+// takes it and hands the slot back a lap later.  No locks and, for values
+// that move without allocating, no allocation.  A full queue turns the value
+// away (and counts it) rather than blocking the producer.
+//
+// |T| must be default-constructible and move-assignable; a popped slot is
+// reset to T() so it doesn't keep payloads alive.
+template <typename T>
+class BoundedMpscQueue
+{
+public:
+    // |capacity| must be a power of two.
+    explicit BoundedMpscQueue(size_t capacity)
+        : slots_(new Slot[capacity]),
+          capacity_(capacity),
+          head_(0),
+          tail_(0),
+          pushed_(0),
+          dropped_(0) {
+        for (size_t i = 0; i < capacity; ++i)
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    // Any thread.  Returns false, leaving |value| alone, when full.
+    bool Push(T&& value) {
+        uint64_t position = head_.load(std::memory_order_relaxed);
+        Slot* slot;
+        for (;;) {
+            slot = &slots_[position & (capacity_ - 1)];
+            uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+            int64_t lag = static_cast<int64_t>(sequence - position);
+            if (lag == 0) {
+                if (head_.compare_exchange_weak(position, position + 1,
+                                                std::memory_order_relaxed))
+                    break;
+            } else if (lag < 0) {
+                // The consumer hasn't freed this slot from the last lap.
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                position = head_.load(std::memory_order_relaxed);
+            }
+        }
+        slot->value = std::move(value);
+        slot->sequence.store(position + 1, std::memory_order_release);
+        pushed_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Consumer thread only.  Values come out in the order their producers
+    // claimed positions; false when there's nothing published at the front.
+    bool Pop(T* value) {
+        uint64_t position = tail_.load(std::memory_order_relaxed);
+        Slot& slot = slots_[position & (capacity_ - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != position + 1)
+            return false;
+        *value = std::move(slot.value);
+        slot.value = T();
+        slot.sequence.store(position + capacity_, std::memory_order_release);
+        tail_.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Approximate while producers are pushing.
+    size_t size() const {
+        uint64_t tail = tail_.load(std::memory_order_acquire);
+        uint64_t head = head_.load(std::memory_order_acquire);
+        return head > tail ? static_cast<size_t>(head - tail) : 0;
+    }
+    size_t capacity() const { return capacity_; }
+    uint64_t pushed() const { return pushed_.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Slot[]> slots_;
+    const size_t capacity_;
+    // Free-running, like TraceRing's, and padded apart for the same reason.
+    std::atomic<uint64_t> head_;
+    char padding_[64 - sizeof(std::atomic<uint64_t>)];
+    std::atomic<uint64_t> tail_;
+    std::atomic<uint64_t> pushed_;
+    std::atomic<uint64_t> dropped_;
+};
+
+// A BoundedMpscQueue that only loses what the producer says it may.  A
+// droppable value that finds the queue full is turned away as before; any
+// other value goes to an unbounded overflow list behind a mutex, and so
+// does every other non-droppable value after it until the consumer has
+// emptied the list, so that those keep the order they were pushed in.
+// The mutex is only taken while there is an overflow.
+template <typename T>
+class OverflowingMpscQueue
+{
+public:
+    explicit OverflowingMpscQueue(size_t capacity)
+        : queue_(capacity), overflowing_(false), overflowed_(0), dropped_(0) {}
+
+    // Any thread.  Returns false, leaving |value| alone, only if |droppable|
+    // and the queue is full.
+    bool Push(T&& value, bool droppable) {
+        if (droppable || !overflowing_.load(std::memory_order_acquire)) {
+            if (queue_.Push(std::move(value)))
+                return true;
+            if (droppable) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+        }
+        std::lock_guard<std::mutex> lock(overflow_mutex_);
+        overflow_.push_back(std::move(value));
+        overflowing_.store(true, std::memory_order_release);
+        overflowed_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Consumer thread only.  The bounded queue comes first: what's there was
+    // pushed before the overflow started, or is droppable and unordered.
+    // The overflow is only touched once the bounded queue is empty, claimed
+    // but unpublished slots included, since a producer's later value may be
+    // in the overflow while its earlier one is published behind such a
+    // slot; until then this returns false.  Taking the overflow out one
+    // value at a time means no producer is back on the bounded queue while
+    // an earlier value of its own is still in the overflow.
+    bool Pop(T* value) {
+        if (queue_.Pop(value))
+            return true;
+        if (!overflowing_.load(std::memory_order_acquire))
+            return false;
+        std::lock_guard<std::mutex> lock(overflow_mutex_);
+        // Read under the lock: a producer claims its slot before it takes
+        // the lock to overflow, so any such claim shows here.
+        if (overflow_.empty() || queue_.size() > 0)
+            return false;
+        *value = std::move(overflow_.front());
+        overflow_.pop_front();
+        if (overflow_.empty())
+            overflowing_.store(false, std::memory_order_release);
+        return true;
+    }
+
+    // Approximate while producers are pushing.
+    size_t size() {
+        size_t size = queue_.size();
+        if (overflowing_.load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> lock(overflow_mutex_);
+            size += overflow_.size();
+        }
+        return size;
+    }
+    size_t capacity() const { return queue_.capacity(); }
+    uint64_t pushed() const { return queue_.pushed() + overflowed(); }
+    uint64_t overflowed() const { return overflowed_.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    BoundedMpscQueue<T> queue_;
+    std::mutex overflow_mutex_;
+    std::deque<T> overflow_;
+    // |overflow_| isn't empty; stored under |overflow_mutex_|.
+    std::atomic<bool> overflowing_;
+    std::atomic<uint64_t> overflowed_;
+    std::atomic<uint64_t> dropped_;
+};
+
+// What the metrics endpoint reports about a queue and its consumer.
+struct EventQueueStats {
+    EventQueueStats()
+        : depth(0), max_depth(0), capacity(0), pushed(0), overflowed(0), dropped(0),
+          batches(0) {}
+
+    // Waiting when the last batch started, and the most ever seen then.
+    size_t depth;
+    size_t max_depth;
+    size_t capacity;
+    uint64_t pushed;
+    // Queued past the capacity, in the consumer's unbounded spill-over.
+    uint64_t overflowed;
+    uint64_t dropped;
+    uint64_t batches;
+};
+
+#endif // EVENTQUEUE_H
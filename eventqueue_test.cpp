@@ -0,0 +1,215 @@
+#include "tests.h"
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "eventqueue.h"
+
+namespace {
+
+struct Item {
+    Item() : producer(-1), sequence(-1), droppable(false) {}
+    Item(int producer, int sequence, bool droppable)
+        : producer(producer), sequence(sequence), droppable(droppable) {}
+
+    int producer;
+    int sequence;
+    bool droppable;
+};
+
+// An Item that producer kGatedProducer's push holds between claiming its
+// slot and publishing it, until |gate_open|.  The value is moved into the
+// slot in that window.
+const int kGatedProducer = 99;
+std::atomic<bool> gate_claimed(false);
+std::atomic<bool> gate_open(false);
+
+struct GatedItem : Item {
+    GatedItem() {}
+    GatedItem(int producer, int sequence) : Item(producer, sequence, false) {}
+    GatedItem(GatedItem&& other) : Item(other) {}
+    GatedItem& operator=(GatedItem&& other) {
+        Item::operator=(other);
+        if (producer == kGatedProducer && !gate_open.load()) {
+            gate_claimed.store(true);
+            while (!gate_open.load())
+                std::this_thread::yield();
+        }
+        return *this;
+    }
+};
+
+}  // namespace
+
+// Single-threaded walk through the three ways a push can go.
+TEST(EventQueueOverflowKeepsOrder) {
+    OverflowingMpscQueue<Item> queue(4);
+    for (int i = 0; i < 4; ++i)
+        ASSERT_TRUE(queue.Push(Item(0, i, false), false));
+    EXPECT_TRUE(!queue.Push(Item(1, 0, true), true));
+    EXPECT_TRUE(queue.Push(Item(0, 4, false), false));
+    EXPECT_EQ(queue.size(), 5u);
+
+    // Room again, but ordered values keep going to the overflow while it
+    // holds anything; droppable ones take the room.
+    Item item;
+    ASSERT_TRUE(queue.Pop(&item));
+    EXPECT_EQ(item.sequence, 0);
+    EXPECT_TRUE(queue.Push(Item(0, 5, false), false));
+    EXPECT_TRUE(queue.Push(Item(1, 1, true), true));
+
+    std::vector<int> ordered;
+    while (queue.Pop(&item)) {
+        if (item.producer == 0)
+            ordered.push_back(item.sequence);
+    }
+    EXPECT_EQ(ordered.size(), 5u);
+    for (size_t i = 0; i < ordered.size(); ++i)
+        EXPECT_EQ(ordered[i], static_cast<int>(i) + 1);
+    EXPECT_EQ(queue.pushed(), 7u);
+    EXPECT_EQ(queue.overflowed(), 2u);
+    EXPECT_EQ(queue.dropped(), 1u);
+
+    // Empty again: ordered values use the bounded queue.
+    EXPECT_TRUE(queue.Push(Item(0, 6, false), false));
+    EXPECT_EQ(queue.overflowed(), 2u);
+}
+
+// Producers hammering a small queue against a consumer.  Nothing ordered
+// is lost or reordered, and every droppable value is either delivered or
+// counted.  Meant to be run under TSan as well (qmake CONFIG+=tsan).
+TEST(EventQueueContention) {
+    const int kOrderedProducers = 3;
+    const int kItems = 100000;
+    OverflowingMpscQueue<Item> queue(16);
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kOrderedProducers; ++p) {
+        producers.emplace_back([&queue, p]() {
+            for (int i = 0; i < kItems; ++i) {
+                queue.Push(Item(p, i, false), false);
+                // Lets the consumer catch up now and then, so the overflow
+                // starts and empties over and over.
+                if (i % 8 == 0)
+                    std::this_thread::yield();
+            }
+        });
+    }
+    producers.emplace_back([&queue]() {
+        for (int i = 0; i < kItems; ++i)
+            queue.Push(Item(kOrderedProducers, i, true), true);
+    });
+
+    std::vector<int> next(kOrderedProducers, 0);
+    int ordered = 0;
+    int droppable = 0;
+    int last_droppable = -1;
+    bool in_order = true;
+    Item item;
+    while (ordered < kOrderedProducers * kItems) {
+        if (!queue.Pop(&item)) {
+            std::this_thread::yield();
+            continue;
+        }
+        if (item.droppable) {
+            // Droppable values still come out in order, only with gaps.
+            in_order = in_order && item.sequence > last_droppable;
+            last_droppable = item.sequence;
+            ++droppable;
+        } else {
+            in_order = in_order && item.sequence == next[item.producer]++;
+            ++ordered;
+        }
+    }
+    for (std::thread& producer : producers)
+        producer.join();
+    while (queue.Pop(&item)) {
+        EXPECT_TRUE(item.droppable);
+        ++droppable;
+    }
+
+    EXPECT_TRUE(in_order);
+    EXPECT_EQ(droppable + queue.dropped(), static_cast<uint64_t>(kItems));
+    EXPECT_EQ(queue.pushed(), static_cast<uint64_t>((kOrderedProducers + 1) * kItems) -
+              queue.dropped());
+    EXPECT_EQ(queue.size(), 0u);
+}
+
+// The front slot claimed but not yet published, the slot behind it
+// published, and a later value of the same producer in the overflow: the
+// overflow must wait for the ring rather than overtake it.
+TEST(EventQueueOverflowWaitsForClaimedSlot) {
+    OverflowingMpscQueue<GatedItem> queue(2);
+    gate_claimed.store(false);
+    gate_open.store(false);
+    std::thread gated([&queue]() {
+        queue.Push(GatedItem(kGatedProducer, 0), false);
+    });
+    while (!gate_claimed.load())
+        std::this_thread::yield();
+
+    ASSERT_TRUE(queue.Push(GatedItem(0, 0), false));
+    ASSERT_TRUE(queue.Push(GatedItem(0, 1), false));
+    EXPECT_EQ(queue.overflowed(), 1u);
+    GatedItem item;
+    EXPECT_TRUE(!queue.Pop(&item));
+
+    gate_open.store(true);
+    gated.join();
+    std::vector<std::string> order;
+    while (queue.Pop(&item))
+        order.push_back(std::to_string(item.producer) + ":" + std::to_string(item.sequence));
+    EXPECT_EQ(order.size(), 3u);
+    if (order.size() == 3) {
+        EXPECT_EQ(order[0], std::string("99:0"));
+        EXPECT_EQ(order[1], std::string("0:0"));
+        EXPECT_EQ(order[2], std::string("0:1"));
+    }
+}
+
+// The same window under load: many producers on a two-slot queue keep
+// the consumer finding a claimed front slot while the overflow is in use.
+TEST(EventQueueManyProducersTinyQueue) {
+    const int kProducers = 8;
+    const int kItems = 20000;
+    OverflowingMpscQueue<Item> queue(2);
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; ++p) {
+        producers.emplace_back([&queue, p]() {
+            for (int i = 0; i < kItems; ++i) {
+                queue.Push(Item(p, i, false), false);
+                if (i % 8 == 0)
+                    std::this_thread::yield();
+            }
+        });
+    }
+
+    std::vector<int> next(kProducers, 0);
+    int received = 0;
+    int reordered = 0;
+    std::string first_reordered;
+    Item item;
+    while (received < kProducers * kItems) {
+        if (!queue.Pop(&item)) {
+            std::this_thread::yield();
+            continue;
+        }
+        if (item.sequence != next[item.producer] && reordered++ == 0) {
+            first_reordered = "producer " + std::to_string(item.producer) + " expected " +
+                    std::to_string(next[item.producer]) + " got " +
+                    std::to_string(item.sequence);
+        }
+        next[item.producer] = item.sequence + 1;
+        ++received;
+    }
+    for (std::thread& producer : producers)
+        producer.join();
+
+    EXPECT_EQ(reordered, 0);
+    EXPECT_EQ(first_reordered, std::string());
+    EXPECT_TRUE(!queue.Pop(&item));
+}
@@ -0,0 +1,189 @@
+#include "fakeaudiodevice.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <memory>
+#include <utility>
+
+#include "modules/audio_device/include/test_audio_device.h"
+#include "rtc_base/buffer.h"
+
+namespace {
+
+const double kPi = 3.14159265358979323846;
+const int kDefaultToneHz = 440;
+const int16_t kAmplitude = 8000;
+
+typedef webrtc::TestAudioDeviceModule TestAdm;
+
+// Splits "kind:argument"; |argument| is empty if there's no colon.
+void SplitSpec(const std::string& spec, std::string* kind, std::string* argument) {
+    size_t colon = spec.find(':');
+    *kind = spec.substr(0, colon);
+    argument->clear();
+    if (colon != std::string::npos)
+        *argument = spec.substr(colon + 1);
+}
+
+// Raw s16le PCM, restarted from the top at end of file.
+class PcmFileCapturer : public TestAdm::Capturer
+{
+public:
+    PcmFileCapturer(FILE* file, int sample_rate_hz, int channels)
+        : file_(file), sample_rate_hz_(sample_rate_hz), channels_(channels) {}
+    ~PcmFileCapturer() override { fclose(file_); }
+
+    int SamplingFrequency() const override { return sample_rate_hz_; }
+    int NumChannels() const override { return channels_; }
+
+    bool Capture(rtc::BufferT<int16_t>* buffer) override {
+        const size_t samples = TestAdm::SamplesPerFrame(sample_rate_hz_) * channels_;
+        buffer->SetData(samples, [this, samples](rtc::ArrayView<int16_t> data) {
+            size_t read = fread(data.data(), sizeof(int16_t), samples, file_);
+            if (read < samples) {
+                rewind(file_);
+                read += fread(data.data() + read, sizeof(int16_t), samples - read, file_);
+            }
+            // Shorter than one frame, or empty: pad with silence.
+            for (size_t i = read; i < samples; ++i)
+                data[i] = 0;
+            return samples;
+        });
+        return true;
+    }
+
+private:
+    FILE* file_;
+    const int sample_rate_hz_;
+    const int channels_;
+};
+
+// A sine wave, or silence when |frequency_hz| is 0.
+class ToneCapturer : public TestAdm::Capturer
+{
+public:
+    ToneCapturer(int frequency_hz, int sample_rate_hz, int channels)
+        : phase_step_(2 * kPi * frequency_hz / sample_rate_hz),
+          phase_(0),
+          sample_rate_hz_(sample_rate_hz),
+          channels_(channels) {}
+
+    int SamplingFrequency() const override { return sample_rate_hz_; }
+    int NumChannels() const override { return channels_; }
+
+    bool Capture(rtc::BufferT<int16_t>* buffer) override {
+        const size_t frames = TestAdm::SamplesPerFrame(sample_rate_hz_);
+        buffer->SetData(frames * channels_, [this, frames](rtc::ArrayView<int16_t> data) {
+            for (size_t i = 0; i < frames; ++i) {
+                int16_t sample = phase_step_ == 0
+                        ? 0 : static_cast<int16_t>(kAmplitude * sin(phase_));
+                for (int c = 0; c < channels_; ++c)
+                    data[i * channels_ + c] = sample;
+                phase_ = fmod(phase_ + phase_step_, 2 * kPi);
+            }
+            return frames * channels_;
+        });
+        return true;
+    }
+
+private:
+    const double phase_step_;
+    double phase_;
+    const int sample_rate_hz_;
+    const int channels_;
+};
+
+std::unique_ptr<TestAdm::Capturer> CreateCapturer(
+        const FakeAudioDeviceConfig& config, std::string* error) {
+    std::string kind, argument;
+    SplitSpec(config.capture, &kind, &argument);
+
+    if (kind == "wav" && !argument.empty()) {
+        FILE* probe = fopen(argument.c_str(), "rb");
+        if (!probe) {
+            *error = "can't open " + argument;
+            return nullptr;
+        }
+        fclose(probe);
+        return TestAdm::CreateWavFileReader(argument, /*repeat=*/true);
+    }
+    if (kind == "pcm" && !argument.empty()) {
+        FILE* file = fopen(argument.c_str(), "rb");
+        if (!file) {
+            *error = "can't open " + argument;
+            return nullptr;
+        }
+        return std::unique_ptr<TestAdm::Capturer>(
+                    new PcmFileCapturer(file, config.sample_rate_hz, config.channels));
+    }
+    if (kind == "tone") {
+        int frequency = argument.empty() ? kDefaultToneHz : atoi(argument.c_str());
+        if (frequency <= 0 || frequency >= config.sample_rate_hz / 2) {
+            *error = "bad tone frequency " + argument;
+            return nullptr;
+        }
+        return std::unique_ptr<TestAdm::Capturer>(
+                    new ToneCapturer(frequency, config.sample_rate_hz, config.channels));
+    }
+    if (kind == "noise") {
+        return TestAdm::CreatePulsedNoiseCapturer(kAmplitude, config.sample_rate_hz,
+                                                  config.channels);
+    }
+    if (kind == "silence") {
+        return std::unique_ptr<TestAdm::Capturer>(
+                    new ToneCapturer(0, config.sample_rate_hz, config.channels));
+    }
+    *error = "unknown capture source " + config.capture;
+    return nullptr;
+}
+
+std::unique_ptr<TestAdm::Renderer> CreateRenderer(
+        const FakeAudioDeviceConfig& config, std::string* error) {
+    std::string kind, argument;
+    SplitSpec(config.playout, &kind, &argument);
+
+    if (kind == "wav" && !argument.empty()) {
+        FILE* probe = fopen(argument.c_str(), "wb");
+        if (!probe) {
+            *error = "can't write " + argument;
+            return nullptr;
+        }
+        fclose(probe);
+        return TestAdm::CreateWavFileWriter(argument, config.sample_rate_hz,
+                                            config.channels);
+    }
+    if (kind == "null") {
+        return TestAdm::CreateDiscardRenderer(config.sample_rate_hz, config.channels);
+    }
+    *error = "unknown playout sink " + config.playout;
+    return nullptr;
+}
+
+}  // namespace
+
+FakeAudioDeviceConfig::FakeAudioDeviceConfig()
+    : capture("silence"),
+      playout("null"),
+      sample_rate_hz(48000),
+      channels(1),
+      speed(1.0f) {
+}
+
+rtc::scoped_refptr<webrtc::AudioDeviceModule> CreateFakeAudioDevice(
+        const FakeAudioDeviceConfig& config, std::string* error) {
+    if (config.sample_rate_hz <= 0 || config.channels < 1 || config.channels > 2 ||
+            config.speed <= 0) {
+        *error = "bad sample rate, channel count or speed";
+        return nullptr;
+    }
+    std::unique_ptr<TestAdm::Capturer> capturer = CreateCapturer(config, error);
+    if (!capturer)
+        return nullptr;
+    std::unique_ptr<TestAdm::Renderer> renderer = CreateRenderer(config, error);
+    if (!renderer)
+        return nullptr;
+    return TestAdm::CreateTestAudioDeviceModule(std::move(capturer),
+                                                std::move(renderer), config.speed);
+}
@@ -0,0 +1,38 @@
+#ifndef FAKEAUDIODEVICE_H
+#define FAKEAUDIODEVICE_H
+
+#include <string>
+
+#include "modules/audio_device/include/audio_device.h"
+
+// An AudioDeviceModule that needs no sound card, for CI, load tests and
+// servers.  Built on webrtc::TestAudioDeviceModule, which paces 10 ms frames
+// on its own thread.
+//
+// |capture| is one of
+//   wav:<path>       a WAV file, looped
+//   pcm:<path>       raw 16-bit little-endian PCM at |sample_rate_hz|, looped
+//   tone[:<hz>]      a sine wave, 440 Hz by default
+//   noise            pulsed noise
+//   silence
+// and |playout| is one of
+//   wav:<path>       written as a WAV file
+//   null             discarded
+struct FakeAudioDeviceConfig {
+    FakeAudioDeviceConfig();
+
+    std::string capture;
+    std::string playout;
+    // Used where the source has no rate of its own, and for playout.
+    int sample_rate_hz;
+    int channels;
+    // 1 is real time; 2 delivers frames twice as fast, and so on.
+    float speed;
+};
+
+// Returns nullptr and sets |error| if a spec is invalid or a file can't be
+// opened.
+rtc::scoped_refptr<webrtc::AudioDeviceModule> CreateFakeAudioDevice(
+        const FakeAudioDeviceConfig& config, std::string* error);
+
+#endif // FAKEAUDIODEVICE_H
@@ -0,0 +1,496 @@
+#include "filetransfer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <QDebug>
+#include <QTimer>
+
+#include "rtc_base/copy_on_write_buffer.h"
+#include "rtc_base/time_utils.h"
+
+#include "buffereddatachannel.h"
+#include "conductor.h"
+
+namespace {
+
+const char kLabelPrefix[] = "file:";
+const size_t kLabelPrefixLength = sizeof(kLabelPrefix) - 1;
+
+const uint8_t kOffer = 'O';
+const uint8_t kAccept = 'A';
+const uint8_t kReject = 'R';
+const uint8_t kChunk = 'C';
+const uint8_t kAck = 'K';
+const uint8_t kDone = 'D';
+// Type and offset.
+const size_t kHeaderSize = 1 + sizeof(uint64_t);
+
+void PutUint64(uint8_t* out, uint64_t value) {
+    for (size_t i = 0; i < sizeof(value); ++i)
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+uint64_t GetUint64(const uint8_t* in) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < sizeof(value); ++i)
+        value |= static_cast<uint64_t>(in[i]) << (8 * i);
+    return value;
+}
+
+bool IdFromLabel(const QString& label, std::string* id) {
+    std::string text = label.toStdString();
+    if (text.compare(0, kLabelPrefixLength, kLabelPrefix) != 0 ||
+            text.size() == kLabelPrefixLength)
+        return false;
+    *id = text.substr(kLabelPrefixLength);
+    return true;
+}
+
+std::string LabelForId(const std::string& id) {
+    return kLabelPrefix + id;
+}
+
+// The last path component, so a peer can't write outside the download
+// directory.
+std::string SafeFileName(const std::string& name, const std::string& fallback) {
+    size_t slash = name.find_last_of("/\\");
+    std::string base = slash == std::string::npos ? name : name.substr(slash + 1);
+    if (base.empty() || base == "." || base == "..")
+        return fallback;
+    return base;
+}
+
+// Tried after |name| is taken: "name (1).ext" up to this.
+const int kMaxNameSuffix = 99;
+
+// |name| with " (|n|)" before its extension; |name| itself for 0.
+std::string NumberedFileName(const std::string& name, int n) {
+    if (n == 0)
+        return name;
+    size_t dot = name.find_last_of('.');
+    if (dot == 0 || dot == std::string::npos)
+        dot = name.size();
+    return name.substr(0, dot) + " (" + std::to_string(n) + ")" + name.substr(dot);
+}
+
+}  // namespace
+
+FileTransferManager::FileTransferManager(Conductor* conductor, QObject *parent)
+    : QObject{parent},
+      conductor_(conductor),
+      next_id_(1) {
+    connect(conductor_, &Conductor::dataChannelOpened, this, &FileTransferManager::OnChannelOpened);
+    connect(conductor_, &Conductor::dataChannelClosed, this, &FileTransferManager::OnChannelClosed);
+    connect(conductor_, &Conductor::dataChannelWritable, this, &FileTransferManager::OnChannelWritable);
+    // Direct, so chunks are written as they arrive.
+    connect(conductor_, &Conductor::dataChannelMessage, this,
+            [this](int peer_id, const QString& label, const QByteArray& data, bool) {
+        OnChannelMessage(peer_id, label, data);
+    }, Qt::DirectConnection);
+    connect(conductor_, &Conductor::callConnected, this, &FileTransferManager::OnCallConnected);
+    connect(conductor_, &Conductor::callEnded, this, &FileTransferManager::OnCallEnded);
+}
+
+FileTransferManager::~FileTransferManager() {
+    for (const auto& entry : outgoing_) {
+        const Outgoing& transfer = *entry.second;
+        if (transfer.data)
+            munmap(const_cast<uint8_t*>(transfer.data), transfer.size);
+        close(transfer.fd);
+    }
+    for (const auto& entry : incoming_)
+        close(entry.second->fd);
+}
+
+void FileTransferManager::SetDownloadDirectory(const std::string& directory) {
+    download_directory_ = directory;
+}
+
+std::string FileTransferManager::SendFile(int peer_id, const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        qDebug() << "Can't open" << path.c_str() << strerror(errno);
+        return std::string();
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        qDebug() << path.c_str() << "is not a regular file";
+        close(fd);
+        return std::string();
+    }
+
+    std::unique_ptr<Outgoing> transfer(new Outgoing());
+    transfer->id = std::to_string(getpid()) + "-" + std::to_string(rtc::TimeUTCMillis()) +
+            "-" + std::to_string(next_id_++);
+    transfer->peer_id = peer_id;
+    transfer->name = SafeFileName(path, transfer->id);
+    transfer->fd = fd;
+    transfer->data = nullptr;
+    transfer->size = static_cast<uint64_t>(info.st_size);
+    transfer->next_offset = 0;
+    transfer->acked_offset = 0;
+    transfer->accepted = false;
+    transfer->paused = false;
+    if (transfer->size > 0) {
+        void* mapping = mmap(nullptr, transfer->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            qDebug() << "Can't map" << path.c_str() << strerror(errno);
+            close(fd);
+            return std::string();
+        }
+        // Read once, front to back.
+        madvise(mapping, transfer->size, MADV_SEQUENTIAL);
+        transfer->data = static_cast<const uint8_t*>(mapping);
+    }
+
+    Outgoing* outgoing = transfer.get();
+    outgoing_[outgoing->id] = std::move(transfer);
+    if (!OpenChannel(outgoing)) {
+        std::string id = outgoing->id;
+        FinishOutgoing(id, false);
+        return std::string();
+    }
+    qDebug() << "Sending" << path.c_str() << "to peer" << peer_id << "as" << outgoing->id.c_str();
+    return outgoing->id;
+}
+
+void FileTransferManager::Cancel(const std::string& id) {
+    if (outgoing_.count(id)) {
+        FinishOutgoing(id, false);
+        return;
+    }
+    auto it = incoming_.find(id);
+    if (it == incoming_.end())
+        return;
+    // Otherwise the sender waits for acknowledgements forever.
+    int peer_id = it->second->peer_id;
+    SendControl(peer_id, id, kReject, 0, std::string());
+    conductor_->CloseDataChannel(peer_id, LabelForId(id));
+    FinishIncoming(id, false);
+}
+
+bool FileTransferManager::OpenChannel(Outgoing* transfer) {
+    std::string label = LabelForId(transfer->id);
+    // A channel left over from before the call dropped.
+    conductor_->CloseDataChannel(transfer->peer_id, label);
+    transfer->accepted = false;
+    transfer->paused = false;
+    return conductor_->OpenDataChannel(transfer->peer_id, label, DataChannelOptions()) != nullptr;
+}
+
+void FileTransferManager::OnChannelOpened(int peer_id, const QString& label) {
+    std::string id;
+    if (!IdFromLabel(label, &id))
+        return;
+    auto it = outgoing_.find(id);
+    if (it == outgoing_.end() || it->second->peer_id != peer_id)
+        return;  // Incoming; the peer speaks first.
+    SendControl(peer_id, id, kOffer, it->second->size, it->second->name);
+}
+
+void FileTransferManager::OnChannelClosed(int peer_id, const QString& label) {
+    std::string id;
+    if (!IdFromLabel(label, &id))
+        return;
+    auto it = outgoing_.find(id);
+    if (it != outgoing_.end() && it->second->peer_id == peer_id) {
+        // Picked up again with the next call.
+        it->second->accepted = false;
+        it->second->paused = true;
+        return;
+    }
+    // Channels of an ending call go without this signal, so the sender
+    // closed it: the transfer was cancelled.
+    auto incoming = incoming_.find(id);
+    if (incoming != incoming_.end() && incoming->second->peer_id == peer_id)
+        FinishIncoming(id, false);
+}
+
+void FileTransferManager::OnChannelWritable(int peer_id, const QString& label) {
+    std::string id;
+    if (!IdFromLabel(label, &id))
+        return;
+    auto it = outgoing_.find(id);
+    if (it != outgoing_.end() && it->second->peer_id == peer_id)
+        Pump(it->second.get());
+}
+
+void FileTransferManager::OnChannelMessage(int peer_id, const QString& label,
+                                           const QByteArray& data) {
+    std::string id;
+    if (!IdFromLabel(label, &id) || data.isEmpty())
+        return;
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data.constData());
+    size_t size = static_cast<size_t>(data.size());
+    auto it = outgoing_.find(id);
+    if (it != outgoing_.end() && it->second->peer_id == peer_id)
+        OnOutgoingMessage(it->second.get(), bytes, size);
+    else
+        OnIncomingMessage(peer_id, id, bytes, size);
+}
+
+void FileTransferManager::OnCallConnected(int peer_id) {
+    for (const auto& entry : outgoing_) {
+        Outgoing* transfer = entry.second.get();
+        if (transfer->peer_id != peer_id || !transfer->paused)
+            continue;
+        qDebug() << "Resuming transfer" << transfer->id.c_str() << "at"
+                 << static_cast<qint64>(transfer->acked_offset);
+        OpenChannel(transfer);
+    }
+}
+
+void FileTransferManager::OnCallEnded(int peer_id) {
+    for (const auto& entry : outgoing_) {
+        if (entry.second->peer_id == peer_id) {
+            entry.second->accepted = false;
+            entry.second->paused = true;
+        }
+    }
+}
+
+void FileTransferManager::OnOutgoingMessage(Outgoing* transfer, const uint8_t* data,
+                                            size_t size) {
+    const uint8_t type = data[0];
+    if (type == kReject) {
+        qDebug() << "Peer" << transfer->peer_id << "refused" << transfer->id.c_str();
+        FinishOutgoing(transfer->id, false);
+        return;
+    }
+    if (type == kDone) {
+        emit transferProgress(QString::fromStdString(transfer->id),
+                              static_cast<qint64>(transfer->size),
+                              static_cast<qint64>(transfer->size));
+        FinishOutgoing(transfer->id, true);
+        return;
+    }
+    if (size < kHeaderSize)
+        return;
+    uint64_t offset = GetUint64(data + 1);
+    if (offset > transfer->size)
+        return;
+    if (type == kAccept) {
+        // Everything before |offset| is on the receiver's disk already.
+        transfer->accepted = true;
+        transfer->next_offset = offset;
+        transfer->acked_offset = offset;
+    } else if (type == kAck) {
+        transfer->acked_offset = std::max(transfer->acked_offset, offset);
+        emit transferProgress(QString::fromStdString(transfer->id),
+                              static_cast<qint64>(transfer->acked_offset),
+                              static_cast<qint64>(transfer->size));
+    } else {
+        return;
+    }
+    Pump(transfer);
+}
+
+void FileTransferManager::Pump(Outgoing* transfer) {
+    if (!transfer->accepted || transfer->paused)
+        return;
+    BufferedDataChannel* channel =
+            conductor_->FindDataChannel(transfer->peer_id, LabelForId(transfer->id));
+    if (!channel || !channel->open())
+        return;
+    const uint64_t window = kWindowChunks * kChunkSize;
+    while (transfer->next_offset < transfer->size &&
+           transfer->next_offset - transfer->acked_offset < window) {
+        size_t length = static_cast<size_t>(
+                    std::min(static_cast<uint64_t>(kChunkSize),
+                             transfer->size - transfer->next_offset));
+        // The one copy: from the mapping into the message.
+        rtc::CopyOnWriteBuffer message(kHeaderSize + length);
+        uint8_t* out = message.data();
+        out[0] = kChunk;
+        PutUint64(out + 1, transfer->next_offset);
+        memcpy(out + kHeaderSize, transfer->data + transfer->next_offset, length);
+        if (!channel->Send(message, true))
+            return;  // Resumed from OnChannelWritable().
+        transfer->next_offset += length;
+    }
+}
+
+void FileTransferManager::OnIncomingMessage(int peer_id, const std::string& id,
+                                            const uint8_t* data, size_t size) {
+    if (data[0] == kOffer) {
+        HandleOffer(peer_id, id, data, size);
+        return;
+    }
+    auto it = incoming_.find(id);
+    if (data[0] == kChunk && it != incoming_.end() && it->second->peer_id == peer_id)
+        HandleChunk(it->second.get(), data, size);
+}
+
+void FileTransferManager::HandleOffer(int peer_id, const std::string& id,
+                                      const uint8_t* data, size_t size) {
+    if (size < kHeaderSize || download_directory_.empty()) {
+        SendControl(peer_id, id, kReject, 0, std::string());
+        return;
+    }
+    uint64_t file_size = GetUint64(data + 1);
+    std::string name(reinterpret_cast<const char*>(data + kHeaderSize), size - kHeaderSize);
+
+    auto it = incoming_.find(id);
+    if (it != incoming_.end() && it->second->size == file_size) {
+        // The sender reconnected; go on from what's on disk.
+        Incoming* transfer = it->second.get();
+        transfer->peer_id = peer_id;
+        transfer->last_ack = transfer->written;
+        SendControl(peer_id, id, kAccept, transfer->written, std::string());
+        return;
+    }
+
+    // Never over an existing file, finished or still arriving: the first
+    // free numbered name wins.
+    std::string base = SafeFileName(name, id);
+    std::string path;
+    std::string part;
+    int fd = -1;
+    int error = EEXIST;
+    for (int n = 0; n <= kMaxNameSuffix && fd < 0; ++n) {
+        path = download_directory_ + "/" + NumberedFileName(base, n);
+        part = path + ".part";
+        if (access(path.c_str(), F_OK) == 0)
+            continue;
+        fd = open(part.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+        if (fd < 0) {
+            error = errno;
+            if (error != EEXIST)
+                break;
+        }
+    }
+    if (fd < 0) {
+        qDebug() << "Can't create" << part.c_str() << strerror(error);
+        SendControl(peer_id, id, kReject, 0, std::string());
+        return;
+    }
+    if (file_size > 0) {
+        // Reserve the space now: no fragmentation as chunks land, and a
+        // full disk shows up before the transfer rather than halfway.
+        error = posix_fallocate(fd, 0, static_cast<off_t>(file_size));
+        if (error == EINVAL || error == EOPNOTSUPP)
+            error = ftruncate(fd, static_cast<off_t>(file_size)) == 0 ? 0 : errno;
+        if (error != 0) {
+            qDebug() << "Can't allocate" << part.c_str() << strerror(error);
+            close(fd);
+            unlink(part.c_str());
+            SendControl(peer_id, id, kReject, 0, std::string());
+            return;
+        }
+    }
+
+    std::unique_ptr<Incoming> transfer(new Incoming());
+    transfer->id = id;
+    transfer->peer_id = peer_id;
+    transfer->path = path;
+    transfer->fd = fd;
+    transfer->size = file_size;
+    transfer->written = 0;
+    transfer->last_ack = 0;
+    incoming_[id] = std::move(transfer);
+    qDebug() << "Receiving" << path.c_str() << "from peer" << peer_id;
+    SendControl(peer_id, id, kAccept, 0, std::string());
+    if (file_size == 0) {
+        SendControl(peer_id, id, kDone, 0, std::string());
+        FinishIncoming(id, true);
+    }
+}
+
+void FileTransferManager::HandleChunk(Incoming* transfer, const uint8_t* data, size_t size) {
+    if (size < kHeaderSize)
+        return;
+    uint64_t offset = GetUint64(data + 1);
+    const uint8_t* payload = data + kHeaderSize;
+    size_t length = size - kHeaderSize;
+    // The channel is ordered, so anything else is a repeat from before a
+    // resume.
+    if (offset != transfer->written || offset + length > transfer->size)
+        return;
+    while (length > 0) {
+        ssize_t written = pwrite(transfer->fd, payload, length, static_cast<off_t>(offset));
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            qDebug() << "Writing" << transfer->path.c_str() << "failed:" << strerror(errno);
+            SendControl(transfer->peer_id, transfer->id, kReject, 0, std::string());
+            FinishIncoming(transfer->id, false);
+            return;
+        }
+        payload += written;
+        offset += static_cast<uint64_t>(written);
+        length -= static_cast<size_t>(written);
+    }
+    transfer->written = offset;
+
+    if (transfer->written == transfer->size) {
+        std::string id = transfer->id;
+        SendControl(transfer->peer_id, id, kAck, transfer->written, std::string());
+        SendControl(transfer->peer_id, id, kDone, 0, std::string());
+        FinishIncoming(id, true);
+    } else if (transfer->written - transfer->last_ack >= kAckEveryChunks * kChunkSize) {
+        transfer->last_ack = transfer->written;
+        SendControl(transfer->peer_id, transfer->id, kAck, transfer->written, std::string());
+    }
+}
+
+bool FileTransferManager::SendControl(int peer_id, const std::string& id, uint8_t type,
+                                      uint64_t value, const std::string& text) {
+    BufferedDataChannel* channel = conductor_->FindDataChannel(peer_id, LabelForId(id));
+    if (!channel)
+        return false;
+    rtc::CopyOnWriteBuffer message(kHeaderSize + text.size());
+    uint8_t* out = message.data();
+    out[0] = type;
+    PutUint64(out + 1, value);
+    memcpy(out + kHeaderSize, text.data(), text.size());
+    return channel->Send(message, true);
+}
+
+void FileTransferManager::FinishOutgoing(const std::string& id, bool success) {
+    auto it = outgoing_.find(id);
+    if (it == outgoing_.end())
+        return;
+    std::unique_ptr<Outgoing> transfer = std::move(it->second);
+    outgoing_.erase(it);
+    if (transfer->data)
+        munmap(const_cast<uint8_t*>(transfer->data), transfer->size);
+    close(transfer->fd);
+    // May be called from the channel's own callback; close it afterwards.
+    int peer_id = transfer->peer_id;
+    std::string label = LabelForId(id);
+    QTimer::singleShot(0, this, [this, peer_id, label]() {
+        conductor_->CloseDataChannel(peer_id, label);
+    });
+    qDebug() << "Transfer" << id.c_str() << (success ? "done" : "failed");
+    emit transferFinished(QString::fromStdString(id), success);
+}
+
+void FileTransferManager::FinishIncoming(const std::string& id, bool success) {
+    auto it = incoming_.find(id);
+    if (it == incoming_.end())
+        return;
+    std::unique_ptr<Incoming> transfer = std::move(it->second);
+    incoming_.erase(it);
+    close(transfer->fd);
+    std::string part = transfer->path + ".part";
+    // link() rather than rename(), which would replace a file that showed
+    // up under the name since the offer.
+    if (success && link(part.c_str(), transfer->path.c_str()) != 0) {
+        qDebug() << "Can't move" << part.c_str() << "into place:" << strerror(errno);
+        success = false;
+    }
+    // A complete file that couldn't be moved stays behind as .part.
+    if (success || transfer->written < transfer->size)
+        unlink(part.c_str());
+    qDebug() << "Transfer" << id.c_str() << (success ? "received" : "failed");
+    if (success)
+        emit fileReceived(transfer->peer_id, QString::fromStdString(id),
+                          QString::fromStdString(transfer->path));
+    emit transferFinished(QString::fromStdString(id), success);
+}
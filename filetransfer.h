@@ -0,0 +1,125 @@
+#ifndef FILETRANSFER_H
+#define FILETRANSFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+
+class Conductor;
+
+// Sends and receives files over data channels of the calls in progress,
+// one reliable, ordered channel per transfer labelled "file:<id>".
+//
+// The sender maps the file and sends it in kChunkSize chunks, each copied
+// once, from the mapping into the message buffer.  At most kWindowChunks
+// are in flight: the receiver acknowledges what it has written every few
+// chunks, and the sender doesn't run further ahead than that.  On top of
+// this the channel's own backpressure applies (BufferedDataChannel), so
+// memory use depends on the window, not on the file size.
+//
+// The receiver writes to <download dir>/<name>.part, preallocated to the
+// full size, and moves it to <name> once complete.  Existing files are
+// never overwritten; if <name> or its .part is taken, "<name> (1)" and so
+// on are used instead.  A transfer cut off by the end of the call resumes
+// when a call with the same peer connects again: the sender reopens the
+// channel and the receiver answers the offer with how much it already has.
+// Either side cancels by closing the channel, the receiver after sending
+// 'R'; a channel that closes while the call goes on ends the transfer.
+//
+// Wire format, all binary, first byte the message type:
+//   'O' size:u64 name     offer, sender to receiver
+//   'A' offset:u64        accept, resuming at |offset|
+//   'R'                   reject
+//   'C' offset:u64 data   chunk
+//   'K' offset:u64        written up to |offset|
+//   'D'                   done, file complete
+// Integers are little-endian.
+class FileTransferManager : public QObject
+{
+    Q_OBJECT
+public:
+    static const size_t kChunkSize = 64 * 1024;
+    static const uint64_t kWindowChunks = 32;
+    // The receiver acknowledges every this many chunks, and at the end.
+    static const uint64_t kAckEveryChunks = 8;
+
+    explicit FileTransferManager(Conductor* conductor, QObject *parent = 0);
+    ~FileTransferManager();
+
+    // Where incoming files go; empty, the default, refuses them.
+    void SetDownloadDirectory(const std::string& directory);
+
+    // Starts sending |path| to the call with |peer_id|.  Returns the
+    // transfer id, or an empty string if the file can't be read or there's
+    // no such call.
+    std::string SendFile(int peer_id, const std::string& path);
+    // Stops an outgoing or incoming transfer and tells the peer.  An
+    // incoming .part file is deleted.
+    void Cancel(const std::string& id);
+
+signals:
+    // Bytes the receiver has written so far.
+    void transferProgress(const QString& id, qint64 bytes, qint64 total);
+    void transferFinished(const QString& id, bool success);
+    void fileReceived(int peerId, const QString& id, const QString& path);
+
+private:
+    struct Outgoing {
+        std::string id;
+        int peer_id;
+        std::string name;
+        int fd;
+        const uint8_t* data;
+        uint64_t size;
+        // Next byte to send, and what the receiver has written.
+        uint64_t next_offset;
+        uint64_t acked_offset;
+        bool accepted;
+        // The call ended; waiting for the next one with |peer_id|.
+        bool paused;
+    };
+
+    struct Incoming {
+        std::string id;
+        int peer_id;
+        std::string path;
+        int fd;
+        uint64_t size;
+        uint64_t written;
+        uint64_t last_ack;
+    };
+
+    void OnChannelOpened(int peer_id, const QString& label);
+    void OnChannelClosed(int peer_id, const QString& label);
+    void OnChannelMessage(int peer_id, const QString& label, const QByteArray& data);
+    void OnChannelWritable(int peer_id, const QString& label);
+    void OnCallConnected(int peer_id);
+    void OnCallEnded(int peer_id);
+
+    void OnOutgoingMessage(Outgoing* transfer, const uint8_t* data, size_t size);
+    void OnIncomingMessage(int peer_id, const std::string& id, const uint8_t* data,
+                           size_t size);
+    void HandleOffer(int peer_id, const std::string& id, const uint8_t* data, size_t size);
+    void HandleChunk(Incoming* transfer, const uint8_t* data, size_t size);
+    // Sends chunks until the window or the channel's queue is full.
+    void Pump(Outgoing* transfer);
+    bool SendControl(int peer_id, const std::string& id, uint8_t type, uint64_t value,
+                     const std::string& text);
+    bool OpenChannel(Outgoing* transfer);
+    void FinishOutgoing(const std::string& id, bool success);
+    void FinishIncoming(const std::string& id, bool success);
+
+    Conductor* conductor_;
+    std::string download_directory_;
+    std::map<std::string, std::unique_ptr<Outgoing>> outgoing_;
+    // Kept after the call ends, for resuming.
+    std::map<std::string, std::unique_ptr<Incoming>> incoming_;
+    int next_id_;
+};
+
+#endif // FILETRANSFER_H
@@ -18,6 +18,10 @@ WEBRTC_DEFINE_string(server, "localhost", "The server to connect to.");
 WEBRTC_DEFINE_int(port,
                   kDefaultServerPort,
                   "The port on which the server is listening.");
+WEBRTC_DEFINE_int(dns_ttl,
+                  60,
+                  "Seconds the server's resolved addresses are reused for "
+                  "reconnecting before it is looked up again.");
 WEBRTC_DEFINE_bool(
     autocall,
     false,
@@ -25,6 +29,121 @@ WEBRTC_DEFINE_bool(
     "the server without user intervention.  Note: this flag should only be set "
     "to true on one of the two clients.");
 
+WEBRTC_DEFINE_bool(
+    keepalive,
+    false,
+    "Keep one HTTP/1.1 connection to the server open for all signaling "
+    "requests instead of connecting once per message.");
+
+WEBRTC_DEFINE_bool(
+    websocket,
+    false,
+    "Signal over a single WebSocket connection (/ws) instead of hanging GETs. "
+    "Falls back to hanging GETs if the server does not support it.");
+
+WEBRTC_DEFINE_int(
+    pc_pool_size,
+    0,
+    "Number of PeerConnections to create ahead of time so that calls can "
+    "start negotiating immediately.");
+
+WEBRTC_DEFINE_int(
+    ice_pool_size,
+    0,
+    "ICE candidate pool size.  When non-zero, candidates are gathered right "
+    "after sign-in instead of when a call starts.");
+WEBRTC_DEFINE_bool(
+    trickle,
+    true,
+    "Send ICE candidates as they are gathered.  When false, the offer or "
+    "answer is sent once gathering completes and includes every candidate.");
+
+WEBRTC_DEFINE_int(network_cpu,
+                  -1,
+                  "Core to pin the WebRTC network thread to.  -1 leaves it "
+                  "to the OS.");
+WEBRTC_DEFINE_int(worker_cpu,
+                  -1,
+                  "Core to pin the WebRTC worker (audio) thread to.  -1 "
+                  "leaves it to the OS.");
+WEBRTC_DEFINE_bool(
+    realtime_audio,
+    false,
+    "Run the worker thread, which encodes and decodes audio, with real-time "
+    "scheduling.  Usually needs elevated privileges.");
+WEBRTC_DEFINE_int(
+    thread_stats_interval,
+    0,
+    "Seconds between logs of per-thread queue depth and busy time.  0 "
+    "disables them.");
+
+WEBRTC_DEFINE_string(
+    audio_in,
+    "",
+    "Capture from a fake audio device instead of the microphone: "
+    "wav:<path>, pcm:<path> (s16le at --audio_rate), tone[:<hz>], noise or "
+    "silence.");
+WEBRTC_DEFINE_string(
+    audio_out,
+    "",
+    "Play out to a fake audio device instead of the speakers: wav:<path> or "
+    "null.");
+WEBRTC_DEFINE_int(audio_rate,
+                  48000,
+                  "Sample rate of the fake audio device.");
+WEBRTC_DEFINE_float(
+    audio_speed,
+    1.0,
+    "Pacing of the fake audio device; 1 is real time, larger is faster.");
+
+WEBRTC_DEFINE_int(
+    stats_interval,
+    0,
+    "Milliseconds between GetStats() polls of every call.  0 disables "
+    "collection.");
+WEBRTC_DEFINE_int(
+    metrics_port,
+    0,
+    "Serve the collected stats in Prometheus text format on "
+    "localhost:<port>/metrics.  0 disables the endpoint.");
+
+WEBRTC_DEFINE_int(
+    mix_sources,
+    0,
+    "Play out only this many of the loudest remote streams.  0 mixes them "
+    "all with WebRTC's default mixer.");
+
+WEBRTC_DEFINE_string(
+    opus,
+    "",
+    "Opus settings for every call, e.g. "
+    "\"bitrate=16000,ptime=40,dtx=1,fec=1,complexity=5,stereo=0\".  Unset "
+    "keys keep WebRTC's defaults.");
+
+WEBRTC_DEFINE_string(
+    audio_profile,
+    "full",
+    "Capture processing for every call: full, headset (no echo "
+    "cancellation), low-cpu (no gain control) or passthrough (none).");
+
+WEBRTC_DEFINE_string(
+    record_dir,
+    "",
+    "Record the remote audio of every call to WAV files in this "
+    "directory.");
+
+WEBRTC_DEFINE_string(
+    download_dir,
+    "",
+    "Accept files peers send during calls into this directory.  Empty "
+    "refuses them.");
+
+WEBRTC_DEFINE_string(
+    trace_file,
+    "",
+    "Record signaling and thread events to this file; convert it with "
+    "tracedecoder.");
+
 WEBRTC_DEFINE_string(
     force_fieldtrials,
     "",
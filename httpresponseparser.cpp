@@ -0,0 +1,164 @@
+#include "httpresponseparser.h"
+
+#include <string.h>
+#include <algorithm>
+
+#include "rtc_base/checks.h"
+
+namespace {
+
+// Free space guaranteed before each Recv().  The old stack buffer had the same
+// size, so a read event never needs more calls than before.
+const size_t kMinReadSpace = 0xffff;
+
+const char kEndOfHeaders[] = "\r\n\r\n";
+const size_t kEndOfHeadersLength = sizeof(kEndOfHeaders) - 1;
+
+// Header names are ASCII; tolower() would be a locale-aware call per byte.
+inline char AsciiToLower(char c) {
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+bool EqualsIgnoreCase(absl::string_view a, absl::string_view b) {
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (AsciiToLower(a[i]) != AsciiToLower(b[i]))
+            return false;
+    }
+    return true;
+}
+
+// Parses the leading decimal digits of |value| without reading past its end.
+bool ParseNumber(absl::string_view value, size_t* number) {
+    size_t result = 0;
+    size_t i = 0;
+    while (i < value.size() && value[i] == ' ')
+        ++i;
+    size_t first_digit = i;
+    for (; i < value.size() && value[i] >= '0' && value[i] <= '9'; ++i)
+        result = result * 10 + (value[i] - '0');
+    if (i == first_digit)
+        return false;
+    *number = result;
+    return true;
+}
+
+}  // namespace
+
+HttpResponseParser::HttpResponseParser()
+    : begin_(0), end_(0), scan_pos_(0) {
+    ResetResponse();
+}
+
+void HttpResponseParser::ReadFrom(rtc::AsyncSocket* socket) {
+    do {
+        if (buffer_.size() - end_ < kMinReadSpace)
+            buffer_.resize(end_ + kMinReadSpace);
+        int bytes = socket->Recv(&buffer_[end_], buffer_.size() - end_, nullptr);
+        if (bytes <= 0)
+            break;
+        end_ += bytes;
+    } while (true);
+}
+
+void HttpResponseParser::Append(const char* data, size_t length) {
+    if (buffer_.size() - end_ < length)
+        buffer_.resize(end_ + std::max(length, kMinReadSpace));
+    memcpy(&buffer_[end_], data, length);
+    end_ += length;
+}
+
+HttpResponseParser::Result HttpResponseParser::Parse() {
+    if (!body_begin_) {
+        // Back up a little so a terminator split across reads is found.
+        size_t from = std::max(begin_, scan_pos_ > kEndOfHeadersLength - 1
+                                       ? scan_pos_ - (kEndOfHeadersLength - 1)
+                                       : 0);
+        absl::string_view pending(buffer_.data() + from, end_ - from);
+        size_t found = pending.find(kEndOfHeaders);
+        scan_pos_ = end_;
+        if (found == absl::string_view::npos)
+            return NEED_MORE_DATA;
+
+        size_t eoh = from + found;
+        if (!ParseHeaders(absl::string_view(buffer_.data() + begin_, eoh - begin_)))
+            return PARSE_ERROR;
+        body_begin_ = eoh + kEndOfHeadersLength;
+    }
+
+    if (end_ - body_begin_ < content_length_)
+        return NEED_MORE_DATA;
+    return COMPLETE;
+}
+
+absl::string_view HttpResponseParser::body() const {
+    RTC_DCHECK(body_begin_);
+    return absl::string_view(buffer_.data() + body_begin_, content_length_);
+}
+
+void HttpResponseParser::Consume() {
+    RTC_DCHECK(body_begin_);
+    begin_ = body_begin_ + content_length_;
+    if (begin_ == end_) {
+        // Common case: nothing pipelined behind this response.
+        begin_ = end_ = 0;
+    } else if (begin_ > buffer_.size() / 2) {
+        memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+        end_ -= begin_;
+        begin_ = 0;
+    }
+    scan_pos_ = begin_;
+    ResetResponse();
+}
+
+void HttpResponseParser::Reset() {
+    begin_ = end_ = scan_pos_ = 0;
+    ResetResponse();
+}
+
+void HttpResponseParser::ResetResponse() {
+    body_begin_ = 0;
+    status_ = -1;
+    content_length_ = 0;
+    pragma_ = -1;
+    connection_close_ = false;
+}
+
+bool HttpResponseParser::ParseHeaders(absl::string_view headers) {
+    size_t eol = headers.find("\r\n");
+    absl::string_view status_line = headers.substr(0, eol);
+    size_t space = status_line.find(' ');
+    size_t status = 0;
+    if (space == absl::string_view::npos ||
+            !ParseNumber(status_line.substr(space + 1), &status))
+        return false;
+    status_ = static_cast<int>(status);
+
+    bool has_content_length = false;
+    while (eol != absl::string_view::npos) {
+        size_t begin = eol + 2;
+        eol = headers.find("\r\n", begin);
+        absl::string_view line = headers.substr(
+                    begin, eol == absl::string_view::npos ? absl::string_view::npos
+                                                          : eol - begin);
+        size_t colon = line.find(':');
+        if (colon == absl::string_view::npos)
+            continue;
+        absl::string_view name = line.substr(0, colon);
+        absl::string_view value = line.substr(colon + 1);
+        while (!value.empty() && value.front() == ' ')
+            value.remove_prefix(1);
+
+        size_t number = 0;
+        if (EqualsIgnoreCase(name, "Content-Length")) {
+            has_content_length = ParseNumber(value, &content_length_);
+        } else if (EqualsIgnoreCase(name, "Pragma")) {
+            if (ParseNumber(value, &number))
+                pragma_ = static_cast<int>(number);
+        } else if (EqualsIgnoreCase(name, "Connection")) {
+            connection_close_ = EqualsIgnoreCase(value, "close");
+        }
+    }
+    return has_content_length;
+}
@@ -0,0 +1,66 @@
+#ifndef HTTPRESPONSEPARSER_H
+#define HTTPRESPONSEPARSER_H
+
+#include <stddef.h>
+#include <vector>
+
+#include "rtc_base/async_socket.h"
+#include "third_party/abseil-cpp/absl/strings/string_view.h"
+
+// Resumable parser for the server's HTTP responses.  Socket data is received
+// straight into the parser's buffer; each Parse() call only looks at bytes it
+// hasn't seen yet, the headers are parsed once when the blank line arrives,
+// and the body is handed out as a view into the buffer.  Bytes past the end
+// of a response are kept for the next one, so pipelined responses on a
+// keep-alive connection work.
+class HttpResponseParser
+{
+public:
+    enum Result {
+        NEED_MORE_DATA,
+        COMPLETE,
+        PARSE_ERROR,
+    };
+
+    HttpResponseParser();
+
+    // Receives everything currently available on |socket|.
+    void ReadFrom(rtc::AsyncSocket* socket);
+    void Append(const char* data, size_t length);
+
+    // Advances over the buffered data.  Once COMPLETE is returned the
+    // accessors below describe the current response until Consume().
+    Result Parse();
+
+    int status() const { return status_; }
+    size_t content_length() const { return content_length_; }
+    // Value of the Pragma header, which carries the peer id; -1 if absent.
+    int pragma() const { return pragma_; }
+    bool connection_close() const { return connection_close_; }
+    absl::string_view body() const;
+
+    // Drops the current response and keeps whatever follows it.
+    void Consume();
+    // Forgets all buffered data.
+    void Reset();
+
+private:
+    void ResetResponse();
+    bool ParseHeaders(absl::string_view headers);
+
+    std::vector<char> buffer_;
+    // Valid data is buffer_[begin_, end_).  The current response starts at
+    // begin_.
+    size_t begin_;
+    size_t end_;
+    // Where the search for the end of the headers resumes.
+    size_t scan_pos_;
+    // Offset of the first body byte, or 0 while headers are incomplete.
+    size_t body_begin_;
+    int status_;
+    size_t content_length_;
+    int pragma_;
+    bool connection_close_;
+};
+
+#endif // HTTPRESPONSEPARSER_H
@@ -0,0 +1,125 @@
+#include "bench.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+
+#include "httpresponseparser.h"
+
+namespace {
+
+// Typical TCP segment payload; what one read event usually brings.
+const size_t kSegmentSize = 1448;
+
+// A /wait response as the server sends it, with a |body_size| byte message.
+std::string MakeResponse(size_t body_size) {
+    std::string response =
+            "HTTP/1.1 200 OK\r\n"
+            "Server: PeerConnectionTestServer/0.1\r\n"
+            "Cache-Control: no-cache\r\n"
+            "Connection: close\r\n"
+            "Content-Type: text/plain\r\n"
+            "Content-Length: " + std::to_string(body_size) + "\r\n"
+            "Pragma: 42\r\n"
+            "Access-Control-Allow-Origin: *\r\n"
+            "Access-Control-Expose-Headers: Content-Length, X-Peer-Id\r\n\r\n";
+    response.append(body_size, 'x');
+    return response;
+}
+
+// ReadIntoBuffer() and ParseServerResponse() as they were before
+// HttpResponseParser: each read goes through a stack buffer into a
+// std::string, which is searched from the start for the end of the headers
+// and for every header on each read.
+class StringResponseReader
+{
+public:
+    // True once |data| completed a 200 response; |body| gets a copy.
+    bool Read(const char* data, size_t length, std::string* body) {
+        char buffer[0xffff];
+        memcpy(buffer, data, length);  // What Recv() wrote.
+        data_.append(buffer, length);
+
+        size_t eoh = data_.find("\r\n\r\n");
+        if (eoh == std::string::npos)
+            return false;
+        size_t content_length = 0;
+        if (!GetHeaderValue(eoh, "\r\nContent-Length: ", &content_length) ||
+                data_.size() < eoh + 4 + content_length)
+            return false;
+        std::string connection;
+        GetHeaderValue(eoh, "\r\nConnection: ", &connection);
+
+        int status = atoi(&data_[data_.find(' ') + 1]);
+        eoh = data_.find("\r\n\r\n");
+        size_t pragma = 0;
+        GetHeaderValue(eoh, "\r\nPragma: ", &pragma);
+        BenchKeep(pragma);
+        *body = data_.substr(eoh + 4);
+        data_.clear();
+        return status == 200;
+    }
+
+private:
+    bool GetHeaderValue(size_t eoh, const char* pattern, size_t* value) const {
+        size_t found = data_.find(pattern);
+        if (found == std::string::npos || found >= eoh)
+            return false;
+        *value = atoi(&data_[found + strlen(pattern)]);
+        return true;
+    }
+    bool GetHeaderValue(size_t eoh, const char* pattern, std::string* value) const {
+        size_t found = data_.find(pattern);
+        if (found == std::string::npos || found >= eoh)
+            return false;
+        size_t begin = found + strlen(pattern);
+        value->assign(data_.substr(begin, data_.find("\r\n", begin) - begin));
+        return true;
+    }
+
+    std::string data_;
+};
+
+void CompareParsers(const char* old_label, const char* new_label, size_t body_size,
+                    int iterations) {
+    const std::string response = MakeResponse(body_size);
+    std::string body;
+
+    StringResponseReader reader;
+    BenchTime(old_label, iterations, [&]() {
+        for (size_t offset = 0; offset < response.size(); offset += kSegmentSize) {
+            size_t length = std::min(kSegmentSize, response.size() - offset);
+            if (reader.Read(response.data() + offset, length, &body))
+                BenchKeep(body);
+        }
+    });
+
+    HttpResponseParser parser;
+    BenchTime(new_label, iterations, [&]() {
+        for (size_t offset = 0; offset < response.size(); offset += kSegmentSize) {
+            size_t length = std::min(kSegmentSize, response.size() - offset);
+            parser.Append(response.data() + offset, length);
+            if (parser.Parse() == HttpResponseParser::COMPLETE) {
+                // Peer messages are copied once, for the observer.
+                absl::string_view view = parser.body();
+                body.assign(view.data(), view.size());
+                BenchKeep(body);
+                parser.Consume();
+            }
+        }
+    });
+}
+
+}  // namespace
+
+// One response per iteration, arriving in kSegmentSize reads: a peer
+// notification, an SDP offer, and a message near the batch limit.
+BENCHMARK(HttpResponseParsing) {
+    CompareParsers("string reader, 40B notification", "HttpResponseParser, 40B notification",
+                   40, 200000);
+    CompareParsers("string reader, 4KB offer", "HttpResponseParser, 4KB offer",
+                   4 * 1024, 100000);
+    CompareParsers("string reader, 32KB batch", "HttpResponseParser, 32KB batch",
+                   32 * 1024, 10000);
+}
@@ -0,0 +1,176 @@
+#include <string.h>
+#include <vector>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QStringList>
+#include <QTimer>
+#include "rtc_base/flags.h"
+#include "rtc_base/ssl_adapter.h"
+#include "rtc_base/thread.h"
+#include "system_wrappers/include/field_trial.h"
+#include "test/field_trial.h"
+
+#include "customsocketserver.h"
+#include "dnscache.h"
+#include "flag_defs.h"
+#include "loadgenerator.h"
+#include "threadtopology.h"
+#include "tracer.h"
+
+// Headless load generator: signs in --clients clients against --server and
+// has every even one call the next odd one, --calls times in a row.  With
+// --data_messages each call also measures data channel throughput.  With
+// --compare the same load runs once per setting being compared, one report
+// after the other.  With --conference one client calls all the others
+// instead, to see what each added participant costs.
+
+WEBRTC_DEFINE_int(clients, 16, "Number of clients to sign in.");
+WEBRTC_DEFINE_int(calls, 1, "Calls each caller places one after the other.");
+WEBRTC_DEFINE_int(timeout, 60, "Give up after this many seconds.");
+WEBRTC_DEFINE_int(data_messages,
+                  0,
+                  "Data channel messages of each --data_sizes size to send "
+                  "per call; 0 skips the data channel test.");
+WEBRTC_DEFINE_string(data_sizes,
+                     "64,65536",
+                     "Comma-separated message sizes in bytes for "
+                     "--data_messages.");
+WEBRTC_DEFINE_bool(conference,
+                   false,
+                   "Instead of pairs, the first client calls every other "
+                   "client in turn and keeps the calls up, reporting CPU and "
+                   "peak memory after each added participant.  Takes about "
+                   "3 s per participant; raise --timeout to match.");
+WEBRTC_DEFINE_string(compare,
+                     "",
+                     "Run the load once per setting and report each: "
+                     "\"keepalive\" runs it without and then with "
+                     "--keepalive, \"pool\" without a PeerConnection "
+                     "pool and then with --pc_pool_size (default 1), \"stats\" "
+                     "without and then with --stats_interval (default 1000); "
+                     "use --conference for calls that stay up.");
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    rtc::FlagList::SetFlagsFromCommandLine(&argc, argv, true);
+    if (FLAG_help) {
+        rtc::FlagList::Print(NULL, false);
+        return 0;
+    }
+
+    webrtc::test::ValidateFieldTrialsStringOrDie(FLAG_force_fieldtrials);
+    webrtc::field_trial::InitFieldTrialsFromString(FLAG_force_fieldtrials);
+
+    if ((FLAG_port < 1) || (FLAG_port > 65535)) {
+        qDebug() << "Error: " << FLAG_port << " is not a valid port.";
+        return -1;
+    }
+    DnsCache::Instance()->set_ttl_ms(FLAG_dns_ttl * 1000);
+
+    // Same single loop as the app: rtc drives it and pumps Qt in between.
+    if (strlen(FLAG_trace_file) > 0 && !Tracer::Instance()->Start(FLAG_trace_file))
+        return -1;
+
+    CustomSocketServer socketServer;
+    rtc::AutoSocketServerThread thread(&socketServer);
+    rtc::InitializeSSL();
+
+    ThreadTopology threads;
+    ThreadPlacement network;
+    network.cpu = FLAG_network_cpu;
+    threads.set_network_placement(network);
+    ThreadPlacement worker;
+    worker.cpu = FLAG_worker_cpu;
+    worker.priority = FLAG_realtime_audio ? rtc::kRealtimePriority : rtc::kNormalPriority;
+    threads.set_worker_placement(worker);
+    if (!threads.Start())
+        return -1;
+
+    LoadGeneratorConfig config;
+    config.server = FLAG_server;
+    config.port = FLAG_port;
+    config.clients = FLAG_clients;
+    config.calls_per_pair = FLAG_calls;
+    config.timeout_s = FLAG_timeout;
+    config.keep_alive = FLAG_keepalive;
+    config.websocket = FLAG_websocket;
+    config.pc_pool_size = FLAG_pc_pool_size;
+    config.stats_interval_ms = FLAG_stats_interval;
+    if (strlen(FLAG_audio_in) > 0)
+        config.audio.capture = FLAG_audio_in;
+    if (strlen(FLAG_audio_out) > 0)
+        config.audio.playout = FLAG_audio_out;
+    config.audio.sample_rate_hz = FLAG_audio_rate;
+    config.audio.speed = FLAG_audio_speed;
+    std::string error;
+    if (!ParseOpusSettings(FLAG_opus, &config.opus, &error)) {
+        qDebug() << "Error: --opus:" << error.c_str();
+        return -1;
+    }
+    if (!ParseAudioProfile(FLAG_audio_profile, &config.audio_profile)) {
+        qDebug() << "Error: unknown --audio_profile" << FLAG_audio_profile;
+        return -1;
+    }
+    config.data_messages = FLAG_data_messages;
+    config.conference = FLAG_conference;
+    config.data_sizes.clear();
+    for (const QString& size : QString(FLAG_data_sizes).split(',', QString::SkipEmptyParts)) {
+        bool ok = false;
+        int bytes = size.trimmed().toInt(&ok);
+        if (!ok || bytes < 16 || bytes > 256 * 1024) {
+            qDebug() << "Error: --data_sizes: sizes are 16 to 262144 bytes";
+            return -1;
+        }
+        config.data_sizes.push_back(static_cast<size_t>(bytes));
+    }
+    config.threads = &threads;
+
+    std::vector<LoadGeneratorConfig> passes;
+    if (strcmp(FLAG_compare, "keepalive") == 0) {
+        config.keep_alive = false;
+        passes.push_back(config);
+        config.keep_alive = true;
+        passes.push_back(config);
+    } else if (strcmp(FLAG_compare, "pool") == 0) {
+        // call_setup starts at ConnectToPeer(), so it includes creating
+        // the PeerConnection unless one is pooled.
+        config.pc_pool_size = 0;
+        passes.push_back(config);
+        config.pc_pool_size = FLAG_pc_pool_size > 0 ? FLAG_pc_pool_size : 1;
+        passes.push_back(config);
+    } else if (strcmp(FLAG_compare, "stats") == 0) {
+        config.stats_interval_ms = 0;
+        passes.push_back(config);
+        config.stats_interval_ms = FLAG_stats_interval > 0 ? FLAG_stats_interval : 1000;
+        passes.push_back(config);
+    } else if (strlen(FLAG_compare) > 0) {
+        qDebug() << "Error: unknown --compare" << FLAG_compare;
+        return -1;
+    } else {
+        passes.push_back(config);
+    }
+
+    int exit_code = 0;
+    for (const LoadGeneratorConfig& pass : passes) {
+        LoadGenerator generator(pass);
+        QObject::connect(&generator, &LoadGenerator::finished, [&thread]() {
+            // Give the sign-outs a moment to reach the server.
+            QTimer::singleShot(500, [&thread]() { thread.Quit(); });
+        });
+        if (generator.Start()) {
+            thread.Run();
+            thread.Restart();
+        } else {
+            exit_code = -1;
+        }
+        generator.Report();
+        if (exit_code != 0)
+            break;
+    }
+
+    Tracer::Instance()->Stop();
+    rtc::CleanupSSL();
+    return exit_code;
+}
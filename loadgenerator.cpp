@@ -0,0 +1,531 @@
+#include "loadgenerator.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#ifdef __APPLE__
+#include <mach/mach.h>
+#endif
+#include <algorithm>
+#include <sstream>
+#include <QDebug>
+#include <QTimer>
+
+#include "rtc_base/copy_on_write_buffer.h"
+#include "rtc_base/location.h"
+#include "rtc_base/time_utils.h"
+#include "threadtopology.h"
+#include "websockettransport.h"
+
+namespace {
+
+// Between hanging up and placing the next call, so the callee has seen the
+// BYE before the next offer.
+const int kRedialDelayMs = 50;
+const char kDataLabel[] = "loadgen";
+// Each message starts with its send time in microseconds and the index of
+// its size in LoadGeneratorConfig::data_sizes.
+const size_t kDataHeaderSize = sizeof(int64_t) + 1;
+// Conference mode: time for a new call to settle (ICE, first packets,
+// jitter buffers filling) before its resource use is sampled, and how long
+// a sample lasts.
+const int kSettleMs = 1000;
+const int kSampleMs = 2000;
+
+int64_t ProcessCpuUs() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    return (static_cast<int64_t>(usage.ru_utime.tv_sec) + usage.ru_stime.tv_sec) * 1000000 +
+            usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+// Current resident set, not getrusage()'s peak: calls hung up between
+// steps give their memory back, and the per-step deltas must show that.
+long ResidentKb() {
+#ifdef __APPLE__
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO,
+                  reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS)
+        return 0;
+    return static_cast<long>(info.resident_size / 1024);
+#else
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (!statm)
+        return 0;
+    long total_pages = 0;
+    long resident_pages = 0;
+    int fields = fscanf(statm, "%ld %ld", &total_pages, &resident_pages);
+    fclose(statm);
+    if (fields != 2)
+        return 0;
+    return resident_pages * (sysconf(_SC_PAGESIZE) / 1024);
+#endif
+}
+
+}  // namespace
+
+LatencyHistogram::LatencyHistogram()
+    : sorted_(true) {
+}
+
+void LatencyHistogram::Add(int64_t ms) {
+    samples_.push_back(ms);
+    sorted_ = false;
+}
+
+void LatencyHistogram::Sort() const {
+    if (sorted_)
+        return;
+    std::sort(samples_.begin(), samples_.end());
+    sorted_ = true;
+}
+
+int64_t LatencyHistogram::Percentile(double fraction) const {
+    if (samples_.empty())
+        return 0;
+    Sort();
+    size_t rank = static_cast<size_t>(fraction * (samples_.size() - 1) + 0.5);
+    return samples_[std::min(rank, samples_.size() - 1)];
+}
+
+std::string LatencyHistogram::ToString(const std::string& name) const {
+    std::ostringstream out;
+    out << name << ": n=" << samples_.size();
+    if (samples_.empty())
+        return out.str() + "\n";
+    Sort();
+    out << " p50=" << Percentile(0.5) << "ms p99=" << Percentile(0.99)
+        << "ms p999=" << Percentile(0.999) << "ms max=" << samples_.back()
+        << "ms\n";
+
+    // Buckets [0,1), [1,2), [2,4), [4,8), ... ms.
+    size_t i = 0;
+    for (int64_t upper = 1; i < samples_.size(); upper *= 2) {
+        size_t in_bucket = 0;
+        while (i < samples_.size() && samples_[i] < upper) {
+            ++in_bucket;
+            ++i;
+        }
+        if (in_bucket > 0) {
+            out << "  <" << upper << "ms\t" << in_bucket << "\t"
+                << std::string(std::max<size_t>(1, 50 * in_bucket / samples_.size()), '#')
+                << "\n";
+        }
+    }
+    return out.str();
+}
+
+LoadGeneratorConfig::LoadGeneratorConfig()
+    : server("localhost"),
+      port(8888),
+      clients(2),
+      calls_per_pair(1),
+      timeout_s(60),
+      keep_alive(false),
+      websocket(false),
+      pc_pool_size(0),
+      stats_interval_ms(0),
+      audio_profile(kAudioProfileFull),
+      data_messages(0),
+      data_sizes({64, 65536}),
+      conference(false),
+      threads(nullptr) {
+}
+
+LoadGenerator::LoadGenerator(const LoadGeneratorConfig& config, QObject *parent)
+    : QObject{parent},
+      config_(config),
+      start_ms_(0),
+      end_ms_(0),
+      start_cpu_us_(0),
+      end_cpu_us_(0),
+      calls_connected_(0),
+      calls_failed_(0),
+      callers_done_(0),
+      sampling_(false),
+      finished_(false) {
+    for (size_t size : config_.data_sizes) {
+        DataStats stats;
+        stats.size = std::max(size, kDataHeaderSize);
+        stats.messages = 0;
+        stats.bytes = 0;
+        stats.first_send_us = 0;
+        stats.last_receive_us = 0;
+        data_stats_.push_back(stats);
+    }
+}
+
+LoadGenerator::~LoadGenerator() {
+    // Conductors before the clients they observe.
+    for (auto& client : clients_)
+        client->conductor.reset();
+}
+
+bool LoadGenerator::Start() {
+    RTC_DCHECK(config_.threads && config_.threads->started());
+    if (config_.clients < 2) {
+        qDebug() << "Need at least two clients";
+        return false;
+    }
+
+    start_ms_ = rtc::TimeMillis();
+    start_cpu_us_ = ProcessCpuUs();
+    int pid = getpid();
+    for (int i = 0; i < config_.clients; ++i) {
+        std::unique_ptr<Client> entry(new Client());
+        Client* client = entry.get();
+        client->index = i;
+        client->name = "loadgen-" + std::to_string(pid) + "-" + std::to_string(i);
+        client->callee = nullptr;
+        client->signed_in = false;
+        client->calling = false;
+        client->calls_done = 0;
+        client->sign_in_start_ms = 0;
+        client->discovery_start_ms = 0;
+        client->call_start_ms = 0;
+        client->data_size_index = 0;
+        client->data_sent = 0;
+        client->data_received = 0;
+
+        client->client.reset(new PeerConnectionClient());
+        client->client->set_keep_alive(config_.keep_alive);
+        if (config_.websocket) {
+            client->client->SetTransport(
+                        std::unique_ptr<SignalingTransport>(new WebSocketTransport()));
+        }
+        client->conductor.reset(new Conductor(client->client.get()));
+        client->conductor->SetThreadTopology(config_.threads);
+
+        std::string error;
+        const FakeAudioDeviceConfig& audio = config_.audio;
+        rtc::scoped_refptr<webrtc::AudioDeviceModule> adm =
+                config_.threads->worker_thread()->Invoke<rtc::scoped_refptr<webrtc::AudioDeviceModule>>(
+                    RTC_FROM_HERE, [&audio, &error]() {
+            return CreateFakeAudioDevice(audio, &error);
+        });
+        if (!adm) {
+            qDebug() << "Fake audio device:" << error.c_str();
+            return false;
+        }
+        client->conductor->SetAudioDeviceModule(adm);
+        client->conductor->SetOpusSettings(config_.opus);
+        client->conductor->SetAudioProfile(config_.audio_profile);
+        client->conductor->SetPeerConnectionPoolSize(config_.pc_pool_size);
+        client->conductor->stats()->Start(config_.stats_interval_ms);
+        if (!client->conductor->InitializePeerConnectionFactory())
+            return false;
+        client->client->RegisterObserver(client->conductor.get());
+
+        connect(client->conductor.get(), &Conductor::signedIn, this,
+                [this, client]() { OnSignedIn(client); });
+        connect(client->conductor.get(), &Conductor::peerConnected, this,
+                [this, client](int, const QString&) { MaybePlaceCall(client); });
+        connect(client->conductor.get(), &Conductor::peersConnected, this,
+                [this, client](const QVector<int>&) { MaybePlaceCall(client); });
+        connect(client->conductor.get(), &Conductor::callConnected, this,
+                [this, client](int peer_id) { OnCallEnded(client, peer_id, true); });
+        connect(client->conductor.get(), &Conductor::callFailed, this,
+                [this, client](int peer_id) { OnCallEnded(client, peer_id, false); });
+        connect(client->conductor.get(), &Conductor::dataChannelOpened, this,
+                [this, client](int, const QString&) { SendData(client); });
+        connect(client->conductor.get(), &Conductor::dataChannelWritable, this,
+                [this, client](int, const QString&) { SendData(client); });
+        connect(client->conductor.get(), &Conductor::dataChannelMessage, this,
+                [this, client](int, const QString&, const QByteArray& data, bool) {
+            OnDataReceived(client, data);
+        });
+        clients_.push_back(std::move(entry));
+    }
+    // In a conference the callee changes with each call; see
+    // MaybeGrowConference().
+    for (size_t i = 0; !config_.conference && i + 1 < clients_.size(); i += 2)
+        clients_[i]->callee = clients_[i + 1].get();
+
+    // All sign-ins go out back to back.
+    for (auto& client : clients_) {
+        client->sign_in_start_ms = rtc::TimeMillis();
+        client->client->Connect(config_.server, config_.port, client->name);
+    }
+
+    QTimer::singleShot(config_.timeout_s * 1000, this, [this]() {
+        if (!finished_) {
+            qDebug() << "Timed out";
+            Finish();
+        }
+    });
+    return true;
+}
+
+void LoadGenerator::OnSignedIn(Client* client) {
+    client->signed_in = true;
+    sign_in_.Add(rtc::TimeMillis() - client->sign_in_start_ms);
+
+    if (config_.conference) {
+        MaybeGrowConference();
+    } else if (client->callee) {
+        MaybePlaceCall(client);
+    } else if (client->index > 0) {
+        // A callee: its caller may already be waiting for it.
+        MaybePlaceCall(clients_[client->index - 1].get());
+    }
+}
+
+void LoadGenerator::MaybePlaceCall(Client* caller) {
+    if (config_.conference) {
+        MaybeGrowConference();
+        return;
+    }
+    if (!caller->callee || caller->calling || caller->calls_done > 0 ||
+            !caller->signed_in || !caller->callee->signed_in || finished_)
+        return;
+
+    // Discovery runs from the moment both ends are signed in.
+    if (caller->discovery_start_ms == 0)
+        caller->discovery_start_ms = rtc::TimeMillis();
+    if (!caller->client->peers().Find(caller->callee->client->id()))
+        return;
+    discovery_.Add(rtc::TimeMillis() - caller->discovery_start_ms);
+    PlaceCall(caller);
+}
+
+void LoadGenerator::PlaceCall(Client* caller) {
+    caller->calling = true;
+    caller->call_start_ms = rtc::TimeMillis();
+    caller->conductor->ConnectToPeer(caller->callee->client->id());
+}
+
+void LoadGenerator::OnCallEnded(Client* caller, int peer_id, bool connected) {
+    if (config_.conference) {
+        // Participants report their side of the call too.
+        if (caller == clients_[0].get())
+            OnConferenceCallEnded(caller, connected);
+        return;
+    }
+    // Callees report their side of the call too; only callers count.
+    if (!caller->callee || !caller->calling || finished_)
+        return;
+
+    caller->calling = false;
+    ++caller->calls_done;
+    if (connected) {
+        ++calls_connected_;
+        call_setup_.Add(rtc::TimeMillis() - caller->call_start_ms);
+    } else {
+        ++calls_failed_;
+    }
+    if (connected && config_.data_messages > 0 && !data_stats_.empty()) {
+        StartDataTransfer(caller, peer_id);
+        return;
+    }
+    HangUp(caller, peer_id);
+}
+
+void LoadGenerator::HangUp(Client* caller, int peer_id) {
+    caller->conductor->DisconnectFromPeer(peer_id);
+
+    if (caller->calls_done < config_.calls_per_pair) {
+        QTimer::singleShot(kRedialDelayMs, this, [this, caller]() {
+            if (!finished_)
+                PlaceCall(caller);
+        });
+        return;
+    }
+    if (++callers_done_ == static_cast<int>(clients_.size() / 2))
+        Finish();
+}
+
+void LoadGenerator::StartDataTransfer(Client* caller, int peer_id) {
+    caller->data_size_index = 0;
+    caller->data_sent = 0;
+    caller->data_received = 0;
+    if (!caller->conductor->OpenDataChannel(peer_id, kDataLabel, DataChannelOptions())) {
+        qDebug() << "Failed to open a data channel to" << peer_id;
+        HangUp(caller, peer_id);
+    }
+    // SendData() once it's open.
+}
+
+void LoadGenerator::SendData(Client* caller) {
+    if (!caller->callee || finished_)
+        return;
+    BufferedDataChannel* channel = caller->conductor->FindDataChannel(
+                caller->callee->client->id(), kDataLabel);
+    if (!channel || !channel->open())
+        return;
+    while (caller->data_size_index < data_stats_.size()) {
+        DataStats& stats = data_stats_[caller->data_size_index];
+        const uint8_t index = static_cast<uint8_t>(caller->data_size_index);
+        while (caller->data_sent < config_.data_messages) {
+            rtc::CopyOnWriteBuffer message(stats.size);
+            int64_t now_us = rtc::TimeMicros();
+            memset(message.data(), 0, stats.size);
+            memcpy(message.data(), &now_us, sizeof(now_us));
+            message.data()[sizeof(now_us)] = index;
+            if (!channel->Send(message, true))
+                return;  // Resumed from dataChannelWritable().
+            if (stats.first_send_us == 0)
+                stats.first_send_us = now_us;
+            ++caller->data_sent;
+        }
+        ++caller->data_size_index;
+        caller->data_sent = 0;
+    }
+}
+
+void LoadGenerator::OnDataReceived(Client* callee, const QByteArray& data) {
+    // Callers are the even clients, right before their callee.
+    if (callee->callee || callee->index == 0 || finished_ ||
+            static_cast<size_t>(data.size()) < kDataHeaderSize)
+        return;
+    int64_t sent_us;
+    memcpy(&sent_us, data.constData(), sizeof(sent_us));
+    size_t index = static_cast<uint8_t>(data[static_cast<int>(sizeof(sent_us))]);
+    if (index >= data_stats_.size())
+        return;
+    int64_t now_us = rtc::TimeMicros();
+    DataStats& stats = data_stats_[index];
+    ++stats.messages;
+    stats.bytes += static_cast<uint64_t>(data.size());
+    stats.last_receive_us = std::max(stats.last_receive_us, now_us);
+    stats.latency.Add((now_us - sent_us) / 1000);
+
+    Client* caller = clients_[callee->index - 1].get();
+    if (++caller->data_received <
+            config_.data_messages * static_cast<int>(data_stats_.size()))
+        return;
+    int peer_id = callee->client->id();
+    // Not from inside the channel's callback.
+    QTimer::singleShot(0, this, [this, caller, peer_id]() {
+        if (!finished_)
+            HangUp(caller, peer_id);
+    });
+}
+
+void LoadGenerator::MaybeGrowConference() {
+    Client* hub = clients_[0].get();
+    if (finished_ || sampling_ || hub->calling || !hub->signed_in)
+        return;
+    size_t next = static_cast<size_t>(hub->calls_done) + 1;
+    if (next >= clients_.size()) {
+        Finish();
+        return;
+    }
+    Client* participant = clients_[next].get();
+    if (!participant->signed_in || !hub->client->peers().Find(participant->client->id()))
+        return;
+    if (resource_samples_.empty()) {
+        // The baseline: everyone signed in, no calls yet.  Sign-ins still
+        // coming in would be charged to the first participants; the last
+        // one brings us back here.
+        for (const auto& client : clients_) {
+            if (!client->signed_in)
+                return;
+        }
+        SampleResources();
+        return;
+    }
+    hub->callee = participant;
+    PlaceCall(hub);
+}
+
+void LoadGenerator::OnConferenceCallEnded(Client* hub, bool connected) {
+    if (!hub->calling || finished_)
+        return;
+    hub->calling = false;
+    if (!connected) {
+        ++calls_failed_;
+        Finish();
+        return;
+    }
+    ++calls_connected_;
+    ++hub->calls_done;
+    call_setup_.Add(rtc::TimeMillis() - hub->call_start_ms);
+    sampling_ = true;
+    QTimer::singleShot(kSettleMs, this, [this]() { SampleResources(); });
+}
+
+void LoadGenerator::SampleResources() {
+    sampling_ = true;
+    int64_t start_cpu_us = ProcessCpuUs();
+    int64_t start_ms = rtc::TimeMillis();
+    QTimer::singleShot(kSampleMs, this, [this, start_cpu_us, start_ms]() {
+        if (finished_)
+            return;
+        int64_t elapsed_ms = rtc::TimeMillis() - start_ms;
+        ResourceSample sample;
+        sample.participants = clients_[0]->calls_done;
+        sample.cpu_percent = elapsed_ms > 0 ?
+                    (ProcessCpuUs() - start_cpu_us) / (10.0 * elapsed_ms) : 0.0;
+        sample.rss_kb = ResidentKb();
+        resource_samples_.push_back(sample);
+        sampling_ = false;
+        MaybeGrowConference();
+    });
+}
+
+void LoadGenerator::Finish() {
+    finished_ = true;
+    end_ms_ = rtc::TimeMillis();
+    end_cpu_us_ = ProcessCpuUs();
+    for (auto& client : clients_)
+        client->conductor->Close();
+    emit finished();
+}
+
+void LoadGenerator::Report() const {
+    int64_t elapsed_ms = (end_ms_ ? end_ms_ : rtc::TimeMillis()) - start_ms_;
+    printf("clients=%d calls_per_pair=%d keep_alive=%d websocket=%d pc_pool_size=%d "
+           "elapsed=%lldms\n",
+           config_.clients, config_.calls_per_pair, config_.keep_alive ? 1 : 0,
+           config_.websocket ? 1 : 0, config_.pc_pool_size,
+           static_cast<long long>(elapsed_ms));
+    printf("%s", sign_in_.ToString("sign_in").c_str());
+    printf("%s", discovery_.ToString("discovery").c_str());
+    printf("%s", call_setup_.ToString("call_setup").c_str());
+    printf("calls: connected=%d failed=%d throughput=%.2f calls/s\n",
+           calls_connected_, calls_failed_,
+           elapsed_ms > 0 ? 1000.0 * calls_connected_ / elapsed_ms : 0.0);
+    int64_t cpu_us = (end_cpu_us_ ? end_cpu_us_ : ProcessCpuUs()) - start_cpu_us_;
+    printf("cpu: %.1f%% of one core\n", elapsed_ms > 0 ? cpu_us / (10.0 * elapsed_ms) : 0.0);
+    if (config_.stats_interval_ms > 0 && !clients_.empty()) {
+        // Only what StatsCollector does with the reports; making them is
+        // in the cpu figure, compared across --compare=stats passes.
+        double overhead = 0;
+        for (const auto& client : clients_)
+            overhead += client->conductor->stats()->overhead();
+        printf("stats: interval=%dms collector=%.3f%% of wall time per client\n",
+               config_.stats_interval_ms, 100.0 * overhead / clients_.size());
+    }
+    if (config_.conference && !resource_samples_.empty()) {
+        // Both ends of every call run in this process, so each step adds a
+        // session on client 0 and a participant's whole Conductor.
+        printf("participants\tcpu%%\t+cpu%%\trss_kb\t+rss_kb\n");
+        const ResourceSample* previous = &resource_samples_.front();
+        for (const ResourceSample& sample : resource_samples_) {
+            printf("%d\t%.1f\t%+.1f\t%ld\t%+ld\n", sample.participants,
+                   sample.cpu_percent, sample.cpu_percent - previous->cpu_percent,
+                   sample.rss_kb, sample.rss_kb - previous->rss_kb);
+            previous = &sample;
+        }
+        const ResourceSample& last = resource_samples_.back();
+        if (last.participants > 0) {
+            const ResourceSample& first = resource_samples_.front();
+            printf("per participant: cpu=%.2f%% rss=%ldkB\n",
+                   (last.cpu_percent - first.cpu_percent) / last.participants,
+                   (last.rss_kb - first.rss_kb) / last.participants);
+        }
+    }
+    if (config_.data_messages > 0) {
+        for (const DataStats& stats : data_stats_) {
+            int64_t elapsed_us = stats.last_receive_us - stats.first_send_us;
+            printf("data %zuB: messages=%d bytes=%llu throughput=%.2f MB/s\n",
+                   stats.size, stats.messages, static_cast<unsigned long long>(stats.bytes),
+                   elapsed_us > 0 ? static_cast<double>(stats.bytes) / elapsed_us : 0.0);
+            printf("%s", stats.latency.ToString("data_latency_" + std::to_string(stats.size) + "B").c_str());
+        }
+    }
+    fflush(stdout);
+}
@@ -0,0 +1,172 @@
+#ifndef LOADGENERATOR_H
+#define LOADGENERATOR_H
+
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include <QObject>
+
+#include "audioprofile.h"
+#include "conductor.h"
+#include "fakeaudiodevice.h"
+#include "opussettings.h"
+#include "peerconnectionclient.h"
+
+class ThreadTopology;
+
+// Latency samples in milliseconds.  Keeps every sample, which is fine for
+// the few thousand calls a run produces, so percentiles are exact.
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void Add(int64_t ms);
+    size_t count() const { return samples_.size(); }
+    // |fraction| in [0, 1]; 0 if there are no samples.
+    int64_t Percentile(double fraction) const;
+    // One line with count and p50/p99/p999/max, then power-of-two buckets.
+    std::string ToString(const std::string& name) const;
+
+private:
+    void Sort() const;
+
+    mutable std::vector<int64_t> samples_;
+    mutable bool sorted_;
+};
+
+struct LoadGeneratorConfig {
+    LoadGeneratorConfig();
+
+    std::string server;
+    int port;
+    // Signed in at once; even ones call the next odd one, like --autocall.
+    int clients;
+    // Calls each caller places one after the other.
+    int calls_per_pair;
+    // The run is cut short after this long.
+    int timeout_s;
+    bool keep_alive;
+    bool websocket;
+    // PeerConnections each Conductor keeps ready; see
+    // Conductor::SetPeerConnectionPoolSize().
+    int pc_pool_size;
+    // GetStats() poll interval of every Conductor's StatsCollector; 0 off.
+    int stats_interval_ms;
+    // Every client gets its own fake device with these settings.
+    FakeAudioDeviceConfig audio;
+    OpusSettings opus;
+    // Compare the CPU use Conductor logs across runs to see what a profile
+    // costs.
+    AudioProfile audio_profile;
+    // When > 0, each connected call also sends this many messages of each
+    // of |data_sizes| bytes over a reliable, ordered data channel before
+    // hanging up, and the report adds throughput and latency per size.
+    int data_messages;
+    std::vector<size_t> data_sizes;
+    // Instead of pairs, client 0 calls every other client in turn and keeps
+    // the calls up; the report adds CPU and peak memory per participant.
+    bool conference;
+    // Shared by all clients' factories.  Must be started.
+    ThreadTopology* threads;
+};
+
+// Runs |clients| PeerConnectionClient/Conductor pairs in this process
+// against one signaling server and times sign-in, peer discovery and call
+// setup (ConnectToPeer() to ICE connected), and optionally data channel
+// throughput over the calls.
+class LoadGenerator : public QObject
+{
+    Q_OBJECT
+public:
+    explicit LoadGenerator(const LoadGeneratorConfig& config, QObject *parent = 0);
+    ~LoadGenerator();
+
+    bool Start();
+    // Prints the histograms and throughput to stdout.
+    void Report() const;
+
+signals:
+    // Every call is done, or the timeout hit.  Clients are signing out.
+    void finished();
+
+private:
+    struct Client {
+        int index;
+        std::string name;
+        std::unique_ptr<PeerConnectionClient> client;
+        std::unique_ptr<Conductor> conductor;
+        // Only set on callers.
+        Client* callee;
+        bool signed_in;
+        bool calling;
+        int calls_done;
+        int64_t sign_in_start_ms;
+        int64_t discovery_start_ms;
+        int64_t call_start_ms;
+        // Data transfer progress, on callers.
+        size_t data_size_index;
+        int data_sent;
+        int data_received;
+    };
+
+    // Process resource use with |participants| calls up on client 0.
+    struct ResourceSample {
+        int participants;
+        // Of one core, over kSampleMs.
+        double cpu_percent;
+        // Resident set when the sample ends.
+        long rss_kb;
+    };
+
+    // Per message size, over all pairs.
+    struct DataStats {
+        size_t size;
+        int messages;
+        uint64_t bytes;
+        int64_t first_send_us;
+        int64_t last_receive_us;
+        LatencyHistogram latency;
+    };
+
+    void OnSignedIn(Client* client);
+    // A caller can call once both ends are signed in and the callee shows
+    // up in its peer list.
+    void MaybePlaceCall(Client* caller);
+    void PlaceCall(Client* caller);
+    void OnCallEnded(Client* caller, int peer_id, bool connected);
+    // Hangs up and places the next call, or counts the caller done.
+    void HangUp(Client* caller, int peer_id);
+    void StartDataTransfer(Client* caller, int peer_id);
+    // Sends until done or the channel's queue is full.
+    void SendData(Client* caller);
+    void OnDataReceived(Client* callee, const QByteArray& data);
+    // Conference mode: calls the next participant once the previous call
+    // connected and its resource use was sampled.
+    void MaybeGrowConference();
+    void OnConferenceCallEnded(Client* hub, bool connected);
+    // Samples resource use for a while, then grows the conference.
+    void SampleResources();
+    void Finish();
+
+    LoadGeneratorConfig config_;
+    std::vector<std::unique_ptr<Client>> clients_;
+    LatencyHistogram sign_in_;
+    LatencyHistogram discovery_;
+    LatencyHistogram call_setup_;
+    std::vector<DataStats> data_stats_;
+    std::vector<ResourceSample> resource_samples_;
+    bool sampling_;
+    int64_t start_ms_;
+    int64_t end_ms_;
+    // Process CPU time at Start() and Finish().
+    int64_t start_cpu_us_;
+    int64_t end_cpu_us_;
+    int calls_connected_;
+    int calls_failed_;
+    int callers_done_;
+    bool finished_;
+};
+
+#endif // LOADGENERATOR_H
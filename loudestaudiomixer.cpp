@@ -0,0 +1,190 @@
+#include "loudestaudiomixer.h"
+
+#include <algorithm>
+
+#include "rtc_base/checks.h"
+#include "rtc_base/ref_counted_object.h"
+
+#include "mixkernels.h"
+
+namespace {
+
+const int kSampleRates[] = {8000, 16000, 32000, 48000};
+const int kDefaultSampleRate = 48000;
+// Mean square of a -60 dBFS frame; anything quieter isn't worth mixing.
+const uint64_t kSilenceLevel = 1074;
+const int32_t kMaxSample = 32767;
+// The limiter gain climbs back to 1 at this much per 10 ms frame.
+const float kGainRecoveryPerFrame = 0.02f;
+
+// Interleaved |in_channels| to |out_channels|: mono is copied to every
+// output channel, a mono output is the average of the inputs, and otherwise
+// missing channels repeat the last input channel.
+void RemixChannels(const int16_t* in, size_t in_channels, int16_t* out,
+                   size_t out_channels, size_t samples_per_channel) {
+    for (size_t i = 0; i < samples_per_channel; ++i) {
+        const int16_t* frame = in + i * in_channels;
+        int16_t* target = out + i * out_channels;
+        if (out_channels == 1) {
+            int32_t total = 0;
+            for (size_t c = 0; c < in_channels; ++c)
+                total += frame[c];
+            target[0] = static_cast<int16_t>(total / static_cast<int32_t>(in_channels));
+            continue;
+        }
+        for (size_t c = 0; c < out_channels; ++c)
+            target[c] = frame[std::min(c, in_channels - 1)];
+    }
+}
+
+}  // namespace
+
+rtc::scoped_refptr<LoudestAudioMixer> LoudestAudioMixer::Create(size_t max_mixed_sources) {
+    return new rtc::RefCountedObject<LoudestAudioMixer>(max_mixed_sources);
+}
+
+LoudestAudioMixer::LoudestAudioMixer(size_t max_mixed_sources)
+    : max_mixed_sources_(std::max<size_t>(max_mixed_sources, 1)),
+      gain_(1.f) {
+    sum_.reserve(webrtc::AudioFrame::kMaxDataSizeSamples);
+    remix_.reserve(webrtc::AudioFrame::kMaxDataSizeSamples);
+}
+
+LoudestAudioMixer::~LoudestAudioMixer() {
+}
+
+bool LoudestAudioMixer::AddSource(Source* source) {
+    RTC_DCHECK(source);
+    rtc::CritScope lock(&crit_);
+    for (const auto& state : sources_) {
+        if (state->source == source)
+            return false;
+    }
+    std::unique_ptr<SourceState> state(new SourceState());
+    state->source = source;
+    state->level = 0;
+    state->mixed = false;
+    sources_.push_back(std::move(state));
+    audible_.reserve(sources_.size());
+    return true;
+}
+
+void LoudestAudioMixer::RemoveSource(Source* source) {
+    rtc::CritScope lock(&crit_);
+    sources_.erase(std::remove_if(sources_.begin(), sources_.end(),
+                                  [source](const std::unique_ptr<SourceState>& state) {
+                                      return state->source == source;
+                                  }),
+                   sources_.end());
+}
+
+int LoudestAudioMixer::OutputSampleRate() const {
+    int preferred = 0;
+    for (const auto& state : sources_)
+        preferred = std::max(preferred, state->source->PreferredSampleRate());
+    if (preferred == 0)
+        return kDefaultSampleRate;
+    for (int rate : kSampleRates) {
+        if (rate >= preferred)
+            return rate;
+    }
+    return kDefaultSampleRate;
+}
+
+const int16_t* LoudestAudioMixer::FrameData(const SourceState& state, size_t channels) {
+    if (state.frame.num_channels_ == channels)
+        return state.frame.data();
+    remix_.resize(state.frame.samples_per_channel_ * channels);
+    RemixChannels(state.frame.data(), state.frame.num_channels_, remix_.data(),
+                  channels, state.frame.samples_per_channel_);
+    return remix_.data();
+}
+
+void LoudestAudioMixer::Mix(size_t number_of_channels,
+                            webrtc::AudioFrame* audio_frame_for_mixing) {
+    RTC_DCHECK(number_of_channels >= 1);
+    rtc::CritScope lock(&crit_);
+    const int sample_rate_hz = OutputSampleRate();
+    const size_t samples_per_channel = static_cast<size_t>(sample_rate_hz / 100);
+
+    // Pull every source (they expect to be pulled each frame) and keep the
+    // ones with something to say.
+    audible_.clear();
+    for (const auto& state : sources_) {
+        Source::AudioFrameInfo info =
+                state->source->GetAudioFrameWithInfo(sample_rate_hz, &state->frame);
+        const webrtc::AudioFrame& frame = state->frame;
+        if (info != Source::AudioFrameInfo::kNormal || frame.muted() ||
+                frame.samples_per_channel_ != samples_per_channel ||
+                frame.num_channels_ == 0) {
+            state->mixed = false;
+            continue;
+        }
+        size_t count = samples_per_channel * frame.num_channels_;
+        state->level = SumOfSquares(frame.data(), count) / count;
+        if (state->level < kSilenceLevel) {
+            state->mixed = false;
+            continue;
+        }
+        audible_.push_back(state.get());
+    }
+
+    audio_frame_for_mixing->UpdateFrame(0, nullptr, samples_per_channel, sample_rate_hz,
+                                        webrtc::AudioFrame::kNormalSpeech,
+                                        webrtc::AudioFrame::kVadUnknown,
+                                        number_of_channels);
+    if (audible_.empty()) {
+        gain_ = std::min(1.f, gain_ + kGainRecoveryPerFrame);
+        return;  // Left muted.
+    }
+
+    // The loudest |selected| end up in front.
+    const size_t selected = std::min(audible_.size(), max_mixed_sources_);
+    if (audible_.size() > selected) {
+        std::nth_element(audible_.begin(), audible_.begin() + selected, audible_.end(),
+                         [](const SourceState* a, const SourceState* b) {
+                             return a->level > b->level;
+                         });
+    }
+
+    // Mono unless someone sends stereo.
+    size_t mix_channels = 1;
+    for (const SourceState* state : audible_) {
+        if (state->frame.num_channels_ > 1)
+            mix_channels = 2;
+    }
+    const size_t count = samples_per_channel * mix_channels;
+    sum_.assign(count, 0);
+
+    for (size_t i = 0; i < audible_.size(); ++i) {
+        SourceState* state = audible_[i];
+        const bool selected_now = i < selected;
+        if (!selected_now && !state->mixed)
+            continue;
+        const int16_t* data = FrameData(*state, mix_channels);
+        if (selected_now && state->mixed)
+            AccumulateSamples(data, count, sum_.data());
+        else if (selected_now)
+            AccumulateSamplesWithRamp(data, count, 0.f, 1.f, sum_.data());
+        else
+            AccumulateSamplesWithRamp(data, count, 1.f, 0.f, sum_.data());
+        state->mixed = selected_now;
+    }
+
+    int32_t peak = PeakMagnitude(sum_.data(), count);
+    float target = peak > kMaxSample ? static_cast<float>(kMaxSample) / peak : 1.f;
+    float next_gain = std::min(target, std::min(1.f, gain_ + kGainRecoveryPerFrame));
+    if (gain_ < 1.f || next_gain < 1.f)
+        ApplyGainRamp(sum_.data(), count, gain_, next_gain);
+    gain_ = next_gain;
+
+    int16_t* out = audio_frame_for_mixing->mutable_data();
+    if (mix_channels == number_of_channels) {
+        SaturateSamples(sum_.data(), count, out);
+    } else {
+        remix_.resize(count);
+        SaturateSamples(sum_.data(), count, remix_.data());
+        RemixChannels(remix_.data(), mix_channels, out, number_of_channels,
+                      samples_per_channel);
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef LOUDESTAUDIOMIXER_H
+#define LOUDESTAUDIOMIXER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+#include "api/audio/audio_frame.h"
+#include "api/audio/audio_mixer.h"
+#include "rtc_base/critical_section.h"
+#include "rtc_base/scoped_ref_ptr.h"
+
+// Mixes only the |max_mixed_sources| loudest remote streams.  Muted and
+// near-silent sources are skipped before anything is summed, so a large
+// call costs little more than a small one when most participants are quiet.
+//
+// Sources entering or leaving the mix are ramped over one frame.  The sum
+// is taken in 32 bits and brought back into range by a gain that drops as
+// soon as the mix would clip and recovers over a few hundred milliseconds.
+// The per-sample work uses the vectorized loops in mixkernels.h.
+//
+// Mix() runs on the audio device thread, AddSource()/RemoveSource() on the
+// worker thread.
+class LoudestAudioMixer : public webrtc::AudioMixer
+{
+public:
+    static rtc::scoped_refptr<LoudestAudioMixer> Create(size_t max_mixed_sources);
+
+    bool AddSource(Source* source) override;
+    void RemoveSource(Source* source) override;
+    void Mix(size_t number_of_channels,
+             webrtc::AudioFrame* audio_frame_for_mixing) override;
+
+protected:
+    explicit LoudestAudioMixer(size_t max_mixed_sources);
+    ~LoudestAudioMixer() override;
+
+private:
+    struct SourceState {
+        Source* source;
+        webrtc::AudioFrame frame;
+        // Mean square of the current frame.
+        uint64_t level;
+        bool mixed;
+    };
+
+    // The lowest supported rate that covers every source's preferred rate.
+    int OutputSampleRate() const;
+    // Returns |state|'s frame as |channels| channels, converting into
+    // |remix_| if needed.
+    const int16_t* FrameData(const SourceState& state, size_t channels);
+
+    rtc::CriticalSection crit_;
+    const size_t max_mixed_sources_;
+    std::vector<std::unique_ptr<SourceState>> sources_;
+    // Scratch space reused by every Mix().
+    std::vector<SourceState*> audible_;
+    std::vector<int32_t> sum_;
+    std::vector<int16_t> remix_;
+    // Limiter gain at the end of the last frame.
+    float gain_;
+};
+
+#endif // LOUDESTAUDIOMIXER_H
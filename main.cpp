@@ -1,19 +1,29 @@
+#include <string.h>
 #include <QQmlContext>
 #include <QGuiApplication>
 #include <QQmlApplicationEngine>
 #include <QDebug>
+#include <QTimer>
 #include "rtc_base/checks.h"
 #include "rtc_base/ssl_adapter.h"
 #include "rtc_base/socket.h"
 #include "rtc_base/async_socket.h"
 #include "rtc_base/physical_socket_server.h"
 #include "rtc_base/flags.h"
+#include "rtc_base/location.h"
 #include "system_wrappers/include/field_trial.h"
 #include "test/field_trial.h"
 
 #include "customsocketserver.h"
+#include "dnscache.h"
+#include "fakeaudiodevice.h"
+#include "filetransfer.h"
 #include "flag_defs.h"
+#include "metricsserver.h"
+#include "threadtopology.h"
+#include "tracer.h"
 #include "webrtcmanager.h"
+#include "websockettransport.h"
 
 int main(int argc, char *argv[])
 {
@@ -21,14 +31,6 @@ int main(int argc, char *argv[])
 
     QGuiApplication app(argc, argv);
 
-    WebrtcManager webrtc;
-
-    QQmlApplicationEngine engine;
-    engine.rootContext()->setContextProperty("webrtc", &webrtc);
-    engine.load(QUrl(QStringLiteral("qrc:/main.qml")));
-    if (engine.rootObjects().isEmpty())
-        return -1;
-
     rtc::FlagList::SetFlagsFromCommandLine(&argc, argv, true);
     if (FLAG_help) {
         rtc::FlagList::Print(NULL, false);
@@ -42,19 +44,120 @@ int main(int argc, char *argv[])
         qDebug() << "Error: " << FLAG_port << " is not a valid port.";
         return -1;
     }
+    DnsCache::Instance()->set_ttl_ms(FLAG_dns_ttl * 1000);
 
+    if (strlen(FLAG_trace_file) > 0 && !Tracer::Instance()->Start(FLAG_trace_file))
+        return -1;
+
+    // The main thread runs a single loop: the rtc::Thread below waits on
+    // |socketServer|, which also dispatches Qt events, so app.exec() is not
+    // used.
     CustomSocketServer socketServer;
-    rtc::Thread thread(&socketServer);       // question
-    rtc::AutoSocketServerThread autothread(&socketServer);
+    rtc::AutoSocketServerThread thread(&socketServer);
 
     rtc::InitializeSSL();
     PeerConnectionClient client;
-    rtc::scoped_refptr<Conductor> conductor(new rtc::RefCountedObject<Conductor>(&client));
+    client.set_keep_alive(FLAG_keepalive);
+    if (FLAG_websocket)
+        client.SetTransport(std::unique_ptr<SignalingTransport>(new WebSocketTransport()));
+    // Network and worker threads are ours so they can be pinned and
+    // watched; signaling stays on this thread.
+    ThreadTopology threads;
+    ThreadPlacement network;
+    network.cpu = FLAG_network_cpu;
+    threads.set_network_placement(network);
+    ThreadPlacement worker;
+    worker.cpu = FLAG_worker_cpu;
+    worker.priority = FLAG_realtime_audio ? rtc::kRealtimePriority : rtc::kNormalPriority;
+    threads.set_worker_placement(worker);
+    if (!threads.Start())
+        return -1;
+
+    QTimer threadStatsTimer;
+    if (FLAG_thread_stats_interval > 0) {
+        QObject::connect(&threadStatsTimer, &QTimer::timeout, [&threads]() {
+            threads.LogStats();
+        });
+        threadStatsTimer.start(FLAG_thread_stats_interval * 1000);
+    }
+
+    Conductor conductor(&client);
+    client.RegisterObserver(&conductor);
+    conductor.SetThreadTopology(&threads);
+
+    // Either flag swaps in a fake device; the other side then defaults to
+    // silence/null.
+    if (strlen(FLAG_audio_in) > 0 || strlen(FLAG_audio_out) > 0) {
+        FakeAudioDeviceConfig config;
+        if (strlen(FLAG_audio_in) > 0)
+            config.capture = FLAG_audio_in;
+        if (strlen(FLAG_audio_out) > 0)
+            config.playout = FLAG_audio_out;
+        config.sample_rate_hz = FLAG_audio_rate;
+        config.speed = FLAG_audio_speed;
+        std::string error;
+        // The ADM is used from the worker thread, so create it there.
+        rtc::scoped_refptr<webrtc::AudioDeviceModule> adm =
+                threads.worker_thread()->Invoke<rtc::scoped_refptr<webrtc::AudioDeviceModule>>(
+                    RTC_FROM_HERE, [&config, &error]() {
+            return CreateFakeAudioDevice(config, &error);
+        });
+        if (!adm) {
+            qDebug() << "Error: fake audio device:" << error.c_str();
+            return -1;
+        }
+        conductor.SetAudioDeviceModule(adm);
+    }
     socketServer.setClient(&client);
-    socketServer.setConducotr(conductor);
+    socketServer.setConducotr(&conductor);
+
+    conductor.SetIceCandidatePoolSize(FLAG_ice_pool_size);
+    conductor.SetTrickleIce(FLAG_trickle);
+    if (FLAG_mix_sources > 0)
+        conductor.SetMaxMixedSources(FLAG_mix_sources);
+    OpusSettings opus;
+    std::string opusError;
+    if (!ParseOpusSettings(FLAG_opus, &opus, &opusError)) {
+        qDebug() << "Error: --opus:" << opusError.c_str();
+        return -1;
+    }
+    conductor.SetOpusSettings(opus);
+    AudioProfile audioProfile;
+    if (!ParseAudioProfile(FLAG_audio_profile, &audioProfile)) {
+        qDebug() << "Error: unknown --audio_profile" << FLAG_audio_profile;
+        return -1;
+    }
+    conductor.SetAudioProfile(audioProfile);
+    conductor.SetRecordingDirectory(FLAG_record_dir);
+    if (FLAG_pc_pool_size > 0)
+        conductor.SetPeerConnectionPoolSize(FLAG_pc_pool_size);
+    conductor.InitializePeerConnectionFactory();
+
+    conductor.stats()->Start(FLAG_stats_interval);
+    MetricsServer metrics(conductor.stats());
+    if (FLAG_metrics_port > 0 && !metrics.Listen(FLAG_metrics_port))
+        return -1;
+    FileTransferManager files(&conductor);
+    files.SetDownloadDirectory(FLAG_download_dir);
+
+    // The UI drives the call stack configured above; this is the only
+    // Conductor.
+    WebrtcManager webrtc(&client, &conductor, &files);
+    QQmlApplicationEngine engine;
+    engine.rootContext()->setContextProperty("webrtc", &webrtc);
+    engine.load(QUrl(QStringLiteral("qrc:/main.qml")));
+    if (engine.rootObjects().isEmpty())
+        return -1;
+
+    app.setQuitOnLastWindowClosed(false);
+    QObject::connect(&app, &QGuiApplication::lastWindowClosed, [&]() {
+        conductor.Close();
+        socketServer.shutdown();
+    });
 
     thread.Run();
 
+    Tracer::Instance()->Stop();
     rtc::CleanupSSL();
-    return app.exec();
+    return 0;
 }
@@ -0,0 +1,58 @@
+#include "metricsserver.h"
+
+#include <QByteArray>
+#include <QDebug>
+#include <QHostAddress>
+#include <QTcpSocket>
+
+#include "statscollector.h"
+
+namespace {
+// Requests are a single line we only look at the start of.
+const qint64 kMaxRequestSize = 4096;
+}
+
+MetricsServer::MetricsServer(StatsCollector* collector, QObject *parent)
+    : QObject{parent},
+      collector_(collector) {
+    connect(&server_, &QTcpServer::newConnection, this, &MetricsServer::OnNewConnection);
+}
+
+bool MetricsServer::Listen(quint16 port) {
+    if (!server_.listen(QHostAddress::LocalHost, port)) {
+        qDebug() << "Metrics server failed to listen on" << port << server_.errorString();
+        return false;
+    }
+    return true;
+}
+
+void MetricsServer::OnNewConnection() {
+    while (QTcpSocket* socket = server_.nextPendingConnection()) {
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]() { OnReadyRead(socket); });
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+    }
+}
+
+void MetricsServer::OnReadyRead(QTcpSocket* socket) {
+    if (!socket->canReadLine()) {
+        if (socket->bytesAvailable() > kMaxRequestSize)
+            socket->abort();
+        return;
+    }
+    QByteArray line = socket->readLine(kMaxRequestSize);
+    socket->readAll();
+
+    QByteArray response;
+    if (line.startsWith("GET /metrics ") || line.startsWith("GET / ")) {
+        const std::string& text = collector_->RenderPrometheus();
+        response = "HTTP/1.0 200 OK\r\n"
+                   "Content-Type: text/plain; version=0.0.4\r\n"
+                   "Content-Length: " + QByteArray::number(static_cast<qulonglong>(text.size())) +
+                   "\r\n\r\n";
+        response.append(text.data(), static_cast<int>(text.size()));
+    } else {
+        response = "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+    }
+    socket->write(response);
+    socket->disconnectFromHost();
+}
@@ -0,0 +1,30 @@
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#include <QObject>
+#include <QTcpServer>
+
+class QTcpSocket;
+class StatsCollector;
+
+// Serves StatsCollector::RenderPrometheus() as GET /metrics on a local
+// port, for a Prometheus scraper.  One short HTTP/1.0 exchange per
+// connection.
+class MetricsServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MetricsServer(StatsCollector* collector, QObject *parent = 0);
+
+    // Listens on the loopback interface only.
+    bool Listen(quint16 port);
+
+private:
+    void OnNewConnection();
+    void OnReadyRead(QTcpSocket* socket);
+
+    StatsCollector* collector_;
+    QTcpServer server_;
+};
+
+#endif // METRICSSERVER_H
@@ -0,0 +1,135 @@
+#include "bench.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "api/audio/audio_frame.h"
+#include "api/audio/audio_mixer.h"
+#include "modules/audio_mixer/audio_mixer_impl.h"
+#include "loudestaudiomixer.h"
+#include "mixkernels.h"
+
+namespace {
+
+const int kSampleRate = 48000;
+const size_t kFrameSamples = kSampleRate / 100;
+// Both mixers mix this many; 3 is AudioMixerImpl's fixed limit.
+const size_t kMixedSources = 3;
+
+// A fixed 10 ms mono tone at |amplitude|, or a muted stream.
+class ToneSource : public webrtc::AudioMixer::Source
+{
+public:
+    ToneSource(int ssrc, double amplitude, bool muted)
+        : ssrc_(ssrc), muted_(muted), samples_(kFrameSamples) {
+        for (size_t i = 0; i < kFrameSamples; ++i) {
+            samples_[i] = static_cast<int16_t>(
+                        amplitude * sin(2 * M_PI * (200 + 10 * ssrc) * i / kSampleRate));
+        }
+    }
+
+    AudioFrameInfo GetAudioFrameWithInfo(int sample_rate_hz,
+                                         webrtc::AudioFrame* frame) override {
+        size_t samples = std::min<size_t>(sample_rate_hz / 100, kFrameSamples);
+        frame->UpdateFrame(0, samples_.data(), samples, sample_rate_hz,
+                           webrtc::AudioFrame::kNormalSpeech,
+                           webrtc::AudioFrame::kVadActive, 1);
+        return muted_ ? AudioFrameInfo::kMuted : AudioFrameInfo::kNormal;
+    }
+    int Ssrc() const override { return ssrc_; }
+    int PreferredSampleRate() const override { return kSampleRate; }
+
+private:
+    const int ssrc_;
+    const bool muted_;
+    std::vector<int16_t> samples_;
+};
+
+// A conference of |count| remote streams: three people talking, a quarter
+// muted, the rest open microphones picking up room noise.
+std::vector<std::unique_ptr<ToneSource>> MakeConference(int count) {
+    std::vector<std::unique_ptr<ToneSource>> sources;
+    for (int i = 0; i < count; ++i) {
+        double amplitude = i < 3 ? 8000 : 40;
+        sources.emplace_back(new ToneSource(i, amplitude, i >= 3 && i % 4 == 0));
+    }
+    return sources;
+}
+
+void MeasureMixer(const char* label, webrtc::AudioMixer* mixer,
+                  const std::vector<std::unique_ptr<ToneSource>>& sources) {
+    for (const auto& source : sources)
+        mixer->AddSource(source.get());
+    webrtc::AudioFrame frame;
+    BenchTime(label, 20000, [&]() {
+        mixer->Mix(1, &frame);
+        BenchKeep(frame);
+    });
+    for (const auto& source : sources)
+        mixer->RemoveSource(source.get());
+}
+
+}  // namespace
+
+// One 10 ms, 48 kHz mono Mix() as playout asks for it, by number of remote
+// streams.
+BENCHMARK(MixerVsDefault) {
+    for (int count : {4, 16, 48}) {
+        std::vector<std::unique_ptr<ToneSource>> sources = MakeConference(count);
+        std::string streams = std::to_string(count) + " streams";
+        MeasureMixer(("AudioMixerImpl, " + streams).c_str(),
+                     webrtc::AudioMixerImpl::Create().get(), sources);
+        MeasureMixer(("LoudestAudioMixer, " + streams).c_str(),
+                     LoudestAudioMixer::Create(kMixedSources).get(), sources);
+    }
+}
+
+// The mixkernels.h loops against the plain loops they replace, on one
+// 48 kHz frame.
+BENCHMARK(MixKernels) {
+    std::vector<int16_t> samples(kFrameSamples);
+    std::vector<int16_t> inverse(kFrameSamples);
+    for (size_t i = 0; i < kFrameSamples; ++i) {
+        samples[i] = static_cast<int16_t>(12000 * sin(2 * M_PI * 440 * i / kSampleRate));
+        inverse[i] = -samples[i];
+    }
+    std::vector<int32_t> sum(kFrameSamples, 0);
+    std::vector<int16_t> out(kFrameSamples);
+
+    BenchTime("scalar sum of squares", 1000000, [&]() {
+        uint64_t total = 0;
+        for (size_t i = 0; i < kFrameSamples; ++i)
+            total += static_cast<int64_t>(samples[i]) * samples[i];
+        BenchKeep(total);
+    });
+    BenchTime("SumOfSquares", 1000000, [&]() {
+        BenchKeep(SumOfSquares(samples.data(), kFrameSamples));
+    });
+    // Two frames that cancel out, so that the sum never overflows.
+    BenchTime("scalar accumulate, 2 frames", 1000000, [&]() {
+        for (size_t i = 0; i < kFrameSamples; ++i)
+            sum[i] += samples[i];
+        for (size_t i = 0; i < kFrameSamples; ++i)
+            sum[i] += inverse[i];
+        BenchKeep(sum);
+    });
+    BenchTime("AccumulateSamples, 2 frames", 1000000, [&]() {
+        AccumulateSamples(samples.data(), kFrameSamples, sum.data());
+        AccumulateSamples(inverse.data(), kFrameSamples, sum.data());
+        BenchKeep(sum);
+    });
+    for (size_t i = 0; i < kFrameSamples; ++i)
+        sum[i] = 3 * samples[i];
+    BenchTime("scalar saturate", 1000000, [&]() {
+        for (size_t i = 0; i < kFrameSamples; ++i)
+            out[i] = static_cast<int16_t>(std::min(32767, std::max(-32768, sum[i])));
+        BenchKeep(out);
+    });
+    BenchTime("SaturateSamples", 1000000, [&]() {
+        SaturateSamples(sum.data(), kFrameSamples, out.data());
+        BenchKeep(out);
+    });
+}
@@ -0,0 +1,221 @@
+#include "mixkernels.h"
+
+#include <limits>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MIX_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIX_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MIX_NEON 1
+#endif
+
+namespace {
+
+inline int16_t Saturate(int32_t value) {
+    if (value > std::numeric_limits<int16_t>::max())
+        return std::numeric_limits<int16_t>::max();
+    if (value < std::numeric_limits<int16_t>::min())
+        return std::numeric_limits<int16_t>::min();
+    return static_cast<int16_t>(value);
+}
+
+}  // namespace
+
+uint64_t SumOfSquares(const int16_t* samples, size_t count) {
+    uint64_t total = 0;
+    size_t i = 0;
+#if defined(MIX_AVX2)
+    // madd adds two squares; at most 2^31, so it fits when read unsigned.
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc = zero;
+    for (; i + 16 <= count; i += 16) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(samples + i));
+        __m256i pairs = _mm256_madd_epi16(x, x);
+        acc = _mm256_add_epi64(acc, _mm256_unpacklo_epi32(pairs, zero));
+        acc = _mm256_add_epi64(acc, _mm256_unpackhi_epi32(pairs, zero));
+    }
+    alignas(32) uint64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+    total = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif defined(MIX_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+    for (; i + 8 <= count; i += 8) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i));
+        __m128i pairs = _mm_madd_epi16(x, x);
+        acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(pairs, zero));
+        acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(pairs, zero));
+    }
+    alignas(16) uint64_t lanes[2];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), acc);
+    total = lanes[0] + lanes[1];
+#elif defined(MIX_NEON)
+    int64x2_t acc = vdupq_n_s64(0);
+    for (; i + 8 <= count; i += 8) {
+        int16x8_t x = vld1q_s16(samples + i);
+        acc = vpadalq_s32(acc, vmull_s16(vget_low_s16(x), vget_low_s16(x)));
+        acc = vpadalq_s32(acc, vmull_s16(vget_high_s16(x), vget_high_s16(x)));
+    }
+    total = static_cast<uint64_t>(vgetq_lane_s64(acc, 0) + vgetq_lane_s64(acc, 1));
+#endif
+    for (; i < count; ++i)
+        total += static_cast<uint64_t>(static_cast<int32_t>(samples[i]) * samples[i]);
+    return total;
+}
+
+void AccumulateSamples(const int16_t* samples, size_t count, int32_t* sum) {
+    size_t i = 0;
+#if defined(MIX_AVX2)
+    for (; i + 8 <= count; i += 8) {
+        __m256i x = _mm256_cvtepi16_epi32(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i)));
+        __m256i* out = reinterpret_cast<__m256i*>(sum + i);
+        _mm256_storeu_si256(out, _mm256_add_epi32(_mm256_loadu_si256(out), x));
+    }
+#elif defined(MIX_SSE2)
+    for (; i + 8 <= count; i += 8) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i));
+        // Sign-extend by placing each sample in the top half and shifting.
+        __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+        __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+        __m128i* out = reinterpret_cast<__m128i*>(sum + i);
+        _mm_storeu_si128(out, _mm_add_epi32(_mm_loadu_si128(out), low));
+        _mm_storeu_si128(out + 1, _mm_add_epi32(_mm_loadu_si128(out + 1), high));
+    }
+#elif defined(MIX_NEON)
+    for (; i + 8 <= count; i += 8) {
+        int16x8_t x = vld1q_s16(samples + i);
+        vst1q_s32(sum + i, vaddw_s16(vld1q_s32(sum + i), vget_low_s16(x)));
+        vst1q_s32(sum + i + 4, vaddw_s16(vld1q_s32(sum + i + 4), vget_high_s16(x)));
+    }
+#endif
+    for (; i < count; ++i)
+        sum[i] += samples[i];
+}
+
+void AccumulateSamplesWithRamp(const int16_t* samples, size_t count,
+                               float start_gain, float end_gain, int32_t* sum) {
+    if (count == 0)
+        return;
+    const float step = (end_gain - start_gain) / count;
+    float gain = start_gain;
+    for (size_t i = 0; i < count; ++i) {
+        sum[i] += static_cast<int32_t>(samples[i] * gain);
+        gain += step;
+    }
+}
+
+int32_t PeakMagnitude(const int32_t* sum, size_t count) {
+    int32_t peak = 0;
+    size_t i = 0;
+#if defined(MIX_AVX2)
+    __m256i peaks = _mm256_setzero_si256();
+    for (; i + 8 <= count; i += 8) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sum + i));
+        peaks = _mm256_max_epi32(peaks, _mm256_abs_epi32(x));
+    }
+    alignas(32) int32_t lanes[8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), peaks);
+    for (int32_t lane : lanes)
+        peak = lane > peak ? lane : peak;
+#elif defined(MIX_SSE2)
+    // No abs or max for 32-bit lanes before SSSE3/SSE4.1.
+    __m128i peaks = _mm_setzero_si128();
+    for (; i + 4 <= count; i += 4) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sum + i));
+        __m128i sign = _mm_srai_epi32(x, 31);
+        __m128i magnitude = _mm_sub_epi32(_mm_xor_si128(x, sign), sign);
+        __m128i greater = _mm_cmpgt_epi32(magnitude, peaks);
+        peaks = _mm_or_si128(_mm_and_si128(greater, magnitude),
+                             _mm_andnot_si128(greater, peaks));
+    }
+    alignas(16) int32_t lanes[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), peaks);
+    for (int32_t lane : lanes)
+        peak = lane > peak ? lane : peak;
+#elif defined(MIX_NEON)
+    int32x4_t peaks = vdupq_n_s32(0);
+    for (; i + 4 <= count; i += 4)
+        peaks = vmaxq_s32(peaks, vabsq_s32(vld1q_s32(sum + i)));
+    int32x2_t pair = vpmax_s32(vget_low_s32(peaks), vget_high_s32(peaks));
+    pair = vpmax_s32(pair, pair);
+    peak = vget_lane_s32(pair, 0);
+#endif
+    for (; i < count; ++i) {
+        int32_t magnitude = sum[i] < 0 ? -sum[i] : sum[i];
+        peak = magnitude > peak ? magnitude : peak;
+    }
+    return peak;
+}
+
+void ApplyGainRamp(int32_t* sum, size_t count, float start_gain, float end_gain) {
+    if (count == 0)
+        return;
+    const float step = (end_gain - start_gain) / count;
+    size_t i = 0;
+#if defined(MIX_AVX2)
+    __m256 gains = _mm256_setr_ps(start_gain, start_gain + step, start_gain + 2 * step,
+                                  start_gain + 3 * step, start_gain + 4 * step,
+                                  start_gain + 5 * step, start_gain + 6 * step,
+                                  start_gain + 7 * step);
+    const __m256 gain_step = _mm256_set1_ps(8 * step);
+    for (; i + 8 <= count; i += 8) {
+        __m256i* data = reinterpret_cast<__m256i*>(sum + i);
+        __m256 x = _mm256_cvtepi32_ps(_mm256_loadu_si256(data));
+        _mm256_storeu_si256(data, _mm256_cvtps_epi32(_mm256_mul_ps(x, gains)));
+        gains = _mm256_add_ps(gains, gain_step);
+    }
+#elif defined(MIX_SSE2)
+    __m128 gains = _mm_setr_ps(start_gain, start_gain + step, start_gain + 2 * step,
+                               start_gain + 3 * step);
+    const __m128 gain_step = _mm_set1_ps(4 * step);
+    for (; i + 4 <= count; i += 4) {
+        __m128i* data = reinterpret_cast<__m128i*>(sum + i);
+        __m128 x = _mm_cvtepi32_ps(_mm_loadu_si128(data));
+        _mm_storeu_si128(data, _mm_cvtps_epi32(_mm_mul_ps(x, gains)));
+        gains = _mm_add_ps(gains, gain_step);
+    }
+#elif defined(MIX_NEON)
+    const float initial[4] = {start_gain, start_gain + step, start_gain + 2 * step,
+                              start_gain + 3 * step};
+    float32x4_t gains = vld1q_f32(initial);
+    const float32x4_t gain_step = vdupq_n_f32(4 * step);
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t x = vcvtq_f32_s32(vld1q_s32(sum + i));
+        vst1q_s32(sum + i, vcvtq_s32_f32(vmulq_f32(x, gains)));
+        gains = vaddq_f32(gains, gain_step);
+    }
+#endif
+    for (; i < count; ++i)
+        sum[i] = static_cast<int32_t>(sum[i] * (start_gain + step * i));
+}
+
+void SaturateSamples(const int32_t* sum, size_t count, int16_t* out) {
+    size_t i = 0;
+#if defined(MIX_AVX2)
+    for (; i + 16 <= count; i += 16) {
+        __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sum + i));
+        __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sum + i + 8));
+        // packs works within 128-bit lanes; put the quarters back in order.
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(low, high), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), packed);
+    }
+#elif defined(MIX_SSE2)
+    for (; i + 8 <= count; i += 8) {
+        __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sum + i));
+        __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sum + i + 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi32(low, high));
+    }
+#elif defined(MIX_NEON)
+    for (; i + 8 <= count; i += 8) {
+        vst1q_s16(out + i, vcombine_s16(vqmovn_s32(vld1q_s32(sum + i)),
+                                        vqmovn_s32(vld1q_s32(sum + i + 4))));
+    }
+#endif
+    for (; i < count; ++i)
+        out[i] = Saturate(sum[i]);
+}
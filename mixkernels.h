@@ -0,0 +1,32 @@
+#ifndef MIXKERNELS_H
+#define MIXKERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Inner loops of LoudestAudioMixer.  The implementation is chosen at compile
+// time: AVX2 when built with -mavx2, else SSE2 on x86, NEON on ARM, plain
+// C++ otherwise.  Pointers need no particular alignment.
+
+// Sum of x[i]^2; exact for any frame size WebRTC produces.
+uint64_t SumOfSquares(const int16_t* samples, size_t count);
+
+// sum[i] += samples[i].
+void AccumulateSamples(const int16_t* samples, size_t count, int32_t* sum);
+
+// sum[i] += samples[i] * gain, with gain going linearly from |start_gain|
+// to |end_gain| across the frame.  Scalar; only used on the frame a source
+// enters or leaves the mix.
+void AccumulateSamplesWithRamp(const int16_t* samples, size_t count,
+                               float start_gain, float end_gain, int32_t* sum);
+
+// max |sum[i]|.
+int32_t PeakMagnitude(const int32_t* sum, size_t count);
+
+// sum[i] *= gain, gain going linearly from |start_gain| to |end_gain|.
+void ApplyGainRamp(int32_t* sum, size_t count, float start_gain, float end_gain);
+
+// out[i] = sum[i] clamped to the int16 range.
+void SaturateSamples(const int32_t* sum, size_t count, int16_t* out);
+
+#endif // MIXKERNELS_H
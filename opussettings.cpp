@@ -0,0 +1,295 @@
+#include "opussettings.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <set>
+#include <utility>
+#include <vector>
+#include <QDebug>
+
+#include "api/audio_codecs/opus/audio_encoder_opus.h"
+#include "rtc_base/ref_counted_object.h"
+
+namespace {
+
+typedef std::vector<std::pair<std::string, std::string>> FmtpParameters;
+
+bool EqualsIgnoreCase(const std::string& a, const char* b) {
+    size_t i = 0;
+    for (; i < a.size() && b[i]; ++i) {
+        if (tolower(static_cast<unsigned char>(a[i])) !=
+                tolower(static_cast<unsigned char>(b[i])))
+            return false;
+    }
+    return i == a.size() && !b[i];
+}
+
+bool ParseInt(const std::string& text, int min, int max, int* value) {
+    if (text.empty())
+        return false;
+    char* end = nullptr;
+    long parsed = strtol(text.c_str(), &end, 10);
+    if (*end != '\0' || parsed < min || parsed > max)
+        return false;
+    *value = static_cast<int>(parsed);
+    return true;
+}
+
+// "a=rtpmap:111 opus/48000/2" and "a=fmtp:111 ..." -> 111, or -1.
+int PayloadType(const std::string& line, const char* prefix, size_t prefix_length) {
+    if (line.compare(0, prefix_length, prefix) != 0)
+        return -1;
+    size_t space = line.find(' ', prefix_length);
+    int payload_type = -1;
+    if (space == std::string::npos ||
+            !ParseInt(line.substr(prefix_length, space - prefix_length), 0, 127,
+                      &payload_type))
+        return -1;
+    return payload_type;
+}
+
+const char kRtpmap[] = "a=rtpmap:";
+const char kFmtp[] = "a=fmtp:";
+const size_t kRtpmapLength = sizeof(kRtpmap) - 1;
+const size_t kFmtpLength = sizeof(kFmtp) - 1;
+
+bool IsOpusRtpmap(const std::string& line, int* payload_type) {
+    *payload_type = PayloadType(line, kRtpmap, kRtpmapLength);
+    if (*payload_type == -1)
+        return false;
+    size_t name = line.find(' ', kRtpmapLength) + 1;
+    size_t slash = line.find('/', name);
+    return slash != std::string::npos &&
+            EqualsIgnoreCase(line.substr(name, slash - name), "opus");
+}
+
+FmtpParameters ToFmtpParameters(const OpusSettings& settings, bool local) {
+    FmtpParameters parameters;
+    if (settings.bitrate_bps)
+        parameters.emplace_back("maxaveragebitrate", std::to_string(*settings.bitrate_bps));
+    if (settings.ptime_ms)
+        parameters.emplace_back("ptime", std::to_string(*settings.ptime_ms));
+    if (settings.dtx)
+        parameters.emplace_back("usedtx", *settings.dtx ? "1" : "0");
+    if (settings.fec)
+        parameters.emplace_back("useinbandfec", *settings.fec ? "1" : "0");
+    if (settings.stereo) {
+        parameters.emplace_back("stereo", *settings.stereo ? "1" : "0");
+        parameters.emplace_back("sprop-stereo", *settings.stereo ? "1" : "0");
+    }
+    // Only for our own encoder; never sent.
+    if (settings.complexity && !local)
+        parameters.emplace_back("complexity", std::to_string(*settings.complexity));
+    return parameters;
+}
+
+// Replaces or appends each of |overrides| in the "k=v;k=v" list |list|.
+std::string MergeFmtp(const std::string& list, const FmtpParameters& overrides) {
+    FmtpParameters merged;
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find(';', pos);
+        if (end == std::string::npos)
+            end = list.size();
+        std::string entry = list.substr(pos, end - pos);
+        size_t start = entry.find_first_not_of(' ');
+        if (start != std::string::npos) {
+            size_t equals = entry.find('=', start);
+            merged.emplace_back(entry.substr(start, equals - start),
+                                equals == std::string::npos ? "" : entry.substr(equals + 1));
+        }
+        pos = end + 1;
+    }
+    for (const auto& change : overrides) {
+        bool found = false;
+        for (auto& entry : merged) {
+            if (EqualsIgnoreCase(entry.first, change.first.c_str())) {
+                entry.second = change.second;
+                found = true;
+            }
+        }
+        if (!found)
+            merged.push_back(change);
+    }
+
+    std::string result;
+    for (const auto& entry : merged) {
+        if (!result.empty())
+            result += ';';
+        result += entry.first;
+        if (!entry.second.empty())
+            result += '=' + entry.second;
+    }
+    return result;
+}
+
+class OpusTuningEncoderFactory : public webrtc::AudioEncoderFactory
+{
+public:
+    explicit OpusTuningEncoderFactory(rtc::scoped_refptr<webrtc::AudioEncoderFactory> factory)
+        : factory_(std::move(factory)) {}
+
+    std::vector<webrtc::AudioCodecSpec> GetSupportedEncoders() override {
+        return factory_->GetSupportedEncoders();
+    }
+
+    absl::optional<webrtc::AudioCodecInfo> QueryAudioEncoder(
+            const webrtc::SdpAudioFormat& format) override {
+        return factory_->QueryAudioEncoder(format);
+    }
+
+    std::unique_ptr<webrtc::AudioEncoder> MakeAudioEncoder(
+            int payload_type, const webrtc::SdpAudioFormat& format,
+            absl::optional<webrtc::AudioCodecPairId> codec_pair_id) override {
+        auto complexity = format.parameters.find("complexity");
+        int value = 0;
+        if (complexity != format.parameters.end() &&
+                EqualsIgnoreCase(format.name, "opus") &&
+                ParseInt(complexity->second, 0, 10, &value)) {
+            absl::optional<webrtc::AudioEncoderOpusConfig> config =
+                    webrtc::AudioEncoderOpus::SdpToConfig(format);
+            if (config) {
+                config->complexity = value;
+                config->low_rate_complexity = value;
+                if (config->IsOk())
+                    return webrtc::AudioEncoderOpus::MakeAudioEncoder(
+                                *config, payload_type, codec_pair_id);
+            }
+        }
+        return factory_->MakeAudioEncoder(payload_type, format, codec_pair_id);
+    }
+
+private:
+    rtc::scoped_refptr<webrtc::AudioEncoderFactory> factory_;
+};
+
+}  // namespace
+
+bool OpusSettings::empty() const {
+    return !bitrate_bps && !ptime_ms && !dtx && !fec && !complexity && !stereo;
+}
+
+bool OpusSettings::NeedsNegotiation(const OpusSettings& other) const {
+    return ptime_ms != other.ptime_ms || dtx != other.dtx || fec != other.fec ||
+            complexity != other.complexity || stereo != other.stereo;
+}
+
+bool ParseOpusSettings(const std::string& spec, OpusSettings* settings,
+                       std::string* error) {
+    OpusSettings parsed;
+    size_t pos = 0;
+    while (pos < spec.size()) {
+        size_t end = spec.find(',', pos);
+        if (end == std::string::npos)
+            end = spec.size();
+        std::string entry = spec.substr(pos, end - pos);
+        pos = end + 1;
+        size_t equals = entry.find('=');
+        std::string key = entry.substr(0, equals);
+        std::string text = equals == std::string::npos ? "" : entry.substr(equals + 1);
+        int value = 0;
+        bool ok;
+        if (key == "bitrate") {
+            ok = ParseInt(text, 6000, 510000, &value);
+            parsed.bitrate_bps = value;
+        } else if (key == "ptime") {
+            ok = ParseInt(text, 10, 120, &value);
+            parsed.ptime_ms = value;
+        } else if (key == "complexity") {
+            ok = ParseInt(text, 0, 10, &value);
+            parsed.complexity = value;
+        } else if (key == "dtx" || key == "fec" || key == "stereo") {
+            ok = ParseInt(text, 0, 1, &value);
+            absl::optional<bool>& flag = key == "dtx" ? parsed.dtx
+                    : key == "fec" ? parsed.fec : parsed.stereo;
+            flag = value != 0;
+        } else {
+            *error = "unknown Opus setting " + key;
+            return false;
+        }
+        if (!ok) {
+            *error = "bad value for Opus setting " + key;
+            return false;
+        }
+    }
+    *settings = parsed;
+    return true;
+}
+
+std::string ApplyOpusSettingsToSdp(const std::string& sdp,
+                                   const OpusSettings& settings, bool local) {
+    FmtpParameters overrides = ToFmtpParameters(settings, local);
+    if (overrides.empty())
+        return sdp;
+
+    // Lines keep their "\r\n" or "\n" endings.
+    std::vector<std::string> lines;
+    size_t pos = 0;
+    while (pos < sdp.size()) {
+        size_t end = sdp.find('\n', pos);
+        end = end == std::string::npos ? sdp.size() : end + 1;
+        lines.push_back(sdp.substr(pos, end - pos));
+        pos = end;
+    }
+
+    std::set<int> opus;
+    std::set<int> with_fmtp;
+    for (const std::string& line : lines) {
+        int payload_type = -1;
+        if (IsOpusRtpmap(line, &payload_type))
+            opus.insert(payload_type);
+        else if ((payload_type = PayloadType(line, kFmtp, kFmtpLength)) != -1)
+            with_fmtp.insert(payload_type);
+    }
+    if (opus.empty())
+        return sdp;
+
+    std::string result;
+    result.reserve(sdp.size() + 128);
+    for (const std::string& line : lines) {
+        int payload_type = -1;
+        size_t content = line.find_last_not_of("\r\n") + 1;
+        std::string ending = line.substr(content);
+        if (IsOpusRtpmap(line, &payload_type)) {
+            result += line;
+            if (with_fmtp.count(payload_type) == 0) {
+                result += kFmtp + std::to_string(payload_type) + ' ' +
+                        MergeFmtp("", overrides) + (ending.empty() ? "\r\n" : ending);
+            }
+        } else if ((payload_type = PayloadType(line, kFmtp, kFmtpLength)) != -1 &&
+                   opus.count(payload_type) != 0) {
+            size_t space = line.find(' ', kFmtpLength);
+            result += line.substr(0, space + 1) +
+                    MergeFmtp(line.substr(space + 1, content - space - 1), overrides) +
+                    ending;
+        } else {
+            result += line;
+        }
+    }
+    return result;
+}
+
+bool ApplyOpusBitrate(webrtc::PeerConnectionInterface* peer_connection,
+                      absl::optional<int> bitrate_bps) {
+    bool ok = true;
+    for (const auto& sender : peer_connection->GetSenders()) {
+        if (sender->media_type() != cricket::MEDIA_TYPE_AUDIO)
+            continue;
+        webrtc::RtpParameters parameters = sender->GetParameters();
+        if (parameters.encodings.empty())
+            continue;  // Not negotiated yet; the fmtp line covers it.
+        for (auto& encoding : parameters.encodings)
+            encoding.max_bitrate_bps = bitrate_bps;
+        webrtc::RTCError error = sender->SetParameters(parameters);
+        if (!error.ok()) {
+            qDebug() << "Failed to set the audio bitrate:" << error.message();
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+rtc::scoped_refptr<webrtc::AudioEncoderFactory> CreateOpusTuningEncoderFactory(
+        rtc::scoped_refptr<webrtc::AudioEncoderFactory> factory) {
+    return new rtc::RefCountedObject<OpusTuningEncoderFactory>(std::move(factory));
+}
@@ -0,0 +1,61 @@
+#ifndef OPUSSETTINGS_H
+#define OPUSSETTINGS_H
+
+#include <string>
+
+#include "api/audio_codecs/audio_encoder_factory.h"
+#include "api/peer_connection_interface.h"
+#include "third_party/abseil-cpp/absl/types/optional.h"
+
+// Opus encoder settings for a call.  Unset fields keep WebRTC's defaults.
+//
+// Only the bitrate can be changed on a live sender (RtpSender::
+// SetParameters()).  Everything else is carried in the Opus fmtp line, so
+// it takes a negotiation to apply:
+//  - our description asks the peer to encode this way;
+//  - the peer's description is rewritten on the way in, which is what
+//    configures our own encoder.
+// Complexity has no SDP parameter.  It's passed to our encoder in a private
+// "complexity" fmtp key that only the remote-side rewrite adds, and that
+// OpusTuningEncoderFactory picks up.
+struct OpusSettings {
+    // 6000 to 510000.
+    absl::optional<int> bitrate_bps;
+    // Frame length, 10 to 120 ms.  Longer frames cost less CPU and header
+    // overhead and add latency.
+    absl::optional<int> ptime_ms;
+    // Discontinuous transmission: near-silent frames aren't sent.
+    absl::optional<bool> dtx;
+    // In-band forward error correction.
+    absl::optional<bool> fec;
+    // 0 (cheapest) to 10.
+    absl::optional<int> complexity;
+    absl::optional<bool> stereo;
+
+    bool empty() const;
+    // True if switching from |other| changes anything that only SDP carries.
+    bool NeedsNegotiation(const OpusSettings& other) const;
+};
+
+// Parses "bitrate=24000,ptime=40,dtx=1,fec=1,complexity=5,stereo=0"; any
+// subset, in any order.  Returns false and sets |error| on unknown keys or
+// out-of-range values.
+bool ParseOpusSettings(const std::string& spec, OpusSettings* settings,
+                       std::string* error);
+
+// Rewrites the fmtp line of every Opus payload type in |sdp|, adding one if
+// there is none.  |local| selects which of the parameters described above
+// apply.  Returns |sdp| unchanged if there's no Opus in it.
+std::string ApplyOpusSettingsToSdp(const std::string& sdp,
+                                   const OpusSettings& settings, bool local);
+
+// Sets (or with nullopt, clears) the bitrate cap of every audio sender of
+// |peer_connection| in place.
+bool ApplyOpusBitrate(webrtc::PeerConnectionInterface* peer_connection,
+                      absl::optional<int> bitrate_bps);
+
+// Wraps |factory| so that Opus encoders honour the "complexity" key.
+rtc::scoped_refptr<webrtc::AudioEncoderFactory> CreateOpusTuningEncoderFactory(
+        rtc::scoped_refptr<webrtc::AudioEncoderFactory> factory);
+
+#endif // OPUSSETTINGS_H
@@ -0,0 +1,83 @@
+#include "tests.h"
+
+#include <string>
+
+#include "opussettings.h"
+
+namespace {
+
+const char kOffer[] =
+        "v=0\r\n"
+        "m=audio 9 UDP/TLS/RTP/SAVPF 111 103 0\r\n"
+        "a=rtpmap:111 opus/48000/2\r\n"
+        "a=fmtp:111 minptime=10;useinbandfec=1\r\n"
+        "a=rtpmap:103 ISAC/16000\r\n"
+        "a=rtpmap:0 PCMU/8000\r\n";
+
+}  // namespace
+
+TEST(OpusSettingsParse) {
+    OpusSettings settings;
+    std::string error;
+    ASSERT_TRUE(ParseOpusSettings("bitrate=24000,ptime=40,dtx=1,fec=0,complexity=5,stereo=0",
+                                  &settings, &error));
+    EXPECT_EQ(*settings.bitrate_bps, 24000);
+    EXPECT_EQ(*settings.ptime_ms, 40);
+    EXPECT_TRUE(*settings.dtx);
+    EXPECT_TRUE(!*settings.fec);
+    EXPECT_EQ(*settings.complexity, 5);
+    EXPECT_TRUE(!*settings.stereo);
+
+    ASSERT_TRUE(ParseOpusSettings("", &settings, &error));
+    EXPECT_TRUE(settings.empty());
+
+    EXPECT_TRUE(!ParseOpusSettings("bitrate=1000", &settings, &error));
+    EXPECT_TRUE(!ParseOpusSettings("ptime=40ms", &settings, &error));
+    EXPECT_TRUE(!ParseOpusSettings("dtx=2", &settings, &error));
+    EXPECT_TRUE(!ParseOpusSettings("volume=11", &settings, &error));
+    EXPECT_EQ(error, std::string("unknown Opus setting volume"));
+}
+
+TEST(OpusSettingsNeedsNegotiation) {
+    OpusSettings before;
+    OpusSettings after;
+    after.bitrate_bps = 32000;
+    // The bitrate goes through RtpSender::SetParameters().
+    EXPECT_TRUE(!after.NeedsNegotiation(before));
+    after.dtx = true;
+    EXPECT_TRUE(after.NeedsNegotiation(before));
+}
+
+// Our description asks the peer for these settings, without the private
+// complexity key.
+TEST(OpusSettingsLocalSdp) {
+    OpusSettings settings;
+    settings.ptime_ms = 20;
+    settings.dtx = true;
+    settings.fec = false;
+    settings.complexity = 3;
+    std::string sdp = ApplyOpusSettingsToSdp(kOffer, settings, true);
+    EXPECT_TRUE(sdp.find("a=fmtp:111 minptime=10;useinbandfec=0;ptime=20;usedtx=1\r\n") !=
+                std::string::npos);
+    EXPECT_TRUE(sdp.find("complexity") == std::string::npos);
+    // Other codecs are left alone.
+    EXPECT_TRUE(sdp.find("a=fmtp:103") == std::string::npos);
+    EXPECT_EQ(sdp.size() - sdp.find("a=rtpmap:103"),
+              std::string(kOffer).size() - std::string(kOffer).find("a=rtpmap:103"));
+}
+
+// The peer's description configures our encoder, complexity included, and
+// gets an fmtp line if it had none.
+TEST(OpusSettingsRemoteSdp) {
+    std::string offer = "m=audio 9 RTP/AVP 96\na=rtpmap:96 OPUS/48000/2\n";
+    OpusSettings settings;
+    settings.complexity = 3;
+    settings.stereo = true;
+    EXPECT_EQ(ApplyOpusSettingsToSdp(offer, settings, false),
+              offer + "a=fmtp:96 stereo=1;sprop-stereo=1;complexity=3\n");
+
+    // Nothing to change without Opus, or without settings.
+    std::string pcmu = "m=audio 9 RTP/AVP 0\r\na=rtpmap:0 PCMU/8000\r\n";
+    EXPECT_EQ(ApplyOpusSettingsToSdp(pcmu, settings, false), pcmu);
+    EXPECT_EQ(ApplyOpusSettingsToSdp(kOffer, OpusSettings(), false), std::string(kOffer));
+}
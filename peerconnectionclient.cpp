@@ -1,11 +1,14 @@
 #include "peerconnectionclient.h"
 #include "defaults.h"
+#include "tracer.h"
+#include <algorithm>
 #include <QDebug>
 
 #include "rtc_base/checks.h"
 #include "rtc_base/logging.h"
 #include "rtc_base/net_helpers.h"
 #include "rtc_base/socket.h"
+#include "rtc_base/time_utils.h"
 
 #ifdef WIN32
 #include "rtc_base/win32_socket_server.h"
@@ -17,6 +20,20 @@ namespace {
 const char kByeMessage[] = "BYE";
 // Delay between server connection retries, in milliseconds
 const int kReconnectDelay = 2000;
+// Head start each address gets before the next one is tried too; RFC 8305
+// recommends 250 ms.
+const int kConnectAttemptDelayMs = 250;
+// rtc::Message ids.
+const uint32_t kRetryConnectMessage = 0;
+const uint32_t kNextAttemptMessage = 1;
+
+// atoi() for views that aren't NUL terminated.
+int ParseInt(absl::string_view value) {
+    int result = 0;
+    for (size_t i = 0; i < value.size() && value[i] >= '0' && value[i] <= '9'; ++i)
+        result = result * 10 + (value[i] - '0');
+    return result;
+}
 
 rtc::AsyncSocket* CreateClientSocket(int family) {
 #ifdef WIN32
@@ -34,9 +51,13 @@ rtc::AsyncSocket* CreateClientSocket(int family) {
 }  // namespace
 
 PeerConnectionClient::PeerConnectionClient(QObject *parent)
-    : callback_(NULL), resolver_(NULL), state_(NOT_CONNECTED), my_id_(-1) {}
+    : callback_(NULL), next_attempt_(0), racing_(false), transport_rejected_(false),
+      state_(NOT_CONNECTED), my_id_(-1), keep_alive_(false),
+      connect_start_ms_(0), sign_in_time_ms_(-1) {}
 
-PeerConnectionClient::~PeerConnectionClient() {}
+PeerConnectionClient::~PeerConnectionClient() {
+    DnsCache::Instance()->Cancel(this);
+}
 
 void PeerConnectionClient::InitSocketSignals()
 {
@@ -58,6 +79,10 @@ bool PeerConnectionClient::is_connected() const {
     return my_id_ != -1;
 }
 
+int64_t PeerConnectionClient::sign_in_time_ms() const {
+    return sign_in_time_ms_;
+}
+
 const Peers& PeerConnectionClient::peers() const {
   return peers_;
 }
@@ -67,6 +92,27 @@ void PeerConnectionClient::RegisterObserver(PeerConnectionClientObserver* callba
     callback_ = callback;
 }
 
+void PeerConnectionClient::set_keep_alive(bool keep_alive) {
+    RTC_DCHECK(state_ == NOT_CONNECTED);
+    keep_alive_ = keep_alive;
+}
+
+bool PeerConnectionClient::keep_alive() const {
+    return keep_alive_;
+}
+
+void PeerConnectionClient::SetTransport(std::unique_ptr<SignalingTransport> transport) {
+    RTC_DCHECK(state_ == NOT_CONNECTED);
+    transport_ = std::move(transport);
+    transport_rejected_ = false;
+    if (transport_)
+        transport_->RegisterObserver(this);
+}
+
+bool PeerConnectionClient::UsingTransport() const {
+    return transport_ && !transport_rejected_;
+}
+
 void PeerConnectionClient::Connect(const std::string& server, int port, const std::string& client_name) {
     RTC_DCHECK(!server.empty());
     RTC_DCHECK(!client_name.empty());
@@ -87,41 +133,70 @@ void PeerConnectionClient::Connect(const std::string& server, int port, const st
 
     server_address_.SetIP(server);
     server_address_.SetPort(port);
+    server_hostname_ = server_address_.IsUnresolvedIP() ? server : std::string();
+    server_addresses_.assign(1, server_address_);
     client_name_ = client_name;
+    connect_start_ms_ = rtc::TimeMillis();
+    sign_in_time_ms_ = -1;
 
-    if (server_address_.IsUnresolvedIP()) {
-        state_ = RESOLVING;
-        resolver_ = new rtc::AsyncResolver();
-        resolver_->SignalDone.connect(this, &PeerConnectionClient::OnResolveResult);
-        resolver_->Start(server_address_);
-    } else {
+    ResolveAndConnect();
+}
+
+void PeerConnectionClient::ResolveAndConnect() {
+    if (server_hostname_.empty()) {
         DoConnect();
+        return;
+    }
+    std::vector<rtc::IPAddress> addresses;
+    if (DnsCache::Instance()->Lookup(server_hostname_, &addresses)) {
+        OnHostResolved(server_hostname_, addresses);
+        return;
     }
+    state_ = RESOLVING;
+    DnsCache::Instance()->Resolve(server_hostname_, this);
 }
 
-
-// todo
-void PeerConnectionClient::OnResolveResult(rtc::AsyncResolverInterface* resolver) {
-    if (resolver_->GetError() != 0) {
-        callback_->OnServerConnectionFailure();
-        resolver_->Destroy(false);
-        resolver_ = NULL;
+void PeerConnectionClient::OnHostResolved(const std::string& hostname,
+                                          const std::vector<rtc::IPAddress>& addresses) {
+    if (addresses.empty()) {
         state_ = NOT_CONNECTED;
-    } else {
-        server_address_ = resolver->address();
-        DoConnect();
+        callback_->OnServerConnectionFailure();
+        return;
     }
+    server_addresses_.clear();
+    for (const rtc::IPAddress& address : addresses) {
+        // Keeps the name, so requests still say Host: <hostname>.
+        rtc::SocketAddress resolved(hostname, server_address_.port());
+        resolved.SetResolvedIP(address);
+        server_addresses_.push_back(resolved);
+    }
+    server_address_ = server_addresses_.front();
+    DoConnect();
 }
 
 void PeerConnectionClient::DoConnect() {
+    if (UsingTransport()) {
+        if (transport_->SignIn(server_address_, client_name_)) {
+            state_ = SIGNING_IN;
+        } else {
+            state_ = NOT_CONNECTED;
+            callback_->OnServerConnectionFailure();
+        }
+        return;
+    }
+
+    if (server_addresses_.size() > 1) {
+        state_ = SIGNING_IN;
+        StartConnectRace();
+        return;
+    }
+
     control_socket_.reset(CreateClientSocket(server_address_.ipaddr().family()));
-    hanging_get_.reset(CreateClientSocket(server_address_.ipaddr().family()));
-    InitSocketSignals();
-    char buffer[1024];
-    snprintf(buffer, sizeof(buffer), "GET /sign_in?%s HTTP/1.0\r\n\r\n", client_name_.c_str());
-    onconnect_data_ = buffer;
+    PrepareSignIn();
 
-    bool ret = ConnectControlSocket();
+    // Signing in twice would leave a second peer with our name behind.
+    bool ret = SendControlRequest(
+                FormatControlRequest("GET", "/sign_in?" + client_name_, ""), -1, false);
     if (ret)
         state_ = SIGNING_IN;
     if (!ret) {
@@ -129,25 +204,117 @@ void PeerConnectionClient::DoConnect() {
     }
 }
 
+void PeerConnectionClient::PrepareSignIn() {
+    hanging_get_.reset(CreateClientSocket(server_address_.ipaddr().family()));
+    InitSocketSignals();
+    in_flight_requests_.clear();
+    control_response_.Reset();
+    notification_response_.Reset();
+}
+
+void PeerConnectionClient::StartConnectRace() {
+    StopConnectRace();
+    attempts_.clear();
+    for (const rtc::SocketAddress& address : server_addresses_) {
+        ConnectAttempt attempt;
+        attempt.address = address;
+        attempts_.push_back(std::move(attempt));
+    }
+    next_attempt_ = 0;
+    racing_ = true;
+    StartNextAttempt();
+}
+
+void PeerConnectionClient::StartNextAttempt() {
+    rtc::Thread::Current()->Clear(this, kNextAttemptMessage);
+    // Addresses that fail straight away (no route for the family, say)
+    // don't hold up the next one.
+    while (next_attempt_ < attempts_.size()) {
+        ConnectAttempt& attempt = attempts_[next_attempt_++];
+        attempt.socket.reset(CreateClientSocket(attempt.address.family()));
+        attempt.socket->SignalConnectEvent.connect(this, &PeerConnectionClient::OnAttemptConnect);
+        attempt.socket->SignalCloseEvent.connect(this, &PeerConnectionClient::OnAttemptClose);
+        if (attempt.socket->Connect(attempt.address) != SOCKET_ERROR) {
+            if (next_attempt_ < attempts_.size()) {
+                rtc::Thread::Current()->PostDelayed(RTC_FROM_HERE, kConnectAttemptDelayMs,
+                                                    this, kNextAttemptMessage);
+            }
+            return;
+        }
+        attempt.socket->Close();
+    }
+    for (const ConnectAttempt& attempt : attempts_) {
+        if (attempt.socket && attempt.socket->GetState() == rtc::Socket::CS_CONNECTING)
+            return;  // Still waiting for one.
+    }
+
+    // Every address failed.  The name may point somewhere else by now.
+    StopConnectRace();
+    if (!server_hostname_.empty())
+        DnsCache::Instance()->Invalidate(server_hostname_);
+    qDebug() << "Can't reach the server; retrying in 2 seconds";
+    rtc::Thread::Current()->PostDelayed(RTC_FROM_HERE, kReconnectDelay, this,
+                                        kRetryConnectMessage);
+}
+
+void PeerConnectionClient::OnAttemptConnect(rtc::AsyncSocket* socket) {
+    auto winner = std::find_if(attempts_.begin(), attempts_.end(),
+                               [socket](const ConnectAttempt& attempt) {
+                                   return attempt.socket.get() == socket;
+                               });
+    RTC_DCHECK(winner != attempts_.end());
+    socket->SignalConnectEvent.disconnect(this);
+    socket->SignalCloseEvent.disconnect(this);
+    server_address_ = winner->address;
+    control_socket_ = std::move(winner->socket);
+    StopConnectRace();
+    if (!server_hostname_.empty())
+        DnsCache::Instance()->SetPreferredFamily(server_hostname_, server_address_.family());
+    TRACE_INSTANT("SignalingAddressFamily", server_address_.family());
+
+    PrepareSignIn();
+    std::string request = FormatControlRequest("GET", "/sign_in?" + client_name_, "");
+    if (keep_alive_)
+        in_flight_requests_.push_back(ControlRequest(request, -1, false));
+    else
+        onconnect_data_ = request;
+    // Already connected; send as the connect event would have.
+    OnConnect(control_socket_.get());
+}
+
+void PeerConnectionClient::OnAttemptClose(rtc::AsyncSocket* socket, int err) {
+    qDebug() << "Connecting to the server failed:" << err;
+    socket->Close();
+    if (racing_)
+        StartNextAttempt();
+}
+
+void PeerConnectionClient::StopConnectRace() {
+    rtc::Thread::Current()->Clear(this, kNextAttemptMessage);
+    for (ConnectAttempt& attempt : attempts_) {
+        if (attempt.socket)
+            attempt.socket->Close();
+    }
+    racing_ = false;
+}
+
 bool PeerConnectionClient::SendToPeer(int peer_id, const std::string& message) {
     if (state_ != CONNECTED)
         return false;
 
     RTC_DCHECK(is_connected());
-    RTC_DCHECK(control_socket_->GetState() == rtc::Socket::CS_CLOSED);
+    if (UsingTransport())
+        return peer_id != -1 && transport_->Send(peer_id, message);
+
+    RTC_DCHECK(keep_alive_ ||
+               control_socket_->GetState() == rtc::Socket::CS_CLOSED);
     if (!is_connected() || peer_id == -1)
         return false;
 
-    char headers[1024];
-    snprintf(headers, sizeof(headers),
-             "POST /message?peer_id=%i&to=%i HTTP/1.0\r\n"
-             "Content-Length: %zu\r\n"
-             "Content-Type: text/plain\r\n"
-             "\r\n",
-             my_id_, peer_id, message.length());
-    onconnect_data_ = headers;
-    onconnect_data_ += message;
-    return ConnectControlSocket();
+    char target[64];
+    snprintf(target, sizeof(target), "/message?peer_id=%i&to=%i", my_id_,
+             peer_id);
+    return SendControlRequest(FormatControlRequest("POST", target, message), peer_id, false);
 }
 
 bool PeerConnectionClient::SendHangUp(int peer_id) {
@@ -155,8 +322,16 @@ bool PeerConnectionClient::SendHangUp(int peer_id) {
 }
 
 bool PeerConnectionClient::IsSendingMessage() {
-    return state_ == CONNECTED &&
-            control_socket_->GetState() != rtc::Socket::CS_CLOSED;
+    // A transport writes messages straight onto its connection.
+    return state_ == CONNECTED && !UsingTransport() && !IsControlIdle();
+}
+
+size_t PeerConnectionClient::MessagesInFlight() const {
+    if (state_ != CONNECTED || UsingTransport())
+        return 0;
+    if (keep_alive_)
+        return in_flight_requests_.size();
+    return IsControlIdle() ? 0 : 1;
 }
 
 bool PeerConnectionClient::SignOut()
@@ -164,17 +339,31 @@ bool PeerConnectionClient::SignOut()
     if (state_ == NOT_CONNECTED || state_ == SIGNING_OUT)
         return true;
 
+    if (state_ == RESOLVING || racing_) {
+        // Nothing sent to the server yet.
+        Close();
+        return true;
+    }
+
+    if (UsingTransport()) {
+        state_ = SIGNING_OUT;
+        if (!transport_->SignOut()) {
+            // Never got far enough to sign in.
+            Close();
+        }
+        return true;
+    }
+
     if (hanging_get_->GetState() != rtc::Socket::CS_CLOSED)
         hanging_get_->Close();
 
-    if (control_socket_->GetState() == rtc::Socket::CS_CLOSED) {
+    if (IsControlIdle()) {
         state_ = SIGNING_OUT;
 
         if (my_id_ != -1) {
-            char buffer[1024];
-            snprintf(buffer, sizeof(buffer), "GET /sign_out?peer_id=%i HTTP/1.0\r\n\r\n", my_id_);
-            onconnect_data_ = buffer;
-            return ConnectControlSocket();
+            char target[64];
+            snprintf(target, sizeof(target), "/sign_out?peer_id=%i", my_id_);
+            return SendControlRequest(FormatControlRequest("GET", target, ""), -1, true);
         } else {
             // Can occur if the app is closed before we finish connecting.
             return true;
@@ -187,14 +376,19 @@ bool PeerConnectionClient::SignOut()
 }
 
 void PeerConnectionClient::Close() {
-    control_socket_->Close();
-    hanging_get_->Close();
+    if (control_socket_)
+        control_socket_->Close();
+    if (hanging_get_)
+        hanging_get_->Close();
+    if (transport_)
+        transport_->Close();
     onconnect_data_.clear();
-    peers_.clear();
-    if (resolver_ != NULL) {
-        resolver_->Destroy(false);
-        resolver_ = NULL;
-    }
+    in_flight_requests_.clear();
+    control_response_.Reset();
+    notification_response_.Reset();
+    peers_.Clear();
+    DnsCache::Instance()->Cancel(this);
+    StopConnectRace();
     my_id_ = -1;
     state_ = NOT_CONNECTED;
 }
@@ -209,7 +403,91 @@ bool PeerConnectionClient::ConnectControlSocket() {
     return true;
 }
 
+bool PeerConnectionClient::SendControlRequest(const std::string& request, int peer_id,
+                                              bool idempotent) {
+    if (!keep_alive_) {
+        onconnect_data_ = request;
+        return ConnectControlSocket();
+    }
+
+    in_flight_requests_.push_back(ControlRequest(request, peer_id, idempotent));
+    switch (control_socket_->GetState()) {
+    case rtc::Socket::CS_CONNECTED: {
+        size_t sent = control_socket_->Send(request.c_str(), request.length());
+        RTC_DCHECK(sent == request.length());
+        in_flight_requests_.back().sent = true;
+        return true;
+    }
+    case rtc::Socket::CS_CONNECTING:
+        // Goes out with the rest of |in_flight_requests_| in OnConnect().
+        return true;
+    default:
+        return ConnectControlSocket();
+    }
+}
+
+bool PeerConnectionClient::IsControlIdle() const {
+    if (keep_alive_)
+        return in_flight_requests_.empty();
+    return control_socket_->GetState() == rtc::Socket::CS_CLOSED;
+}
+
+std::string PeerConnectionClient::FormatControlRequest(const char* method, const std::string& target, const std::string& body) const {
+    std::string request = method;
+    request += ' ';
+    request += target;
+    if (keep_alive_) {
+        request += " HTTP/1.1\r\nHost: ";
+        request += server_address_.HostAsURIString();
+        request += "\r\n";
+    } else {
+        request += " HTTP/1.0\r\n";
+    }
+    if (!body.empty()) {
+        char headers[128];
+        snprintf(headers, sizeof(headers),
+                 "Content-Length: %zu\r\n"
+                 "Content-Type: text/plain\r\n",
+                 body.length());
+        request += headers;
+    }
+    request += "\r\n";
+    request += body;
+    return request;
+}
+
 void PeerConnectionClient::OnConnect(rtc::AsyncSocket* socket) {
+    if (keep_alive_) {
+        // Fresh connection or a reconnect after the server closed the old one.
+        // What went out on the old one may have been acted on although no
+        // answer came, so only idempotent requests are repeated; the rest
+        // are failed back to the observer.
+        std::vector<int> failed_peers;
+        bool sign_in_failed = false;
+        auto it = in_flight_requests_.begin();
+        while (it != in_flight_requests_.end()) {
+            if (it->sent && !it->idempotent) {
+                if (it->peer_id != -1)
+                    failed_peers.push_back(it->peer_id);
+                else
+                    sign_in_failed = true;
+                it = in_flight_requests_.erase(it);
+                continue;
+            }
+            size_t sent = socket->Send(it->data.c_str(), it->data.length());
+            RTC_DCHECK(sent == it->data.length());
+            it->sent = true;
+            ++it;
+        }
+        if (sign_in_failed) {
+            Close();
+            callback_->OnServerConnectionFailure();
+            return;
+        }
+        for (int peer_id : failed_peers)
+            callback_->OnMessageFailed(peer_id);
+        return;
+    }
     RTC_DCHECK(!onconnect_data_.empty());
     size_t sent = socket->Send(onconnect_data_.c_str(), onconnect_data_.length());
     RTC_DCHECK(sent == onconnect_data_.length());
@@ -234,109 +512,71 @@ void PeerConnectionClient::OnMessageFromPeer(int peer_id, const std::string& mes
     }
 }
 
-bool PeerConnectionClient::GetHeaderValue(const std::string& data, size_t eoh, const char* header_pattern, size_t* value) {
-    RTC_DCHECK(value != NULL);
-    size_t found = data.find(header_pattern);
-    if (found != std::string::npos && found < eoh) {
-        *value = atoi(&data[found + strlen(header_pattern)]);
-        return true;
-    }
-    return false;
-}
+bool PeerConnectionClient::ReadIntoBuffer(rtc::AsyncSocket* socket, HttpResponseParser* response) {
+    response->ReadFrom(socket);
 
-bool PeerConnectionClient::GetHeaderValue(const std::string& data, size_t eoh, const char* header_pattern, std::string* value) {
-    RTC_DCHECK(value != NULL);
-    size_t found = data.find(header_pattern);
-    if (found != std::string::npos && found < eoh) {
-        size_t begin = found + strlen(header_pattern);
-        size_t end = data.find("\r\n", begin);
-        if (end == std::string::npos)
-            end = eoh;
-        value->assign(data.substr(begin, end - begin));
-        return true;
+    switch (response->Parse()) {
+    case HttpResponseParser::NEED_MORE_DATA:
+        // We haven't received everything.  Just continue to accept data.
+        return false;
+    case HttpResponseParser::PARSE_ERROR:
+        qDebug() << "No content length field specified by the server.";
+        response->Reset();
+        return false;
+    case HttpResponseParser::COMPLETE:
+        break;
     }
-    return false;
-}
 
-bool PeerConnectionClient::ReadIntoBuffer(rtc::AsyncSocket* socket, std::string* data, size_t* content_length) {
-    char buffer[0xffff];
-    do {
-        int bytes = socket->Recv(buffer, sizeof(buffer), nullptr);
-        if (bytes <= 0)
-            break;
-        data->append(buffer, bytes);
-    } while (true);
-
-    bool ret = false;
-    size_t i = data->find("\r\n\r\n");
-    if (i != std::string::npos) {
-        qDebug() << "Headers received";
-        if (GetHeaderValue(*data, i, "\r\nContent-Length: ", content_length)) {
-            size_t total_response_size = (i + 4) + *content_length;
-            if (data->length() >= total_response_size) {
-                ret = true;
-                std::string should_close;
-                const char kConnection[] = "\r\nConnection: ";
-                if (GetHeaderValue(*data, i, kConnection, &should_close) &&
-                        should_close.compare("close") == 0) {
-                    socket->Close();
-                    // Since we closed the socket, there was no notification delivered
-                    // to us.  Compensate by letting ourselves know.
-                    OnClose(socket, 0);
-                }
-            } else {
-                // We haven't received everything.  Just continue to accept data.
-            }
-        } else {
-            qDebug() << "No content length field specified by the server.";
-        }
+    if (response->connection_close()) {
+        socket->Close();
+        // Since we closed the socket, there was no notification delivered
+        // to us.  Compensate by letting ourselves know.  A persistent
+        // control connection is reopened by OnRead() instead, once the
+        // answered request has been dropped from the in-flight list.
+        if (!keep_alive_ || socket != control_socket_.get())
+            OnClose(socket, 0);
     }
-    return ret;
+    return true;
 }
 
 void PeerConnectionClient::OnRead(rtc::AsyncSocket* socket) {
-    size_t content_length = 0;
-    if (ReadIntoBuffer(socket, &control_data_, &content_length)) {
-        size_t peer_id = 0, eoh = 0;
-        bool ok =
-                ParseServerResponse(control_data_, content_length, &peer_id, &eoh);
-        if (ok) {
-            if (my_id_ == -1) {
-                // First response.  Let's store our server assigned ID.
-                RTC_DCHECK(state_ == SIGNING_IN);
-                my_id_ = static_cast<int>(peer_id);
-                RTC_DCHECK(my_id_ != -1);
-
-                // The body of the response will be a list of already connected peers.
-                if (content_length) {
-                    size_t pos = eoh + 4;
-                    while (pos < control_data_.size()) {
-                        size_t eol = control_data_.find('\n', pos);
-                        if (eol == std::string::npos)
-                            break;
-                        int id = 0;
-                        std::string name;
-                        bool connected;
-                        if (ParseEntry(control_data_.substr(pos, eol - pos), &name, &id,
-                                       &connected) &&
-                                id != my_id_) {
-                            peers_[id] = name;
-                            callback_->OnPeerConnected(id, name);
-                        }
-                        pos = eol + 1;
-                    }
-                }
-                RTC_DCHECK(is_connected());
-                callback_->OnSignedIn();
-            } else if (state_ == SIGNING_OUT) {
-                Close();
-                callback_->OnDisconnected();
-            } else if (state_ == SIGNING_OUT_WAITING) {
-                SignOut();
-            }
+    // In keep-alive mode several responses may arrive back-to-back, so keep
+    // going until the buffer no longer holds a complete one.
+    while (ReadIntoBuffer(socket, &control_response_)) {
+        int peer_id = -1;
+        if (!ParseServerResponse(control_response_, &peer_id))
+            return;
+
+        if (keep_alive_) {
+            RTC_DCHECK(!in_flight_requests_.empty());
+            if (!in_flight_requests_.empty())
+                in_flight_requests_.pop_front();
         }
 
-        control_data_.clear();
+        if (my_id_ == -1) {
+            // First response.  Let's store our server assigned ID.
+            RTC_DCHECK(state_ == SIGNING_IN);
+            my_id_ = peer_id;
+            RTC_DCHECK(my_id_ != -1);
+
+            // The body of the response will be a list of already connected peers.
+            AddPeers(control_response_.body());
+            RTC_DCHECK(is_connected());
+            sign_in_time_ms_ = rtc::TimeMillis() - connect_start_ms_;
+            callback_->OnSignedIn();
+        } else if (state_ == SIGNING_OUT) {
+            Close();
+            callback_->OnDisconnected();
+            return;
+        } else if (state_ == SIGNING_OUT_WAITING) {
+            SignOut();
+        } else if (keep_alive_) {
+            // The connection stays open, so there's no close event to report
+            // the completed send for us.
+            callback_->OnMessageSent(0);
+        }
+
+        control_response_.Consume();
 
         if (state_ == SIGNING_IN) {
             RTC_DCHECK(hanging_get_->GetState() == rtc::Socket::CS_CLOSED);
@@ -344,43 +584,29 @@ void PeerConnectionClient::OnRead(rtc::AsyncSocket* socket) {
             hanging_get_->Connect(server_address_);
         }
     }
+
+    if (keep_alive_ && !in_flight_requests_.empty() &&
+            control_socket_->GetState() == rtc::Socket::CS_CLOSED) {
+        // The server closed the connection with requests still unanswered.
+        ConnectControlSocket();
+    }
 }
 
 void PeerConnectionClient::OnHangingGetRead(rtc::AsyncSocket* socket) {
-    qDebug() << __FUNCTION__;
-    size_t content_length = 0;
-    if (ReadIntoBuffer(socket, &notification_data_, &content_length)) {
-        size_t peer_id = 0, eoh = 0;
-        bool ok =
-                ParseServerResponse(notification_data_, content_length, &peer_id, &eoh);
-
-        if (ok) {
-            // Store the position where the body begins.
-            size_t pos = eoh + 4;
-
-            if (my_id_ == static_cast<int>(peer_id)) {
+    TRACE_SCOPE("OnHangingGetRead");
+    if (ReadIntoBuffer(socket, &notification_response_)) {
+        int peer_id = -1;
+        if (ParseServerResponse(notification_response_, &peer_id)) {
+            absl::string_view body = notification_response_.body();
+            if (my_id_ == peer_id) {
                 // A notification about a new member or a member that just
                 // disconnected.
-                int id = 0;
-                std::string name;
-                bool connected = false;
-                if (ParseEntry(notification_data_.substr(pos), &name, &id,
-                               &connected)) {
-                    if (connected) {
-                        peers_[id] = name;
-                        callback_->OnPeerConnected(id, name);
-                    } else {
-                        peers_.erase(id);
-                        callback_->OnPeerDisconnected(id);
-                    }
-                }
+                HandlePeerNotification(body);
             } else {
-                OnMessageFromPeer(static_cast<int>(peer_id),
-                                  notification_data_.substr(pos));
+                OnMessageFromPeer(peer_id, std::string(body.data(), body.size()));
             }
+            notification_response_.Consume();
         }
-
-        notification_data_.clear();
     }
 
     if (hanging_get_->GetState() == rtc::Socket::CS_CLOSED &&
@@ -389,7 +615,47 @@ void PeerConnectionClient::OnHangingGetRead(rtc::AsyncSocket* socket) {
     }
 }
 
-bool PeerConnectionClient::ParseEntry(const std::string& entry, std::string* name, int* id, bool* connected) {
+void PeerConnectionClient::AddPeers(absl::string_view peer_list) {
+    std::vector<int> added;
+    // One line per peer; a cheap count lets big rooms skip rehashing.
+    size_t lines = std::count(peer_list.begin(), peer_list.end(), '\n');
+    peers_.Reserve(peers_.size() + lines);
+    added.reserve(lines);
+
+    size_t pos = 0;
+    while (pos < peer_list.size()) {
+        size_t eol = peer_list.find('\n', pos);
+        if (eol == absl::string_view::npos)
+            break;
+        int id = 0;
+        std::string name;
+        bool connected;
+        if (ParseEntry(peer_list.substr(pos, eol - pos), &name, &id, &connected) &&
+                id != my_id_) {
+            if (peers_.Add(id, std::move(name)))
+                added.push_back(id);
+        }
+        pos = eol + 1;
+    }
+    if (!added.empty())
+        callback_->OnPeersConnected(added);
+}
+
+void PeerConnectionClient::HandlePeerNotification(absl::string_view entry) {
+    int id = 0;
+    std::string name;
+    bool connected = false;
+    if (entry.empty() || !ParseEntry(entry, &name, &id, &connected))
+        return;
+    if (connected) {
+        peers_.Add(id, name);
+        callback_->OnPeerConnected(id, name);
+    } else if (peers_.Remove(id)) {
+        callback_->OnPeerDisconnected(id);
+    }
+}
+
+bool PeerConnectionClient::ParseEntry(absl::string_view entry, std::string* name, int* id, bool* connected) {
     RTC_DCHECK(name != NULL);
     RTC_DCHECK(id != NULL);
     RTC_DCHECK(connected != NULL);
@@ -397,44 +663,28 @@ bool PeerConnectionClient::ParseEntry(const std::string& entry, std::string* nam
 
     *connected = false;
     size_t separator = entry.find(',');
-    if (separator != std::string::npos) {
-        *id = atoi(&entry[separator + 1]);
-        name->assign(entry.substr(0, separator));
+    if (separator != absl::string_view::npos) {
+        *id = ParseInt(entry.substr(separator + 1));
+        name->assign(entry.data(), separator);
         separator = entry.find(',', separator + 1);
-        if (separator != std::string::npos) {
-            *connected = atoi(&entry[separator + 1]) ? true : false;
+        if (separator != absl::string_view::npos) {
+            *connected = ParseInt(entry.substr(separator + 1)) ? true : false;
         }
     }
     return !name->empty();
 }
 
-int PeerConnectionClient::GetResponseStatus(const std::string& response) {
-    int status = -1;
-    size_t pos = response.find(' ');
-    if (pos != std::string::npos)
-        status = atoi(&response[pos + 1]);
-    return status;
-}
-
-bool PeerConnectionClient::ParseServerResponse(const std::string& response, size_t content_length, size_t* peer_id, size_t* eoh) {
-    int status = GetResponseStatus(response.c_str());
-    if (status != 200) {
+bool PeerConnectionClient::ParseServerResponse(const HttpResponseParser& response, int* peer_id) {
+    if (response.status() != 200) {
         qDebug() << "Received error from server";
         Close();
         callback_->OnDisconnected();
         return false;
     }
 
-    *eoh = response.find("\r\n\r\n");
-    RTC_DCHECK(*eoh != std::string::npos);
-    if (*eoh == std::string::npos)
-        return false;
-
-    *peer_id = -1;
-
     // See comment in peer_channel.cc for why we use the Pragma header and
     // not e.g. "X-Peer-Id".
-    GetHeaderValue(response, *eoh, "\r\nPragma: ", peer_id);
+    *peer_id = response.pragma();
 
     return true;
 }
@@ -454,6 +704,12 @@ void PeerConnectionClient::OnClose(rtc::AsyncSocket* socket, int err) {
                 hanging_get_->Close();
                 hanging_get_->Connect(server_address_);
             }
+        } else if (keep_alive_) {
+            // The server dropped the persistent connection.  Reconnect right
+            // away if requests are outstanding; otherwise the next
+            // SendControlRequest() will.
+            if (!in_flight_requests_.empty() && state_ != NOT_CONNECTED)
+                ConnectControlSocket();
         } else {
             callback_->OnMessageSent(err);
         }
@@ -461,7 +717,7 @@ void PeerConnectionClient::OnClose(rtc::AsyncSocket* socket, int err) {
         if (socket == control_socket_.get()) {
             qDebug() << "Connection refused; retrying in 2 seconds";
             rtc::Thread::Current()->PostDelayed(RTC_FROM_HERE, kReconnectDelay, this,
-                                                0);
+                                                kRetryConnectMessage);
         } else {
             Close();
             callback_->OnDisconnected();
@@ -470,6 +726,44 @@ void PeerConnectionClient::OnClose(rtc::AsyncSocket* socket, int err) {
 }
 
 void PeerConnectionClient::OnMessage(rtc::Message* msg) {
-    // ignore msg; there is currently only one supported message ("retry")
+    if (msg->message_id == kNextAttemptMessage) {
+        StartNextAttempt();
+        return;
+    }
+    // Retry; the cache skips DNS unless the addresses went stale.
+    ResolveAndConnect();
+}
+
+void PeerConnectionClient::OnTransportSignedIn(int my_id, const std::string& peer_list) {
+    RTC_DCHECK(state_ == SIGNING_IN);
+    my_id_ = my_id;
+    RTC_DCHECK(my_id_ != -1);
+    AddPeers(peer_list);
+    state_ = CONNECTED;
+    sign_in_time_ms_ = rtc::TimeMillis() - connect_start_ms_;
+    callback_->OnSignedIn();
+}
+
+void PeerConnectionClient::OnTransportPeerNotification(const std::string& entry) {
+    HandlePeerNotification(entry);
+}
+
+void PeerConnectionClient::OnTransportMessage(int peer_id, const std::string& message) {
+    OnMessageFromPeer(peer_id, message);
+}
+
+void PeerConnectionClient::OnTransportRejected() {
+    qDebug() << "Server rejected the signaling transport; falling back to hanging GET";
+    transport_rejected_ = true;
     DoConnect();
 }
+
+void PeerConnectionClient::OnTransportClosed(int err) {
+    if (state_ == SIGNING_IN) {
+        state_ = NOT_CONNECTED;
+        callback_->OnServerConnectionFailure();
+        return;
+    }
+    Close();
+    callback_->OnDisconnected();
+}
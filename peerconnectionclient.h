@@ -1,31 +1,46 @@
 #ifndef PEERCONNECTIONCLIENT_H
 #define PEERCONNECTIONCLIENT_H
+#include <stdint.h>
+#include <deque>
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 #include <QObject>
 
 #include "rtc_base/net_helpers.h"
 #include "rtc_base/physical_socket_server.h"
 #include "rtc_base/signal_thread.h"
 #include "rtc_base/third_party/sigslot/sigslot.h"
+#include "dnscache.h"
+#include "httpresponseparser.h"
+#include "peerdirectory.h"
+#include "signalingtransport.h"
+#include "third_party/abseil-cpp/absl/strings/string_view.h"
 
-typedef std::map<int, std::string> Peers;
+typedef PeerDirectory Peers;
 
 struct PeerConnectionClientObserver {
   virtual void OnSignedIn() = 0;  // Called when we're logged on.
   virtual void OnDisconnected() = 0;
+  // The peer list that came with sign-in, delivered once as a batch.
+  virtual void OnPeersConnected(const std::vector<int>& ids) = 0;
   virtual void OnPeerConnected(int id, const std::string& name) = 0;
   virtual void OnPeerDisconnected(int peer_id) = 0;
   virtual void OnMessageFromPeer(int peer_id, const std::string& message) = 0;
   virtual void OnMessageSent(int err) = 0;
+  // A message to |peer_id| went out on a keep-alive connection that closed
+  // before the server answered; it may or may not have been delivered, and
+  // isn't sent again.
+  virtual void OnMessageFailed(int peer_id) = 0;
   virtual void OnServerConnectionFailure() = 0;
 
  protected:
   virtual ~PeerConnectionClientObserver() {}
 };
 
-class PeerConnectionClient : public QObject, public sigslot::has_slots<>, public rtc::MessageHandler
+class PeerConnectionClient : public QObject, public sigslot::has_slots<>, public rtc::MessageHandler, public SignalingTransportObserver,
+                             public DnsCacheObserver
 {
     Q_OBJECT
 public:
@@ -42,10 +57,23 @@ public:
 
     int id() const;
     bool is_connected() const;
+    // Connect() to signed in, in ms; -1 until signed in.
+    int64_t sign_in_time_ms() const;
     const Peers& peers() const;
 
     void RegisterObserver(PeerConnectionClientObserver* callback);
 
+    // When enabled, control requests are sent as HTTP/1.1 over a single
+    // persistent |control_socket_| instead of one connection per request.
+    // Must be set before Connect().
+    void set_keep_alive(bool keep_alive);
+    bool keep_alive() const;
+
+    // Installs an alternative wire protocol, e.g. WebSocketTransport.  If the
+    // server rejects it during sign-in, the client falls back to the
+    // hanging-GET protocol.  Must be set before Connect().
+    void SetTransport(std::unique_ptr<SignalingTransport> transport);
+
     void Connect(const std::string& server,
                  int port,
                  const std::string& client_name);
@@ -53,70 +81,135 @@ public:
     bool SendToPeer(int peer_id, const std::string& message);
     bool SendHangUp(int peer_id);
     bool IsSendingMessage();
+    // Number of SendToPeer() requests still waiting for a server response.
+    // Can only exceed one in keep-alive mode.
+    size_t MessagesInFlight() const;
 
     bool SignOut();
 
     // implements the MessageHandler interface
     void OnMessage(rtc::Message* msg);
 
+    // implements the SignalingTransportObserver interface
+    void OnTransportSignedIn(int my_id, const std::string& peer_list) override;
+    void OnTransportPeerNotification(const std::string& entry) override;
+    void OnTransportMessage(int peer_id, const std::string& message) override;
+    void OnTransportRejected() override;
+    void OnTransportClosed(int err) override;
+
+    // implements the DnsCacheObserver interface
+    void OnHostResolved(const std::string& hostname,
+                        const std::vector<rtc::IPAddress>& addresses) override;
+
    protected:
+    // One connection attempt of the race in StartConnectRace().
+    struct ConnectAttempt {
+        rtc::SocketAddress address;
+        std::unique_ptr<rtc::AsyncSocket> socket;
+    };
+    // A request on the keep-alive |control_socket_|, kept until answered.
+    struct ControlRequest {
+        ControlRequest(const std::string& data, int peer_id, bool idempotent)
+            : data(data), peer_id(peer_id), idempotent(idempotent), sent(false) {}
+
+        std::string data;
+        // Recipient of a POST /message; -1 for sign-in and sign-out.
+        int peer_id;
+        // The server acting on it twice does no harm, so it can be sent
+        // again after a reconnect.
+        bool idempotent;
+        // Written to a connection, which may since have closed.
+        bool sent;
+    };
+
+    // Signs in to |server_hostname_|'s addresses, from DnsCache when it has
+    // them fresh, or resolving first.
+    void ResolveAndConnect();
     void DoConnect();
+    // Happy Eyeballs (RFC 8305): connects to |server_addresses_| in order,
+    // starting the next attempt whenever one fails or kConnectAttemptDelayMs
+    // pass without an answer, and signs in over whichever connects first.
+    void StartConnectRace();
+    void StartNextAttempt();
+    void OnAttemptConnect(rtc::AsyncSocket* socket);
+    void OnAttemptClose(rtc::AsyncSocket* socket, int err);
+    // Stops the attempts still running.  Sockets are only closed, since
+    // this can run inside one of their callbacks; the next race frees them.
+    void StopConnectRace();
+    // Fresh hanging-GET socket and response state for signing in over
+    // |control_socket_| to |server_address_|.
+    void PrepareSignIn();
     void Close();
     void InitSocketSignals();
     bool ConnectControlSocket();
+    // Sends |request| on the control connection, connecting first if needed.
+    // |peer_id| and |idempotent| as in ControlRequest.
+    bool SendControlRequest(const std::string& request, int peer_id, bool idempotent);
+    // Returns true if no control request is waiting for a response.
+    bool IsControlIdle() const;
+    std::string FormatControlRequest(const char* method,
+                                     const std::string& target,
+                                     const std::string& body) const;
     void OnConnect(rtc::AsyncSocket* socket);
     void OnHangingGetConnect(rtc::AsyncSocket* socket);
     void OnMessageFromPeer(int peer_id, const std::string& message);
+    // True while |transport_| carries the signaling instead of the sockets.
+    bool UsingTransport() const;
 
-    // Quick and dirty support for parsing HTTP header values.
-    bool GetHeaderValue(const std::string& data,
-                        size_t eoh,
-                        const char* header_pattern,
-                        size_t* value);
-
-    bool GetHeaderValue(const std::string& data,
-                        size_t eoh,
-                        const char* header_pattern,
-                        std::string* value);
+    // Adds the "<name>,<id>,<connected>" lines of |peer_list| to peers_ and
+    // reports them with a single OnPeersConnected().
+    void AddPeers(absl::string_view peer_list);
+    // Applies a single join/leave notification entry.
+    void HandlePeerNotification(absl::string_view entry);
 
     // Returns true if the whole response has been read.
     bool ReadIntoBuffer(rtc::AsyncSocket* socket,
-                        std::string* data,
-                        size_t* content_length);
+                        HttpResponseParser* response);
 
     void OnRead(rtc::AsyncSocket* socket);
 
     void OnHangingGetRead(rtc::AsyncSocket* socket);
 
     // Parses a single line entry in the form "<name>,<id>,<connected>"
-    bool ParseEntry(const std::string& entry,
+    bool ParseEntry(absl::string_view entry,
                     std::string* name,
                     int* id,
                     bool* connected);
 
-    int GetResponseStatus(const std::string& response);
-
-    bool ParseServerResponse(const std::string& response,
-                             size_t content_length,
-                             size_t* peer_id,
-                             size_t* eoh);
+    bool ParseServerResponse(const HttpResponseParser& response,
+                             int* peer_id);
 
     void OnClose(rtc::AsyncSocket* socket, int err);
 
-    void OnResolveResult(rtc::AsyncResolverInterface* resolver);
-
     PeerConnectionClientObserver* callback_;
+    // The address signed in to, or being tried.  Keeps the host name for
+    // the Host header.
     rtc::SocketAddress server_address_;
-    rtc::AsyncResolver* resolver_;
+    // Empty if the server was given as an IP address.
+    std::string server_hostname_;
+    // Where the server can be reached, in the order to try.
+    std::vector<rtc::SocketAddress> server_addresses_;
+    std::vector<ConnectAttempt> attempts_;
+    size_t next_attempt_;
+    bool racing_;
     std::unique_ptr<rtc::AsyncSocket> control_socket_;
     std::unique_ptr<rtc::AsyncSocket> hanging_get_;
+    std::unique_ptr<SignalingTransport> transport_;
+    // Set once the server rejected |transport_|; sticks for this client.
+    bool transport_rejected_;
     std::string onconnect_data_;
-    std::string control_data_;
-    std::string notification_data_;
+    // Keep-alive mode only: requests sent (or queued for sending) on
+    // |control_socket_| whose responses haven't been read yet, in order.
+    std::deque<ControlRequest> in_flight_requests_;
+    HttpResponseParser control_response_;
+    HttpResponseParser notification_response_;
     std::string client_name_;
     Peers peers_;
     State state_;
     int my_id_;
+    bool keep_alive_;
+    int64_t connect_start_ms_;
+    int64_t sign_in_time_ms_;
 };
 
 #endif // PEERCONNECTIONCLIENT_H
@@ -0,0 +1,71 @@
+#include "peerdirectory.h"
+
+#include <limits>
+
+PeerDirectory::PeerDirectory() {}
+
+PeerDirectory::~PeerDirectory() {}
+
+void PeerDirectory::Reserve(size_t count) {
+    peers_.reserve(count);
+    index_.reserve(count);
+}
+
+bool PeerDirectory::Add(int id, std::string name) {
+    auto inserted = index_.emplace(id, peers_.size());
+    if (!inserted.second) {
+        PeerInfo& peer = peers_[inserted.first->second];
+        if (peer.name != name) {
+            by_name_.erase(std::make_pair(peer.name, id));
+            by_name_.emplace(name, id);
+            peer.name = std::move(name);
+        }
+        return false;
+    }
+    by_name_.emplace(name, id);
+    peers_.push_back(PeerInfo{id, std::move(name)});
+    return true;
+}
+
+bool PeerDirectory::Remove(int id) {
+    auto found = index_.find(id);
+    if (found == index_.end())
+        return false;
+
+    size_t position = found->second;
+    index_.erase(found);
+    by_name_.erase(std::make_pair(peers_[position].name, id));
+    // Keep |peers_| dense by moving the last entry into the hole.
+    if (position != peers_.size() - 1) {
+        peers_[position] = std::move(peers_.back());
+        index_[peers_[position].id] = position;
+    }
+    peers_.pop_back();
+    return true;
+}
+
+void PeerDirectory::Clear() {
+    peers_.clear();
+    index_.clear();
+    by_name_.clear();
+}
+
+const std::string* PeerDirectory::Find(int id) const {
+    auto found = index_.find(id);
+    if (found == index_.end())
+        return nullptr;
+    return &peers_[found->second].name;
+}
+
+std::vector<const PeerInfo*> PeerDirectory::FindByPrefix(absl::string_view prefix, size_t limit) const {
+    std::vector<const PeerInfo*> matches;
+    auto it = by_name_.lower_bound(std::make_pair(
+                std::string(prefix.data(), prefix.size()),
+                std::numeric_limits<int>::min()));
+    for (; it != by_name_.end() && matches.size() < limit; ++it) {
+        if (it->first.compare(0, prefix.size(), prefix.data(), prefix.size()) != 0)
+            break;
+        matches.push_back(&peers_[index_.find(it->second)->second]);
+    }
+    return matches;
+}
@@ -0,0 +1,55 @@
+#ifndef PEERDIRECTORY_H
+#define PEERDIRECTORY_H
+
+#include <stddef.h>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "third_party/abseil-cpp/absl/container/flat_hash_map.h"
+#include "third_party/abseil-cpp/absl/strings/string_view.h"
+
+struct PeerInfo {
+    int id;
+    std::string name;
+};
+
+// The peers signed in to the server.  Entries live in a dense vector (in no
+// particular order) with a flat hash index by id, so adds, removals and id
+// lookups are O(1) and iteration is cache friendly.  A separate ordered name
+// index answers prefix queries for large rooms.
+class PeerDirectory
+{
+public:
+    typedef std::vector<PeerInfo>::const_iterator const_iterator;
+
+    PeerDirectory();
+    ~PeerDirectory();
+
+    void Reserve(size_t count);
+    // Adds a peer or renames an existing one.  Returns true if |id| is new.
+    bool Add(int id, std::string name);
+    // Returns false if |id| wasn't known.
+    bool Remove(int id);
+    void Clear();
+
+    // Name of |id|, or nullptr if there's no such peer.
+    const std::string* Find(int id) const;
+    // Up to |limit| peers whose name starts with |prefix|, ordered by name.
+    std::vector<const PeerInfo*> FindByPrefix(absl::string_view prefix,
+                                              size_t limit) const;
+
+    size_t size() const { return peers_.size(); }
+    bool empty() const { return peers_.empty(); }
+    const_iterator begin() const { return peers_.begin(); }
+    const_iterator end() const { return peers_.end(); }
+
+private:
+    std::vector<PeerInfo> peers_;
+    // id -> position in |peers_|.
+    absl::flat_hash_map<int, size_t> index_;
+    std::set<std::pair<std::string, int>> by_name_;
+};
+
+#endif // PEERDIRECTORY_H
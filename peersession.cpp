@@ -0,0 +1,145 @@
+#include "peersession.h"
+
+#include <utility>
+
+PeerSession::PeerSession(PeerSessionObserver* observer)
+    : observer_(observer),
+      peer_id_(-1),
+      loopback_(false),
+      awaiting_gathering_(false),
+      audio_profile_(kAudioProfileFull),
+      record_audio_(false) {
+}
+
+PeerSession::~PeerSession() {
+    Close();
+}
+
+bool PeerSession::Initialize(
+        webrtc::PeerConnectionFactoryInterface* factory,
+        const webrtc::PeerConnectionInterface::RTCConfiguration& config) {
+    data_channels_.clear();
+    if (peer_connection_)
+        peer_connection_->Close();
+    peer_connection_ = factory->CreatePeerConnection(config, nullptr, nullptr, this);
+    return peer_connection_ != nullptr;
+}
+
+void PeerSession::Close() {
+    observer_ = nullptr;
+    data_channels_.clear();
+    if (peer_connection_) {
+        // Receivers may outlive the connection; they must not call us back.
+        for (const auto& receiver : peer_connection_->GetReceivers())
+            receiver->SetObserver(nullptr);
+        peer_connection_->Close();
+        peer_connection_ = nullptr;
+    }
+}
+
+void PeerSession::AddDataChannel(std::unique_ptr<BufferedDataChannel> channel) {
+    data_channels_.push_back(std::move(channel));
+}
+
+BufferedDataChannel* PeerSession::FindDataChannel(const std::string& label) const {
+    for (const auto& channel : data_channels_) {
+        if (channel->label() == label)
+            return channel.get();
+    }
+    return nullptr;
+}
+
+bool PeerSession::RemoveDataChannel(const std::string& label) {
+    for (auto it = data_channels_.begin(); it != data_channels_.end(); ++it) {
+        if ((*it)->label() == label) {
+            data_channels_.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+void PeerSession::OnDataChannel(
+        rtc::scoped_refptr<webrtc::DataChannelInterface> channel) {
+    if (observer_)
+        observer_->OnSessionDataChannel(this, std::move(channel));
+}
+
+void PeerSession::OnAddTrack(
+        rtc::scoped_refptr<webrtc::RtpReceiverInterface> receiver,
+        const std::vector<rtc::scoped_refptr<webrtc::MediaStreamInterface>>& streams) {
+    if (observer_)
+        observer_->OnSessionTrackAdded(this, std::move(receiver), streams);
+}
+
+void PeerSession::OnRemoveTrack(
+        rtc::scoped_refptr<webrtc::RtpReceiverInterface> receiver) {
+    if (observer_)
+        observer_->OnSessionTrackRemoved(this, std::move(receiver));
+}
+
+void PeerSession::OnIceConnectionChange(
+        webrtc::PeerConnectionInterface::IceConnectionState new_state) {
+    switch (new_state) {
+    case webrtc::PeerConnectionInterface::kIceConnectionChecking:
+        timeline_.Mark(kPhaseIceChecking);
+        break;
+    case webrtc::PeerConnectionInterface::kIceConnectionConnected:
+    case webrtc::PeerConnectionInterface::kIceConnectionCompleted:
+        timeline_.Mark(kPhaseIceConnected);
+        break;
+    default:
+        break;
+    }
+    if (observer_)
+        observer_->OnSessionIceConnectionChange(this, new_state);
+}
+
+void PeerSession::OnIceGatheringChange(
+        webrtc::PeerConnectionInterface::IceGatheringState new_state) {
+    if (observer_)
+        observer_->OnSessionIceGatheringChange(this, new_state);
+}
+
+void PeerSession::OnIceCandidate(const webrtc::IceCandidateInterface* candidate) {
+    timeline_.Mark(kPhaseFirstCandidate);
+    if (observer_)
+        observer_->OnSessionIceCandidate(this, candidate);
+}
+
+void PeerSession::OnConnectionChange(
+        webrtc::PeerConnectionInterface::PeerConnectionState new_state) {
+    // Connected means the DTLS handshake finished on top of ICE.
+    if (new_state == webrtc::PeerConnectionInterface::PeerConnectionState::kConnected)
+        timeline_.Mark(kPhaseDtlsConnected);
+}
+
+void PeerSession::OnTrack(
+        rtc::scoped_refptr<webrtc::RtpTransceiverInterface> transceiver) {
+    if (transceiver->media_type() == cricket::MEDIA_TYPE_AUDIO)
+        transceiver->receiver()->SetObserver(this);
+}
+
+void PeerSession::OnSuccess(webrtc::SessionDescriptionInterface* desc) {
+    if (!observer_) {
+        // Closed while the offer/answer was being created; we own |desc|.
+        delete desc;
+        return;
+    }
+    timeline_.Mark(desc->GetType() == webrtc::SdpType::kOffer ? kPhaseOfferCreated
+                                                             : kPhaseAnswerCreated);
+    observer_->OnSessionDescriptionCreated(this, desc);
+}
+
+void PeerSession::OnFailure(webrtc::RTCError error) {
+    if (observer_)
+        observer_->OnSessionDescriptionFailure(this, std::move(error));
+}
+
+void PeerSession::OnFirstPacketReceived(cricket::MediaType media_type) {
+    if (media_type != cricket::MEDIA_TYPE_AUDIO)
+        return;
+    timeline_.Mark(kPhaseFirstAudioPacket);
+    if (observer_)
+        observer_->OnSessionFirstPacketReceived(this);
+}
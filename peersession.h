@@ -0,0 +1,158 @@
+#ifndef PEERSESSION_H
+#define PEERSESSION_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "api/peer_connection_interface.h"
+#include "api/rtp_receiver_interface.h"
+#include "api/rtp_transceiver_interface.h"
+#include "audioprofile.h"
+#include "buffereddatachannel.h"
+#include "calltimeline.h"
+#include "opussettings.h"
+
+class PeerSession;
+
+// Receives the callbacks of every PeerSession, with the session they came
+// from so that they can be routed by peer id.
+class PeerSessionObserver {
+public:
+    virtual void OnSessionIceCandidate(
+            PeerSession* session,
+            const webrtc::IceCandidateInterface* candidate) = 0;
+    virtual void OnSessionIceGatheringChange(
+            PeerSession* session,
+            webrtc::PeerConnectionInterface::IceGatheringState new_state) = 0;
+    virtual void OnSessionIceConnectionChange(
+            PeerSession* session,
+            webrtc::PeerConnectionInterface::IceConnectionState new_state) = 0;
+    virtual void OnSessionTrackAdded(
+            PeerSession* session,
+            rtc::scoped_refptr<webrtc::RtpReceiverInterface> receiver,
+            const std::vector<rtc::scoped_refptr<webrtc::MediaStreamInterface>>& streams) = 0;
+    virtual void OnSessionTrackRemoved(
+            PeerSession* session,
+            rtc::scoped_refptr<webrtc::RtpReceiverInterface> receiver) = 0;
+    // The peer opened a data channel.
+    virtual void OnSessionDataChannel(
+            PeerSession* session,
+            rtc::scoped_refptr<webrtc::DataChannelInterface> channel) = 0;
+    virtual void OnSessionDescriptionCreated(
+            PeerSession* session,
+            webrtc::SessionDescriptionInterface* desc) = 0;
+    virtual void OnSessionDescriptionFailure(PeerSession* session,
+                                             webrtc::RTCError error) = 0;
+    // The first audio packet of the call arrived; the timeline is complete.
+    virtual void OnSessionFirstPacketReceived(PeerSession* session) = 0;
+
+protected:
+    virtual ~PeerSessionObserver() {}
+};
+
+// One PeerConnection and the per-call state that goes with it.  The session
+// is the connection's observer, so several can share one
+// PeerConnectionFactory and still tell their callbacks apart.  It also
+// keeps the call's setup timeline: the phases it can see itself are marked
+// here, the signaling ones by the Conductor.
+class PeerSession : public webrtc::PeerConnectionObserver,
+                    public webrtc::CreateSessionDescriptionObserver,
+                    public webrtc::RtpReceiverObserverInterface
+{
+public:
+    explicit PeerSession(PeerSessionObserver* observer);
+
+    // Creates the PeerConnection, replacing the current one if any.
+    bool Initialize(webrtc::PeerConnectionFactoryInterface* factory,
+                    const webrtc::PeerConnectionInterface::RTCConfiguration& config);
+    // Closes the connection and stops forwarding callbacks.  Pending
+    // CreateOffer/CreateAnswer calls may still hold a reference to us.
+    void Close();
+
+    webrtc::PeerConnectionInterface* peer_connection() const {
+        return peer_connection_.get();
+    }
+
+    // -1 while the session sits in the pool.
+    int peer_id() const { return peer_id_; }
+    void set_peer_id(int peer_id) { peer_id_ = peer_id; }
+
+    bool loopback() const { return loopback_; }
+    void set_loopback(bool loopback) { loopback_ = loopback; }
+
+    // Non-trickle only: our description is set but not sent yet.
+    bool awaiting_gathering() const { return awaiting_gathering_; }
+    void set_awaiting_gathering(bool awaiting) { awaiting_gathering_ = awaiting; }
+
+    // What we ask of the peer's encoder and apply to ours.
+    const OpusSettings& opus_settings() const { return opus_settings_; }
+    void set_opus_settings(const OpusSettings& settings) { opus_settings_ = settings; }
+
+    // Capture processing this call asks for.
+    AudioProfile audio_profile() const { return audio_profile_; }
+    void set_audio_profile(AudioProfile profile) { audio_profile_ = profile; }
+
+    // Remote audio goes to the Conductor's CallRecorder.
+    bool record_audio() const { return record_audio_; }
+    void set_record_audio(bool record) { record_audio_ = record; }
+
+    // Data channels of the call, opened by either side.  Dropped, and so
+    // closed, with the connection.
+    void AddDataChannel(std::unique_ptr<BufferedDataChannel> channel);
+    BufferedDataChannel* FindDataChannel(const std::string& label) const;
+    bool RemoveDataChannel(const std::string& label);
+
+    CallTimeline& timeline() { return timeline_; }
+    const CallTimeline& timeline() const { return timeline_; }
+
+    //
+    // PeerConnectionObserver implementation.
+    //
+
+    void OnSignalingChange(
+            webrtc::PeerConnectionInterface::SignalingState new_state) override {}
+    void OnAddTrack(
+            rtc::scoped_refptr<webrtc::RtpReceiverInterface> receiver,
+            const std::vector<rtc::scoped_refptr<webrtc::MediaStreamInterface>>&
+            streams) override;
+    void OnRemoveTrack(
+            rtc::scoped_refptr<webrtc::RtpReceiverInterface> receiver) override;
+    void OnDataChannel(
+            rtc::scoped_refptr<webrtc::DataChannelInterface> channel) override;
+    void OnRenegotiationNeeded() override {}
+    void OnIceConnectionChange(
+            webrtc::PeerConnectionInterface::IceConnectionState new_state) override;
+    void OnIceGatheringChange(
+            webrtc::PeerConnectionInterface::IceGatheringState new_state) override;
+    void OnIceCandidate(const webrtc::IceCandidateInterface* candidate) override;
+    void OnIceConnectionReceivingChange(bool receiving) override {}
+    void OnConnectionChange(
+            webrtc::PeerConnectionInterface::PeerConnectionState new_state) override;
+    void OnTrack(
+            rtc::scoped_refptr<webrtc::RtpTransceiverInterface> transceiver) override;
+
+    // CreateSessionDescriptionObserver implementation.
+    void OnSuccess(webrtc::SessionDescriptionInterface* desc) override;
+    void OnFailure(webrtc::RTCError error) override;
+
+    // RtpReceiverObserverInterface implementation.
+    void OnFirstPacketReceived(cricket::MediaType media_type) override;
+
+protected:
+    ~PeerSession() override;
+
+private:
+    PeerSessionObserver* observer_;
+    rtc::scoped_refptr<webrtc::PeerConnectionInterface> peer_connection_;
+    int peer_id_;
+    bool loopback_;
+    bool awaiting_gathering_;
+    OpusSettings opus_settings_;
+    AudioProfile audio_profile_;
+    bool record_audio_;
+    CallTimeline timeline_;
+    std::vector<std::unique_ptr<BufferedDataChannel>> data_channels_;
+};
+
+#endif // PEERSESSION_H
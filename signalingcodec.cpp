@@ -0,0 +1,325 @@
+#include "signalingcodec.h"
+
+#include <stdio.h>
+
+namespace {
+
+// Names used for a IceCandidate JSON object.
+const char kCandidateSdpMidName[] = "sdpMid";
+const char kCandidateSdpMlineIndexName[] = "sdpMLineIndex";
+const char kCandidateSdpName[] = "candidate";
+
+// Names used for a SessionDescription JSON object.
+const char kSessionDescriptionTypeName[] = "type";
+const char kSessionDescriptionSdpName[] = "sdp";
+
+// Nesting allowed inside values we skip.
+const int kMaxSkipDepth = 16;
+
+void AppendEscaped(absl::string_view value, std::string* out) {
+    out->push_back('"');
+    size_t run = 0;
+    for (size_t i = 0; i < value.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(value[i]);
+        if (c >= 0x20 && c != '"' && c != '\\')
+            continue;
+        out->append(value.data() + run, i - run);
+        run = i + 1;
+        switch (c) {
+        case '"': out->append("\\\""); break;
+        case '\\': out->append("\\\\"); break;
+        case '\n': out->append("\\n"); break;
+        case '\r': out->append("\\r"); break;
+        case '\t': out->append("\\t"); break;
+        default: {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out->append(escaped);
+            break;
+        }
+        }
+    }
+    out->append(value.data() + run, value.size() - run);
+    out->push_back('"');
+}
+
+void AppendKey(const char* key, std::string* out) {
+    out->push_back('"');
+    out->append(key);
+    out->append("\":");
+}
+
+void AppendUtf8(unsigned int code_point, std::string* out) {
+    if (code_point < 0x80) {
+        out->push_back(static_cast<char>(code_point));
+    } else if (code_point < 0x800) {
+        out->push_back(static_cast<char>(0xc0 | (code_point >> 6)));
+        out->push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+    } else if (code_point < 0x10000) {
+        out->push_back(static_cast<char>(0xe0 | (code_point >> 12)));
+        out->push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3f)));
+        out->push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+    } else {
+        out->push_back(static_cast<char>(0xf0 | (code_point >> 18)));
+        out->push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3f)));
+        out->push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3f)));
+        out->push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+    }
+}
+
+// Forward-only reader over the JSON text.
+class Scanner {
+public:
+    explicit Scanner(absl::string_view input)
+        : pos_(input.data()), end_(input.data() + input.size()) {}
+
+    void SkipSpace() {
+        while (pos_ < end_ && (*pos_ == ' ' || *pos_ == '\n' ||
+                               *pos_ == '\r' || *pos_ == '\t'))
+            ++pos_;
+    }
+
+    bool Consume(char c) {
+        SkipSpace();
+        if (pos_ < end_ && *pos_ == c) {
+            ++pos_;
+            return true;
+        }
+        return false;
+    }
+
+    bool Peek(char c) {
+        SkipSpace();
+        return pos_ < end_ && *pos_ == c;
+    }
+
+    bool AtEnd() {
+        SkipSpace();
+        return pos_ == end_;
+    }
+
+    bool ReadString(std::string* out) {
+        out->clear();
+        if (!Consume('"'))
+            return false;
+        const char* run = pos_;
+        while (pos_ < end_) {
+            char c = *pos_;
+            if (c == '"') {
+                out->append(run, pos_ - run);
+                ++pos_;
+                return true;
+            }
+            if (c != '\\') {
+                ++pos_;
+                continue;
+            }
+            out->append(run, pos_ - run);
+            if (++pos_ == end_)
+                return false;
+            switch (*pos_++) {
+            case '"': out->push_back('"'); break;
+            case '\\': out->push_back('\\'); break;
+            case '/': out->push_back('/'); break;
+            case 'b': out->push_back('\b'); break;
+            case 'f': out->push_back('\f'); break;
+            case 'n': out->push_back('\n'); break;
+            case 'r': out->push_back('\r'); break;
+            case 't': out->push_back('\t'); break;
+            case 'u': {
+                unsigned int code_point = 0;
+                if (!ReadHex4(&code_point))
+                    return false;
+                if (code_point >= 0xd800 && code_point < 0xdc00) {
+                    unsigned int low = 0;
+                    if (end_ - pos_ < 2 || pos_[0] != '\\' || pos_[1] != 'u')
+                        return false;
+                    pos_ += 2;
+                    if (!ReadHex4(&low) || low < 0xdc00 || low > 0xdfff)
+                        return false;
+                    code_point = 0x10000 + ((code_point - 0xd800) << 10) +
+                            (low - 0xdc00);
+                }
+                AppendUtf8(code_point, out);
+                break;
+            }
+            default:
+                return false;
+            }
+            run = pos_;
+        }
+        return false;
+    }
+
+    bool ReadInt(int* value) {
+        SkipSpace();
+        bool negative = pos_ < end_ && *pos_ == '-';
+        if (negative)
+            ++pos_;
+        const char* digits = pos_;
+        int result = 0;
+        while (pos_ < end_ && *pos_ >= '0' && *pos_ <= '9')
+            result = result * 10 + (*pos_++ - '0');
+        if (pos_ == digits)
+            return false;
+        *value = negative ? -result : result;
+        return true;
+    }
+
+    // Skips any JSON value without looking at it.
+    bool SkipValue(std::string* scratch, int depth = 0) {
+        if (depth > kMaxSkipDepth)
+            return false;
+        SkipSpace();
+        if (pos_ == end_)
+            return false;
+        switch (*pos_) {
+        case '"':
+            return ReadString(scratch);
+        case '{':
+        case '[': {
+            char close = *pos_ == '{' ? '}' : ']';
+            ++pos_;
+            if (Consume(close))
+                return true;
+            do {
+                if (close == '}' && (!ReadString(scratch) || !Consume(':')))
+                    return false;
+                if (!SkipValue(scratch, depth + 1))
+                    return false;
+            } while (Consume(','));
+            return Consume(close);
+        }
+        default:
+            // Numbers, true, false and null.
+            while (pos_ < end_ && *pos_ != ',' && *pos_ != '}' && *pos_ != ']' &&
+                   *pos_ != ' ' && *pos_ != '\n' && *pos_ != '\r' && *pos_ != '\t')
+                ++pos_;
+            return true;
+        }
+    }
+
+private:
+    bool ReadHex4(unsigned int* value) {
+        if (end_ - pos_ < 4)
+            return false;
+        unsigned int result = 0;
+        for (int i = 0; i < 4; ++i) {
+            char c = *pos_++;
+            result <<= 4;
+            if (c >= '0' && c <= '9')
+                result |= c - '0';
+            else if (c >= 'a' && c <= 'f')
+                result |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F')
+                result |= c - 'A' + 10;
+            else
+                return false;
+        }
+        *value = result;
+        return true;
+    }
+
+    const char* pos_;
+    const char* end_;
+};
+
+bool ParseObject(Scanner* scanner, std::string* key, SignalingMessage* message) {
+    message->Clear();
+    if (!scanner->Consume('{'))
+        return false;
+    if (scanner->Consume('}'))
+        return true;
+    do {
+        if (!scanner->ReadString(key) || !scanner->Consume(':'))
+            return false;
+        bool ok;
+        if (*key == kSessionDescriptionTypeName) {
+            ok = scanner->ReadString(&message->type);
+        } else if (*key == kSessionDescriptionSdpName) {
+            ok = message->has_sdp = scanner->ReadString(&message->sdp);
+        } else if (*key == kCandidateSdpMidName) {
+            ok = message->has_sdp_mid = scanner->ReadString(&message->sdp_mid);
+        } else if (*key == kCandidateSdpMlineIndexName) {
+            ok = message->has_sdp_mline_index =
+                    scanner->ReadInt(&message->sdp_mline_index);
+        } else if (*key == kCandidateSdpName) {
+            ok = message->has_candidate = scanner->ReadString(&message->candidate);
+        } else {
+            ok = scanner->SkipValue(key);
+        }
+        if (!ok)
+            return false;
+    } while (scanner->Consume(','));
+    return scanner->Consume('}');
+}
+
+}  // namespace
+
+SignalingMessage::SignalingMessage() {
+    Clear();
+}
+
+void SignalingMessage::Clear() {
+    // clear() rather than assigning new strings keeps the capacity around.
+    type.clear();
+    sdp.clear();
+    sdp_mid.clear();
+    sdp_mline_index = 0;
+    candidate.clear();
+    has_sdp = false;
+    has_sdp_mid = false;
+    has_sdp_mline_index = false;
+    has_candidate = false;
+}
+
+SignalingCodec::SignalingCodec() {}
+
+const std::string& SignalingCodec::WriteSessionDescription(absl::string_view type, absl::string_view sdp) {
+    out_.clear();
+    out_.reserve(sdp.size() + sdp.size() / 16 + 32);
+    out_.push_back('{');
+    AppendKey(kSessionDescriptionTypeName, &out_);
+    AppendEscaped(type, &out_);
+    out_.push_back(',');
+    AppendKey(kSessionDescriptionSdpName, &out_);
+    AppendEscaped(sdp, &out_);
+    out_.push_back('}');
+    return out_;
+}
+
+const std::string& SignalingCodec::WriteCandidate(absl::string_view sdp_mid, int sdp_mline_index, absl::string_view candidate) {
+    char index[16];
+    snprintf(index, sizeof(index), "%d", sdp_mline_index);
+
+    out_.clear();
+    out_.push_back('{');
+    AppendKey(kCandidateSdpMidName, &out_);
+    AppendEscaped(sdp_mid, &out_);
+    out_.push_back(',');
+    AppendKey(kCandidateSdpMlineIndexName, &out_);
+    out_.append(index);
+    out_.push_back(',');
+    AppendKey(kCandidateSdpName, &out_);
+    AppendEscaped(candidate, &out_);
+    out_.push_back('}');
+    return out_;
+}
+
+bool SignalingCodec::Parse(absl::string_view json, std::vector<SignalingMessage>* messages, size_t* count) {
+    Scanner scanner(json);
+    *count = 0;
+    bool batch = scanner.Consume('[');
+    if (!batch || !scanner.Consume(']')) {
+        do {
+            if (*count == messages->size())
+                messages->emplace_back();
+            if (!ParseObject(&scanner, &key_, &(*messages)[*count]))
+                return false;
+            ++*count;
+        } while (batch && scanner.Consume(','));
+        if (batch && !scanner.Consume(']'))
+            return false;
+    }
+    return scanner.AtEnd();
+}
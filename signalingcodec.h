@@ -0,0 +1,59 @@
+#ifndef SIGNALINGCODEC_H
+#define SIGNALINGCODEC_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include "third_party/abseil-cpp/absl/strings/string_view.h"
+
+// One signaling object exchanged with the peer: a session description
+// ({"type", "sdp"}), a loopback request ({"type": "offer-loopback"}) or an ICE
+// candidate ({"sdpMid", "sdpMLineIndex", "candidate"}).
+struct SignalingMessage {
+    SignalingMessage();
+    void Clear();
+
+    // Empty for candidates.
+    std::string type;
+    std::string sdp;
+    std::string sdp_mid;
+    int sdp_mline_index;
+    std::string candidate;
+    bool has_sdp;
+    bool has_sdp_mid;
+    bool has_sdp_mline_index;
+    bool has_candidate;
+};
+
+// Encoder/decoder for the three message shapes above.  Output is compact JSON
+// written into a buffer the codec keeps between calls; input is parsed in a
+// single pass straight into SignalingMessage fields, skipping unknown keys,
+// so no DOM is built.  Both directions reuse their storage across messages.
+class SignalingCodec
+{
+public:
+    SignalingCodec();
+
+    // The returned reference stays valid until the next Write call.
+    const std::string& WriteSessionDescription(absl::string_view type,
+                                               absl::string_view sdp);
+    const std::string& WriteCandidate(absl::string_view sdp_mid,
+                                      int sdp_mline_index,
+                                      absl::string_view candidate);
+
+    // Parses a single object or a batch array of objects (see
+    // Conductor::TakeMessageBatch()).  On success the first |*count| entries
+    // of |messages| hold the result; entries beyond that are kept around so
+    // their string capacity is reused by later calls.
+    bool Parse(absl::string_view json,
+               std::vector<SignalingMessage>* messages,
+               size_t* count);
+
+private:
+    std::string out_;
+    // Scratch space for object keys.
+    std::string key_;
+};
+
+#endif // SIGNALINGCODEC_H
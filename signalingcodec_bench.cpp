@@ -0,0 +1,121 @@
+#include "bench.h"
+
+#include <string>
+#include <vector>
+
+#include "rtc_base/strings/json.h"
+#include "third_party/jsoncpp/source/include/json/json.h"
+#include "signalingcodec.h"
+
+namespace {
+
+// An audio-only offer about the size Conductor sends.
+std::string MakeOffer() {
+    std::string sdp =
+            "v=0\r\n"
+            "o=- 4611731400430051336 2 IN IP4 127.0.0.1\r\n"
+            "s=-\r\n"
+            "t=0 0\r\n"
+            "a=group:BUNDLE 0\r\n"
+            "a=msid-semantic: WMS stream_id\r\n"
+            "m=audio 9 UDP/TLS/RTP/SAVPF 111 103 104 9 102 0 8 106 105 13 110 112 113 126\r\n"
+            "c=IN IP4 0.0.0.0\r\n"
+            "a=rtcp:9 IN IP4 0.0.0.0\r\n"
+            "a=ice-ufrag:8hhY\r\n"
+            "a=ice-pwd:asd88fgpdd777uzjYhagZg\r\n"
+            "a=ice-options:trickle\r\n"
+            "a=fingerprint:sha-256 D2:FA:0E:C3:22:59:5E:14:95:69:92:3D:13:B4:84:24:"
+            "2C:C2:A2:C0:3E:FD:34:8E:5E:EA:6F:AF:52:CE:E6:0F\r\n"
+            "a=setup:actpass\r\n"
+            "a=mid:0\r\n"
+            "a=extmap:1 urn:ietf:params:rtp-hdrext:ssrc-audio-level\r\n"
+            "a=sendrecv\r\n"
+            "a=msid:stream_id audio_label\r\n"
+            "a=rtcp-mux\r\n"
+            "a=rtpmap:111 opus/48000/2\r\n"
+            "a=rtcp-fb:111 transport-cc\r\n"
+            "a=fmtp:111 minptime=10;useinbandfec=1\r\n";
+    for (int pt = 102; pt < 127; ++pt)
+        sdp += "a=rtpmap:" + std::to_string(pt) + " telephone-event/8000\r\n";
+    sdp += "a=ssrc:1001 cname:Yq1bOGKsUh8Ao/sR\r\n"
+           "a=ssrc:1001 msid:stream_id audio_label\r\n";
+    return sdp;
+}
+
+const char kCandidate[] =
+        "candidate:842163049 1 udp 1677729535 203.0.113.7 54400 typ srflx "
+        "raddr 192.168.1.20 rport 54400 generation 0 ufrag 8hhY network-cost 50";
+
+// What Conductor did before SignalingCodec.
+std::string JsonWriteDescription(const std::string& type, const std::string& sdp) {
+    Json::StyledWriter writer;
+    Json::Value message;
+    message["type"] = type;
+    message["sdp"] = sdp;
+    return writer.write(message);
+}
+
+std::string JsonWriteCandidate(const std::string& mid, int index, const std::string& sdp) {
+    Json::StyledWriter writer;
+    Json::Value message;
+    message["sdpMid"] = mid;
+    message["sdpMLineIndex"] = index;
+    message["candidate"] = sdp;
+    return writer.write(message);
+}
+
+bool JsonParse(const std::string& text, SignalingMessage* out) {
+    Json::Reader reader;
+    Json::Value message;
+    if (!reader.parse(text, message))
+        return false;
+    out->has_sdp = false;
+    if (rtc::GetStringFromJsonObject(message, "type", &out->type)) {
+        out->has_sdp = rtc::GetStringFromJsonObject(message, "sdp", &out->sdp);
+        return true;
+    }
+    return rtc::GetStringFromJsonObject(message, "sdpMid", &out->sdp_mid) &&
+            rtc::GetIntFromJsonObject(message, "sdpMLineIndex", &out->sdp_mline_index) &&
+            rtc::GetStringFromJsonObject(message, "candidate", &out->candidate);
+}
+
+}  // namespace
+
+// Writing and parsing the two messages every call sends: the offer, and
+// (per candidate) a trickled ICE candidate.
+BENCHMARK(SignalingCodecVsJsoncpp) {
+    const std::string offer = MakeOffer();
+    const std::string candidate = kCandidate;
+    SignalingCodec codec;
+    std::vector<SignalingMessage> messages;
+    size_t count = 0;
+
+    BenchTime("jsoncpp write offer", 20000, [&]() {
+        BenchKeep(JsonWriteDescription("offer", offer));
+    });
+    BenchTime("codec write offer", 20000, [&]() {
+        BenchKeep(codec.WriteSessionDescription("offer", offer));
+    });
+    BenchTime("jsoncpp write candidate", 100000, [&]() {
+        BenchKeep(JsonWriteCandidate("0", 0, candidate));
+    });
+    BenchTime("codec write candidate", 100000, [&]() {
+        BenchKeep(codec.WriteCandidate("0", 0, candidate));
+    });
+
+    const std::string offer_json = codec.WriteSessionDescription("offer", offer);
+    const std::string candidate_json = codec.WriteCandidate("0", 0, candidate);
+    SignalingMessage parsed;
+    BenchTime("jsoncpp parse offer", 20000, [&]() {
+        BenchKeep(JsonParse(offer_json, &parsed));
+    });
+    BenchTime("codec parse offer", 20000, [&]() {
+        BenchKeep(codec.Parse(offer_json, &messages, &count));
+    });
+    BenchTime("jsoncpp parse candidate", 100000, [&]() {
+        BenchKeep(JsonParse(candidate_json, &parsed));
+    });
+    BenchTime("codec parse candidate", 100000, [&]() {
+        BenchKeep(codec.Parse(candidate_json, &messages, &count));
+    });
+}
@@ -0,0 +1,827 @@
+#include "signalingserver.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <utility>
+
+#include "rtc_base/message_digest.h"
+#include "rtc_base/third_party/base64/base64.h"
+
+namespace {
+
+// epoll keys of the non-connection descriptors.
+const uint64_t kListenKey = 0;
+const uint64_t kWakeupKey = 1;
+const uint64_t kTimerKey = 2;
+
+const size_t kMaxHeaderSize = 16 * 1024;
+const size_t kMaxBodySize = 1024 * 1024;
+// Undelivered messages kept for a member that isn't waiting; the oldest
+// are dropped beyond this.
+const size_t kMaxQueuedDeliveries = 1024;
+const int kMaxEvents = 256;
+const size_t kMaxIovecs = 64;
+const int kDefaultIdleTimeoutMs = 60 * 1000;
+const int kMinSweepIntervalMs = 10;
+
+const uint8_t kOpContinuation = 0x0;
+const uint8_t kOpText = 0x1;
+const uint8_t kOpBinary = 0x2;
+const uint8_t kOpClose = 0x8;
+const uint8_t kOpPing = 0x9;
+const uint8_t kOpPong = 0xa;
+
+// Magic GUID from RFC 6455, section 1.3.
+const char kWebSocketGuid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+std::string ComputeAcceptKey(const std::string& key) {
+    std::string input = key + kWebSocketGuid;
+    unsigned char digest[20];
+    size_t length = rtc::ComputeDigest(rtc::DIGEST_SHA_1, input.data(),
+                                       input.size(), digest, sizeof(digest));
+    std::string accept;
+    rtc::Base64::EncodeFromArray(digest, length, &accept);
+    return accept;
+}
+
+// |lower_headers| is the lower-cased header block, starting with the CRLF
+// that ends the request line; |name| must be lower case.
+std::string GetHeader(const std::string& lower_headers,
+                      const std::string& headers, const char* name) {
+    std::string pattern = "\r\n";
+    pattern += name;
+    pattern += ':';
+    size_t found = lower_headers.find(pattern);
+    if (found == std::string::npos)
+        return std::string();
+    size_t begin = found + pattern.length();
+    while (begin < headers.size() && headers[begin] == ' ')
+        ++begin;
+    return headers.substr(begin, headers.find("\r\n", begin) - begin);
+}
+
+// Value of |name| in "a=1&b=2", or -1.
+int GetQueryInt(const std::string& query, const char* name) {
+    std::string pattern = name;
+    pattern += '=';
+    size_t pos = 0;
+    while (pos < query.size()) {
+        if (query.compare(pos, pattern.size(), pattern) == 0)
+            return atoi(query.c_str() + pos + pattern.size());
+        pos = query.find('&', pos);
+        if (pos == std::string::npos)
+            break;
+        ++pos;
+    }
+    return -1;
+}
+
+int64_t NowMs() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<int64_t>(now.tv_sec) * 1000 + now.tv_nsec / 1000000;
+}
+
+void Lower(std::string* text) {
+    for (char& c : *text)
+        c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+}
+
+}  // namespace
+
+SignalingServer::Connection::Connection(uint64_t key, int fd)
+    : key(key),
+      fd(fd),
+      last_read_ms(NowMs()),
+      ping_sent(false),
+      out_offset(0),
+      want_write(false),
+      close_after_write(false),
+      parked_for(-1),
+      parked_keep_alive(false),
+      websocket_member(-1) {
+}
+
+SignalingServer::SignalingServer()
+    : epoll_fd_(epoll_create1(EPOLL_CLOEXEC)),
+      listen_fd_(-1),
+      port_(0),
+      wakeup_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+      timer_fd_(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)),
+      idle_timeout_ms_(kDefaultIdleTimeoutMs),
+      running_(false),
+      next_id_(1),
+      next_key_(kTimerKey + 1) {
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u64 = kWakeupKey;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wakeup_fd_, &event);
+    event.data.u64 = kTimerKey;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, timer_fd_, &event);
+}
+
+SignalingServer::~SignalingServer() {
+    for (auto& entry : connections_)
+        close(entry.second->fd);
+    if (listen_fd_ != -1)
+        close(listen_fd_);
+    close(wakeup_fd_);
+    close(timer_fd_);
+    close(epoll_fd_);
+}
+
+bool SignalingServer::Listen(int port) {
+    // Dual-stack where possible.
+    int fd = socket(AF_INET6, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    bool v6 = fd != -1;
+    if (!v6)
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        perror("socket");
+        return false;
+    }
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    int result;
+    if (v6) {
+        int off = 0;
+        setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+        sockaddr_in6 addr = {};
+        addr.sin6_family = AF_INET6;
+        addr.sin6_addr = in6addr_any;
+        addr.sin6_port = htons(port);
+        result = bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    } else {
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(port);
+        result = bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    }
+    if (result == -1 || listen(fd, SOMAXCONN) == -1) {
+        perror("bind/listen");
+        close(fd);
+        return false;
+    }
+
+    sockaddr_storage bound = {};
+    socklen_t bound_length = sizeof(bound);
+    getsockname(fd, reinterpret_cast<sockaddr*>(&bound), &bound_length);
+    port_ = ntohs(v6 ? reinterpret_cast<sockaddr_in6*>(&bound)->sin6_port
+                     : reinterpret_cast<sockaddr_in*>(&bound)->sin_port);
+
+    listen_fd_ = fd;
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u64 = kListenKey;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &event);
+    return true;
+}
+
+void SignalingServer::Stop() {
+    uint64_t one = 1;
+    ssize_t ignored = write(wakeup_fd_, &one, sizeof(one));
+    (void)ignored;
+}
+
+void SignalingServer::Run() {
+    running_ = true;
+    if (idle_timeout_ms_ > 0) {
+        int interval_ms = std::max(idle_timeout_ms_ / 4, kMinSweepIntervalMs);
+        itimerspec spec = {};
+        spec.it_interval.tv_sec = interval_ms / 1000;
+        spec.it_interval.tv_nsec = (interval_ms % 1000) * 1000000L;
+        spec.it_value = spec.it_interval;
+        timerfd_settime(timer_fd_, 0, &spec, nullptr);
+    }
+    epoll_event events[kMaxEvents];
+    while (running_) {
+        int count = epoll_wait(epoll_fd_, events, kMaxEvents, -1);
+        if (count == -1) {
+            if (errno == EINTR)
+                continue;
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < count; ++i)
+            HandleEvent(events[i].data.u64, events[i].events);
+
+        // Resuming can unpark further connections; keep going until none
+        // are left.
+        while (!resume_.empty()) {
+            std::vector<uint64_t> resume;
+            resume.swap(resume_);
+            for (uint64_t key : resume) {
+                auto it = connections_.find(key);
+                if (it != connections_.end())
+                    ProcessInput(it->second.get());
+            }
+        }
+    }
+}
+
+void SignalingServer::HandleEvent(uint64_t key, uint32_t events) {
+    if (key == kListenKey) {
+        Accept();
+        return;
+    }
+    if (key == kWakeupKey) {
+        uint64_t value;
+        ssize_t ignored = read(wakeup_fd_, &value, sizeof(value));
+        (void)ignored;
+        running_ = false;
+        return;
+    }
+    if (key == kTimerKey) {
+        uint64_t expirations;
+        ssize_t ignored = read(timer_fd_, &expirations, sizeof(expirations));
+        (void)ignored;
+        SweepIdle();
+        return;
+    }
+
+    // The connection may have been closed by an earlier event in the batch.
+    auto it = connections_.find(key);
+    if (it == connections_.end())
+        return;
+    Connection* conn = it->second.get();
+    if (events & (EPOLLERR | EPOLLHUP)) {
+        CloseConnection(conn);
+        return;
+    }
+    if (events & (EPOLLIN | EPOLLRDHUP)) {
+        OnReadable(conn);
+        if (connections_.find(key) == connections_.end())
+            return;
+    }
+    if (events & EPOLLOUT)
+        OnWritable(conn);
+}
+
+void SignalingServer::Accept() {
+    while (true) {
+        int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                perror("accept");
+            return;
+        }
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+        uint64_t key = next_key_++;
+        epoll_event event = {};
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.u64 = key;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) == -1) {
+            close(fd);
+            continue;
+        }
+        connections_[key].reset(new Connection(key, fd));
+    }
+}
+
+void SignalingServer::OnReadable(Connection* conn) {
+    char buffer[64 * 1024];
+    while (true) {
+        ssize_t bytes = recv(conn->fd, buffer, sizeof(buffer), 0);
+        if (bytes > 0) {
+            conn->in.append(buffer, bytes);
+            conn->last_read_ms = NowMs();
+            conn->ping_sent = false;
+            continue;
+        }
+        if (bytes == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            CloseConnection(conn);
+            return;
+        }
+        if (errno != EINTR)
+            break;
+    }
+    ProcessInput(conn);
+}
+
+void SignalingServer::OnWritable(Connection* conn) {
+    while (!conn->out.empty()) {
+        iovec iov[kMaxIovecs];
+        size_t iov_count = 0;
+        size_t total = 0;
+        size_t skip = conn->out_offset;
+        for (const Output& output : conn->out) {
+            if (iov_count + 2 > kMaxIovecs)
+                break;
+            size_t head_skip = std::min(skip, output.head.size());
+            if (head_skip < output.head.size()) {
+                iov[iov_count].iov_base = const_cast<char*>(output.head.data() + head_skip);
+                iov[iov_count].iov_len = output.head.size() - head_skip;
+                total += iov[iov_count].iov_len;
+                ++iov_count;
+            }
+            skip -= head_skip;
+            if (output.body && skip < output.body->size()) {
+                iov[iov_count].iov_base = const_cast<char*>(output.body->data() + skip);
+                iov[iov_count].iov_len = output.body->size() - skip;
+                total += iov[iov_count].iov_len;
+                ++iov_count;
+            }
+            skip = 0;
+        }
+
+        // sendmsg() rather than writev() for MSG_NOSIGNAL: a peer that went
+        // away must not SIGPIPE the server.
+        msghdr message = {};
+        message.msg_iov = iov;
+        message.msg_iovlen = iov_count;
+        ssize_t written = sendmsg(conn->fd, &message, MSG_NOSIGNAL);
+        if (written == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            if (errno == EINTR)
+                continue;
+            CloseConnection(conn);
+            return;
+        }
+
+        size_t remaining = static_cast<size_t>(written);
+        while (!conn->out.empty()) {
+            const Output& front = conn->out.front();
+            size_t size = front.head.size() + (front.body ? front.body->size() : 0);
+            size_t left = size - conn->out_offset;
+            if (remaining < left) {
+                conn->out_offset += remaining;
+                break;
+            }
+            remaining -= left;
+            conn->out.pop_front();
+            conn->out_offset = 0;
+        }
+        if (static_cast<size_t>(written) < total)
+            break;  // The socket buffer is full; wait for EPOLLOUT.
+    }
+
+    if (conn->out.empty() && conn->close_after_write) {
+        CloseConnection(conn);
+        return;
+    }
+    UpdateEvents(conn);
+}
+
+void SignalingServer::CloseConnection(Connection* conn) {
+    if (conn->parked_for != -1) {
+        Member* member = FindMember(conn->parked_for);
+        if (member && member->waiting == conn) {
+            member->waiting = nullptr;
+            member->last_seen_ms = NowMs();
+        }
+    }
+    if (conn->websocket_member != -1) {
+        // A dropped WebSocket is a sign-out.
+        int id = conn->websocket_member;
+        Member* member = FindMember(id);
+        if (member && member->websocket == conn) {
+            member->websocket = nullptr;
+            SignOut(id);
+        }
+    }
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, conn->fd, nullptr);
+    close(conn->fd);
+    connections_.erase(conn->key);
+}
+
+void SignalingServer::SweepIdle() {
+    int64_t now = NowMs();
+    // Closing and answering change connections_; decide first.
+    std::vector<uint64_t> idle;
+    for (const auto& entry : connections_) {
+        const Connection& conn = *entry.second;
+        int64_t threshold = conn.websocket_member != -1 ? idle_timeout_ms_ / 2
+                                                         : idle_timeout_ms_;
+        if (now - conn.last_read_ms >= threshold)
+            idle.push_back(entry.first);
+    }
+    for (uint64_t key : idle) {
+        auto it = connections_.find(key);
+        if (it == connections_.end())
+            continue;
+        Connection* conn = it->second.get();
+        if (conn->websocket_member != -1) {
+            if (now - conn->last_read_ms >= idle_timeout_ms_) {
+                CloseConnection(conn);
+            } else if (!conn->ping_sent) {
+                SendFrame(conn, kOpPing, std::string(), nullptr);
+                conn->ping_sent = true;
+            }
+        } else if (conn->parked_for != -1) {
+            // An empty notification, which the client ignores before
+            // parking its next wait.
+            Member* member = FindMember(conn->parked_for);
+            if (member && member->waiting == conn) {
+                member->waiting = nullptr;
+                member->last_seen_ms = now;
+            }
+            conn->last_read_ms = now;
+            Respond(conn, 200, "OK", conn->parked_for, conn->parked_keep_alive, nullptr);
+            conn->parked_for = -1;
+            resume_.push_back(conn->key);
+        } else {
+            CloseConnection(conn);
+        }
+    }
+
+    std::vector<int> gone;
+    for (const auto& entry : members_) {
+        const Member& member = entry.second;
+        if (!member.waiting && !member.websocket &&
+                now - member.last_seen_ms >= idle_timeout_ms_)
+            gone.push_back(entry.first);
+    }
+    for (int id : gone)
+        SignOut(id);
+}
+
+void SignalingServer::UpdateEvents(Connection* conn) {
+    bool want_write = !conn->out.empty() || conn->close_after_write;
+    if (want_write == conn->want_write)
+        return;
+    conn->want_write = want_write;
+    epoll_event event = {};
+    event.events = EPOLLIN | EPOLLRDHUP | (want_write ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+    event.data.u64 = conn->key;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, conn->fd, &event);
+}
+
+void SignalingServer::Queue(Connection* conn, Output output) {
+    conn->out.push_back(std::move(output));
+    UpdateEvents(conn);
+}
+
+void SignalingServer::ProcessInput(Connection* conn) {
+    while (!conn->close_after_write) {
+        if (conn->websocket_member != -1) {
+            ProcessFrames(conn);
+            return;
+        }
+        if (conn->parked_for != -1)
+            return;
+
+        size_t eoh = conn->in.find("\r\n\r\n");
+        if (eoh == std::string::npos) {
+            if (conn->in.size() > kMaxHeaderSize)
+                Respond(conn, 431, "Request Header Fields Too Large", -1, false, nullptr);
+            return;
+        }
+
+        size_t line_end = conn->in.find("\r\n");
+        std::string line = conn->in.substr(0, line_end);
+        size_t sp1 = line.find(' ');
+        size_t sp2 = sp1 == std::string::npos ? sp1 : line.find(' ', sp1 + 1);
+        if (sp2 == std::string::npos) {
+            Respond(conn, 400, "Bad Request", -1, false, nullptr);
+            return;
+        }
+        std::string method = line.substr(0, sp1);
+        std::string target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+        std::string version = line.substr(sp2 + 1);
+
+        // From the request line's CRLF through the last header's.
+        std::string headers = conn->in.substr(line_end, eoh + 2 - line_end);
+        std::string lower_headers = headers;
+        Lower(&lower_headers);
+
+        std::string length_value = GetHeader(lower_headers, headers, "content-length");
+        long long length = length_value.empty() ? 0 : atoll(length_value.c_str());
+        if (length < 0 || static_cast<size_t>(length) > kMaxBodySize) {
+            Respond(conn, 413, "Payload Too Large", -1, false, nullptr);
+            return;
+        }
+        size_t request_size = eoh + 4 + static_cast<size_t>(length);
+        if (conn->in.size() < request_size)
+            return;
+
+        std::string connection = GetHeader(lower_headers, lower_headers, "connection");
+        bool keep_alive = version == "HTTP/1.1" ? connection != "close"
+                                                : connection == "keep-alive";
+        Payload body;
+        if (length > 0)
+            body = std::make_shared<const std::string>(conn->in, eoh + 4, length);
+        conn->in.erase(0, request_size);
+
+        HandleRequest(conn, method, target, keep_alive, headers, body);
+    }
+}
+
+void SignalingServer::HandleRequest(Connection* conn, const std::string& method,
+                                    const std::string& target, bool keep_alive,
+                                    const std::string& headers, Payload body) {
+    size_t question = target.find('?');
+    std::string path = target.substr(0, question);
+    std::string query = question == std::string::npos ? std::string()
+                                                      : target.substr(question + 1);
+
+    if (path == "/sign_in") {
+        SignIn(conn, query, keep_alive);
+    } else if (path == "/wait") {
+        Wait(conn, GetQueryInt(query, "peer_id"), keep_alive);
+    } else if (path == "/message" && method == "POST") {
+        int from = GetQueryInt(query, "peer_id");
+        Member* to = FindMember(GetQueryInt(query, "to"));
+        if (!FindMember(from) || !to) {
+            Respond(conn, 500, "Peer Not Found", -1, keep_alive, nullptr);
+            return;
+        }
+        Deliver(to, Delivery{from, body ? body : std::make_shared<const std::string>()});
+        Respond(conn, 200, "OK", from, keep_alive, nullptr);
+    } else if (path == "/sign_out") {
+        int id = GetQueryInt(query, "peer_id");
+        if (!FindMember(id)) {
+            Respond(conn, 500, "Peer Not Found", -1, keep_alive, nullptr);
+            return;
+        }
+        SignOut(id);
+        Respond(conn, 200, "OK", id, keep_alive, nullptr);
+    } else if (path == "/ws") {
+        std::string lower_headers = headers;
+        Lower(&lower_headers);
+        std::string upgrade = GetHeader(lower_headers, lower_headers, "upgrade");
+        std::string key = GetHeader(lower_headers, headers, "sec-websocket-key");
+        if (upgrade != "websocket" || key.empty() || query.empty()) {
+            Respond(conn, 400, "Bad Request", -1, false, nullptr);
+            return;
+        }
+        AcceptWebSocket(conn, query, key);
+    } else {
+        Respond(conn, 404, "Not Found", -1, keep_alive, nullptr);
+    }
+}
+
+void SignalingServer::SignIn(Connection* conn, const std::string& name, bool keep_alive) {
+    if (name.empty()) {
+        Respond(conn, 400, "Bad Request", -1, keep_alive, nullptr);
+        return;
+    }
+    Member& member = members_[next_id_];
+    member.id = next_id_++;
+    member.name = name;
+    member.waiting = nullptr;
+    member.websocket = nullptr;
+    member.last_seen_ms = NowMs();
+
+    // Our own entry first, then everyone else.
+    std::shared_ptr<std::string> list = std::make_shared<std::string>(PeerEntry(member, true));
+    for (const auto& entry : members_) {
+        if (entry.first != member.id)
+            *list += PeerEntry(entry.second, true);
+    }
+    Respond(conn, 200, "Added", member.id, keep_alive, list);
+    NotifyOthers(member, true);
+}
+
+void SignalingServer::AcceptWebSocket(Connection* conn, const std::string& name,
+                                      const std::string& key) {
+    Member& member = members_[next_id_];
+    member.id = next_id_++;
+    member.name = name;
+    member.waiting = nullptr;
+    member.websocket = conn;
+    member.last_seen_ms = NowMs();
+    conn->websocket_member = member.id;
+
+    Output response;
+    response.head = "HTTP/1.1 101 Switching Protocols\r\n"
+                    "Upgrade: websocket\r\n"
+                    "Connection: Upgrade\r\n"
+                    "Sec-WebSocket-Accept: " + ComputeAcceptKey(key) + "\r\n"
+                    "Pragma: " + std::to_string(member.id) + "\r\n\r\n";
+    Queue(conn, std::move(response));
+
+    // The first frame is the peer list, like the /sign_in body.
+    std::shared_ptr<std::string> list = std::make_shared<std::string>(PeerEntry(member, true));
+    for (const auto& entry : members_) {
+        if (entry.first != member.id)
+            *list += PeerEntry(entry.second, true);
+    }
+    SendFrame(conn, kOpText, std::to_string(member.id) + "\n", list);
+    NotifyOthers(member, true);
+}
+
+void SignalingServer::SignOut(int id) {
+    auto it = members_.find(id);
+    if (it == members_.end())
+        return;
+    Member member = std::move(it->second);
+    members_.erase(it);
+
+    if (member.waiting) {
+        member.waiting->parked_for = -1;
+        member.waiting->close_after_write = true;
+        UpdateEvents(member.waiting);
+    }
+    if (member.websocket) {
+        member.websocket->websocket_member = -1;
+        // Status 1000, normal closure.
+        SendFrame(member.websocket, kOpClose, std::string("\x03\xe8", 2), nullptr);
+        member.websocket->close_after_write = true;
+        UpdateEvents(member.websocket);
+    }
+    NotifyOthers(member, false);
+}
+
+void SignalingServer::Wait(Connection* conn, int id, bool keep_alive) {
+    Member* member = FindMember(id);
+    if (!member || member->websocket) {
+        Respond(conn, 500, "Peer Not Found", -1, keep_alive, nullptr);
+        return;
+    }
+    member->last_seen_ms = NowMs();
+    if (!member->queue.empty()) {
+        Delivery delivery = std::move(member->queue.front());
+        member->queue.pop_front();
+        Respond(conn, 200, "OK", delivery.pragma, keep_alive, delivery.body);
+        return;
+    }
+    if (member->waiting && member->waiting != conn) {
+        // A newer wait replaces the old one.
+        member->waiting->parked_for = -1;
+        member->waiting->close_after_write = true;
+        UpdateEvents(member->waiting);
+    }
+    member->waiting = conn;
+    conn->parked_for = id;
+    conn->parked_keep_alive = keep_alive;
+}
+
+void SignalingServer::Deliver(Member* to, Delivery delivery) {
+    if (to->websocket) {
+        SendFrame(to->websocket, kOpText, std::to_string(delivery.pragma) + "\n",
+                  std::move(delivery.body));
+        return;
+    }
+    if (to->waiting) {
+        Connection* conn = to->waiting;
+        to->waiting = nullptr;
+        to->last_seen_ms = NowMs();
+        conn->parked_for = -1;
+        conn->last_read_ms = to->last_seen_ms;
+        Respond(conn, 200, "OK", delivery.pragma, conn->parked_keep_alive,
+                std::move(delivery.body));
+        resume_.push_back(conn->key);
+        return;
+    }
+    if (to->queue.size() >= kMaxQueuedDeliveries) {
+        fprintf(stderr, "Dropping a message for peer %d; it isn't reading\n", to->id);
+        to->queue.pop_front();
+    }
+    to->queue.push_back(std::move(delivery));
+}
+
+void SignalingServer::NotifyOthers(const Member& changed, bool connected) {
+    // One payload shared by every notification.
+    Payload entry = std::make_shared<const std::string>(PeerEntry(changed, connected));
+    for (auto& other : members_) {
+        if (other.first != changed.id)
+            Deliver(&other.second, Delivery{other.first, entry});
+    }
+}
+
+void SignalingServer::ProcessFrames(Connection* conn) {
+    size_t pos = 0;
+    while (conn->websocket_member != -1 && !conn->close_after_write) {
+        size_t available = conn->in.size() - pos;
+        if (available < 2)
+            break;
+        const uint8_t* header = reinterpret_cast<const uint8_t*>(conn->in.data() + pos);
+        bool fin = (header[0] & 0x80) != 0;
+        uint8_t opcode = header[0] & 0x0f;
+        bool masked = (header[1] & 0x80) != 0;
+        uint64_t length = header[1] & 0x7f;
+        size_t header_size = 2;
+        if (length == 126) {
+            if (available < 4)
+                break;
+            length = (header[2] << 8) | header[3];
+            header_size = 4;
+        } else if (length == 127) {
+            if (available < 10)
+                break;
+            length = 0;
+            for (int i = 0; i < 8; ++i)
+                length = (length << 8) | header[2 + i];
+            header_size = 10;
+        }
+        // Clients must mask (RFC 6455, section 5.1).
+        if (!masked || length > kMaxBodySize) {
+            SignOut(conn->websocket_member);
+            break;
+        }
+        header_size += 4;
+        if (available < header_size + length)
+            break;
+
+        char* payload = &conn->in[pos + header_size];
+        const uint8_t* mask = header + header_size - 4;
+        for (size_t i = 0; i < length; ++i)
+            payload[i] ^= mask[i % 4];
+        pos += header_size + length;
+
+        switch (opcode) {
+        case kOpText:
+        case kOpBinary:
+            conn->fragments.assign(payload, length);
+            break;
+        case kOpContinuation:
+            conn->fragments.append(payload, length);
+            break;
+        case kOpPing:
+            SendFrame(conn, kOpPong, std::string(payload, length), nullptr);
+            continue;
+        case kOpPong:
+            continue;
+        case kOpClose:
+            SignOut(conn->websocket_member);
+            continue;
+        default:
+            continue;
+        }
+        if (!fin)
+            continue;
+
+        // "<to>\n<body>"
+        size_t eol = conn->fragments.find('\n');
+        Member* to = eol == std::string::npos
+                ? nullptr : FindMember(atoi(conn->fragments.c_str()));
+        if (to) {
+            Deliver(to, Delivery{conn->websocket_member,
+                                 std::make_shared<const std::string>(
+                                     conn->fragments, eol + 1)});
+        }
+        conn->fragments.clear();
+    }
+    conn->in.erase(0, pos);
+}
+
+void SignalingServer::Respond(Connection* conn, int status, const char* reason,
+                              int pragma, bool keep_alive, Payload body) {
+    Output response;
+    response.head = "HTTP/1.1 " + std::to_string(status) + " " + reason + "\r\n";
+    response.head += "Server: webrtc-demo-signaling\r\n"
+                     "Cache-Control: no-cache\r\n";
+    response.head += keep_alive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+    response.head += "Content-Type: text/plain\r\n"
+                     "Content-Length: " + std::to_string(body ? body->size() : 0) + "\r\n";
+    if (pragma >= 0)
+        response.head += "Pragma: " + std::to_string(pragma) + "\r\n";
+    response.head += "Access-Control-Allow-Origin: *\r\n"
+                     "Access-Control-Expose-Headers: Content-Length, X-Peer-Id\r\n\r\n";
+    response.body = std::move(body);
+    if (!keep_alive)
+        conn->close_after_write = true;
+    Queue(conn, std::move(response));
+}
+
+void SignalingServer::SendFrame(Connection* conn, uint8_t opcode,
+                                const std::string& prefix, Payload body) {
+    size_t length = prefix.size() + (body ? body->size() : 0);
+    Output frame;
+    frame.head.reserve(10 + prefix.size());
+    frame.head += static_cast<char>(0x80 | opcode);
+    // Server frames aren't masked.
+    if (length < 126) {
+        frame.head += static_cast<char>(length);
+    } else if (length <= 0xffff) {
+        frame.head += static_cast<char>(126);
+        frame.head += static_cast<char>(length >> 8);
+        frame.head += static_cast<char>(length & 0xff);
+    } else {
+        frame.head += static_cast<char>(127);
+        for (int shift = 56; shift >= 0; shift -= 8)
+            frame.head += static_cast<char>((static_cast<uint64_t>(length) >> shift) & 0xff);
+    }
+    frame.head += prefix;
+    frame.body = std::move(body);
+    Queue(conn, std::move(frame));
+}
+
+std::string SignalingServer::PeerEntry(const Member& member, bool connected) const {
+    return member.name + "," + std::to_string(member.id) + "," +
+            (connected ? "1" : "0") + "\n";
+}
+
+SignalingServer::Member* SignalingServer::FindMember(int id) {
+    auto it = members_.find(id);
+    return it == members_.end() ? nullptr : &it->second;
+}
@@ -0,0 +1,160 @@
+#ifndef SIGNALINGSERVER_H
+#define SIGNALINGSERVER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// epoll-based signaling server speaking the same protocol as
+// peerconnection_server, which is what PeerConnectionClient expects:
+//
+//   GET  /sign_in?<name>              -> peer list, our id in Pragma
+//   GET  /wait?peer_id=<id>           -> parked until a message or a
+//                                        notification is ready for <id>
+//   POST /message?peer_id=<from>&to=<to>
+//   GET  /sign_out?peer_id=<id>
+//
+// plus the single-connection WebSocket variant of WebSocketTransport
+// (GET /ws?<name>).  HTTP/1.1 connections are kept alive and pipelined
+// requests are answered in order.
+//
+// Connections that send nothing for the idle timeout are closed, which also
+// catches half-open ones whose client vanished without a FIN.  Parked waits
+// are idle by design: they are answered with an empty notification so that
+// a live client asks again, and a member with neither a wait nor a
+// WebSocket for that long is signed out.  WebSockets are pinged halfway
+// through.
+//
+// Message bodies are read once into a reference-counted payload and queued
+// to recipients by reference; responses go out straight from that payload
+// with a gathering write.  Linux only.
+class SignalingServer
+{
+public:
+    SignalingServer();
+    ~SignalingServer();
+
+    // Binds to |port| on all interfaces; 0 picks a free one, see port().
+    bool Listen(int port);
+    // Serves until Stop() is called.
+    void Run();
+    // Safe to call from a signal handler or another thread.
+    void Stop();
+    // 0 disables the idle sweep.  Call before Run().
+    void set_idle_timeout_ms(int ms) { idle_timeout_ms_ = ms; }
+
+    // The port listened on, once Listen() succeeded.
+    int port() const { return port_; }
+    size_t peer_count() const { return members_.size(); }
+    size_t connection_count() const { return connections_.size(); }
+
+private:
+    typedef std::shared_ptr<const std::string> Payload;
+
+    // One chunk of output: a small per-recipient head (status line and
+    // headers, or a WebSocket frame header) and an optional shared body.
+    struct Output {
+        std::string head;
+        Payload body;
+    };
+
+    // Something waiting to be delivered to a member.
+    struct Delivery {
+        // The sender, or the recipient itself for peer list notifications.
+        int pragma;
+        Payload body;
+    };
+
+    struct Connection {
+        Connection(uint64_t key, int fd);
+
+        // epoll user data; unlike fds, keys are never reused.
+        uint64_t key;
+        int fd;
+        // When the client last sent something; see SweepIdle().
+        int64_t last_read_ms;
+        bool ping_sent;
+        std::string in;
+        std::deque<Output> out;
+        // Bytes of out.front() already written.
+        size_t out_offset;
+        bool want_write;
+        bool close_after_write;
+        // A /wait is parked on this connection; further pipelined requests
+        // wait behind it.
+        int parked_for;
+        bool parked_keep_alive;
+        // Set once the connection has been upgraded.
+        int websocket_member;
+        std::string fragments;
+    };
+
+    struct Member {
+        int id;
+        std::string name;
+        Connection* waiting;
+        Connection* websocket;
+        // Last sign of life: a request, or the end of its previous wait.
+        int64_t last_seen_ms;
+        std::deque<Delivery> queue;
+    };
+
+    void Accept();
+    void HandleEvent(uint64_t key, uint32_t events);
+    void OnReadable(Connection* conn);
+    void OnWritable(Connection* conn);
+    void CloseConnection(Connection* conn);
+    void UpdateEvents(Connection* conn);
+    // Runs every quarter of the idle timeout.
+    void SweepIdle();
+
+    // Handles as many complete requests (or frames) as are buffered.
+    void ProcessInput(Connection* conn);
+    // Never closes |conn| directly; errors are answered and the connection
+    // is closed once the answer is out.
+    void HandleRequest(Connection* conn, const std::string& method,
+                       const std::string& target, bool keep_alive,
+                       const std::string& headers, Payload body);
+    void ProcessFrames(Connection* conn);
+
+    void SignIn(Connection* conn, const std::string& name, bool keep_alive);
+    void AcceptWebSocket(Connection* conn, const std::string& name,
+                         const std::string& key);
+    // Closes the member's parked wait or WebSocket once it's flushed.
+    void SignOut(int id);
+    void Wait(Connection* conn, int id, bool keep_alive);
+    // Queues |delivery| for |to| or hands it to its parked wait or socket.
+    void Deliver(Member* to, Delivery delivery);
+    void NotifyOthers(const Member& changed, bool connected);
+
+    // |pragma| < 0 leaves the header out.
+    void Respond(Connection* conn, int status, const char* reason,
+                 int pragma, bool keep_alive, Payload body);
+    void SendFrame(Connection* conn, uint8_t opcode, const std::string& prefix,
+                   Payload body);
+    void Queue(Connection* conn, Output output);
+
+    std::string PeerEntry(const Member& member, bool connected) const;
+    Member* FindMember(int id);
+
+    int epoll_fd_;
+    int listen_fd_;
+    int port_;
+    int wakeup_fd_;
+    int timer_fd_;
+    int idle_timeout_ms_;
+    bool running_;
+    int next_id_;
+    uint64_t next_key_;
+    std::unordered_map<uint64_t, std::unique_ptr<Connection>> connections_;
+    std::unordered_map<int, Member> members_;
+    // Parked connections that got their response; their pipelined requests
+    // are picked up after the current batch of events.
+    std::vector<uint64_t> resume_;
+};
+
+#endif // SIGNALINGSERVER_H
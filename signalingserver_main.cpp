@@ -0,0 +1,62 @@
+#include <signal.h>
+#include <stdio.h>
+#include <sys/resource.h>
+#include "rtc_base/flags.h"
+
+#include "signalingserver.h"
+
+// Stand-alone signaling server; a drop-in for peerconnection_server.
+
+WEBRTC_DEFINE_bool(help, false, "Prints this message");
+WEBRTC_DEFINE_int(port, 8888, "The port to listen on.");
+WEBRTC_DEFINE_int(idle_timeout,
+                  60,
+                  "Seconds a connection may stay silent before it is closed, "
+                  "its wait answered or its WebSocket pinged; 0 never.");
+
+namespace {
+
+SignalingServer* g_server = nullptr;
+
+void OnSignal(int) {
+    if (g_server)
+        g_server->Stop();
+}
+
+// Every parked /wait holds a descriptor; allow as many as the hard limit.
+void RaiseFileLimit() {
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+    rtc::FlagList::SetFlagsFromCommandLine(&argc, argv, true);
+    if (FLAG_help) {
+        rtc::FlagList::Print(NULL, false);
+        return 0;
+    }
+    if ((FLAG_port < 1) || (FLAG_port > 65535)) {
+        fprintf(stderr, "Error: %i is not a valid port.\n", FLAG_port);
+        return -1;
+    }
+
+    RaiseFileLimit();
+    SignalingServer server;
+    server.set_idle_timeout_ms(FLAG_idle_timeout * 1000);
+    if (!server.Listen(FLAG_port))
+        return -1;
+    g_server = &server;
+    signal(SIGINT, OnSignal);
+    signal(SIGTERM, OnSignal);
+
+    printf("Server listening on port %i\n", FLAG_port);
+    server.Run();
+    g_server = nullptr;
+    return 0;
+}
@@ -0,0 +1,273 @@
+#include "tests.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <string>
+#include <thread>
+
+#include "signalingserver.h"
+
+namespace {
+
+const int kReadTimeoutMs = 2000;
+
+// A blocking client speaking raw HTTP and WebSocket frames, so that the
+// server is checked against the protocol rather than against our client.
+class RawClient
+{
+public:
+    explicit RawClient(int port) : fd_(socket(AF_INET, SOCK_STREAM, 0)) {
+        timeval timeout = {kReadTimeoutMs / 1000, (kReadTimeoutMs % 1000) * 1000};
+        setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        connected_ = connect(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+    }
+    ~RawClient() { close(fd_); }
+
+    bool connected() const { return connected_; }
+
+    bool Send(const std::string& data) {
+        return send(fd_, data.data(), data.size(), MSG_NOSIGNAL) ==
+                static_cast<ssize_t>(data.size());
+    }
+
+    // The head of the next HTTP response; its body is left buffered.
+    bool ReadHead(std::string* head) {
+        size_t eoh;
+        while ((eoh = buffer_.find("\r\n\r\n")) == std::string::npos) {
+            if (!Fill())
+                return false;
+        }
+        head->assign(buffer_, 0, eoh + 4);
+        buffer_.erase(0, eoh + 4);
+        return true;
+    }
+
+    bool ReadBytes(size_t count, std::string* data) {
+        while (buffer_.size() < count) {
+            if (!Fill())
+                return false;
+        }
+        data->assign(buffer_, 0, count);
+        buffer_.erase(0, count);
+        return true;
+    }
+
+    // Status and body of the next response, which must have a Content-Length.
+    bool ReadResponse(int* status, std::string* head, std::string* body) {
+        if (!ReadHead(head))
+            return false;
+        *status = atoi(head->c_str() + head->find(' ') + 1);
+        size_t length = head->find("Content-Length: ");
+        if (length == std::string::npos)
+            return false;
+        return ReadBytes(atoi(head->c_str() + length + 16), body);
+    }
+
+    // A client frame: always masked, here with a fixed key.
+    bool SendFrame(uint8_t opcode, const std::string& payload) {
+        const uint8_t mask[4] = {0x12, 0x34, 0x56, 0x78};
+        std::string frame;
+        frame += static_cast<char>(0x80 | opcode);
+        if (payload.size() < 126) {
+            frame += static_cast<char>(0x80 | payload.size());
+        } else {
+            frame += static_cast<char>(0x80 | 126);
+            frame += static_cast<char>(payload.size() >> 8);
+            frame += static_cast<char>(payload.size() & 0xff);
+        }
+        frame.append(reinterpret_cast<const char*>(mask), 4);
+        for (size_t i = 0; i < payload.size(); ++i)
+            frame += static_cast<char>(payload[i] ^ mask[i % 4]);
+        return Send(frame);
+    }
+
+    // The next unfragmented server frame.
+    bool ReadFrame(uint8_t* opcode, std::string* payload) {
+        std::string header;
+        if (!ReadBytes(2, &header))
+            return false;
+        *opcode = header[0] & 0x0f;
+        uint64_t length = header[1] & 0x7f;
+        if (length >= 126) {
+            std::string extended;
+            if (!ReadBytes(length == 126 ? 2 : 8, &extended))
+                return false;
+            length = 0;
+            for (char c : extended)
+                length = (length << 8) | static_cast<uint8_t>(c);
+        }
+        return ReadBytes(length, payload);
+    }
+
+    // Skips whatever else arrives; true if the server then closed the
+    // connection, false if the read timed out.
+    bool ReadClosed() {
+        buffer_.clear();
+        char data[4096];
+        ssize_t bytes;
+        while ((bytes = recv(fd_, data, sizeof(data), 0)) > 0) {
+        }
+        return bytes == 0;
+    }
+
+private:
+    bool Fill() {
+        char data[4096];
+        ssize_t bytes = recv(fd_, data, sizeof(data), 0);
+        if (bytes <= 0)
+            return false;
+        buffer_.append(data, bytes);
+        return true;
+    }
+
+    int fd_;
+    bool connected_;
+    std::string buffer_;
+};
+
+// Upgrades |client| as |name|; |id| gets the member id from the first
+// frame, which also carries the peer list.
+bool OpenWebSocket(RawClient* client, const std::string& name, int* id) {
+    std::string head;
+    if (!client->Send("GET /ws?" + name + " HTTP/1.1\r\n"
+                      "Host: localhost\r\n"
+                      "Upgrade: websocket\r\n"
+                      "Connection: Upgrade\r\n"
+                      "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                      "Sec-WebSocket-Version: 13\r\n\r\n") ||
+            !client->ReadHead(&head))
+        return false;
+    // The example key from RFC 6455, section 1.3.
+    if (head.compare(0, 12, "HTTP/1.1 101") != 0 ||
+            head.find("Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n") ==
+                std::string::npos)
+        return false;
+    uint8_t opcode;
+    std::string list;
+    if (!client->ReadFrame(&opcode, &list) || opcode != 0x1)
+        return false;
+    *id = atoi(list.c_str());
+    return list.find(name + "," + std::to_string(*id) + ",1\n") != std::string::npos;
+}
+
+// Serves on a free port from its own thread for the scope of a case.
+class ServerThread
+{
+public:
+    explicit ServerThread(int idle_timeout_ms) {
+        server_.set_idle_timeout_ms(idle_timeout_ms);
+        listening_ = server_.Listen(0);
+        if (listening_)
+            thread_ = std::thread([this]() { server_.Run(); });
+    }
+    ~ServerThread() {
+        if (listening_) {
+            server_.Stop();
+            thread_.join();
+        }
+    }
+
+    bool listening() const { return listening_; }
+    int port() const { return server_.port(); }
+
+private:
+    SignalingServer server_;
+    bool listening_;
+    std::thread thread_;
+};
+
+}  // namespace
+
+// Two members on /ws: sign-in notification, a message each way, and the
+// sign-out notification when one sends a close frame.
+TEST(SignalingServerWebSocketRoundTrip) {
+    ServerThread server(0);
+    ASSERT_TRUE(server.listening());
+    RawClient alice(server.port());
+    RawClient bob(server.port());
+    ASSERT_TRUE(alice.connected() && bob.connected());
+
+    int alice_id = -1;
+    int bob_id = -1;
+    ASSERT_TRUE(OpenWebSocket(&alice, "alice", &alice_id));
+    ASSERT_TRUE(OpenWebSocket(&bob, "bob", &bob_id));
+
+    uint8_t opcode = 0;
+    std::string payload;
+    ASSERT_TRUE(alice.ReadFrame(&opcode, &payload));
+    EXPECT_EQ(payload, std::to_string(alice_id) + "\nbob," + std::to_string(bob_id) + ",1\n");
+
+    ASSERT_TRUE(alice.SendFrame(0x1, std::to_string(bob_id) + "\n{\"type\":\"offer\"}"));
+    ASSERT_TRUE(bob.ReadFrame(&opcode, &payload));
+    EXPECT_EQ(static_cast<int>(opcode), 0x1);
+    EXPECT_EQ(payload, std::to_string(alice_id) + "\n{\"type\":\"offer\"}");
+
+    // A body past the 125-byte short form.
+    std::string answer(300, 'a');
+    ASSERT_TRUE(bob.SendFrame(0x1, std::to_string(alice_id) + "\n" + answer));
+    ASSERT_TRUE(alice.ReadFrame(&opcode, &payload));
+    EXPECT_EQ(payload, std::to_string(bob_id) + "\n" + answer);
+
+    ASSERT_TRUE(alice.SendFrame(0x8, std::string("\x03\xe8", 2)));
+    ASSERT_TRUE(alice.ReadFrame(&opcode, &payload));
+    EXPECT_EQ(static_cast<int>(opcode), 0x8);
+    EXPECT_TRUE(alice.ReadClosed());
+    ASSERT_TRUE(bob.ReadFrame(&opcode, &payload));
+    EXPECT_EQ(payload, std::to_string(bob_id) + "\nalice," + std::to_string(alice_id) + ",0\n");
+}
+
+// What the idle sweep does to each kind of connection.
+TEST(SignalingServerIdleTimeout) {
+    const int kIdleTimeoutMs = 200;
+    ServerThread server(kIdleTimeoutMs);
+    ASSERT_TRUE(server.listening());
+
+    // Connected but silent, as a half-open connection looks: closed.
+    RawClient silent(server.port());
+    ASSERT_TRUE(silent.connected());
+    EXPECT_TRUE(silent.ReadClosed());
+
+    // A parked wait: answered with an empty notification, after which the
+    // member is still signed in and can wait again.
+    RawClient polling(server.port());
+    ASSERT_TRUE(polling.connected());
+    int status = 0;
+    std::string head;
+    std::string body;
+    ASSERT_TRUE(polling.Send("GET /sign_in?poller HTTP/1.1\r\n\r\n"));
+    ASSERT_TRUE(polling.ReadResponse(&status, &head, &body));
+    EXPECT_EQ(status, 200);
+    int id = atoi(body.c_str() + body.find(',') + 1);
+    std::string wait = "GET /wait?peer_id=" + std::to_string(id) + " HTTP/1.1\r\n\r\n";
+    ASSERT_TRUE(polling.Send(wait));
+    ASSERT_TRUE(polling.ReadResponse(&status, &head, &body));
+    EXPECT_EQ(status, 200);
+    EXPECT_TRUE(body.empty());
+    EXPECT_TRUE(head.find("Pragma: " + std::to_string(id) + "\r\n") != std::string::npos);
+    ASSERT_TRUE(polling.Send(wait));
+    ASSERT_TRUE(polling.ReadResponse(&status, &head, &body));
+    EXPECT_EQ(status, 200);
+
+    // A WebSocket that doesn't answer the ping: closed.
+    RawClient socket(server.port());
+    ASSERT_TRUE(socket.connected());
+    int socket_id = -1;
+    ASSERT_TRUE(OpenWebSocket(&socket, "quiet", &socket_id));
+    uint8_t opcode = 0;
+    std::string payload;
+    // The poller showing up in its list comes first.
+    do {
+        ASSERT_TRUE(socket.ReadFrame(&opcode, &payload));
+    } while (opcode == 0x1);
+    EXPECT_EQ(static_cast<int>(opcode), 0x9);
+    EXPECT_TRUE(socket.ReadClosed());
+}
@@ -0,0 +1,46 @@
+#ifndef SIGNALINGTRANSPORT_H
+#define SIGNALINGTRANSPORT_H
+
+#include <string>
+
+#include "rtc_base/socket_address.h"
+
+// Events a SignalingTransport reports back to PeerConnectionClient.  Peer
+// entries use the same "<name>,<id>,<connected>" lines as the /sign_in and
+// /wait responses of the hanging-GET protocol.
+struct SignalingTransportObserver {
+  // Sign-in accepted.  |peer_list| holds one entry per line.
+  virtual void OnTransportSignedIn(int my_id, const std::string& peer_list) = 0;
+  // A peer joined or left; |entry| is a single line.
+  virtual void OnTransportPeerNotification(const std::string& entry) = 0;
+  virtual void OnTransportMessage(int peer_id, const std::string& message) = 0;
+  // The server does not speak this transport.  Only reported before sign-in
+  // completes, so the client can fall back to the hanging-GET protocol.
+  virtual void OnTransportRejected() = 0;
+  // The connection is gone, either after SignOut() or because the server
+  // dropped it.
+  virtual void OnTransportClosed(int err) = 0;
+
+ protected:
+  virtual ~SignalingTransportObserver() {}
+};
+
+// Alternative wire protocol for PeerConnectionClient.  When one is installed
+// the client routes sign-in, peer notifications and peer messages through it
+// instead of its built-in control socket / hanging-GET pair.
+class SignalingTransport {
+ public:
+  virtual ~SignalingTransport() {}
+
+  virtual void RegisterObserver(SignalingTransportObserver* observer) = 0;
+
+  virtual bool SignIn(const rtc::SocketAddress& server,
+                      const std::string& client_name) = 0;
+  virtual bool Send(int peer_id, const std::string& message) = 0;
+  // Starts an orderly sign-out; OnTransportClosed() follows.
+  virtual bool SignOut() = 0;
+  // Drops the connection without notifying the observer.
+  virtual void Close() = 0;
+};
+
+#endif // SIGNALINGTRANSPORT_H
@@ -0,0 +1,43 @@
+#include "bench.h"
+
+#include "rtc_base/physical_socket_server.h"
+#include "rtc_base/thread.h"
+#include "customsocketserver.h"
+
+namespace {
+
+const int kIdleMs = 2000;
+
+void PrintIdle(const char* label, int64_t cpu_us, uint64_t wakeups) {
+    printf("  %-40s %8.2f ms CPU/s %8.1f wakeups/s\n", label,
+           cpu_us / 1000.0 / (kIdleMs / 1000.0),
+           wakeups / (kIdleMs / 1000.0));
+}
+
+}  // namespace
+
+// CPU an idle main thread burns: nothing is signed in, no timers run.  Run
+// it again with QT_NO_GLIB=1 for the sliced wait used where Qt can't wake
+// the socket server.
+BENCHMARK(IdleMainLoop) {
+    {
+        // What Wait() did before it blocked: poll with a zero timeout.
+        rtc::PhysicalSocketServer server;
+        uint64_t polls = 0;
+        int64_t cpu_start_us = BenchCpuTimeUs();
+        int64_t end_ns = BenchNowNs() + kIdleMs * 1000000LL;
+        while (BenchNowNs() < end_ns) {
+            server.Wait(0, true);
+            ++polls;
+        }
+        PrintIdle("zero-timeout polling", BenchCpuTimeUs() - cpu_start_us, polls);
+    }
+    {
+        CustomSocketServer server;
+        rtc::AutoSocketServerThread thread(&server);
+        int64_t cpu_start_us = BenchCpuTimeUs();
+        thread.ProcessMessages(kIdleMs);
+        PrintIdle("CustomSocketServer", BenchCpuTimeUs() - cpu_start_us,
+                  server.waitCount());
+    }
+}
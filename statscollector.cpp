@@ -0,0 +1,290 @@
+#include "statscollector.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#include "api/stats/rtcstats_objects.h"
+#include "rtc_base/ref_counted_object.h"
+#include "rtc_base/time_utils.h"
+
+namespace {
+
+// Room for the whole exposition at 16 calls without regrowing.
+const size_t kTextReserve = 16 * 1024;
+
+template <typename T>
+void Take(const webrtc::RTCStatsMember<T>& member, T* out) {
+    if (member.is_defined())
+        *out = *member;
+}
+
+// Appends "# HELP"/"# TYPE" for one metric family.
+void AppendFamily(std::string* text, const char* name, const char* type,
+                  const char* help) {
+    *text += "# HELP ";
+    *text += name;
+    *text += ' ';
+    *text += help;
+    *text += "\n# TYPE ";
+    *text += name;
+    *text += ' ';
+    *text += type;
+    *text += '\n';
+}
+
+void AppendSample(std::string* text, const char* name, int peer_id, double value) {
+    char line[128];
+    int length = snprintf(line, sizeof(line), "%s{peer=\"%d\"} %.17g\n",
+                          name, peer_id, value);
+    if (length > 0)
+        text->append(line, std::min(static_cast<size_t>(length), sizeof(line) - 1));
+}
+
+void AppendValue(std::string* text, const char* name, double value) {
+    char line[128];
+    int length = snprintf(line, sizeof(line), "%s %.17g\n", name, value);
+    if (length > 0)
+        text->append(line, std::min(static_cast<size_t>(length), sizeof(line) - 1));
+}
+
+// One per-call metric: name, type, help and where to read it.
+struct Family {
+    const char* name;
+    const char* type;
+    const char* help;
+    double (*get)(const CallMetrics&);
+};
+
+const Family kFamilies[] = {
+    {"webrtc_packets_received_total", "counter", "RTP packets received.",
+     [](const CallMetrics& m) { return static_cast<double>(m.packets_received); }},
+    {"webrtc_packets_lost_total", "counter", "RTP packets lost.",
+     [](const CallMetrics& m) { return static_cast<double>(m.packets_lost); }},
+    {"webrtc_bytes_received_total", "counter", "RTP payload bytes received.",
+     [](const CallMetrics& m) { return static_cast<double>(m.bytes_received); }},
+    {"webrtc_packets_sent_total", "counter", "RTP packets sent.",
+     [](const CallMetrics& m) { return static_cast<double>(m.packets_sent); }},
+    {"webrtc_bytes_sent_total", "counter", "RTP payload bytes sent.",
+     [](const CallMetrics& m) { return static_cast<double>(m.bytes_sent); }},
+    {"webrtc_samples_received_total", "counter", "Audio samples received.",
+     [](const CallMetrics& m) { return static_cast<double>(m.total_samples_received); }},
+    {"webrtc_concealed_samples_total", "counter", "Audio samples concealed.",
+     [](const CallMetrics& m) { return static_cast<double>(m.concealed_samples); }},
+    {"webrtc_concealment_events_total", "counter", "Concealment events.",
+     [](const CallMetrics& m) { return static_cast<double>(m.concealment_events); }},
+    {"webrtc_jitter_buffer_delay_seconds_total", "counter",
+     "Summed jitter buffer delay of emitted samples.",
+     [](const CallMetrics& m) { return m.jitter_buffer_delay_seconds; }},
+    {"webrtc_jitter_seconds", "gauge", "Interarrival jitter.",
+     [](const CallMetrics& m) { return m.jitter_seconds; }},
+    {"webrtc_round_trip_time_seconds", "gauge", "RTT of the selected candidate pair.",
+     [](const CallMetrics& m) { return m.round_trip_time_seconds; }},
+    {"webrtc_audio_level", "gauge", "Received audio level, 0 to 1.",
+     [](const CallMetrics& m) { return m.audio_level; }},
+};
+
+}  // namespace
+
+CallMetrics::CallMetrics() {
+    Clear();
+}
+
+void CallMetrics::Clear() {
+    peer_id = -1;
+    updated_ms = 0;
+    packets_received = 0;
+    packets_lost = 0;
+    bytes_received = 0;
+    packets_sent = 0;
+    bytes_sent = 0;
+    total_samples_received = 0;
+    concealed_samples = 0;
+    concealment_events = 0;
+    jitter_buffer_delay_seconds = 0;
+    jitter_seconds = 0;
+    round_trip_time_seconds = 0;
+    audio_level = 0;
+}
+
+StatsSlotCallback::StatsSlotCallback(StatsCollector* collector, size_t slot)
+    : collector_(collector), slot_(slot), pending_(false), generation_(0) {
+}
+
+void StatsSlotCallback::OnStatsDelivered(
+        const rtc::scoped_refptr<const webrtc::RTCStatsReport>& report) {
+    pending_ = false;
+    if (collector_)
+        collector_->OnStatsDelivered(slot_, generation_, *report);
+}
+
+StatsCollector::StatsCollector(size_t max_calls, QObject *parent)
+    : QObject{parent},
+      metrics_(max_calls),
+      peer_connections_(max_calls),
+      generations_(max_calls, 0),
+      event_queue_stats_(nullptr),
+      start_us_(0),
+      busy_us_(0),
+      polls_(0),
+      reports_(0) {
+    callbacks_.reserve(max_calls);
+    for (size_t i = 0; i < max_calls; ++i)
+        callbacks_.push_back(new rtc::RefCountedObject<StatsSlotCallback>(this, i));
+    text_.reserve(kTextReserve);
+    connect(&timer_, &QTimer::timeout, this, &StatsCollector::Poll);
+}
+
+StatsCollector::~StatsCollector() {
+    // Reports still in flight land on a detached callback.
+    for (const auto& callback : callbacks_)
+        callback->Detach();
+}
+
+void StatsCollector::Start(int interval_ms) {
+    if (interval_ms <= 0) {
+        timer_.stop();
+        return;
+    }
+    start_us_ = rtc::TimeMicros();
+    busy_us_ = 0;
+    timer_.start(interval_ms);
+}
+
+void StatsCollector::AddCall(int peer_id, webrtc::PeerConnectionInterface* peer_connection) {
+    int slot = FindSlot(peer_id);
+    if (slot == -1)
+        slot = FindSlot(-1);
+    if (slot == -1)
+        return;
+    metrics_[slot].Clear();
+    metrics_[slot].peer_id = peer_id;
+    peer_connections_[slot] = peer_connection;
+    ++generations_[slot];
+}
+
+void StatsCollector::RemoveCall(int peer_id) {
+    int slot = FindSlot(peer_id);
+    if (slot == -1)
+        return;
+    metrics_[slot].Clear();
+    peer_connections_[slot] = nullptr;
+    ++generations_[slot];
+}
+
+int StatsCollector::FindSlot(int peer_id) const {
+    for (size_t i = 0; i < metrics_.size(); ++i) {
+        if (metrics_[i].peer_id == peer_id)
+            return static_cast<int>(i);
+    }
+    return -1;
+}
+
+void StatsCollector::Poll() {
+    ++polls_;
+    for (size_t i = 0; i < peer_connections_.size(); ++i) {
+        // Don't stack requests up behind a slow report.
+        if (!peer_connections_[i] || callbacks_[i]->pending())
+            continue;
+        callbacks_[i]->Request(generations_[i]);
+        peer_connections_[i]->GetStats(callbacks_[i].get());
+    }
+}
+
+void StatsCollector::OnStatsDelivered(size_t slot, uint64_t generation,
+                                      const webrtc::RTCStatsReport& report) {
+    int64_t start = rtc::TimeMicros();
+    CallMetrics& metrics = metrics_[slot];
+    // The call ended while the report was being made, and maybe another
+    // took its slot.
+    if (generation != generations_[slot])
+        return;
+
+    // Iterate the report directly; GetStatsOfType() would build a vector.
+    for (const webrtc::RTCStats& stats : report) {
+        const char* type = stats.type();
+        if (type == webrtc::RTCInboundRTPStreamStats::kType) {
+            const auto& inbound = stats.cast_to<webrtc::RTCInboundRTPStreamStats>();
+            uint32_t packets = static_cast<uint32_t>(metrics.packets_received);
+            int32_t lost = static_cast<int32_t>(metrics.packets_lost);
+            Take(inbound.packets_received, &packets);
+            Take(inbound.packets_lost, &lost);
+            Take(inbound.bytes_received, &metrics.bytes_received);
+            Take(inbound.jitter, &metrics.jitter_seconds);
+            metrics.packets_received = packets;
+            metrics.packets_lost = lost;
+        } else if (type == webrtc::RTCOutboundRTPStreamStats::kType) {
+            const auto& outbound = stats.cast_to<webrtc::RTCOutboundRTPStreamStats>();
+            uint32_t packets = static_cast<uint32_t>(metrics.packets_sent);
+            Take(outbound.packets_sent, &packets);
+            Take(outbound.bytes_sent, &metrics.bytes_sent);
+            metrics.packets_sent = packets;
+        } else if (type == webrtc::RTCIceCandidatePairStats::kType) {
+            const auto& pair = stats.cast_to<webrtc::RTCIceCandidatePairStats>();
+            if (pair.nominated.is_defined() && *pair.nominated)
+                Take(pair.current_round_trip_time, &metrics.round_trip_time_seconds);
+        } else if (type == webrtc::RTCMediaStreamTrackStats::kType) {
+            const auto& track = stats.cast_to<webrtc::RTCMediaStreamTrackStats>();
+            if (!track.remote_source.is_defined() || !*track.remote_source)
+                continue;
+            Take(track.audio_level, &metrics.audio_level);
+            Take(track.total_samples_received, &metrics.total_samples_received);
+            Take(track.concealed_samples, &metrics.concealed_samples);
+            Take(track.concealment_events, &metrics.concealment_events);
+            Take(track.jitter_buffer_delay, &metrics.jitter_buffer_delay_seconds);
+        }
+    }
+    metrics.updated_ms = rtc::TimeMillis();
+    ++reports_;
+    busy_us_ += rtc::TimeMicros() - start;
+    emit updated();
+}
+
+double StatsCollector::overhead() const {
+    int64_t wall = rtc::TimeMicros() - start_us_;
+    return wall > 0 && start_us_ != 0 ? static_cast<double>(busy_us_) / wall : 0.0;
+}
+
+const std::string& StatsCollector::RenderPrometheus() {
+    text_.clear();
+    for (const Family& family : kFamilies) {
+        AppendFamily(&text_, family.name, family.type, family.help);
+        for (const CallMetrics& metrics : metrics_) {
+            if (metrics.peer_id != -1)
+                AppendSample(&text_, family.name, metrics.peer_id, family.get(metrics));
+        }
+    }
+
+    AppendFamily(&text_, "webrtc_stats_polls_total", "counter", "GetStats() rounds.");
+    AppendValue(&text_, "webrtc_stats_polls_total", static_cast<double>(polls_));
+    AppendFamily(&text_, "webrtc_stats_reports_total", "counter", "Reports converted.");
+    AppendValue(&text_, "webrtc_stats_reports_total", static_cast<double>(reports_));
+    AppendFamily(&text_, "webrtc_stats_overhead_ratio", "gauge",
+                 "Share of wall time spent converting reports.");
+    AppendValue(&text_, "webrtc_stats_overhead_ratio", overhead());
+
+    if (event_queue_stats_) {
+        const EventQueueStats& events = *event_queue_stats_;
+        AppendFamily(&text_, "webrtc_event_queue_depth", "gauge",
+                     "Events waiting for the Qt thread when the last batch started.");
+        AppendValue(&text_, "webrtc_event_queue_depth", static_cast<double>(events.depth));
+        AppendFamily(&text_, "webrtc_event_queue_max_depth", "gauge",
+                     "Most events ever waiting when a batch started.");
+        AppendValue(&text_, "webrtc_event_queue_max_depth", static_cast<double>(events.max_depth));
+        AppendFamily(&text_, "webrtc_event_queue_capacity", "gauge", "Event queue slots.");
+        AppendValue(&text_, "webrtc_event_queue_capacity", static_cast<double>(events.capacity));
+        AppendFamily(&text_, "webrtc_event_queue_pushed_total", "counter", "Events queued.");
+        AppendValue(&text_, "webrtc_event_queue_pushed_total", static_cast<double>(events.pushed));
+        AppendFamily(&text_, "webrtc_event_queue_overflowed_total", "counter",
+                     "Events queued past the capacity rather than dropped.");
+        AppendValue(&text_, "webrtc_event_queue_overflowed_total",
+                    static_cast<double>(events.overflowed));
+        AppendFamily(&text_, "webrtc_event_queue_dropped_total", "counter",
+                     "Events turned away by a full queue.");
+        AppendValue(&text_, "webrtc_event_queue_dropped_total", static_cast<double>(events.dropped));
+        AppendFamily(&text_, "webrtc_event_queue_batches_total", "counter",
+                     "Batches handled on the Qt thread.");
+        AppendValue(&text_, "webrtc_event_queue_batches_total", static_cast<double>(events.batches));
+    }
+    return text_;
+}
@@ -0,0 +1,127 @@
+#ifndef STATSCOLLECTOR_H
+#define STATSCOLLECTOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <QObject>
+#include <QTimer>
+
+#include "api/peer_connection_interface.h"
+#include "api/stats/rtc_stats_collector_callback.h"
+#include "api/stats/rtc_stats_report.h"
+#include "eventqueue.h"
+
+class StatsCollector;
+
+// Flat per-call figures taken from the last RTCStatsReport.  Counters are
+// cumulative as reported by WebRTC; gauges are the latest value.
+struct CallMetrics {
+    CallMetrics();
+    void Clear();
+
+    int peer_id;
+    int64_t updated_ms;
+
+    // Counters.
+    uint64_t packets_received;
+    int64_t packets_lost;
+    uint64_t bytes_received;
+    uint64_t packets_sent;
+    uint64_t bytes_sent;
+    uint64_t total_samples_received;
+    uint64_t concealed_samples;
+    uint64_t concealment_events;
+    double jitter_buffer_delay_seconds;
+
+    // Gauges.
+    double jitter_seconds;
+    double round_trip_time_seconds;
+    double audio_level;
+};
+
+// Delivers one peer's report to the collector.  There is one per slot,
+// created up front and reused for every poll.  A report carries the slot's
+// generation at request time, so one requested for a call that has since
+// been replaced in the slot is dropped.
+class StatsSlotCallback : public webrtc::RTCStatsCollectorCallback
+{
+public:
+    StatsSlotCallback(StatsCollector* collector, size_t slot);
+
+    void Detach() { collector_ = nullptr; }
+    bool pending() const { return pending_; }
+    void Request(uint64_t generation) {
+        pending_ = true;
+        generation_ = generation;
+    }
+
+    void OnStatsDelivered(
+            const rtc::scoped_refptr<const webrtc::RTCStatsReport>& report) override;
+
+private:
+    StatsCollector* collector_;
+    const size_t slot_;
+    bool pending_;
+    uint64_t generation_;
+};
+
+// Polls GetStats() on every call at a fixed interval and keeps the figures
+// in preallocated slots, so steady-state collection doesn't allocate.
+// Renders them in the Prometheus text format and tracks its own cost:
+// time spent converting reports against wall time.
+class StatsCollector : public QObject
+{
+    Q_OBJECT
+public:
+    explicit StatsCollector(size_t max_calls, QObject *parent = 0);
+    ~StatsCollector();
+
+    // Starts polling; 0 stops.
+    void Start(int interval_ms);
+    bool running() const { return timer_.isActive(); }
+
+    // Conductor keeps these in step with its sessions.
+    void AddCall(int peer_id, webrtc::PeerConnectionInterface* peer_connection);
+    void RemoveCall(int peer_id);
+
+    // Also rendered, if set; must outlive us.
+    void SetEventQueueStats(const EventQueueStats* stats) { event_queue_stats_ = stats; }
+
+    // Slots in use; entries with peer_id == -1 are free.
+    const std::vector<CallMetrics>& calls() const { return metrics_; }
+
+    // Prometheus text exposition of everything above, rebuilt in a buffer
+    // that is reused between calls.
+    const std::string& RenderPrometheus();
+
+    // Fraction of wall time spent in OnStatsDelivered() since Start().
+    double overhead() const;
+
+signals:
+    void updated();
+
+private:
+    friend class StatsSlotCallback;
+
+    void Poll();
+    void OnStatsDelivered(size_t slot, uint64_t generation,
+                          const webrtc::RTCStatsReport& report);
+    int FindSlot(int peer_id) const;
+
+    QTimer timer_;
+    std::vector<CallMetrics> metrics_;
+    std::vector<rtc::scoped_refptr<webrtc::PeerConnectionInterface>> peer_connections_;
+    std::vector<rtc::scoped_refptr<StatsSlotCallback>> callbacks_;
+    // Bumped whenever a slot changes hands.
+    std::vector<uint64_t> generations_;
+    const EventQueueStats* event_queue_stats_;
+    std::string text_;
+    int64_t start_us_;
+    int64_t busy_us_;
+    uint64_t polls_;
+    uint64_t reports_;
+};
+
+#endif // STATSCOLLECTOR_H
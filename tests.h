@@ -0,0 +1,60 @@
+#ifndef TESTS_H
+#define TESTS_H
+
+#include <sstream>
+#include <string>
+
+// A few lines of harness for webrtc-tests.pro, the counterpart of bench.h.
+// Each *_test.cpp defines its cases with TEST(); tests_main.cpp runs the
+// ones whose name contains the first command line argument, or all of them,
+// and exits non-zero if any check failed.
+//
+//   TEST(ConnectOrderAlternates) {
+//       EXPECT_EQ(order.size(), 4u);
+//       ASSERT_TRUE(!order.empty());  // Returns from the case on failure.
+//   }
+
+typedef void (*TestFunction)();
+
+class TestRegistration
+{
+public:
+    TestRegistration(const char* name, TestFunction function);
+
+    // Runs the registered cases whose name contains |filter|; all when null.
+    // Returns the number of failed cases.
+    static int RunAll(const char* filter);
+
+private:
+    const char* name_;
+    TestFunction function_;
+    TestRegistration* next_;
+};
+
+// Records a failed check of the running case; returns |passed|.
+bool TestCheck(bool passed, const char* expression, const std::string& values,
+               const char* file, int line);
+
+template <typename A, typename B>
+std::string TestValues(const A& a, const B& b) {
+    std::ostringstream out;
+    out << a << " vs " << b;
+    return out.str();
+}
+
+#define TEST(name)                                                           \
+    static void name();                                                      \
+    static TestRegistration name##_registration(#name, name);                \
+    static void name()
+
+#define EXPECT_TRUE(condition)                                               \
+    TestCheck(!!(condition), #condition, std::string(), __FILE__, __LINE__)
+#define EXPECT_EQ(a, b)                                                      \
+    TestCheck((a) == (b), #a " == " #b, TestValues((a), (b)), __FILE__, __LINE__)
+#define ASSERT_TRUE(condition)                                               \
+    do {                                                                     \
+        if (!EXPECT_TRUE(condition))                                         \
+            return;                                                          \
+    } while (0)
+
+#endif // TESTS_H
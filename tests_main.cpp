@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "tests.h"
+
+// Checks of the signaling and queueing code that run without a network or
+// a sound card; see tests.h.
+//
+//   webrtc-tests [filter]
+
+namespace {
+
+TestRegistration* registrations = nullptr;
+int failed_checks = 0;
+
+}  // namespace
+
+TestRegistration::TestRegistration(const char* name, TestFunction function)
+    : name_(name), function_(function), next_(registrations) {
+    registrations = this;
+}
+
+int TestRegistration::RunAll(const char* filter) {
+    int failed = 0;
+    int ran = 0;
+    for (TestRegistration* test = registrations; test; test = test->next_) {
+        if (filter && !strstr(test->name_, filter))
+            continue;
+        int failed_before = failed_checks;
+        test->function_();
+        bool passed = failed_checks == failed_before;
+        printf("%s %s\n", passed ? "PASS" : "FAIL", test->name_);
+        fflush(stdout);
+        if (!passed)
+            ++failed;
+        ++ran;
+    }
+    printf("%d of %d passed\n", ran - failed, ran);
+    return ran == 0 ? 1 : failed;
+}
+
+bool TestCheck(bool passed, const char* expression, const std::string& values,
+               const char* file, int line) {
+    if (passed)
+        return true;
+    ++failed_checks;
+    fprintf(stderr, "%s:%d: check failed: %s", file, line, expression);
+    if (!values.empty())
+        fprintf(stderr, " (%s)", values.c_str());
+    fprintf(stderr, "\n");
+    return false;
+}
+
+int main(int argc, char *argv[])
+{
+    const char* filter = argc > 1 ? argv[1] : nullptr;
+    return TestRegistration::RunAll(filter) == 0 ? 0 : 1;
+}
@@ -0,0 +1,201 @@
+#include "threadtopology.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <algorithm>
+#include <utility>
+#include <QDebug>
+
+#include "rtc_base/location.h"
+#include "rtc_base/null_socket_server.h"
+#include "rtc_base/socket_server.h"
+#include "rtc_base/time_utils.h"
+
+#include "tracer.h"
+
+#if defined(WEBRTC_MAC)
+#include <mach/mach.h>
+#include <mach/thread_policy.h>
+#endif
+
+namespace {
+
+bool PinCurrentThread(int cpu) {
+#if defined(WEBRTC_LINUX) || defined(WEBRTC_ANDROID)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#elif defined(WEBRTC_MAC)
+    // macOS has no hard affinity, only a tag: threads with different tags
+    // are spread over different L2 caches.
+    thread_affinity_policy_data_t policy = {cpu + 1};
+    return thread_policy_set(pthread_mach_thread_np(pthread_self()),
+                             THREAD_AFFINITY_POLICY,
+                             reinterpret_cast<thread_policy_t>(&policy),
+                             THREAD_AFFINITY_POLICY_COUNT) == KERN_SUCCESS;
+#else
+    return false;
+#endif
+}
+
+// Same mapping as rtc::PlatformThread::SetPriority(); normal and low leave
+// the thread on the default time-sharing scheduler.
+bool SetCurrentThreadPriority(rtc::ThreadPriority priority) {
+    if (priority == rtc::kNormalPriority || priority == rtc::kLowPriority)
+        return true;
+
+    const int policy = SCHED_FIFO;
+    const int min_prio = sched_get_priority_min(policy);
+    const int max_prio = sched_get_priority_max(policy);
+    if (min_prio == -1 || max_prio == -1)
+        return false;
+    if (max_prio - min_prio <= 2)
+        return false;
+
+    const int top_prio = max_prio - 1;
+    const int low_prio = min_prio + 1;
+    sched_param param;
+    switch (priority) {
+    case rtc::kHighPriority:
+        param.sched_priority = std::max(top_prio - 2, low_prio);
+        break;
+    case rtc::kHighestPriority:
+        param.sched_priority = std::max(top_prio - 1, low_prio);
+        break;
+    default:
+        param.sched_priority = top_prio;
+        break;
+    }
+    return pthread_setschedparam(pthread_self(), policy, &param) == 0;
+}
+
+}  // namespace
+
+InstrumentedThread::InstrumentedThread(
+        const std::string& name,
+        std::unique_ptr<rtc::SocketServer> socket_server)
+    : rtc::Thread(std::move(socket_server)),
+      busy_time_us_(0),
+      dispatched_(0),
+      max_dispatch_time_us_(0) {
+    SetName(name, this);
+}
+
+InstrumentedThread::~InstrumentedThread() {
+    // rtc::Thread subclasses have to stop the thread themselves.
+    Stop();
+}
+
+void InstrumentedThread::Dispatch(rtc::Message* pmsg) {
+    TRACE_SCOPE("Dispatch");
+    int64_t start = rtc::TimeMicros();
+    rtc::Thread::Dispatch(pmsg);
+    int64_t elapsed = rtc::TimeMicros() - start;
+
+    busy_time_us_ += elapsed;
+    ++dispatched_;
+    int64_t max = max_dispatch_time_us_.load(std::memory_order_relaxed);
+    while (elapsed > max &&
+           !max_dispatch_time_us_.compare_exchange_weak(max, elapsed,
+                                                        std::memory_order_relaxed)) {
+    }
+}
+
+ThreadTopology::ThreadTopology()
+    : signaling_thread_(nullptr),
+      start_time_us_(0) {
+}
+
+ThreadTopology::~ThreadTopology() {
+    Stop();
+}
+
+bool ThreadTopology::Start() {
+    if (started())
+        return true;
+
+    signaling_thread_ = rtc::Thread::Current();
+    network_thread_.reset(new InstrumentedThread(
+                              "network", rtc::SocketServer::CreateDefault()));
+    worker_thread_.reset(new InstrumentedThread(
+                             "worker", std::unique_ptr<rtc::SocketServer>(
+                                 new rtc::NullSocketServer())));
+    if (!network_thread_->Start() || !worker_thread_->Start()) {
+        qDebug() << "Failed to start the WebRTC threads";
+        Stop();
+        return false;
+    }
+    start_time_us_ = rtc::TimeMicros();
+
+    ApplyPlacement(network_thread_.get(), "network", network_placement_);
+    ApplyPlacement(worker_thread_.get(), "worker", worker_placement_);
+    return true;
+}
+
+void ThreadTopology::Stop() {
+    worker_thread_.reset();
+    network_thread_.reset();
+    signaling_thread_ = nullptr;
+}
+
+void ThreadTopology::ApplyPlacement(rtc::Thread* thread,
+                                    const std::string& name,
+                                    const ThreadPlacement& placement) {
+    thread->Invoke<void>(RTC_FROM_HERE, [&name, &placement]() {
+        if (placement.cpu >= 0 && !PinCurrentThread(placement.cpu)) {
+            qDebug() << "Failed to pin the" << name.c_str() << "thread to cpu"
+                     << placement.cpu;
+        }
+        if (!SetCurrentThreadPriority(placement.priority)) {
+            qDebug() << "Failed to raise the priority of the" << name.c_str()
+                     << "thread";
+        }
+    });
+}
+
+std::vector<ThreadStats> ThreadTopology::GetStats() const {
+    std::vector<ThreadStats> stats;
+    if (!started())
+        return stats;
+
+    int64_t uptime_us = rtc::TimeMicros() - start_time_us_;
+    const InstrumentedThread* owned[] = {network_thread_.get(),
+                                         worker_thread_.get()};
+    for (const InstrumentedThread* thread : owned) {
+        ThreadStats entry;
+        entry.name = thread->name();
+        entry.queue_depth = thread->size();
+        entry.busy_time_us = thread->busy_time_us();
+        entry.dispatched = thread->dispatched();
+        entry.max_dispatch_time_us = thread->max_dispatch_time_us();
+        entry.uptime_us = uptime_us;
+        stats.push_back(entry);
+    }
+
+    ThreadStats signaling;
+    signaling.name = "signaling";
+    signaling.queue_depth = signaling_thread_->size();
+    signaling.busy_time_us = -1;
+    signaling.dispatched = -1;
+    signaling.max_dispatch_time_us = -1;
+    signaling.uptime_us = uptime_us;
+    stats.push_back(signaling);
+    return stats;
+}
+
+void ThreadTopology::LogStats() const {
+    for (const ThreadStats& entry : GetStats()) {
+        if (entry.busy_time_us < 0) {
+            qDebug() << entry.name.c_str() << "queue:" << entry.queue_depth;
+            continue;
+        }
+        double load = entry.uptime_us > 0
+                ? 100.0 * entry.busy_time_us / entry.uptime_us : 0.0;
+        qDebug() << entry.name.c_str() << "queue:" << entry.queue_depth
+                 << "busy:" << entry.busy_time_us / 1000 << "ms"
+                 << "(" << load << "%)"
+                 << "messages:" << entry.dispatched
+                 << "longest:" << entry.max_dispatch_time_us << "us";
+    }
+}
@@ -0,0 +1,104 @@
+#ifndef THREADTOPOLOGY_H
+#define THREADTOPOLOGY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rtc_base/platform_thread.h"
+#include "rtc_base/thread.h"
+
+// An rtc::Thread that accounts the time it spends dispatching messages.
+class InstrumentedThread : public rtc::Thread
+{
+public:
+    InstrumentedThread(const std::string& name,
+                       std::unique_ptr<rtc::SocketServer> socket_server);
+    ~InstrumentedThread() override;
+
+    // Time spent in Dispatch() since Start().  Synchronous Invoke()s run
+    // outside Dispatch() and aren't included.
+    int64_t busy_time_us() const { return busy_time_us_; }
+    int64_t dispatched() const { return dispatched_; }
+    int64_t max_dispatch_time_us() const { return max_dispatch_time_us_; }
+
+protected:
+    void Dispatch(rtc::Message* pmsg) override;
+
+private:
+    std::atomic<int64_t> busy_time_us_;
+    std::atomic<int64_t> dispatched_;
+    std::atomic<int64_t> max_dispatch_time_us_;
+};
+
+// Where a thread runs: a core to pin it to and a scheduling priority.
+struct ThreadPlacement {
+    ThreadPlacement() : cpu(-1), priority(rtc::kNormalPriority) {}
+    // -1 lets the OS schedule the thread on any core.
+    int cpu;
+    rtc::ThreadPriority priority;
+};
+
+struct ThreadStats {
+    std::string name;
+    // Messages waiting, including delayed ones.
+    size_t queue_depth;
+    // -1 for threads we don't own (signaling).
+    int64_t busy_time_us;
+    int64_t dispatched;
+    int64_t max_dispatch_time_us;
+    // Since Start(), for turning busy time into a load figure.
+    int64_t uptime_us;
+};
+
+// Owns the network and worker threads handed to the PeerConnectionFactory so
+// they can be pinned, prioritized, observed and shared with other
+// components.  Audio encoding and decoding run on the worker thread; the
+// network thread does socket I/O.  ADM callbacks run there only with
+// TestAudioDeviceModule: a platform ADM calls back on its own audio
+// threads, so don't lean on the worker thread to serialize with them.
+// Signaling stays on the thread that calls Start() (the Qt/main loop), which
+// is where Conductor expects its callbacks.
+class ThreadTopology
+{
+public:
+    ThreadTopology();
+    ~ThreadTopology();
+
+    void set_network_placement(const ThreadPlacement& placement) {
+        network_placement_ = placement;
+    }
+    void set_worker_placement(const ThreadPlacement& placement) {
+        worker_placement_ = placement;
+    }
+
+    // Starts the threads and applies their placement.  Placement failures
+    // (no such core, no permission for real-time scheduling) are logged and
+    // otherwise ignored.
+    bool Start();
+    void Stop();
+    bool started() const { return network_thread_ != nullptr; }
+
+    rtc::Thread* network_thread() const { return network_thread_.get(); }
+    rtc::Thread* worker_thread() const { return worker_thread_.get(); }
+    rtc::Thread* signaling_thread() const { return signaling_thread_; }
+
+    std::vector<ThreadStats> GetStats() const;
+    void LogStats() const;
+
+private:
+    static void ApplyPlacement(rtc::Thread* thread, const std::string& name,
+                               const ThreadPlacement& placement);
+
+    ThreadPlacement network_placement_;
+    ThreadPlacement worker_placement_;
+    std::unique_ptr<InstrumentedThread> network_thread_;
+    std::unique_ptr<InstrumentedThread> worker_thread_;
+    rtc::Thread* signaling_thread_;
+    int64_t start_time_us_;
+};
+
+#endif // THREADTOPOLOGY_H
@@ -0,0 +1,97 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "rtc_base/location.h"
+#include "rtc_base/message_handler.h"
+#include "rtc_base/time_utils.h"
+#include "threadtopology.h"
+
+namespace {
+
+// The ADM asks for audio every 10 ms.
+const int kTickMs = 10;
+const size_t kTicks = 300;
+
+// Reposts itself every kTickMs on the worker and records how late each
+// message ran.
+class Ticker : public rtc::MessageHandler
+{
+public:
+    explicit Ticker(rtc::Thread* thread)
+        : thread_(thread), posted_us_(0), done_(false) {}
+
+    void Start() {
+        posted_us_ = rtc::TimeMicros();
+        thread_->PostDelayed(RTC_FROM_HERE, kTickMs, this);
+    }
+    void OnMessage(rtc::Message* msg) override {
+        lateness_us_.push_back(rtc::TimeMicros() - posted_us_ - kTickMs * 1000);
+        if (lateness_us_.size() < kTicks)
+            Start();
+        else
+            done_ = true;
+    }
+
+    bool done() const { return done_; }
+    // Only once done().
+    std::vector<int64_t>* lateness_us() { return &lateness_us_; }
+
+private:
+    rtc::Thread* thread_;
+    int64_t posted_us_;
+    std::vector<int64_t> lateness_us_;
+    std::atomic<bool> done_;
+};
+
+void MeasureJitter(const char* label, const ThreadPlacement& worker) {
+    ThreadTopology threads;
+    threads.set_worker_placement(worker);
+    if (!threads.Start())
+        return;
+
+    // Every core busy, and the calling thread standing in for a UI thread
+    // that doesn't yield.
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> hogs;
+    for (unsigned i = 0; i < std::max(1u, std::thread::hardware_concurrency()); ++i) {
+        hogs.emplace_back([&stop]() {
+            while (!stop.load(std::memory_order_relaxed)) {
+            }
+        });
+    }
+
+    Ticker ticker(threads.worker_thread());
+    ticker.Start();
+    while (!ticker.done()) {
+    }
+    stop = true;
+    for (std::thread& hog : hogs)
+        hog.join();
+
+    std::vector<int64_t>& lateness = *ticker.lateness_us();
+    std::sort(lateness.begin(), lateness.end());
+    printf("  %-40s p50 %6lld us  p99 %6lld us  max %6lld us\n", label,
+           static_cast<long long>(lateness[lateness.size() / 2]),
+           static_cast<long long>(lateness[lateness.size() * 99 / 100]),
+           static_cast<long long>(lateness.back()));
+}
+
+}  // namespace
+
+// How late a 10 ms task on the worker thread runs while every core and the
+// main thread are busy: with the placement WebRTC's own threads get, and
+// pinned with real-time priority (--worker_cpu, --realtime_audio).  Real-time
+// priority needs CAP_SYS_NICE or an rtprio limit; without them the second
+// line logs a failure and matches the first.
+BENCHMARK(WorkerJitterUnderLoad) {
+    MeasureJitter("default placement", ThreadPlacement());
+
+    ThreadPlacement pinned;
+    pinned.cpu = static_cast<int>(std::max(1u, std::thread::hardware_concurrency())) - 1;
+    pinned.priority = rtc::kRealtimePriority;
+    MeasureJitter("pinned, realtime priority", pinned);
+}
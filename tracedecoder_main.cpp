@@ -0,0 +1,122 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <unordered_map>
+
+#include "tracer.h"
+
+// Turns a --trace_file recording into Chrome trace JSON:
+//
+//   tracedecoder <trace file> [<output.json>]
+//
+// Load the output in chrome://tracing or ui.perfetto.dev.
+
+namespace {
+
+void WriteEscaped(FILE* out, const std::string& text) {
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\')
+            fprintf(out, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(out, "\\u%04x", c);
+        else
+            fputc(c, out);
+    }
+}
+
+bool ReadText(FILE* in, int64_t length, std::string* text) {
+    if (length < 0 || length > 0xffff)
+        return false;
+    text->resize(static_cast<size_t>(length));
+    return length == 0 || fread(&(*text)[0], 1, text->size(), in) == text->size();
+}
+
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "usage: %s <trace file> [<output.json>]\n", argv[0]);
+        return 1;
+    }
+    FILE* in = fopen(argv[1], "rb");
+    if (!in) {
+        fprintf(stderr, "Can't open %s: %s\n", argv[1], strerror(errno));
+        return 1;
+    }
+    FILE* out = argc == 3 ? fopen(argv[2], "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "Can't open %s: %s\n", argv[2], strerror(errno));
+        return 1;
+    }
+
+    TraceFileHeader header;
+    if (fread(&header, sizeof(header), 1, in) != 1 ||
+            memcmp(header.magic, kTraceMagic, sizeof(header.magic)) != 0) {
+        fprintf(stderr, "%s is not a trace file\n", argv[1]);
+        return 1;
+    }
+    if (header.version != kTraceVersion) {
+        fprintf(stderr, "Unsupported trace version %u\n", header.version);
+        return 1;
+    }
+
+    std::unordered_map<uint16_t, std::string> names;
+    size_t events = 0;
+    const char* separator = "\n";
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+    TraceFileRecord record;
+    std::string text;
+    while (fread(&record, sizeof(record), 1, in) == 1) {
+        if (record.phase == kTraceDefineName || record.phase == kTraceDefineThread) {
+            if (!ReadText(in, record.arg, &text)) {
+                fprintf(stderr, "Truncated definition after %zu events\n", events);
+                break;
+            }
+            if (record.phase == kTraceDefineName) {
+                names[record.name_id] = text;
+                continue;
+            }
+            fprintf(out, "%s{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\","
+                         "\"args\":{\"name\":\"", separator, record.thread_id);
+            WriteEscaped(out, text);
+            fprintf(out, "\"}}");
+            separator = ",\n";
+            continue;
+        }
+
+        auto name = names.find(record.name_id);
+        if (name == names.end()) {
+            fprintf(stderr, "Undefined name id %u\n", record.name_id);
+            continue;
+        }
+        fprintf(out, "%s{\"ph\":\"%c\",\"pid\":1,\"tid\":%u,\"ts\":%lld,\"name\":\"",
+                separator, record.phase, record.thread_id,
+                static_cast<long long>(record.timestamp_us));
+        WriteEscaped(out, name->second);
+        fputc('"', out);
+        switch (record.phase) {
+        case kTraceInstant:
+            fprintf(out, ",\"s\":\"t\",\"args\":{\"arg\":%lld}",
+                    static_cast<long long>(record.arg));
+            break;
+        case kTraceCounter:
+            fprintf(out, ",\"args\":{\"value\":%lld}", static_cast<long long>(record.arg));
+            break;
+        default:
+            break;
+        }
+        fputc('}', out);
+        separator = ",\n";
+        ++events;
+    }
+
+    fprintf(out, "\n]}\n");
+    fprintf(stderr, "%zu events\n", events);
+    fclose(in);
+    if (out != stdout)
+        fclose(out);
+    return 0;
+}
@@ -0,0 +1,214 @@
+#include "tracer.h"
+
+#include <errno.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <QDebug>
+
+#include "rtc_base/thread.h"
+#include "rtc_base/time_utils.h"
+
+namespace {
+
+// How often the drainer wakes up; a ring fills in no less than
+// kCapacity events, so this only needs to beat the busiest thread's burst.
+const int kDrainIntervalMs = 50;
+const size_t kDrainChunk = 512;
+
+thread_local TraceRing* current_ring = nullptr;
+
+}  // namespace
+
+TraceRing::TraceRing(uint16_t thread_id, const std::string& thread_name)
+    : head_(0),
+      tail_(0),
+      dropped_(0),
+      thread_id_(thread_id),
+      thread_name_(thread_name) {
+}
+
+bool TraceRing::Push(const Event& event) {
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) == kCapacity) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    events_[head & (kCapacity - 1)] = event;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+size_t TraceRing::Pop(Event* out, size_t max) {
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    uint64_t available = head_.load(std::memory_order_acquire) - tail;
+    size_t count = static_cast<size_t>(std::min<uint64_t>(available, max));
+    for (size_t i = 0; i < count; ++i)
+        out[i] = events_[(tail + i) & (kCapacity - 1)];
+    tail_.store(tail + count, std::memory_order_release);
+    return count;
+}
+
+std::atomic<bool> Tracer::enabled_(false);
+
+Tracer* Tracer::Instance() {
+    // Never destroyed: threads keep pointers to their rings until they exit.
+    static Tracer* tracer = new Tracer();
+    return tracer;
+}
+
+Tracer::Tracer()
+    : stopping_(false),
+      file_(nullptr),
+      written_threads_(0),
+      scratch_(kDrainChunk) {
+}
+
+Tracer::~Tracer() {
+    Stop();
+}
+
+bool Tracer::Start(const std::string& path) {
+    if (file_)
+        return false;
+    file_ = fopen(path.c_str(), "wb");
+    if (!file_) {
+        qDebug() << "Can't open trace file" << path.c_str() << strerror(errno);
+        return false;
+    }
+    TraceFileHeader header;
+    memcpy(header.magic, kTraceMagic, sizeof(header.magic));
+    header.version = kTraceVersion;
+    fwrite(&header, sizeof(header), 1, file_);
+
+    // Anything left over from an earlier session belongs to a closed file.
+    {
+        std::lock_guard<std::mutex> lock(rings_mutex_);
+        for (const auto& ring : rings_) {
+            while (ring->Pop(scratch_.data(), scratch_.size()) > 0) {
+            }
+        }
+    }
+    names_.clear();
+    written_threads_ = 0;
+    stopping_ = false;
+    drainer_ = std::thread(&Tracer::DrainLoop, this);
+    enabled_.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+void Tracer::Stop() {
+    if (!file_)
+        return;
+    enabled_.store(false, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(drain_mutex_);
+        stopping_ = true;
+    }
+    drain_wakeup_.notify_one();
+    drainer_.join();
+    DrainAll();
+
+    uint64_t dropped = 0;
+    {
+        std::lock_guard<std::mutex> lock(rings_mutex_);
+        for (const auto& ring : rings_)
+            dropped += ring->dropped();
+    }
+    if (dropped > 0)
+        qDebug() << "Trace dropped" << dropped << "events; rings were full";
+    fclose(file_);
+    file_ = nullptr;
+}
+
+void Tracer::Record(uint8_t phase, const char* name, int64_t arg) {
+    TraceRing* ring = CurrentRing();
+    TraceRing::Event event;
+    event.timestamp_us = rtc::TimeMicros();
+    event.arg = arg;
+    event.name = name;
+    event.phase = phase;
+    ring->Push(event);
+}
+
+TraceRing* Tracer::CurrentRing() {
+    if (current_ring)
+        return current_ring;
+    // Once per thread.
+    std::string name;
+    rtc::Thread* thread = rtc::Thread::Current();
+    if (thread && !thread->name().empty())
+        name = thread->name();
+    std::lock_guard<std::mutex> lock(rings_mutex_);
+    uint16_t id = static_cast<uint16_t>(rings_.size() + 1);
+    if (name.empty())
+        name = "thread " + std::to_string(id);
+    rings_.emplace_back(new TraceRing(id, name));
+    current_ring = rings_.back().get();
+    return current_ring;
+}
+
+void Tracer::DrainLoop() {
+    std::unique_lock<std::mutex> lock(drain_mutex_);
+    while (!stopping_) {
+        drain_wakeup_.wait_for(lock, std::chrono::milliseconds(kDrainIntervalMs));
+        lock.unlock();
+        DrainAll();
+        lock.lock();
+    }
+}
+
+void Tracer::DrainAll() {
+    std::vector<TraceRing*> rings;
+    {
+        std::lock_guard<std::mutex> lock(rings_mutex_);
+        rings.reserve(rings_.size());
+        for (const auto& ring : rings_)
+            rings.push_back(ring.get());
+    }
+    for (; written_threads_ < rings.size(); ++written_threads_) {
+        const TraceRing* ring = rings[written_threads_];
+        WriteDefinition(kTraceDefineThread, ring->thread_id(), ring->thread_name());
+    }
+
+    TraceFileRecord record;
+    memset(&record, 0, sizeof(record));
+    for (TraceRing* ring : rings) {
+        record.thread_id = ring->thread_id();
+        size_t count;
+        while ((count = ring->Pop(scratch_.data(), scratch_.size())) > 0) {
+            for (size_t i = 0; i < count; ++i) {
+                const TraceRing::Event& event = scratch_[i];
+                record.timestamp_us = event.timestamp_us;
+                record.arg = event.arg;
+                record.name_id = InternName(event.name);
+                record.phase = event.phase;
+                fwrite(&record, sizeof(record), 1, file_);
+            }
+        }
+    }
+    fflush(file_);
+}
+
+void Tracer::WriteDefinition(uint8_t kind, uint16_t id, const std::string& text) {
+    TraceFileRecord record;
+    memset(&record, 0, sizeof(record));
+    record.phase = kind;
+    record.arg = static_cast<int64_t>(text.size());
+    if (kind == kTraceDefineName)
+        record.name_id = id;
+    else
+        record.thread_id = id;
+    fwrite(&record, sizeof(record), 1, file_);
+    fwrite(text.data(), 1, text.size(), file_);
+}
+
+uint16_t Tracer::InternName(const char* name) {
+    auto it = names_.find(name);
+    if (it != names_.end())
+        return it->second;
+    uint16_t id = static_cast<uint16_t>(names_.size() + 1);
+    names_.emplace(name, id);
+    WriteDefinition(kTraceDefineName, id, name);
+    return id;
+}
@@ -0,0 +1,175 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Binary event tracing for the signaling and media callbacks.
+//
+// Each thread records into its own fixed-size ring; recording is a relaxed
+// load of the enabled flag, a clock read and a few stores, with no lock and
+// no allocation.  A background thread drains the rings into a compact file
+// which tracedecoder turns into Chrome trace JSON (chrome://tracing,
+// Perfetto).  A full ring drops new events and counts them rather than
+// blocking the recording thread.
+//
+// Event names must be string literals: only the pointer is recorded and the
+// drainer interns it the first time it sees it.
+
+// Phases, as in the Chrome trace event format.
+enum TracePhase : uint8_t {
+    kTraceBegin = 'B',
+    kTraceEnd = 'E',
+    kTraceInstant = 'i',
+    kTraceCounter = 'C',
+};
+
+// File layout: a TraceFileHeader followed by TraceFileRecords.  Definition
+// records (kTraceDefineName, kTraceDefineThread) are followed by |arg| bytes
+// of UTF-8 text and assign |name_id| or |thread_id|; they always come before
+// the first event that uses the id.  Native byte order.
+const char kTraceMagic[4] = {'W', 'T', 'R', 'C'};
+const uint32_t kTraceVersion = 1;
+const uint8_t kTraceDefineName = 'N';
+const uint8_t kTraceDefineThread = 'T';
+
+struct TraceFileHeader {
+    char magic[4];
+    uint32_t version;
+};
+
+struct TraceFileRecord {
+    int64_t timestamp_us;
+    int64_t arg;
+    uint16_t name_id;
+    uint16_t thread_id;
+    uint8_t phase;
+    uint8_t reserved[3];
+};
+
+// One thread's events, written by that thread and read by the drainer.
+class TraceRing
+{
+public:
+    static const size_t kCapacity = 4096;
+
+    struct Event {
+        int64_t timestamp_us;
+        int64_t arg;
+        const char* name;
+        uint8_t phase;
+    };
+
+    TraceRing(uint16_t thread_id, const std::string& thread_name);
+
+    // Producer side; returns false (and counts a drop) when full.
+    bool Push(const Event& event);
+    // Consumer side; copies out up to |max| events.
+    size_t Pop(Event* out, size_t max);
+
+    uint16_t thread_id() const { return thread_id_; }
+    const std::string& thread_name() const { return thread_name_; }
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    static_assert((kCapacity & (kCapacity - 1)) == 0, "must be a power of two");
+
+    Event events_[kCapacity];
+    // Free-running; the slot is the index modulo kCapacity.  Padded apart
+    // so producer and drainer don't write to the same cache line (alignas
+    // would need C++17 aligned new).
+    std::atomic<uint64_t> head_;
+    char padding_[64 - sizeof(std::atomic<uint64_t>)];
+    std::atomic<uint64_t> tail_;
+    std::atomic<uint64_t> dropped_;
+    const uint16_t thread_id_;
+    const std::string thread_name_;
+};
+
+class Tracer
+{
+public:
+    static Tracer* Instance();
+
+    // Starts the drainer writing to |path|, truncating it.
+    bool Start(const std::string& path);
+    // Drains what's left and closes the file.
+    void Stop();
+
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    // Use the TRACE_* macros below rather than calling this directly.
+    void Record(uint8_t phase, const char* name, int64_t arg);
+
+private:
+    Tracer();
+    ~Tracer();
+
+    TraceRing* CurrentRing();
+    void DrainLoop();
+    void DrainAll();
+    void WriteDefinition(uint8_t kind, uint16_t id, const std::string& text);
+    uint16_t InternName(const char* name);
+
+    static std::atomic<bool> enabled_;
+
+    // Rings outlive their threads; a thread that comes back gets a new one.
+    std::mutex rings_mutex_;
+    std::vector<std::unique_ptr<TraceRing>> rings_;
+
+    // Drainer state; |file_|, |names_| and the |written_threads_| count are
+    // only touched by the drainer and by Start()/Stop() around it.
+    std::thread drainer_;
+    std::mutex drain_mutex_;
+    std::condition_variable drain_wakeup_;
+    bool stopping_;
+    FILE* file_;
+    std::unordered_map<const char*, uint16_t> names_;
+    size_t written_threads_;
+    std::vector<TraceRing::Event> scratch_;
+};
+
+// Records a begin event now and the matching end event on scope exit.
+class TraceScope
+{
+public:
+    explicit TraceScope(const char* name) : name_(nullptr) {
+        if (Tracer::enabled()) {
+            name_ = name;
+            Tracer::Instance()->Record(kTraceBegin, name, 0);
+        }
+    }
+    ~TraceScope() {
+        if (name_)
+            Tracer::Instance()->Record(kTraceEnd, name_, 0);
+    }
+
+private:
+    const char* name_;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define TRACE_INSTANT(name, arg)                                         \
+    do {                                                                 \
+        if (Tracer::enabled())                                           \
+            Tracer::Instance()->Record(kTraceInstant, name, (arg));      \
+    } while (0)
+#define TRACE_COUNTER(name, value)                                       \
+    do {                                                                 \
+        if (Tracer::enabled())                                           \
+            Tracer::Instance()->Record(kTraceCounter, name, (value));    \
+    } while (0)
+
+#endif // TRACER_H
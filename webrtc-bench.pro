@@ -0,0 +1,73 @@
+# Micro benchmarks; see bench.h.  Build in release, run with an optional
+# name filter: webrtc-bench IdleMainLoop
+QT += network
+QT -= gui
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+DEFINES += NO_SDP_DUMPS
+
+SOURCES += \
+    bench_main.cpp \
+    socketserver_bench.cpp \
+    httpresponseparser_bench.cpp \
+    threadtopology_bench.cpp \
+    signalingcodec_bench.cpp \
+    mixer_bench.cpp \
+    apm_bench.cpp \
+    conductor.cpp \
+    peerconnectionclient.cpp \
+    dnscache.cpp \
+    defaults.cpp \
+    customsocketserver.cpp \
+    websockettransport.cpp \
+    httpresponseparser.cpp \
+    peerdirectory.cpp \
+    signalingcodec.cpp \
+    peersession.cpp \
+    audioprofile.cpp \
+    buffereddatachannel.cpp \
+    callrecorder.cpp \
+    calltimeline.cpp \
+    opussettings.cpp \
+    loudestaudiomixer.cpp \
+    mixkernels.cpp \
+    threadtopology.cpp \
+    fakeaudiodevice.cpp \
+    statscollector.cpp \
+    tracer.cpp
+
+INCLUDEPATH = /Users/peppa/webRTC/webrtc/src
+
+linux:qtConfig(glib) {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += glib-2.0
+    DEFINES += HAVE_GLIB
+}
+
+HEADERS += \
+    bench.h \
+    conductor.h \
+    eventqueue.h \
+    peerconnectionclient.h \
+    dnscache.h \
+    defaults.h \
+    customsocketserver.h \
+    signalingtransport.h \
+    websockettransport.h \
+    httpresponseparser.h \
+    peerdirectory.h \
+    signalingcodec.h \
+    peersession.h \
+    audioprofile.h \
+    buffereddatachannel.h \
+    callrecorder.h \
+    calltimeline.h \
+    opussettings.h \
+    loudestaudiomixer.h \
+    mixkernels.h \
+    threadtopology.h \
+    fakeaudiodevice.h \
+    statscollector.h \
+    tracer.h
@@ -1,4 +1,4 @@
-QT += quick
+QT += quick network
 CONFIG += c++11
 
 # The following define makes your compiler emit warnings if you use
@@ -12,18 +12,50 @@ DEFINES += QT_DEPRECATED_WARNINGS
 # You can also select to disable deprecated APIs only up to a certain version of Qt.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
+# Uncomment to keep whole session descriptions and candidates out of the log.
+#DEFINES += NO_SDP_DUMPS
+
+# Uncomment to build the mixer's AVX2 loops instead of SSE2 (x86 only).
+#QMAKE_CXXFLAGS += -mavx2
+
 SOURCES += \
         main.cpp \
     conductor.cpp \
     peerconnectionclient.cpp \
+    dnscache.cpp \
     defaults.cpp \
     customsocketserver.cpp \
-    webrtcmanager.cpp
+    webrtcmanager.cpp \
+    websockettransport.cpp \
+    httpresponseparser.cpp \
+    peerdirectory.cpp \
+    signalingcodec.cpp \
+    peersession.cpp \
+    audioprofile.cpp \
+    buffereddatachannel.cpp \
+    callrecorder.cpp \
+    calltimeline.cpp \
+    opussettings.cpp \
+    loudestaudiomixer.cpp \
+    mixkernels.cpp \
+    threadtopology.cpp \
+    fakeaudiodevice.cpp \
+    filetransfer.cpp \
+    statscollector.cpp \
+    metricsserver.cpp \
+    tracer.cpp
 
 RESOURCES += qml.qrc
 
 INCLUDEPATH = /Users/peppa/webRTC/webrtc/src
 
+# Lets CustomSocketServer sleep until Qt has work; see customsocketserver.h.
+linux:qtConfig(glib) {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += glib-2.0
+    DEFINES += HAVE_GLIB
+}
+
 # Additional import path used to resolve QML modules in Qt Creator's code model
 QML_IMPORT_PATH =
 
@@ -37,8 +69,29 @@ else: unix:!android: target.path = /opt/$${TARGET}/bin
 
 HEADERS += \
     conductor.h \
+    eventqueue.h \
     peerconnectionclient.h \
+    dnscache.h \
     defaults.h \
     customsocketserver.h \
     flag_defs.h \
-    webrtcmanager.h
+    webrtcmanager.h \
+    signalingtransport.h \
+    websockettransport.h \
+    httpresponseparser.h \
+    peerdirectory.h \
+    signalingcodec.h \
+    peersession.h \
+    audioprofile.h \
+    buffereddatachannel.h \
+    callrecorder.h \
+    calltimeline.h \
+    opussettings.h \
+    loudestaudiomixer.h \
+    mixkernels.h \
+    threadtopology.h \
+    fakeaudiodevice.h \
+    filetransfer.h \
+    statscollector.h \
+    metricsserver.h \
+    tracer.h
@@ -0,0 +1,71 @@
+# Headless load generator; see loadgen_main.cpp.  Shares the signaling and
+# call code with webrtc-demo-voice.pro but needs neither QML nor a sound card.
+QT += network
+QT -= gui
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+# Thousands of descriptions go by; don't print them.
+DEFINES += NO_SDP_DUMPS
+
+SOURCES += \
+    loadgen_main.cpp \
+    loadgenerator.cpp \
+    conductor.cpp \
+    peerconnectionclient.cpp \
+    dnscache.cpp \
+    defaults.cpp \
+    customsocketserver.cpp \
+    websockettransport.cpp \
+    httpresponseparser.cpp \
+    peerdirectory.cpp \
+    signalingcodec.cpp \
+    peersession.cpp \
+    audioprofile.cpp \
+    buffereddatachannel.cpp \
+    callrecorder.cpp \
+    calltimeline.cpp \
+    opussettings.cpp \
+    loudestaudiomixer.cpp \
+    mixkernels.cpp \
+    threadtopology.cpp \
+    fakeaudiodevice.cpp \
+    statscollector.cpp \
+    tracer.cpp
+
+INCLUDEPATH = /Users/peppa/webRTC/webrtc/src
+
+# Lets CustomSocketServer sleep until Qt has work; see customsocketserver.h.
+linux:qtConfig(glib) {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += glib-2.0
+    DEFINES += HAVE_GLIB
+}
+
+HEADERS += \
+    loadgenerator.h \
+    conductor.h \
+    eventqueue.h \
+    peerconnectionclient.h \
+    dnscache.h \
+    defaults.h \
+    customsocketserver.h \
+    flag_defs.h \
+    signalingtransport.h \
+    websockettransport.h \
+    httpresponseparser.h \
+    peerdirectory.h \
+    signalingcodec.h \
+    peersession.h \
+    audioprofile.h \
+    buffereddatachannel.h \
+    callrecorder.h \
+    calltimeline.h \
+    opussettings.h \
+    loudestaudiomixer.h \
+    mixkernels.h \
+    threadtopology.h \
+    fakeaudiodevice.h \
+    statscollector.h \
+    tracer.h
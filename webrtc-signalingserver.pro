@@ -0,0 +1,14 @@
+# Stand-alone signaling server; see signalingserver.h.  Plain C++ on epoll,
+# so Linux only and no Qt.
+TEMPLATE = app
+CONFIG += c++11 console
+CONFIG -= qt app_bundle
+
+SOURCES += \
+    signalingserver_main.cpp \
+    signalingserver.cpp
+
+INCLUDEPATH = /Users/peppa/webRTC/webrtc/src
+
+HEADERS += \
+    signalingserver.h
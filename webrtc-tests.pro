@@ -0,0 +1,48 @@
+# Checks that run without a network or a sound card; see tests.h.  Run
+# with an optional name filter: webrtc-tests WebSocket
+QT += network
+QT -= gui
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+# qmake CONFIG+=tsan for a ThreadSanitizer build, which is what the
+# EventQueueContention case is for.
+tsan {
+    QMAKE_CXXFLAGS += -fsanitize=thread
+    QMAKE_LFLAGS += -fsanitize=thread
+}
+
+SOURCES += \
+    tests_main.cpp \
+    websockettransport_test.cpp \
+    signalingserver_test.cpp \
+    opussettings_test.cpp \
+    eventqueue_test.cpp \
+    dnscache_test.cpp \
+    peerconnectionclient.cpp \
+    dnscache.cpp \
+    defaults.cpp \
+    websockettransport.cpp \
+    httpresponseparser.cpp \
+    peerdirectory.cpp \
+    signalingserver.cpp \
+    opussettings.cpp \
+    tracer.cpp
+
+INCLUDEPATH = /Users/peppa/webRTC/webrtc/src
+
+HEADERS += \
+    tests.h \
+    peerconnectionclient.h \
+    dnscache.h \
+    defaults.h \
+    signalingtransport.h \
+    websockettransport.h \
+    httpresponseparser.h \
+    peerdirectory.h \
+    signalingserver.h \
+    opussettings.h \
+    eventqueue.h \
+    tracer.h
@@ -0,0 +1,10 @@
+# Converts --trace_file recordings to Chrome trace JSON; see tracer.h.
+TEMPLATE = app
+CONFIG += c++11 console
+CONFIG -= qt app_bundle
+
+SOURCES += \
+    tracedecoder_main.cpp
+
+HEADERS += \
+    tracer.h
@@ -1,8 +1,37 @@
 #include "webrtcmanager.h"
 
-WebrtcManager::WebrtcManager(QObject *parent)
-    : client(new PeerConnectionClient),
-      conductor(new Conductor(client))
+#include <QDebug>
+#include <QStringList>
+#include <QVariantMap>
+
+WebrtcManager::WebrtcManager(PeerConnectionClient *client, Conductor *conductor,
+                             FileTransferManager *fileTransfers, QObject *parent)
+    : QObject{parent},
+      client(client),
+      conductor(conductor),
+      fileTransfers(fileTransfers)
+{
+    connect(conductor, &Conductor::signedIn, this, &WebrtcManager::signedIn);
+    connect(conductor, &Conductor::disconnected, this, &WebrtcManager::disconnected);
+    connect(conductor, &Conductor::peersConnected, this, &WebrtcManager::peersConnected);
+    connect(conductor, &Conductor::peerConnected, this, &WebrtcManager::peerConnected);
+    connect(conductor, &Conductor::peerDisconnected, this, &WebrtcManager::peerDisconnected);
+    connect(conductor->stats(), &StatsCollector::updated, this, &WebrtcManager::statsUpdated);
+    connect(conductor, &Conductor::callTimelineReady, this, &WebrtcManager::callTimelineReady);
+    connect(conductor, &Conductor::dataChannelOpened, this, &WebrtcManager::dataChannelOpened);
+    connect(conductor, &Conductor::dataChannelClosed, this, &WebrtcManager::dataChannelClosed);
+    connect(conductor, &Conductor::dataChannelWritable, this, &WebrtcManager::dataChannelWritable);
+    connect(fileTransfers, &FileTransferManager::transferProgress, this, &WebrtcManager::transferProgress);
+    connect(fileTransfers, &FileTransferManager::transferFinished, this, &WebrtcManager::transferFinished);
+    connect(fileTransfers, &FileTransferManager::fileReceived, this, &WebrtcManager::fileReceived);
+    connect(conductor, &Conductor::dataChannelMessage, this,
+            [this](int peerId, const QString &label, const QByteArray &data, bool binary) {
+        if (!binary)
+            emit dataChannelMessage(peerId, label, QString::fromUtf8(data));
+    });
+}
+
+WebrtcManager::~WebrtcManager()
 {
 }
 
@@ -22,6 +51,11 @@ void WebrtcManager::connectToPeer(int peerId)
     conductor->ConnectToPeer(peerId);
 }
 
+void WebrtcManager::disconnectFromPeer(int peerId)
+{
+    conductor->DisconnectFromPeer(peerId);
+}
+
 void WebrtcManager::disconnectFromCurrentPeer()
 {
     conductor->DisconnectFromCurrentPeer();
@@ -37,3 +71,138 @@ void WebrtcManager::setAudioControl(bool mute)
     conductor->SetAudioControl(mute);
 }
 
+
+QVariantList WebrtcManager::findPeers(const QString &prefix, int limit)
+{
+    QVariantList result;
+    std::vector<const PeerInfo*> peers =
+            client->peers().FindByPrefix(prefix.toStdString(), limit > 0 ? limit : 0);
+    result.reserve(static_cast<int>(peers.size()));
+    for (const PeerInfo* peer : peers) {
+        QVariantMap entry;
+        entry["id"] = peer->id;
+        entry["name"] = QString::fromStdString(peer->name);
+        result.append(entry);
+    }
+    return result;
+}
+
+void WebrtcManager::setStatsInterval(int intervalMs)
+{
+    conductor->stats()->Start(intervalMs);
+}
+
+QVariantList WebrtcManager::callStats() const
+{
+    QVariantList result;
+    for (const CallMetrics& call : conductor->stats()->calls()) {
+        if (call.peer_id == -1)
+            continue;
+        QVariantMap entry;
+        entry["peerId"] = call.peer_id;
+        entry["packetsReceived"] = static_cast<qulonglong>(call.packets_received);
+        entry["packetsLost"] = static_cast<qlonglong>(call.packets_lost);
+        entry["packetsSent"] = static_cast<qulonglong>(call.packets_sent);
+        entry["jitter"] = call.jitter_seconds;
+        entry["roundTripTime"] = call.round_trip_time_seconds;
+        entry["audioLevel"] = call.audio_level;
+        entry["concealedSamples"] = static_cast<qulonglong>(call.concealed_samples);
+        entry["totalSamplesReceived"] = static_cast<qulonglong>(call.total_samples_received);
+        result.append(entry);
+    }
+    return result;
+}
+
+QVariantMap WebrtcManager::callTimeline(int peerId) const
+{
+    QVariantMap result;
+    CallTimeline timeline;
+    if (!conductor->GetCallTimeline(peerId, &timeline))
+        return result;
+    if (client->sign_in_time_ms() >= 0)
+        result["sign_in_ms"] = static_cast<qlonglong>(client->sign_in_time_ms());
+    for (int i = kPhaseStarted + 1; i < kCallPhaseCount; ++i) {
+        CallPhase phase = static_cast<CallPhase>(i);
+        if (timeline.reached(phase))
+            result[CallPhaseName(phase)] = static_cast<qlonglong>(timeline.OffsetMs(phase));
+    }
+    return result;
+}
+
+bool WebrtcManager::setOpusSettings(int peerId, const QVariantMap &settings)
+{
+    // Same syntax and checks as --opus.
+    QStringList entries;
+    for (auto it = settings.constBegin(); it != settings.constEnd(); ++it)
+        entries.append(it.key() + "=" + QString::number(it.value().toInt()));
+    OpusSettings opus;
+    std::string error;
+    if (!ParseOpusSettings(entries.join(",").toStdString(), &opus, &error)) {
+        qDebug() << "setOpusSettings:" << error.c_str();
+        return false;
+    }
+    if (peerId == -1) {
+        conductor->SetOpusSettings(opus);
+        return true;
+    }
+    return conductor->SetCallOpusSettings(peerId, opus);
+}
+
+bool WebrtcManager::setAudioProfile(int peerId, const QString &profile)
+{
+    AudioProfile audioProfile;
+    if (!ParseAudioProfile(profile.toStdString(), &audioProfile)) {
+        qDebug() << "setAudioProfile: unknown profile" << profile;
+        return false;
+    }
+    if (peerId == -1) {
+        conductor->SetAudioProfile(audioProfile);
+        return true;
+    }
+    return conductor->SetCallAudioProfile(peerId, audioProfile);
+}
+
+bool WebrtcManager::setRecording(int peerId, bool record)
+{
+    return conductor->SetCallRecording(peerId, record);
+}
+
+bool WebrtcManager::openDataChannel(int peerId, const QString &label,
+                                    const QVariantMap &options)
+{
+    DataChannelOptions channelOptions;
+    channelOptions.ordered = options.value("ordered", true).toBool();
+    channelOptions.max_retransmits = options.value("maxRetransmits", -1).toInt();
+    channelOptions.max_packet_life_time_ms = options.value("maxPacketLifeTime", -1).toInt();
+    if (channelOptions.max_retransmits >= 0 && channelOptions.max_packet_life_time_ms >= 0) {
+        qDebug() << "openDataChannel: maxRetransmits and maxPacketLifeTime are exclusive";
+        return false;
+    }
+    return conductor->OpenDataChannel(peerId, label.toStdString(), channelOptions) != nullptr;
+}
+
+bool WebrtcManager::sendData(int peerId, const QString &label, const QString &text)
+{
+    BufferedDataChannel *channel = conductor->FindDataChannel(peerId, label.toStdString());
+    return channel && channel->Send(text.toStdString());
+}
+
+bool WebrtcManager::closeDataChannel(int peerId, const QString &label)
+{
+    return conductor->CloseDataChannel(peerId, label.toStdString());
+}
+
+QString WebrtcManager::sendFile(int peerId, const QString &path)
+{
+    return QString::fromStdString(fileTransfers->SendFile(peerId, path.toStdString()));
+}
+
+void WebrtcManager::cancelTransfer(const QString &id)
+{
+    fileTransfers->Cancel(id.toStdString());
+}
+
+void WebrtcManager::setDownloadDirectory(const QString &directory)
+{
+    fileTransfers->SetDownloadDirectory(directory.toStdString());
+}
@@ -1,26 +1,86 @@
 #ifndef WEBRTCMANAGER_H
 #define WEBRTCMANAGER_H
 #include <QObject>
+#include <QVariantList>
+#include <QVariantMap>
+#include <QVector>
 #include "conductor.h"
+#include "filetransfer.h"
 #include "peerconnectionclient.h"
 
 
+// The QML face of the call stack main() sets up.  Borrows |client|,
+// |conductor| and |fileTransfers|, which must outlive it.
 class WebrtcManager : public QObject
 {
     Q_OBJECT
 public:
-    WebrtcManager(QObject *parent = 0);
+    WebrtcManager(PeerConnectionClient *client, Conductor *conductor,
+                  FileTransferManager *fileTransfers, QObject *parent = 0);
     virtual ~WebrtcManager();
     Q_INVOKABLE void startLogin(const QString &server, int port);
     void disconnectFromServer();
     void connectToPeer(int peerId);
+    void disconnectFromPeer(int peerId);
     void disconnectFromCurrentPeer();
     void close();
     Q_INVOKABLE void setAudioControl(bool mute);
+    // Signed-in peers whose name starts with |prefix|, as {id, name} maps.
+    Q_INVOKABLE QVariantList findPeers(const QString &prefix, int limit);
+    // Polls call statistics every |intervalMs|; 0 stops.
+    Q_INVOKABLE void setStatsInterval(int intervalMs);
+    // One map per call: peerId, jitter, roundTripTime, packetsLost, ...
+    Q_INVOKABLE QVariantList callStats() const;
+    // Setup phases of the call with |peerId| so far, as ms since the call
+    // started ("offer_created", "ice_connected", ...), plus "sign_in_ms".
+    Q_INVOKABLE QVariantMap callTimeline(int peerId) const;
+    // Opus settings for the call with |peerId|, or for calls started from
+    // now on if |peerId| is -1.  Keys: bitrate, ptime, dtx, fec, complexity
+    // and stereo; see OpusSettings.  Returns false on bad settings.
+    Q_INVOKABLE bool setOpusSettings(int peerId, const QVariantMap &settings);
+    // Capture processing ("full", "headset", "low-cpu" or "passthrough") for
+    // the call with |peerId|, or for calls started from now on if |peerId|
+    // is -1.  Takes effect at once.  Returns false on an unknown profile.
+    Q_INVOKABLE bool setAudioProfile(int peerId, const QString &profile);
+    // Starts or stops recording the call with |peerId|.  Needs --record_dir.
+    Q_INVOKABLE bool setRecording(int peerId, bool record);
+    // Opens a data channel on the call with |peerId|.  Options: ordered
+    // (default true), and maxRetransmits or maxPacketLifeTime (ms) for a
+    // partially reliable channel.
+    Q_INVOKABLE bool openDataChannel(int peerId, const QString &label,
+                                     const QVariantMap &options);
+    // False if the channel is closed or its send queue is full; wait for
+    // dataChannelWritable() then.
+    Q_INVOKABLE bool sendData(int peerId, const QString &label, const QString &text);
+    Q_INVOKABLE bool closeDataChannel(int peerId, const QString &label);
+    // Sends the file at |path| to the call with |peerId|.  Returns the
+    // transfer id, or an empty string on error.
+    Q_INVOKABLE QString sendFile(int peerId, const QString &path);
+    Q_INVOKABLE void cancelTransfer(const QString &id);
+    // Where files from peers are saved; empty refuses them.
+    Q_INVOKABLE void setDownloadDirectory(const QString &directory);
+
+signals:
+    void signedIn();
+    void disconnected();
+    void peersConnected(const QVector<int> &ids);
+    void peerConnected(int id, const QString &name);
+    void peerDisconnected(int id);
+    void statsUpdated();
+    void callTimelineReady(int peerId, const QString &json);
+    void dataChannelOpened(int peerId, const QString &label);
+    void dataChannelClosed(int peerId, const QString &label);
+    // Text messages; binary ones are left to C++ users of Conductor.
+    void dataChannelMessage(int peerId, const QString &label, const QString &text);
+    void dataChannelWritable(int peerId, const QString &label);
+    void transferProgress(const QString &id, qint64 bytes, qint64 total);
+    void transferFinished(const QString &id, bool success);
+    void fileReceived(int peerId, const QString &id, const QString &path);
 
 private:
-    Conductor *conductor;
     PeerConnectionClient *client;
+    Conductor *conductor;
+    FileTransferManager *fileTransfers;
 };
 
 #endif // WEBRTCMANAGER_H
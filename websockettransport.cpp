@@ -0,0 +1,365 @@
+#include "websockettransport.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <QDebug>
+
+#include "rtc_base/checks.h"
+#include "rtc_base/helpers.h"
+#include "rtc_base/message_digest.h"
+#include "rtc_base/third_party/base64/base64.h"
+#include "rtc_base/thread.h"
+
+namespace {
+
+const uint8_t kOpContinuation = 0x0;
+const uint8_t kOpText = 0x1;
+const uint8_t kOpBinary = 0x2;
+const uint8_t kOpClose = 0x8;
+const uint8_t kOpPing = 0x9;
+const uint8_t kOpPong = 0xa;
+
+// Magic GUID from RFC 6455, section 1.3.
+const char kWebSocketGuid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+// Refuse frames larger than this; SDP blobs are a few kilobytes.
+const uint64_t kMaxMessageSize = 1024 * 1024;
+
+std::string ComputeAcceptKey(const std::string& key) {
+    std::string input = key + kWebSocketGuid;
+    unsigned char digest[20];
+    size_t length = rtc::ComputeDigest(rtc::DIGEST_SHA_1, input.data(),
+                                       input.size(), digest, sizeof(digest));
+    std::string accept;
+    rtc::Base64::EncodeFromArray(digest, length, &accept);
+    return accept;
+}
+
+// Returns the value of |name| in a header block where every line, including
+// the last, ends in "\r\n".
+std::string GetHeader(const std::string& headers, const char* name) {
+    std::string pattern = "\r\n";
+    pattern += name;
+    pattern += ": ";
+    size_t found = headers.find(pattern);
+    if (found == std::string::npos)
+        return std::string();
+    size_t begin = found + pattern.length();
+    return headers.substr(begin, headers.find("\r\n", begin) - begin);
+}
+
+}  // namespace
+
+WebSocketTransport::WebSocketTransport()
+    : observer_(NULL), state_(CLOSED), my_id_(-1), signed_in_(false), in_message_(false) {}
+
+WebSocketTransport::~WebSocketTransport() {}
+
+void WebSocketTransport::RegisterObserver(SignalingTransportObserver* observer) {
+    RTC_DCHECK(!observer_);
+    observer_ = observer;
+}
+
+bool WebSocketTransport::SignIn(const rtc::SocketAddress& server, const std::string& client_name) {
+    RTC_DCHECK(state_ == CLOSED);
+    server_address_ = server;
+    client_name_ = client_name;
+    my_id_ = -1;
+    signed_in_ = false;
+    read_buffer_.clear();
+    write_buffer_.clear();
+    fragments_.clear();
+    in_message_ = false;
+
+    socket_.reset(rtc::Thread::Current()->socketserver()->CreateAsyncSocket(
+                      server_address_.ipaddr().family(), SOCK_STREAM));
+    socket_->SignalConnectEvent.connect(this, &WebSocketTransport::OnConnect);
+    socket_->SignalReadEvent.connect(this, &WebSocketTransport::OnRead);
+    socket_->SignalWriteEvent.connect(this, &WebSocketTransport::OnWrite);
+    socket_->SignalCloseEvent.connect(this, &WebSocketTransport::OnClose);
+
+    if (socket_->Connect(server_address_) == SOCKET_ERROR) {
+        socket_.reset();
+        return false;
+    }
+    state_ = CONNECTING;
+    return true;
+}
+
+bool WebSocketTransport::Send(int peer_id, const std::string& message) {
+    if (state_ != OPEN || !signed_in_)
+        return false;
+    std::string text = std::to_string(peer_id);
+    text += '\n';
+    text += message;
+    return SendFrame(kOpText, text.data(), text.size());
+}
+
+bool WebSocketTransport::SignOut() {
+    if (state_ != OPEN) {
+        Close();
+        return false;
+    }
+    // Status 1000, normal closure.
+    const char status[] = {'\x03', '\xe8'};
+    if (!SendFrame(kOpClose, status, sizeof(status)))
+        return false;
+    state_ = CLOSING;
+    return true;
+}
+
+void WebSocketTransport::Close() {
+    if (socket_)
+        socket_->Close();
+    read_buffer_.clear();
+    write_buffer_.clear();
+    fragments_.clear();
+    in_message_ = false;
+    state_ = CLOSED;
+    signed_in_ = false;
+}
+
+void WebSocketTransport::OnConnect(rtc::AsyncSocket* socket) {
+    std::string key;
+    rtc::CreateRandomData(16, &key);
+    std::string encoded_key;
+    rtc::Base64::EncodeFromArray(key.data(), key.size(), &encoded_key);
+    expected_accept_ = ComputeAcceptKey(encoded_key);
+
+    std::string request = "GET /ws?" + client_name_ + " HTTP/1.1\r\n";
+    request += "Host: " + server_address_.HostAsURIString() + "\r\n";
+    request += "Upgrade: websocket\r\n"
+               "Connection: Upgrade\r\n"
+               "Sec-WebSocket-Version: 13\r\n";
+    request += "Sec-WebSocket-Key: " + encoded_key + "\r\n\r\n";
+
+    state_ = HANDSHAKING;
+    Write(request);
+}
+
+void WebSocketTransport::OnRead(rtc::AsyncSocket* socket) {
+    char buffer[0xffff];
+    do {
+        int bytes = socket->Recv(buffer, sizeof(buffer), nullptr);
+        if (bytes <= 0)
+            break;
+        read_buffer_.append(buffer, bytes);
+    } while (true);
+
+    if (state_ == HANDSHAKING && !ReadHandshake())
+        return;
+    if (state_ == OPEN || state_ == CLOSING)
+        ReadFrames();
+}
+
+void WebSocketTransport::OnWrite(rtc::AsyncSocket* socket) {
+    Flush();
+}
+
+void WebSocketTransport::OnClose(rtc::AsyncSocket* socket, int err) {
+    qDebug() << __FUNCTION__ << err;
+    State state = state_;
+    Close();
+    if (state == HANDSHAKING) {
+        // Accepted the connection but hung up on the upgrade request.
+        observer_->OnTransportRejected();
+    } else if (state != CLOSED) {
+        observer_->OnTransportClosed(err);
+    }
+}
+
+bool WebSocketTransport::ReadHandshake() {
+    size_t eoh = read_buffer_.find("\r\n\r\n");
+    if (eoh == std::string::npos)
+        return false;
+
+    // Keep the CRLF of the last header line so GetHeader() can rely on it.
+    std::string headers = read_buffer_.substr(0, eoh + 2);
+    read_buffer_.erase(0, eoh + 4);
+
+    int status = -1;
+    size_t pos = headers.find(' ');
+    if (pos != std::string::npos)
+        status = atoi(&headers[pos + 1]);
+    if (status != 101 ||
+            GetHeader(headers, "Sec-WebSocket-Accept") != expected_accept_) {
+        qDebug() << "WebSocket upgrade refused, status" << status;
+        Close();
+        observer_->OnTransportRejected();
+        return false;
+    }
+
+    std::string pragma = GetHeader(headers, "Pragma");
+    my_id_ = pragma.empty() ? -1 : atoi(pragma.c_str());
+    state_ = OPEN;
+    return true;
+}
+
+void WebSocketTransport::ReadFrames() {
+    size_t pos = 0;
+    while (state_ == OPEN || state_ == CLOSING) {
+        size_t available = read_buffer_.size() - pos;
+        if (available < 2)
+            break;
+        const uint8_t* header =
+                reinterpret_cast<const uint8_t*>(read_buffer_.data() + pos);
+        bool fin = (header[0] & 0x80) != 0;
+        uint8_t opcode = header[0] & 0x0f;
+        bool masked = (header[1] & 0x80) != 0;
+        uint64_t length = header[1] & 0x7f;
+        size_t header_size = 2;
+        if (length == 126) {
+            if (available < 4)
+                break;
+            length = (header[2] << 8) | header[3];
+            header_size = 4;
+        } else if (length == 127) {
+            if (available < 10)
+                break;
+            length = 0;
+            for (int i = 0; i < 8; ++i)
+                length = (length << 8) | header[2 + i];
+            header_size = 10;
+        }
+        // Servers must not mask, but unmasking costs nothing.
+        if (masked)
+            header_size += 4;
+
+        if (length > kMaxMessageSize) {
+            qDebug() << "WebSocket frame too large:" << length;
+            Close();
+            observer_->OnTransportClosed(0);
+            return;
+        }
+        if (available < header_size + length)
+            break;
+
+        char* payload = &read_buffer_[pos + header_size];
+        if (masked) {
+            const uint8_t* mask = header + header_size - 4;
+            for (size_t i = 0; i < length; ++i)
+                payload[i] ^= mask[i % 4];
+        }
+        pos += header_size + length;
+        HandleFrame(fin, opcode, payload, static_cast<size_t>(length));
+    }
+    // HandleFrame() may have closed us, which already emptied the buffer.
+    if (state_ != CLOSED)
+        read_buffer_.erase(0, pos);
+}
+
+void WebSocketTransport::HandleFrame(bool fin, uint8_t opcode, const char* payload, size_t length) {
+    switch (opcode) {
+    case kOpText:
+    case kOpBinary:
+        fragments_.assign(payload, length);
+        in_message_ = true;
+        break;
+    case kOpContinuation:
+        // The frame limit alone would let a peer grow a message forever.
+        if (!in_message_ || fragments_.size() + length > kMaxMessageSize) {
+            qDebug() << (in_message_ ? "WebSocket message too large" :
+                                       "WebSocket continuation without a message");
+            Close();
+            observer_->OnTransportClosed(0);
+            return;
+        }
+        fragments_.append(payload, length);
+        break;
+    case kOpPing:
+        SendFrame(kOpPong, payload, length);
+        return;
+    case kOpPong:
+        return;
+    case kOpClose:
+        // Server-initiated; echo it back before going away.
+        if (state_ == OPEN && !SendFrame(kOpClose, payload, length < 2 ? length : 2))
+            return;
+        Close();
+        observer_->OnTransportClosed(0);
+        return;
+    default:
+        qDebug() << "Unknown WebSocket opcode" << opcode;
+        return;
+    }
+
+    if (fin) {
+        in_message_ = false;
+        std::string text;
+        text.swap(fragments_);
+        HandleTextMessage(text);
+    }
+}
+
+void WebSocketTransport::HandleTextMessage(const std::string& text) {
+    size_t eol = text.find('\n');
+    if (eol == std::string::npos) {
+        qDebug() << "Malformed signaling frame";
+        return;
+    }
+    int peer_id = atoi(text.c_str());
+    std::string body = text.substr(eol + 1);
+
+    if (!signed_in_) {
+        signed_in_ = true;
+        observer_->OnTransportSignedIn(my_id_, body);
+    } else if (peer_id == my_id_) {
+        observer_->OnTransportPeerNotification(body);
+    } else {
+        observer_->OnTransportMessage(peer_id, body);
+    }
+}
+
+bool WebSocketTransport::SendFrame(uint8_t opcode, const char* payload, size_t length) {
+    RTC_DCHECK(socket_);
+    std::string frame;
+    frame.reserve(length + 14);
+    frame += static_cast<char>(0x80 | opcode);
+    // Client frames are always masked (RFC 6455, section 5.3).
+    if (length < 126) {
+        frame += static_cast<char>(0x80 | length);
+    } else if (length <= 0xffff) {
+        frame += static_cast<char>(0x80 | 126);
+        frame += static_cast<char>(length >> 8);
+        frame += static_cast<char>(length & 0xff);
+    } else {
+        frame += static_cast<char>(0x80 | 127);
+        for (int shift = 56; shift >= 0; shift -= 8)
+            frame += static_cast<char>((static_cast<uint64_t>(length) >> shift) & 0xff);
+    }
+    uint32_t mask_key = rtc::CreateRandomId();
+    char mask[4];
+    memcpy(mask, &mask_key, sizeof(mask));
+    frame.append(mask, sizeof(mask));
+    size_t offset = frame.size();
+    frame.append(payload, length);
+    for (size_t i = 0; i < length; ++i)
+        frame[offset + i] ^= mask[i % 4];
+
+    return Write(frame);
+}
+
+bool WebSocketTransport::Write(const std::string& data) {
+    RTC_DCHECK(socket_);
+    // Frames must reach the stream whole and in order, so nothing skips
+    // the queue.
+    bool idle = write_buffer_.empty();
+    write_buffer_ += data;
+    return !idle || Flush();
+}
+
+bool WebSocketTransport::Flush() {
+    while (!write_buffer_.empty()) {
+        int sent = socket_->Send(write_buffer_.data(), write_buffer_.size());
+        if (sent < 0) {
+            if (socket_->IsBlocking())
+                return true;
+            int error = socket_->GetError();
+            qDebug() << "WebSocket write failed:" << error;
+            Close();
+            observer_->OnTransportClosed(error);
+            return false;
+        }
+        write_buffer_.erase(0, sent);
+    }
+    return true;
+}
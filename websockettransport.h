@@ -0,0 +1,74 @@
+#ifndef WEBSOCKETTRANSPORT_H
+#define WEBSOCKETTRANSPORT_H
+
+#include <stdint.h>
+#include <memory>
+#include <string>
+
+#include "rtc_base/async_socket.h"
+#include "rtc_base/third_party/sigslot/sigslot.h"
+#include "signalingtransport.h"
+
+// Carries the signaling protocol over one WebSocket (RFC 6455) connection.
+//
+// The client upgrades "GET /ws?<name>"; the 101 response carries our id in
+// the Pragma header, as /sign_in does.  Every text frame after that is
+// "<peer_id>\n<body>": from the server, peer_id is the sender and equals our
+// own id for peer notifications; from the client, it is the recipient.  The
+// first server frame is the peer list.  A close frame signs out.
+class WebSocketTransport : public SignalingTransport, public sigslot::has_slots<>
+{
+public:
+    WebSocketTransport();
+    ~WebSocketTransport() override;
+
+    void RegisterObserver(SignalingTransportObserver* observer) override;
+    bool SignIn(const rtc::SocketAddress& server,
+                const std::string& client_name) override;
+    bool Send(int peer_id, const std::string& message) override;
+    bool SignOut() override;
+    void Close() override;
+
+protected:
+    enum State {
+        CLOSED,
+        CONNECTING,
+        HANDSHAKING,
+        OPEN,
+        CLOSING,
+    };
+
+    void OnConnect(rtc::AsyncSocket* socket);
+    void OnRead(rtc::AsyncSocket* socket);
+    void OnWrite(rtc::AsyncSocket* socket);
+    void OnClose(rtc::AsyncSocket* socket, int err);
+
+    // Returns true once the upgrade response has been read and accepted.
+    bool ReadHandshake();
+    void ReadFrames();
+    void HandleFrame(bool fin, uint8_t opcode, const char* payload, size_t length);
+    void HandleTextMessage(const std::string& text);
+    // False if the connection failed, which has then been closed and
+    // reported.
+    bool SendFrame(uint8_t opcode, const char* payload, size_t length);
+    // Queues |data| behind anything not yet written and writes what the
+    // socket takes; the rest goes out from OnWrite().  Same result.
+    bool Write(const std::string& data);
+    bool Flush();
+
+    SignalingTransportObserver* observer_;
+    std::unique_ptr<rtc::AsyncSocket> socket_;
+    rtc::SocketAddress server_address_;
+    std::string client_name_;
+    std::string expected_accept_;
+    std::string read_buffer_;
+    std::string write_buffer_;
+    std::string fragments_;
+    State state_;
+    int my_id_;
+    bool signed_in_;
+    // A text or binary frame without FIN came in; |fragments_| holds it.
+    bool in_message_;
+};
+
+#endif // WEBSOCKETTRANSPORT_H
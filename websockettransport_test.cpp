@@ -0,0 +1,121 @@
+#include "tests.h"
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "rtc_base/physical_socket_server.h"
+#include "rtc_base/thread.h"
+#include "rtc_base/time_utils.h"
+#include "peerconnectionclient.h"
+#include "signalingserver.h"
+#include "websockettransport.h"
+
+namespace {
+
+const int kTimeoutMs = 5000;
+
+// Remembers what a client reported.
+struct RecordingObserver : public PeerConnectionClientObserver {
+    RecordingObserver()
+        : signed_in(false), disconnected(false), connection_failed(false) {}
+
+    void OnSignedIn() override { signed_in = true; }
+    void OnDisconnected() override { disconnected = true; }
+    void OnPeersConnected(const std::vector<int>& ids) override {
+        peers.insert(peers.end(), ids.begin(), ids.end());
+    }
+    void OnPeerConnected(int id, const std::string& name) override {
+        peers.push_back(id);
+    }
+    void OnPeerDisconnected(int peer_id) override { departed.push_back(peer_id); }
+    void OnMessageFromPeer(int peer_id, const std::string& message) override {
+        messages.push_back(std::make_pair(peer_id, message));
+    }
+    void OnMessageSent(int err) override {}
+    void OnMessageFailed(int peer_id) override {}
+    void OnServerConnectionFailure() override { connection_failed = true; }
+
+    bool HasPeer(int id) const {
+        return std::find(peers.begin(), peers.end(), id) != peers.end();
+    }
+    bool HasDeparted(int id) const {
+        return std::find(departed.begin(), departed.end(), id) != departed.end();
+    }
+
+    bool signed_in;
+    bool disconnected;
+    bool connection_failed;
+    std::vector<int> peers;
+    std::vector<int> departed;
+    std::vector<std::pair<int, std::string>> messages;
+};
+
+// Runs |thread|'s loop until |done| or kTimeoutMs pass.
+bool RunUntil(rtc::Thread* thread, const std::function<bool()>& done) {
+    int64_t deadline = rtc::TimeMillis() + kTimeoutMs;
+    while (!done()) {
+        if (rtc::TimeMillis() > deadline)
+            return false;
+        thread->ProcessMessages(10);
+    }
+    return true;
+}
+
+void ConnectOverWebSocket(PeerConnectionClient* client, RecordingObserver* observer,
+                          int port, const std::string& name) {
+    client->SetTransport(std::unique_ptr<SignalingTransport>(new WebSocketTransport()));
+    client->RegisterObserver(observer);
+    client->Connect("127.0.0.1", port, name);
+}
+
+}  // namespace
+
+// Two clients sign in over /ws to the in-repo server, exchange a message
+// and sign out, as the app does with --websocket.
+TEST(WebSocketSignInMessageSignOut) {
+    SignalingServer server;
+    ASSERT_TRUE(server.Listen(0));
+    std::thread serving([&server]() { server.Run(); });
+
+    {
+        rtc::PhysicalSocketServer socket_server;
+        rtc::AutoSocketServerThread thread(&socket_server);
+        RecordingObserver alice_events;
+        RecordingObserver bob_events;
+        PeerConnectionClient alice;
+        PeerConnectionClient bob;
+
+        ConnectOverWebSocket(&alice, &alice_events, server.port(), "alice");
+        EXPECT_TRUE(RunUntil(&thread, [&]() { return alice_events.signed_in; }));
+        ConnectOverWebSocket(&bob, &bob_events, server.port(), "bob");
+        EXPECT_TRUE(RunUntil(&thread, [&]() {
+            return bob_events.signed_in && alice_events.HasPeer(bob.id());
+        }));
+        EXPECT_TRUE(bob_events.HasPeer(alice.id()));
+        EXPECT_TRUE(!alice_events.connection_failed && !bob_events.connection_failed);
+
+        EXPECT_TRUE(alice.SendToPeer(bob.id(), "{\"type\":\"offer\"}"));
+        EXPECT_TRUE(RunUntil(&thread, [&]() { return !bob_events.messages.empty(); }));
+        if (!bob_events.messages.empty()) {
+            EXPECT_EQ(bob_events.messages[0].first, alice.id());
+            EXPECT_EQ(bob_events.messages[0].second, std::string("{\"type\":\"offer\"}"));
+        }
+
+        int alice_id = alice.id();
+        EXPECT_TRUE(alice.SignOut());
+        EXPECT_TRUE(RunUntil(&thread, [&]() {
+            return alice_events.disconnected && bob_events.HasDeparted(alice_id);
+        }));
+        EXPECT_TRUE(!alice.is_connected());
+
+        EXPECT_TRUE(bob.SignOut());
+        EXPECT_TRUE(RunUntil(&thread, [&]() { return bob_events.disconnected; }));
+    }
+
+    server.Stop();
+    serving.join();
+}